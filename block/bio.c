@@ -1371,8 +1371,12 @@ int submit_bio_wait(struct bio *bio)
 {
 	DECLARE_COMPLETION_ONSTACK_MAP(done,
 			bio->bi_bdev->bd_disk->lockdep_map);
+	struct psi_group *psi_prev;
 	unsigned long hang_check;
 
+	/* Charge the wait to the device the caller submitted to */
+	psi_prev = blk_psi_io_enter(bdev_get_queue(bio->bi_bdev));
+
 	bio->bi_private = &done;
 	bio->bi_end_io = submit_bio_wait_endio;
 	bio->bi_opf |= REQ_SYNC;
@@ -1387,6 +1391,8 @@ int submit_bio_wait(struct bio *bio)
 	else
 		wait_for_completion_io(&done);
 
+	blk_psi_io_leave(psi_prev);
+
 	return blk_status_to_errno(bio->bi_status);
 }
 EXPORT_SYMBOL(submit_bio_wait);
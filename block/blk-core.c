@@ -269,6 +269,7 @@ static void blk_free_queue(struct request_queue *q)
 
 	blk_free_queue_stats(q->stats);
 	kfree(q->poll_stat);
+	blk_psi_free(q);
 
 	if (queue_is_mq(q))
 		blk_mq_release(q);
@@ -414,6 +415,9 @@ struct request_queue *blk_alloc_queue(int node_id)
 	if (!q->stats)
 		goto fail_id;
 
+	if (blk_psi_alloc(q))
+		goto fail_psi;
+
 	q->node = node_id;
 
 	atomic_set(&q->nr_active_requests_shared_tags, 0);
@@ -446,6 +450,8 @@ struct request_queue *blk_alloc_queue(int node_id)
 	return q;
 
 fail_stats:
+	blk_psi_free(q);
+fail_psi:
 	blk_free_queue_stats(q->stats);
 fail_id:
 	ida_free(&blk_queue_ida, q->id);
@@ -126,6 +126,7 @@ unsigned long blk_mq_get_tags(struct blk_mq_alloc_data *data, int nr_tags,
 unsigned int blk_mq_get_tag(struct blk_mq_alloc_data *data)
 {
 	struct blk_mq_tags *tags = blk_mq_tags_from_data(data);
+	struct psi_group *psi_prev;
 	struct sbitmap_queue *bt;
 	struct sbq_wait_state *ws;
 	DEFINE_SBQ_WAIT(wait);
@@ -177,7 +178,9 @@ unsigned int blk_mq_get_tag(struct blk_mq_alloc_data *data)
 			break;
 
 		bt_prev = bt;
+		psi_prev = blk_psi_io_enter(data->q);
 		io_schedule();
+		blk_psi_io_leave(psi_prev);
 
 		sbitmap_finish_wait(bt, ws, &wait);
 
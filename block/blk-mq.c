@@ -1387,10 +1387,13 @@ blk_status_t blk_execute_rq(struct request *rq, bool at_head)
 	struct blk_rq_wait wait = {
 		.done = COMPLETION_INITIALIZER_ONSTACK(wait.done),
 	};
+	struct psi_group *psi_prev;
 
 	WARN_ON(irqs_disabled());
 	WARN_ON(!blk_rq_is_passthrough(rq));
 
+	psi_prev = blk_psi_io_enter(rq->q);
+
 	rq->end_io_data = &wait;
 	rq->end_io = blk_end_sync_rq;
 
@@ -1414,6 +1417,8 @@ blk_status_t blk_execute_rq(struct request *rq, bool at_head)
 			wait_for_completion_io(&wait.done);
 	}
 
+	blk_psi_io_leave(psi_prev);
+
 	return wait.ret;
 }
 EXPORT_SYMBOL(blk_execute_rq);
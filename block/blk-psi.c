@@ -0,0 +1,101 @@
+// SPDX-License-Identifier: GPL-2.0
+/*
+ * Per-device IO pressure.
+ *
+ * Tasks waiting for a request_queue, whether for a tag or for the
+ * completion of their IO, are charged to a pressure group owned by the
+ * queue. The group is exported as /sys/block/<disk>/io.pressure, which
+ * reads and accepts triggers like /proc/pressure/io.
+ */
+#include <linux/blkdev.h>
+#include <linux/kernfs.h>
+#include <linux/psi.h>
+#include <linux/seq_file.h>
+
+#include "blk.h"
+
+int blk_psi_alloc(struct request_queue *q)
+{
+	struct psi_group *group = psi_group_alloc();
+
+	if (IS_ERR(group))
+		return PTR_ERR(group);
+	q->psi = group;
+	return 0;
+}
+
+void blk_psi_free(struct request_queue *q)
+{
+	psi_group_free(q->psi);
+	q->psi = NULL;
+}
+
+static int blk_psi_show(struct seq_file *sf, void *v)
+{
+	struct kernfs_open_file *of = sf->private;
+	struct request_queue *q = of->kn->priv;
+
+	return psi_show(sf, q->psi, PSI_IO);
+}
+
+static ssize_t blk_psi_write(struct kernfs_open_file *of, char *buf,
+			     size_t nbytes, loff_t off)
+{
+	struct request_queue *q = of->kn->priv;
+	struct psi_trigger *new;
+
+	/* of->mutex serializes writers, allow one trigger per open file */
+	if (of->priv)
+		return -EBUSY;
+
+	new = psi_trigger_create(q->psi, strstrip(buf), PSI_IO);
+	if (IS_ERR(new))
+		return PTR_ERR(new);
+
+	smp_store_release(&of->priv, new);
+	return nbytes;
+}
+
+static __poll_t blk_psi_poll(struct kernfs_open_file *of,
+			     struct poll_table_struct *pt)
+{
+	return psi_trigger_poll(&of->priv, of->file, pt);
+}
+
+/* Also called by kernfs for files still open when the disk goes away */
+static void blk_psi_release(struct kernfs_open_file *of)
+{
+	psi_trigger_destroy(of->priv);
+}
+
+static const struct kernfs_ops blk_psi_kf_ops = {
+	.seq_show	= blk_psi_show,
+	.write		= blk_psi_write,
+	.poll		= blk_psi_poll,
+	.release	= blk_psi_release,
+};
+
+/*
+ * Triggers are tied to the open file, which plain sysfs attributes cannot
+ * express, so create the file with kernfs ops in the disk directory.
+ */
+int blk_psi_register(struct gendisk *disk)
+{
+	struct request_queue *q = disk->queue;
+	struct kernfs_node *kn;
+
+	if (!q->psi)
+		return 0;
+
+	kn = __kernfs_create_file(disk_to_dev(disk)->kobj.sd, "io.pressure",
+				  0644, GLOBAL_ROOT_UID, GLOBAL_ROOT_GID, 0,
+				  &blk_psi_kf_ops, q, NULL, NULL);
+	return PTR_ERR_OR_ZERO(kn);
+}
+
+void blk_psi_unregister(struct gendisk *disk)
+{
+	if (disk->queue->psi)
+		kernfs_remove_by_name(disk_to_dev(disk)->kobj.sd,
+				      "io.pressure");
+}
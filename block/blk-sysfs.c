@@ -816,6 +816,10 @@ int blk_register_queue(struct gendisk *disk)
 	if (ret)
 		goto out_elv_unregister;
 
+	ret = blk_psi_register(disk);
+	if (ret)
+		goto out_crypto_unregister;
+
 	blk_queue_flag_set(QUEUE_FLAG_REGISTERED, q);
 	wbt_enable_default(q);
 	blk_throtl_register(disk);
@@ -843,6 +847,8 @@ int blk_register_queue(struct gendisk *disk)
 
 	return ret;
 
+out_crypto_unregister:
+	blk_crypto_sysfs_unregister(disk);
 out_elv_unregister:
 	elv_unregister_queue(q);
 out_unregister_ia_ranges:
@@ -891,6 +897,7 @@ void blk_unregister_queue(struct gendisk *disk)
 	if (queue_is_mq(q))
 		blk_mq_sysfs_unregister(disk);
 	blk_crypto_sysfs_unregister(disk);
+	blk_psi_unregister(disk);
 
 	mutex_lock(&q->sysfs_lock);
 	elv_unregister_queue(q);
@@ -4,6 +4,7 @@
 
 #include <linux/blk-crypto.h>
 #include <linux/memblock.h>	/* for max_pfn/max_low_pfn */
+#include <linux/psi.h>
 #include <xen/xen.h>
 #include "blk-crypto-internal.h"
 
@@ -406,6 +407,33 @@ static inline void disk_free_zone_bitmaps(struct gendisk *disk) {}
 static inline void disk_clear_zone_settings(struct gendisk *disk) {}
 #endif
 
+#ifdef CONFIG_PSI
+int blk_psi_alloc(struct request_queue *q);
+void blk_psi_free(struct request_queue *q);
+int blk_psi_register(struct gendisk *disk);
+void blk_psi_unregister(struct gendisk *disk);
+
+/* Charge the iowait of the current task to @q until blk_psi_io_leave() */
+static inline struct psi_group *blk_psi_io_enter(struct request_queue *q)
+{
+	return psi_iodev_enter(q->psi);
+}
+#else
+static inline int blk_psi_alloc(struct request_queue *q) { return 0; }
+static inline void blk_psi_free(struct request_queue *q) {}
+static inline int blk_psi_register(struct gendisk *disk) { return 0; }
+static inline void blk_psi_unregister(struct gendisk *disk) {}
+static inline struct psi_group *blk_psi_io_enter(struct request_queue *q)
+{
+	return NULL;
+}
+#endif
+
+static inline void blk_psi_io_leave(struct psi_group *prev)
+{
+	psi_iodev_leave(prev);
+}
+
 int blk_alloc_ext_minor(void);
 void blk_free_ext_minor(unsigned int minor);
 #define ADDPART_FLAG_NONE	0
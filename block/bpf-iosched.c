@@ -0,0 +1,876 @@
+// SPDX-License-Identifier: GPL-2.0
+/*
+ * BPF programmable I/O scheduler. The insert, dispatch and completion
+ * decisions are delegated to a struct bpf_iosched_ops implemented by BPF
+ * struct_ops programs; the kernel side only keeps the requests, handles
+ * merging and falls back to FIFO dispatch whenever the policy is absent,
+ * misbehaves or lets a request starve.
+ *
+ * A policy is loaded as a BPF_MAP_TYPE_STRUCT_OPS map of type
+ * struct bpf_iosched_ops and selected per queue by writing its name to
+ * /sys/block/<dev>/queue/iosched/policy once "bpf" is the active
+ * scheduler. Writing "fifo" detaches the policy. Queues switched to "bpf"
+ * start out with the most recently registered policy.
+ *
+ * Dispatch order is: at_head insertions, requests the policy rejected or
+ * never saw, the policy's choice, and finally the oldest request owned
+ * by the policy if the policy returned nothing usable. Requests owned by
+ * the policy for longer than fifo_expire are dispatched regardless of
+ * the policy. A policy that returns max_errors invalid ids or insertion
+ * errors in a row is detached from the queue.
+ */
+#include <linux/kernel.h>
+#include <linux/blkdev.h>
+#include <linux/blk-mq.h>
+#include <linux/bpf.h>
+#include <linux/bpf_iosched.h>
+#include <linux/bpf_verifier.h>
+#include <linux/btf.h>
+#include <linux/init.h>
+#include <linux/rculist.h>
+#include <linux/slab.h>
+
+#include <trace/events/block.h>
+
+#include "elevator.h"
+#include "blk.h"
+#include "blk-mq.h"
+#include "blk-mq-debugfs.h"
+#include "blk-mq-sched.h"
+
+/* Time after which a request owned by the policy is dispatched anyway. */
+static const int fifo_expire = 10 * HZ;
+/* Consecutive policy errors after which the policy is detached. */
+static const int max_errors = 16;
+/* Number of times ->dispatch() is retried after returning a stale id. */
+#define BIS_DISPATCH_RETRIES	4
+
+/* rq->elv.priv[1] flags */
+enum {
+	BIS_RQ_INSERTED	= 1 << 0,	/* went through bis_insert_request() */
+	BIS_RQ_POLICY	= 1 << 1,	/* accepted by the policy */
+	BIS_RQ_QUEUED	= 1 << 2,	/* on bd->owned, waiting for dispatch */
+	BIS_RQ_BUSY	= 1 << 3,	/* dispatched, not yet completed */
+};
+
+struct bis_stats {
+	u64 inserted;
+	u64 merged;
+	u64 policy_dispatched;
+	u64 fifo_dispatched;
+	u64 expired;
+	u64 insert_errors;
+	u64 dispatch_errors;
+	u64 stale_ids;
+	u64 detached;
+};
+
+struct bis_data {
+	struct request_queue *q;
+	spinlock_t lock;
+
+	/* at_head insertions, dispatched before anything else */
+	struct list_head dispatch;
+	/* requests the policy does not know about, in insertion order */
+	struct list_head fifo;
+	/* requests owned by the policy, in insertion order */
+	struct list_head owned;
+	u32 nr_owned;
+	atomic_t nr_busy;
+
+	struct bpf_iosched_ops __rcu *ops;
+	/* first cookie handed out to the currently attached policy */
+	u32 attach_cookie;
+	u32 next_cookie;
+	unsigned int errors;
+
+	int fifo_expire;
+	int max_errors;
+
+	struct bis_stats stats;
+	atomic64_t nr_completed;
+
+	/* on bis_queues */
+	struct list_head node;
+};
+
+/*
+ * bis_mutex protects the list of registered policies and the list of
+ * queues using this scheduler. Attaching a policy to a queue also needs
+ * the queue's bd->lock.
+ */
+static DEFINE_MUTEX(bis_mutex);
+static LIST_HEAD(bis_policies);
+static LIST_HEAD(bis_queues);
+
+static inline unsigned long bis_rq_flags(struct request *rq)
+{
+	return (uintptr_t)rq->elv.priv[1];
+}
+
+static inline void bis_set_rq_flags(struct request *rq, unsigned long flags)
+{
+	rq->elv.priv[1] = (void *)(uintptr_t)flags;
+}
+
+static inline u32 bis_rq_cookie(struct request *rq)
+{
+	return (uintptr_t)rq->elv.priv[0];
+}
+
+/*
+ * Request ids handed to BPF encode the cookie assigned at insertion time,
+ * the hardware queue and the scheduler tag, so that they can be mapped
+ * back to a request without any lookup structure.
+ */
+static u64 bis_rq_id(struct request *rq)
+{
+	return ((u64)bis_rq_cookie(rq) << 32) |
+		((u64)(rq->mq_hctx->queue_num & 0xffff) << 16) |
+		(rq->internal_tag & 0xffff);
+}
+
+static struct request *bis_rq_from_id(struct bis_data *bd, u64 id,
+				      bool *stale)
+{
+	unsigned int hctx_idx = (id >> 16) & 0xffff;
+	unsigned int tag = id & 0xffff;
+	u32 cookie = id >> 32;
+	struct blk_mq_hw_ctx *hctx;
+	struct request *rq;
+
+	*stale = false;
+	if (!cookie || hctx_idx >= bd->q->nr_hw_queues)
+		return NULL;
+	hctx = xa_load(&bd->q->hctx_table, hctx_idx);
+	if (!hctx || !hctx->sched_tags || tag >= hctx->sched_tags->nr_tags)
+		return NULL;
+	rq = hctx->sched_tags->static_rqs[tag];
+	if (!rq)
+		return NULL;
+
+	if (rq->q != bd->q || bis_rq_cookie(rq) != cookie ||
+	    !(bis_rq_flags(rq) & BIS_RQ_QUEUED)) {
+		/* Well formed, but dispatched or merged in the meantime. */
+		*stale = true;
+		return NULL;
+	}
+	return rq;
+}
+
+static u32 bis_dev(struct bis_data *bd)
+{
+	return bd->q->disk ? disk_devt(bd->q->disk) : 0;
+}
+
+static void bis_fill_rq(struct bis_data *bd, struct request *rq,
+			struct bpf_iosched_rq *info)
+{
+	info->id = bis_rq_id(rq);
+	info->sector = blk_rq_pos(rq);
+	info->nr_sectors = blk_rq_sectors(rq);
+	info->opf = rq->cmd_flags;
+	info->dev = bis_dev(bd);
+	info->ioprio = req_get_ioprio(rq);
+	info->hctx = rq->mq_hctx->queue_num;
+	info->start_time_ns = rq->start_time_ns;
+}
+
+/*
+ * Hand all requests owned by the policy back to the FIFO. Called with
+ * bd->lock held when the policy goes away.
+ */
+static void bis_disown_all(struct bis_data *bd)
+{
+	struct request *rq;
+
+	lockdep_assert_held(&bd->lock);
+
+	list_for_each_entry(rq, &bd->owned, queuelist)
+		bis_set_rq_flags(rq, bis_rq_flags(rq) & ~BIS_RQ_QUEUED);
+	list_splice_init(&bd->owned, &bd->fifo);
+	bd->nr_owned = 0;
+}
+
+/*
+ * Replace the policy attached to @bd. The reference on @ops, if any, is
+ * transferred to @bd. The reference on the previous policy is dropped;
+ * its programs are freed after an RCU grace period so concurrent
+ * completion callbacks are safe.
+ */
+static void bis_attach_locked(struct bis_data *bd, struct bpf_iosched_ops *ops)
+{
+	struct bpf_iosched_ops *old;
+
+	lockdep_assert_held(&bd->lock);
+
+	old = rcu_replace_pointer(bd->ops, ops, lockdep_is_held(&bd->lock));
+	if (old) {
+		bis_disown_all(bd);
+		bpf_struct_ops_put(old);
+	}
+	WRITE_ONCE(bd->attach_cookie, bd->next_cookie);
+	bd->errors = 0;
+}
+
+static void bis_attach(struct bis_data *bd, struct bpf_iosched_ops *ops)
+{
+	spin_lock(&bd->lock);
+	bis_attach_locked(bd, ops);
+	spin_unlock(&bd->lock);
+	blk_mq_run_hw_queues(bd->q, true);
+}
+
+/*
+ * Account a policy error. Returns true if the policy has been detached
+ * because it kept misbehaving.
+ */
+static bool bis_policy_error(struct bis_data *bd, struct bpf_iosched_ops *ops)
+{
+	lockdep_assert_held(&bd->lock);
+
+	if (++bd->errors < bd->max_errors)
+		return false;
+
+	pr_warn_ratelimited("bpf-iosched: detaching policy %s from %s after %u errors, falling back to FIFO\n",
+			    ops->name,
+			    bd->q->disk ? bd->q->disk->disk_name : "?",
+			    bd->errors);
+	bd->stats.detached++;
+	bis_attach_locked(bd, NULL);
+	return true;
+}
+
+static u32 bis_next_cookie(struct bis_data *bd)
+{
+	if (unlikely(!++bd->next_cookie))
+		++bd->next_cookie;
+	return bd->next_cookie;
+}
+
+/*
+ * Remove @rq from whichever list it is on and from the merge hash.
+ */
+static void bis_remove_request(struct bis_data *bd, struct request *rq)
+{
+	struct request_queue *q = bd->q;
+	unsigned long flags = bis_rq_flags(rq);
+
+	list_del_init(&rq->queuelist);
+	if (flags & BIS_RQ_QUEUED) {
+		bis_set_rq_flags(rq, flags & ~BIS_RQ_QUEUED);
+		bd->nr_owned--;
+	}
+
+	elv_rqhash_del(q, rq);
+	if (q->last_merge == rq)
+		q->last_merge = NULL;
+}
+
+static void bis_insert_request(struct bis_data *bd, struct blk_mq_hw_ctx *hctx,
+			       struct request *rq, bool at_head)
+{
+	struct request_queue *q = hctx->queue;
+	struct bpf_iosched_ops *ops;
+	struct bpf_iosched_rq info;
+	LIST_HEAD(free);
+
+	lockdep_assert_held(&bd->lock);
+
+	if (blk_mq_sched_try_insert_merge(q, rq, &free)) {
+		blk_mq_free_requests(&free);
+		return;
+	}
+
+	trace_block_rq_insert(rq);
+
+	bd->stats.inserted++;
+	/* A requeued request starts over. */
+	bis_set_rq_flags(rq, BIS_RQ_INSERTED);
+	rq->fifo_time = jiffies;
+
+	if (at_head) {
+		list_add(&rq->queuelist, &bd->dispatch);
+		return;
+	}
+
+	if (rq_mergeable(rq)) {
+		elv_rqhash_add(q, rq);
+		if (!q->last_merge)
+			q->last_merge = rq;
+	}
+
+	ops = rcu_dereference(bd->ops);
+	if (!ops || blk_rq_is_passthrough(rq)) {
+		list_add_tail(&rq->queuelist, &bd->fifo);
+		return;
+	}
+
+	rq->elv.priv[0] = (void *)(uintptr_t)bis_next_cookie(bd);
+	bis_fill_rq(bd, rq, &info);
+	if (ops->insert(&info) < 0) {
+		bd->stats.insert_errors++;
+		list_add_tail(&rq->queuelist, &bd->fifo);
+		bis_policy_error(bd, ops);
+		return;
+	}
+
+	bd->errors = 0;
+	bis_set_rq_flags(rq, BIS_RQ_INSERTED | BIS_RQ_POLICY | BIS_RQ_QUEUED);
+	list_add_tail(&rq->queuelist, &bd->owned);
+	bd->nr_owned++;
+}
+
+static void bis_insert_requests(struct blk_mq_hw_ctx *hctx,
+				struct list_head *list, bool at_head)
+{
+	struct bis_data *bd = hctx->queue->elevator->elevator_data;
+
+	spin_lock(&bd->lock);
+	rcu_read_lock();
+	while (!list_empty(list)) {
+		struct request *rq;
+
+		rq = list_first_entry(list, struct request, queuelist);
+		list_del_init(&rq->queuelist);
+		bis_insert_request(bd, hctx, rq, at_head);
+	}
+	rcu_read_unlock();
+	spin_unlock(&bd->lock);
+}
+
+/*
+ * Ask the policy for the next request. Returns NULL if the policy has
+ * nothing to say or keeps returning invalid ids.
+ */
+static struct request *bis_policy_dispatch(struct bis_data *bd,
+					   struct bpf_iosched_ops *ops,
+					   struct blk_mq_hw_ctx *hctx)
+{
+	struct bpf_iosched_queue qinfo = {
+		.dev		= bis_dev(bd),
+		.hctx		= hctx->queue_num,
+		.nr_queued	= bd->nr_owned,
+		.nr_busy	= atomic_read(&bd->nr_busy),
+	};
+	struct request *rq;
+	bool stale;
+	int i;
+
+	for (i = 0; i < BIS_DISPATCH_RETRIES; i++) {
+		u64 id = ops->dispatch(&qinfo);
+
+		if (!id)
+			return NULL;
+
+		rq = bis_rq_from_id(bd, id, &stale);
+		if (rq) {
+			bd->errors = 0;
+			return rq;
+		}
+		if (stale) {
+			bd->stats.stale_ids++;
+			continue;
+		}
+		bd->stats.dispatch_errors++;
+		if (bis_policy_error(bd, ops))
+			return NULL;
+	}
+
+	return NULL;
+}
+
+static struct request *bis_dispatch_request(struct blk_mq_hw_ctx *hctx)
+{
+	struct bis_data *bd = hctx->queue->elevator->elevator_data;
+	struct bpf_iosched_ops *ops;
+	struct request *rq;
+
+	spin_lock(&bd->lock);
+	rq = list_first_entry_or_null(&bd->dispatch, struct request, queuelist);
+	if (rq) {
+		list_del_init(&rq->queuelist);
+		goto unlock;
+	}
+
+	/* Requests the policy never saw do not wait on its decisions. */
+	rq = list_first_entry_or_null(&bd->fifo, struct request, queuelist);
+	if (rq) {
+		bd->stats.fifo_dispatched++;
+		goto remove;
+	}
+
+	rq = list_first_entry_or_null(&bd->owned, struct request, queuelist);
+	if (!rq)
+		goto unlock;
+
+	/* Do not let a buggy or unfair policy starve anybody. */
+	if (time_after_eq(jiffies, (unsigned long)rq->fifo_time +
+				   bd->fifo_expire)) {
+		bd->stats.expired++;
+		goto busy;
+	}
+
+	rcu_read_lock();
+	ops = rcu_dereference(bd->ops);
+	if (ops) {
+		struct request *prq = bis_policy_dispatch(bd, ops, hctx);
+
+		if (prq) {
+			rq = prq;
+			bd->stats.policy_dispatched++;
+			rcu_read_unlock();
+			goto busy;
+		}
+	}
+	rcu_read_unlock();
+
+	/*
+	 * The policy had nothing to offer, or was detached and its requests
+	 * went back to the FIFO.
+	 */
+	rq = list_first_entry_or_null(&bd->fifo, struct request, queuelist);
+	if (!rq)
+		rq = list_first_entry_or_null(&bd->owned, struct request,
+					      queuelist);
+	if (!rq)
+		goto unlock;
+	bd->stats.fifo_dispatched++;
+
+busy:
+	if (bis_rq_flags(rq) & BIS_RQ_QUEUED) {
+		bis_set_rq_flags(rq, bis_rq_flags(rq) | BIS_RQ_BUSY);
+		atomic_inc(&bd->nr_busy);
+	}
+remove:
+	bis_remove_request(bd, rq);
+unlock:
+	spin_unlock(&bd->lock);
+
+	return rq;
+}
+
+static bool bis_has_work(struct blk_mq_hw_ctx *hctx)
+{
+	struct bis_data *bd = hctx->queue->elevator->elevator_data;
+
+	return !list_empty_careful(&bd->dispatch) ||
+		!list_empty_careful(&bd->fifo) ||
+		!list_empty_careful(&bd->owned);
+}
+
+static bool bis_bio_merge(struct request_queue *q, struct bio *bio,
+			  unsigned int nr_segs)
+{
+	struct bis_data *bd = q->elevator->elevator_data;
+	struct request *free = NULL;
+	bool ret;
+
+	spin_lock(&bd->lock);
+	ret = blk_mq_sched_try_merge(q, bio, nr_segs, &free);
+	spin_unlock(&bd->lock);
+
+	if (free)
+		blk_mq_free_request(free);
+
+	return ret;
+}
+
+/*
+ * Callback function that is invoked after @next has been merged into @req.
+ * The policy may still hold the id of @next; it will be reported as stale.
+ */
+static void bis_requests_merged(struct request_queue *q, struct request *req,
+				struct request *next)
+{
+	struct bis_data *bd = q->elevator->elevator_data;
+
+	lockdep_assert_held(&bd->lock);
+
+	bd->stats.merged++;
+	bis_remove_request(bd, next);
+}
+
+/* Callback from inside blk_mq_rq_ctx_init(). */
+static void bis_prepare_request(struct request *rq)
+{
+	rq->elv.priv[0] = NULL;
+	rq->elv.priv[1] = NULL;
+}
+
+static void bis_completed_request(struct request *rq, u64 now)
+{
+	struct bis_data *bd = rq->q->elevator->elevator_data;
+	struct bpf_iosched_ops *ops;
+	struct bpf_iosched_rq info;
+
+	if (!(bis_rq_flags(rq) & BIS_RQ_POLICY))
+		return;
+
+	rcu_read_lock();
+	ops = rcu_dereference(bd->ops);
+	/* Skip requests inserted before the current policy was attached. */
+	if (ops && ops->completed &&
+	    (s32)(bis_rq_cookie(rq) - READ_ONCE(bd->attach_cookie)) > 0) {
+		bis_fill_rq(bd, rq, &info);
+		ops->completed(&info, now);
+	}
+	rcu_read_unlock();
+}
+
+static void bis_requeue_request(struct request *rq)
+{
+	struct bis_data *bd = rq->q->elevator->elevator_data;
+	unsigned long flags = bis_rq_flags(rq);
+
+	if (flags & BIS_RQ_BUSY) {
+		atomic_dec(&bd->nr_busy);
+		bis_set_rq_flags(rq, flags & ~BIS_RQ_BUSY);
+	}
+}
+
+/*
+ * Callback from inside blk_mq_free_request(). The block layer core may
+ * call this without having called bis_insert_requests().
+ */
+static void bis_finish_request(struct request *rq)
+{
+	struct bis_data *bd = rq->q->elevator->elevator_data;
+
+	if (!(bis_rq_flags(rq) & BIS_RQ_INSERTED))
+		return;
+
+	atomic64_inc(&bd->nr_completed);
+	bis_requeue_request(rq);
+}
+
+static int bis_init_sched(struct request_queue *q, struct elevator_type *e)
+{
+	struct bpf_iosched_ops *ops;
+	struct elevator_queue *eq;
+	struct bis_data *bd;
+
+	eq = elevator_alloc(q, e);
+	if (!eq)
+		return -ENOMEM;
+
+	bd = kzalloc_node(sizeof(*bd), GFP_KERNEL, q->node);
+	if (!bd) {
+		kobject_put(&eq->kobj);
+		return -ENOMEM;
+	}
+
+	bd->q = q;
+	spin_lock_init(&bd->lock);
+	INIT_LIST_HEAD(&bd->dispatch);
+	INIT_LIST_HEAD(&bd->fifo);
+	INIT_LIST_HEAD(&bd->owned);
+	atomic_set(&bd->nr_busy, 0);
+	bd->fifo_expire = fifo_expire;
+	bd->max_errors = max_errors;
+	eq->elevator_data = bd;
+
+	/* We dispatch from request queue wide instead of hw queue */
+	blk_queue_flag_set(QUEUE_FLAG_SQ_SCHED, q);
+
+	/* Start out with the most recently registered policy, if any. */
+	mutex_lock(&bis_mutex);
+	ops = list_first_entry_or_null(&bis_policies, struct bpf_iosched_ops,
+				       list);
+	if (ops && bpf_struct_ops_get(ops))
+		RCU_INIT_POINTER(bd->ops, ops);
+	list_add(&bd->node, &bis_queues);
+	mutex_unlock(&bis_mutex);
+
+	q->elevator = eq;
+	return 0;
+}
+
+static void bis_exit_sched(struct elevator_queue *e)
+{
+	struct bis_data *bd = e->elevator_data;
+
+	mutex_lock(&bis_mutex);
+	list_del(&bd->node);
+	spin_lock(&bd->lock);
+	bis_attach_locked(bd, NULL);
+	WARN_ON_ONCE(!list_empty(&bd->dispatch));
+	WARN_ON_ONCE(!list_empty(&bd->fifo));
+	spin_unlock(&bd->lock);
+	mutex_unlock(&bis_mutex);
+
+	kfree(bd);
+}
+
+/*
+ * sysfs parts below
+ */
+static struct bpf_iosched_ops *bis_find_policy(const char *name)
+{
+	struct bpf_iosched_ops *ops;
+
+	lockdep_assert_held(&bis_mutex);
+
+	list_for_each_entry(ops, &bis_policies, list)
+		if (!strcmp(ops->name, name))
+			return ops;
+	return NULL;
+}
+
+static ssize_t bis_policy_show(struct elevator_queue *e, char *page)
+{
+	struct bis_data *bd = e->elevator_data;
+	struct bpf_iosched_ops *cur, *ops;
+	int len = 0;
+
+	mutex_lock(&bis_mutex);
+	cur = rcu_dereference_protected(bd->ops, lockdep_is_held(&bis_mutex));
+	if (!cur)
+		len += sysfs_emit_at(page, len, "[fifo] ");
+	else
+		len += sysfs_emit_at(page, len, "fifo ");
+	list_for_each_entry(ops, &bis_policies, list) {
+		if (ops == cur)
+			len += sysfs_emit_at(page, len, "[%s] ", ops->name);
+		else
+			len += sysfs_emit_at(page, len, "%s ", ops->name);
+	}
+	mutex_unlock(&bis_mutex);
+
+	len += sysfs_emit_at(page, len, "\n");
+	return len;
+}
+
+static ssize_t bis_policy_store(struct elevator_queue *e, const char *page,
+				size_t count)
+{
+	struct bis_data *bd = e->elevator_data;
+	struct bpf_iosched_ops *ops = NULL;
+	char buf[BPF_IOSCHED_NAME_MAX], *name;
+	int ret = count;
+
+	strscpy(buf, page, sizeof(buf));
+	name = strim(buf);
+
+	mutex_lock(&bis_mutex);
+	if (strcmp(name, "fifo")) {
+		ops = bis_find_policy(name);
+		if (!ops || !bpf_struct_ops_get(ops)) {
+			ret = -EINVAL;
+			goto unlock;
+		}
+	}
+	bis_attach(bd, ops);
+unlock:
+	mutex_unlock(&bis_mutex);
+
+	return ret;
+}
+
+#define SHOW_INT(__FUNC, __VAR)						\
+static ssize_t __FUNC(struct elevator_queue *e, char *page)		\
+{									\
+	struct bis_data *bd = e->elevator_data;				\
+									\
+	return sysfs_emit(page, "%d\n", __VAR);				\
+}
+SHOW_INT(bis_fifo_expire_show, jiffies_to_msecs(bd->fifo_expire));
+SHOW_INT(bis_max_errors_show, bd->max_errors);
+#undef SHOW_INT
+
+#define STORE_FUNCTION(__FUNC, __PTR, MIN, MAX, __CONV)			\
+static ssize_t __FUNC(struct elevator_queue *e, const char *page, size_t count)	\
+{									\
+	struct bis_data *bd = e->elevator_data;				\
+	int __data, __ret;						\
+									\
+	__ret = kstrtoint(page, 0, &__data);				\
+	if (__ret < 0)							\
+		return __ret;						\
+	if (__data < (MIN))						\
+		__data = (MIN);						\
+	else if (__data > (MAX))					\
+		__data = (MAX);						\
+	*(__PTR) = __CONV(__data);					\
+	return count;							\
+}
+STORE_FUNCTION(bis_fifo_expire_store, &bd->fifo_expire, 1, INT_MAX,
+	       msecs_to_jiffies);
+STORE_FUNCTION(bis_max_errors_store, &bd->max_errors, 1, INT_MAX, );
+#undef STORE_FUNCTION
+
+#define BIS_ATTR(name) \
+	__ATTR(name, 0644, bis_##name##_show, bis_##name##_store)
+
+static struct elv_fs_entry bis_attrs[] = {
+	BIS_ATTR(policy),
+	BIS_ATTR(fifo_expire),
+	BIS_ATTR(max_errors),
+	__ATTR_NULL
+};
+
+#ifdef CONFIG_BLK_DEBUG_FS
+static int bis_stats_show(void *data, struct seq_file *m)
+{
+	struct request_queue *q = data;
+	struct bis_data *bd = q->elevator->elevator_data;
+	struct bis_stats stats;
+	u32 nr_owned;
+
+	spin_lock(&bd->lock);
+	stats = bd->stats;
+	nr_owned = bd->nr_owned;
+	spin_unlock(&bd->lock);
+
+	seq_printf(m, "inserted %llu\n", stats.inserted);
+	seq_printf(m, "merged %llu\n", stats.merged);
+	seq_printf(m, "policy_dispatched %llu\n", stats.policy_dispatched);
+	seq_printf(m, "fifo_dispatched %llu\n", stats.fifo_dispatched);
+	seq_printf(m, "expired %llu\n", stats.expired);
+	seq_printf(m, "completed %lld\n", atomic64_read(&bd->nr_completed));
+	seq_printf(m, "insert_errors %llu\n", stats.insert_errors);
+	seq_printf(m, "dispatch_errors %llu\n", stats.dispatch_errors);
+	seq_printf(m, "stale_ids %llu\n", stats.stale_ids);
+	seq_printf(m, "detached %llu\n", stats.detached);
+	seq_printf(m, "owned %u\n", nr_owned);
+	seq_printf(m, "busy %d\n", atomic_read(&bd->nr_busy));
+	return 0;
+}
+
+static const struct blk_mq_debugfs_attr bis_queue_debugfs_attrs[] = {
+	{"stats", 0400, bis_stats_show},
+	{},
+};
+#endif
+
+static struct elevator_type bpf_iosched = {
+	.ops = {
+		.insert_requests	= bis_insert_requests,
+		.dispatch_request	= bis_dispatch_request,
+		.prepare_request	= bis_prepare_request,
+		.completed_request	= bis_completed_request,
+		.requeue_request	= bis_requeue_request,
+		.finish_request		= bis_finish_request,
+		.bio_merge		= bis_bio_merge,
+		.requests_merged	= bis_requests_merged,
+		.has_work		= bis_has_work,
+		.init_sched		= bis_init_sched,
+		.exit_sched		= bis_exit_sched,
+	},
+
+#ifdef CONFIG_BLK_DEBUG_FS
+	.queue_debugfs_attrs = bis_queue_debugfs_attrs,
+#endif
+	.elevator_attrs = bis_attrs,
+	.elevator_name = "bpf",
+	.elevator_owner = THIS_MODULE,
+};
+
+/*
+ * struct_ops glue
+ */
+static int bpf_iosched_init(struct btf *btf)
+{
+	return 0;
+}
+
+static const struct bpf_func_proto *
+bpf_iosched_get_func_proto(enum bpf_func_id func_id,
+			   const struct bpf_prog *prog)
+{
+	return bpf_base_func_proto(func_id);
+}
+
+static bool bpf_iosched_is_valid_access(int off, int size,
+					enum bpf_access_type type,
+					const struct bpf_prog *prog,
+					struct bpf_insn_access_aux *info)
+{
+	return bpf_tracing_btf_ctx_access(off, size, type, prog, info);
+}
+
+/* No btf_struct_access: the request and queue views are read-only. */
+static const struct bpf_verifier_ops bpf_iosched_verifier_ops = {
+	.get_func_proto		= bpf_iosched_get_func_proto,
+	.is_valid_access	= bpf_iosched_is_valid_access,
+};
+
+static int bpf_iosched_check_member(const struct btf_type *t,
+				    const struct btf_member *member)
+{
+	return 0;
+}
+
+static int bpf_iosched_init_member(const struct btf_type *t,
+				   const struct btf_member *member,
+				   void *kdata, const void *udata)
+{
+	const struct bpf_iosched_ops *uops = udata;
+	struct bpf_iosched_ops *ops = kdata;
+	u32 moff = __btf_member_bit_offset(t, member) / 8;
+	int prog_fd;
+
+	switch (moff) {
+	case offsetof(struct bpf_iosched_ops, name):
+		if (bpf_obj_name_cpy(ops->name, uops->name,
+				     sizeof(ops->name)) <= 0)
+			return -EINVAL;
+		if (!strcmp(ops->name, "fifo"))
+			return -EINVAL;
+		return 1;
+	case offsetof(struct bpf_iosched_ops, insert):
+	case offsetof(struct bpf_iosched_ops, dispatch):
+		/* Ensure bpf_prog is provided for compulsory func ptr */
+		prog_fd = (int)(*(unsigned long *)(udata + moff));
+		if (!prog_fd)
+			return -EINVAL;
+		break;
+	}
+
+	return 0;
+}
+
+static int bpf_iosched_reg(void *kdata)
+{
+	struct bpf_iosched_ops *ops = kdata;
+	int ret = 0;
+
+	mutex_lock(&bis_mutex);
+	if (bis_find_policy(ops->name))
+		ret = -EEXIST;
+	else
+		list_add(&ops->list, &bis_policies);
+	mutex_unlock(&bis_mutex);
+
+	return ret;
+}
+
+static void bpf_iosched_unreg(void *kdata)
+{
+	struct bpf_iosched_ops *ops = kdata;
+	struct bis_data *bd;
+
+	mutex_lock(&bis_mutex);
+	list_del(&ops->list);
+	list_for_each_entry(bd, &bis_queues, node) {
+		if (rcu_access_pointer(bd->ops) == ops)
+			bis_attach(bd, NULL);
+	}
+	mutex_unlock(&bis_mutex);
+}
+
+struct bpf_struct_ops bpf_bpf_iosched_ops = {
+	.verifier_ops	= &bpf_iosched_verifier_ops,
+	.init		= bpf_iosched_init,
+	.check_member	= bpf_iosched_check_member,
+	.init_member	= bpf_iosched_init_member,
+	.reg		= bpf_iosched_reg,
+	.unreg		= bpf_iosched_unreg,
+	.name		= "bpf_iosched_ops",
+};
+
+static int __init bpf_iosched_elv_init(void)
+{
+	return elv_register(&bpf_iosched);
+}
+device_initcall(bpf_iosched_elv_init);
@@ -171,6 +171,7 @@ static ssize_t __blkdev_direct_IO(struct kiocb *iocb, struct iov_iter *iter,
 		unsigned int nr_pages)
 {
 	struct block_device *bdev = iocb->ki_filp->private_data;
+	struct psi_group *psi_prev;
 	struct blk_plug plug;
 	struct blkdev_dio *dio;
 	struct bio *bio;
@@ -249,6 +250,7 @@ static ssize_t __blkdev_direct_IO(struct kiocb *iocb, struct iov_iter *iter,
 	if (!is_sync)
 		return -EIOCBQUEUED;
 
+	psi_prev = blk_psi_io_enter(bdev_get_queue(bdev));
 	for (;;) {
 		set_current_state(TASK_UNINTERRUPTIBLE);
 		if (!READ_ONCE(dio->waiter))
@@ -256,6 +258,7 @@ static ssize_t __blkdev_direct_IO(struct kiocb *iocb, struct iov_iter *iter,
 		blk_io_schedule();
 	}
 	__set_current_state(TASK_RUNNING);
+	blk_psi_io_leave(psi_prev);
 
 	if (!ret)
 		ret = blk_status_to_errno(dio->bio.bi_status);
@@ -0,0 +1,412 @@
+// SPDX-License-Identifier: GPL-2.0
+/*
+ * Offload of bulk page-to-page copies to a DMA_MEMCPY capable channel.
+ *
+ * The service is off by default. Writing 1 to
+ * /sys/module/dma_copy/parameters/enable (or booting with dma_copy.enable=1)
+ * claims one channel able to do DMA_MEMCPY. From then on, batches handed to
+ * dma_copy_submit() are mapped and queued on that channel, one descriptor
+ * per entry, and the callback runs once the last of them completed. Only
+ * whole cache lines of a destination are given to the channel, the CPU
+ * copies the partial lines at either end. Batches that cannot go to the
+ * channel, because it is not claimed, the offsets do not meet its alignment
+ * or mapping or descriptor preparation fails, are copied by the CPU
+ * instead, and so are those the channel reports an error for, so users
+ * never see a failed copy.
+ *
+ * Users call dma_copy_worthwhile() to decide whether an operation is large
+ * enough, as set by the threshold parameter, to be worth the mapping and
+ * interrupt cost. Counters are in /sys/kernel/debug/dma_copy.
+ */
+#define pr_fmt(fmt) KBUILD_MODNAME ": " fmt
+
+#include <linux/atomic.h>
+#include <linux/completion.h>
+#include <linux/debugfs.h>
+#include <linux/dma-copy.h>
+#include <linux/dma-mapping.h>
+#include <linux/dmaengine.h>
+#include <linux/init.h>
+#include <linux/moduleparam.h>
+#include <linux/mutex.h>
+#include <linux/seq_file.h>
+#include <linux/sizes.h>
+#include <linux/slab.h>
+#include <linux/wait_bit.h>
+
+static unsigned int threshold = SZ_64K;
+module_param(threshold, uint, 0644);
+MODULE_PARM_DESC(threshold,
+		 "Smallest operation, in bytes, worth offloading (default: 64K)");
+
+struct dma_copy_req {
+	struct dma_chan		*chan;
+	struct dma_copy_batch	batch;
+	dma_addr_t		src[DMA_COPY_BATCH_MAX];
+	dma_addr_t		dst[DMA_COPY_BATCH_MAX];
+	unsigned int		mapped;
+	atomic_t		pending;	/* descriptors, plus one for issue */
+	bool			failed;
+	bool			shared;		/* counted in dma_copy_inflight */
+	dma_copy_done_t		done;
+	void			*param;
+};
+
+static DEFINE_MUTEX(dma_copy_mutex);
+static bool dma_copy_enable;
+static bool dma_copy_ready;		/* channels may have been registered */
+static struct dma_chan *dma_copy_chan;	/* NULL unless enabled */
+static atomic_t dma_copy_inflight;	/* submitters that may use the channel */
+
+static atomic_long_t dma_copy_batches;
+static atomic_long_t dma_copy_dma_bytes;
+static atomic_long_t dma_copy_cpu_bytes;
+static atomic_long_t dma_copy_fallbacks;
+
+static int dma_copy_start(void)
+{
+	struct dma_chan *chan;
+	dma_cap_mask_t mask;
+
+	dma_cap_zero(mask);
+	dma_cap_set(DMA_MEMCPY, mask);
+	chan = dma_request_chan_by_mask(&mask);
+	if (IS_ERR(chan))
+		return PTR_ERR(chan);
+
+	pr_info("offloading copies to %s\n", dma_chan_name(chan));
+	WRITE_ONCE(dma_copy_chan, chan);
+	return 0;
+}
+
+static void dma_copy_stop(void)
+{
+	struct dma_chan *chan = dma_copy_chan;
+
+	if (!chan)
+		return;
+
+	WRITE_ONCE(dma_copy_chan, NULL);
+	/* Pairs with the barrier in dma_copy_submit() */
+	smp_mb();
+	wait_var_event(&dma_copy_inflight, !atomic_read(&dma_copy_inflight));
+	dma_release_channel(chan);
+}
+
+static int dma_copy_enable_set(const char *val, const struct kernel_param *kp)
+{
+	bool enable;
+	int ret;
+
+	ret = kstrtobool(val, &enable);
+	if (ret)
+		return ret;
+
+	mutex_lock(&dma_copy_mutex);
+	if (dma_copy_ready) {
+		if (enable && !dma_copy_chan)
+			ret = dma_copy_start();
+		else if (!enable)
+			dma_copy_stop();
+	}
+	if (!ret)
+		dma_copy_enable = enable;
+	mutex_unlock(&dma_copy_mutex);
+
+	return ret;
+}
+
+static const struct kernel_param_ops dma_copy_enable_ops = {
+	.set = dma_copy_enable_set,
+	.get = param_get_bool,
+};
+
+module_param_cb(enable, &dma_copy_enable_ops, &dma_copy_enable, 0644);
+MODULE_PARM_DESC(enable, "Offload copies to a DMA_MEMCPY channel (default: off)");
+
+static void dma_copy_idle(void)
+{
+	if (atomic_dec_and_test(&dma_copy_inflight))
+		wake_up_var(&dma_copy_inflight);
+}
+
+/*
+ * Find the part of @ent the channel may copy and have the CPU copy the rest
+ * now. On non-coherent systems, unmapping the destination invalidates the
+ * cache lines it touches, which would drop CPU stores to data sharing a line
+ * with it, so the channel only gets whole cache lines. Returns false if
+ * nothing is left for the channel.
+ */
+static bool dma_copy_split(struct dma_chan *chan,
+			   const struct dma_copy_ent *ent,
+			   struct dma_copy_ent *mid)
+{
+	unsigned int align = dma_get_cache_alignment();
+	unsigned int head, len;
+
+	head = min(ALIGN(ent->dst_off, align) - ent->dst_off, ent->len);
+	len = round_down(ent->len - head, align);
+	if (!len || !is_dma_copy_aligned(chan->device, ent->src_off + head,
+					 ent->dst_off + head, len)) {
+		memcpy_page(ent->dst, ent->dst_off, ent->src, ent->src_off,
+			    ent->len);
+		return false;
+	}
+
+	*mid = *ent;
+	mid->dst_off += head;
+	mid->src_off += head;
+	mid->len = len;
+
+	if (head)
+		memcpy_page(ent->dst, ent->dst_off, ent->src, ent->src_off,
+			    head);
+	if (head + len < ent->len)
+		memcpy_page(ent->dst, mid->dst_off + len, ent->src,
+			    mid->src_off + len, ent->len - head - len);
+	return true;
+}
+
+static void dma_copy_finish(struct dma_copy_req *req)
+{
+	struct device *dev = dmaengine_get_dma_device(req->chan);
+	dma_copy_done_t done = req->done;
+	void *param = req->param;
+	unsigned int i;
+
+	for (i = 0; i < req->mapped; i++) {
+		dma_unmap_page(dev, req->src[i], req->batch.ent[i].len,
+			       DMA_TO_DEVICE);
+		dma_unmap_page(dev, req->dst[i], req->batch.ent[i].len,
+			       DMA_FROM_DEVICE);
+	}
+
+	/* The sources are unchanged, so redoing all of it is safe */
+	if (req->failed) {
+		dma_copy_cpu(&req->batch);
+		atomic_long_inc(&dma_copy_fallbacks);
+		atomic_long_add(req->batch.bytes, &dma_copy_cpu_bytes);
+	} else {
+		atomic_long_add(req->batch.bytes, &dma_copy_dma_bytes);
+	}
+
+	if (req->shared)
+		dma_copy_idle();
+	kfree(req);
+	done(param);
+}
+
+static void dma_copy_put(struct dma_copy_req *req)
+{
+	if (atomic_dec_and_test(&req->pending))
+		dma_copy_finish(req);
+}
+
+static void dma_copy_callback(void *param, const struct dmaengine_result *result)
+{
+	struct dma_copy_req *req = param;
+
+	if (result && result->result != DMA_TRANS_NOERROR)
+		WRITE_ONCE(req->failed, true);
+	dma_copy_put(req);
+}
+
+/*
+ * Queue one descriptor per entry. Each holds a reference on @req, so it
+ * completes when the last descriptor did, whatever order the channel
+ * completes them in. If an entry cannot be queued, those already queued
+ * still run and the whole batch is redone by the CPU afterwards.
+ */
+static void dma_copy_issue(struct dma_copy_req *req)
+{
+	struct device *dev = dmaengine_get_dma_device(req->chan);
+	struct dma_async_tx_descriptor *tx;
+	unsigned int i, queued = 0;
+
+	for (i = 0; i < req->batch.nr; i++) {
+		struct dma_copy_ent *ent = &req->batch.ent[i];
+
+		req->src[i] = dma_map_page(dev, ent->src, ent->src_off,
+					   ent->len, DMA_TO_DEVICE);
+		if (dma_mapping_error(dev, req->src[i]))
+			break;
+		req->dst[i] = dma_map_page(dev, ent->dst, ent->dst_off,
+					   ent->len, DMA_FROM_DEVICE);
+		if (dma_mapping_error(dev, req->dst[i])) {
+			dma_unmap_page(dev, req->src[i], ent->len,
+				       DMA_TO_DEVICE);
+			break;
+		}
+		req->mapped++;
+
+		tx = dmaengine_prep_dma_memcpy(req->chan, req->dst[i],
+					       req->src[i], ent->len,
+					       DMA_PREP_INTERRUPT |
+					       DMA_CTRL_ACK);
+		if (!tx)
+			break;
+		tx->callback_result = dma_copy_callback;
+		tx->callback_param = req;
+
+		atomic_inc(&req->pending);
+		if (dma_submit_error(dmaengine_submit(tx))) {
+			atomic_dec(&req->pending);
+			break;
+		}
+		queued++;
+	}
+
+	if (i < req->batch.nr)
+		req->failed = true;
+	if (queued)
+		dma_async_issue_pending(req->chan);
+}
+
+/**
+ * dma_copy_worthwhile - whether to build batches for an operation
+ * @len: total number of bytes the operation copies
+ *
+ * Return: true if offload is enabled and @len is at least the threshold.
+ */
+bool dma_copy_worthwhile(size_t len)
+{
+	return READ_ONCE(dma_copy_chan) && len >= READ_ONCE(threshold);
+}
+EXPORT_SYMBOL_GPL(dma_copy_worthwhile);
+
+static void __dma_copy_submit(struct dma_chan *chan,
+			      const struct dma_copy_batch *batch,
+			      dma_copy_done_t done, void *param, bool shared)
+{
+	struct dma_copy_req *req = NULL;
+	struct dma_copy_ent mid;
+	unsigned int i;
+
+	atomic_long_inc(&dma_copy_batches);
+	if (chan && batch->nr)
+		req = kmalloc(sizeof(*req), GFP_NOIO | __GFP_NOWARN);
+	if (!req)
+		goto cpu;
+
+	dma_copy_batch_init(&req->batch);
+	for (i = 0; i < batch->nr; i++) {
+		if (dma_copy_split(chan, &batch->ent[i], &mid))
+			dma_copy_batch_add(&req->batch, mid.dst, mid.dst_off,
+					   mid.src, mid.src_off, mid.len);
+	}
+	atomic_long_add(batch->bytes - req->batch.bytes, &dma_copy_cpu_bytes);
+	if (!req->batch.nr) {
+		kfree(req);
+		goto out;
+	}
+
+	req->chan = chan;
+	req->mapped = 0;
+	atomic_set(&req->pending, 1);
+	req->failed = false;
+	req->shared = shared;
+	req->done = done;
+	req->param = param;
+
+	dma_copy_issue(req);
+	dma_copy_put(req);
+	return;
+
+cpu:
+	dma_copy_cpu(batch);
+	atomic_long_add(batch->bytes, &dma_copy_cpu_bytes);
+out:
+	if (shared)
+		dma_copy_idle();
+	done(param);
+}
+
+/**
+ * dma_copy_submit - copy a batch of page ranges
+ * @batch: copies to do, may be reused as soon as this returns
+ * @done: called once all of @batch has been copied
+ * @param: argument for @done
+ *
+ * May sleep. @done is called from the DMA driver's completion context,
+ * usually a tasklet, or from this function when the CPU did the copy.
+ * The pages must stay allocated until then.
+ */
+void dma_copy_submit(const struct dma_copy_batch *batch,
+		     dma_copy_done_t done, void *param)
+{
+	atomic_inc(&dma_copy_inflight);
+	/* Pairs with the barrier in dma_copy_stop() */
+	smp_mb__after_atomic();
+
+	__dma_copy_submit(READ_ONCE(dma_copy_chan), batch, done, param, true);
+}
+EXPORT_SYMBOL_GPL(dma_copy_submit);
+
+/**
+ * dma_copy_submit_chan - copy a batch of page ranges on a given channel
+ * @chan: DMA_MEMCPY channel owned by the caller
+ * @batch: copies to do, may be reused as soon as this returns
+ * @done: called once all of @batch has been copied
+ * @param: argument for @done
+ *
+ * Like dma_copy_submit(), whether or not offload is enabled. Meant for
+ * dmatest, which checks the service on the channels it tests.
+ */
+void dma_copy_submit_chan(struct dma_chan *chan,
+			  const struct dma_copy_batch *batch,
+			  dma_copy_done_t done, void *param)
+{
+	__dma_copy_submit(chan, batch, done, param, false);
+}
+EXPORT_SYMBOL_GPL(dma_copy_submit_chan);
+
+static void dma_copy_wake(void *param)
+{
+	complete(param);
+}
+
+/**
+ * dma_copy_sync - copy a batch of page ranges and wait for it
+ * @batch: copies to do
+ */
+void dma_copy_sync(const struct dma_copy_batch *batch)
+{
+	DECLARE_COMPLETION_ONSTACK(done);
+
+	dma_copy_submit(batch, dma_copy_wake, &done);
+	wait_for_completion(&done);
+}
+EXPORT_SYMBOL_GPL(dma_copy_sync);
+
+static int dma_copy_stats_show(struct seq_file *s, void *unused)
+{
+	struct dma_chan *chan;
+
+	mutex_lock(&dma_copy_mutex);
+	chan = dma_copy_chan;
+	seq_printf(s, "channel: %s\n", chan ? dma_chan_name(chan) : "none");
+	mutex_unlock(&dma_copy_mutex);
+
+	seq_printf(s, "batches: %ld\n", atomic_long_read(&dma_copy_batches));
+	seq_printf(s, "dma_bytes: %ld\n", atomic_long_read(&dma_copy_dma_bytes));
+	seq_printf(s, "cpu_bytes: %ld\n", atomic_long_read(&dma_copy_cpu_bytes));
+	seq_printf(s, "fallbacks: %ld\n", atomic_long_read(&dma_copy_fallbacks));
+	return 0;
+}
+DEFINE_SHOW_ATTRIBUTE(dma_copy_stats);
+
+/* DMA controllers built in have registered their channels by now */
+static int __init dma_copy_init(void)
+{
+	mutex_lock(&dma_copy_mutex);
+	dma_copy_ready = true;
+	if (dma_copy_enable && dma_copy_start()) {
+		pr_warn("no DMA_MEMCPY channel, copies stay on the CPU\n");
+		dma_copy_enable = false;
+	}
+	mutex_unlock(&dma_copy_mutex);
+
+	debugfs_create_file("dma_copy", 0444, NULL, NULL, &dma_copy_stats_fops);
+	return 0;
+}
+late_initcall(dma_copy_init);
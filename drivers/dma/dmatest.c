@@ -8,17 +8,24 @@
 #define pr_fmt(fmt) KBUILD_MODNAME ": " fmt
 
 #include <linux/err.h>
+#include <linux/debugfs.h>
 #include <linux/delay.h>
+#include <linux/dma-copy.h>
 #include <linux/dma-mapping.h>
 #include <linux/dmaengine.h>
 #include <linux/freezer.h>
 #include <linux/init.h>
+#include <linux/kernel_stat.h>
 #include <linux/kthread.h>
 #include <linux/sched/task.h>
 #include <linux/module.h>
 #include <linux/moduleparam.h>
 #include <linux/random.h>
+#include <linux/raid/pq.h>
+#include <linux/raid/xor.h>
+#include <linux/seq_file.h>
 #include <linux/slab.h>
+#include <linux/sort.h>
 #include <linux/wait.h>
 
 static unsigned int test_buf_size = 16384;
@@ -88,6 +95,22 @@ static bool polled;
 module_param(polled, bool, 0644);
 MODULE_PARM_DESC(polled, "Use polling for completion instead of interrupts");
 
+static bool copy_offload;
+module_param(copy_offload, bool, 0644);
+MODULE_PARM_DESC(copy_offload, "Do memcpy tests through the copy offload service");
+
+static bool bench;
+module_param(bench, bool, 0644);
+MODULE_PARM_DESC(bench, "Benchmark instead of test, results in debugfs dmatest/results (default: off)");
+
+static unsigned int bench_min_size = 512;
+module_param(bench_min_size, uint, 0644);
+MODULE_PARM_DESC(bench_min_size, "Smallest transfer size of the benchmark (default: 512)");
+
+static unsigned int bench_max_size;
+module_param(bench_max_size, uint, 0644);
+MODULE_PARM_DESC(bench_max_size, "Largest transfer size of the benchmark (default: test_buf_size)");
+
 /**
  * struct dmatest_params - test parameters.
  * @buf_size:		size of the memcpy test buffer
@@ -104,6 +127,10 @@ MODULE_PARM_DESC(polled, "Use polling for completion instead of interrupts");
  * @alignment:		custom data address alignment taken as 2^alignment
  * @transfer_size:	custom transfer size in bytes
  * @polled:		use polling for completion instead of interrupts
+ * @copy_offload:	do memcpy tests with dma_copy_submit_chan()
+ * @bench:		benchmark instead of testing
+ * @bench_min_size:	smallest transfer size of the benchmark
+ * @bench_max_size:	largest transfer size of the benchmark, 0 for buf_size
  */
 struct dmatest_params {
 	unsigned int	buf_size;
@@ -120,6 +147,10 @@ struct dmatest_params {
 	int		alignment;
 	unsigned int	transfer_size;
 	bool		polled;
+	bool		copy_offload;
+	bool		bench;
+	unsigned int	bench_min_size;
+	unsigned int	bench_max_size;
 };
 
 /**
@@ -239,6 +270,43 @@ struct dmatest_chan {
 	struct list_head	threads;
 };
 
+/* Transfers per size when benchmarking without an iteration count */
+#define BENCH_ITERATIONS	1000
+
+/**
+ * struct dmatest_bench_result - benchmark of one thread at one size
+ * @node:		entry in dmatest_results
+ * @thread:		name of the thread, telling channel and operation
+ * @channels:		number of channels under test at the same time
+ * @threads:		number of threads per channel
+ * @size:		transfer size in bytes
+ * @count:		completed transfers
+ * @failed:		failed transfers
+ * @ns:			time taken by the transfers, mapping included
+ * @lat_ns:		50th, 90th and 99th percentile and maximum latency
+ * @thread_cpu_ns:	CPU time used by the thread during the transfers
+ * @busy_ns:		CPU time used by all CPUs during the transfers
+ * @cpu_ns:		time the CPU took for the same operations, 0 if none
+ */
+struct dmatest_bench_result {
+	struct list_head	node;
+	char			thread[TASK_COMM_LEN];
+	unsigned int		channels;
+	unsigned int		threads;
+	unsigned int		size;
+	unsigned int		count;
+	unsigned int		failed;
+	u64			ns;
+	u64			lat_ns[4];
+	u64			thread_cpu_ns;
+	u64			busy_ns;
+	u64			cpu_ns;
+};
+
+static LIST_HEAD(dmatest_results);
+static DEFINE_MUTEX(dmatest_results_lock);
+static struct dentry *dmatest_debugfs;
+
 static DECLARE_WAIT_QUEUE_HEAD(thread_wait);
 static bool wait;
 
@@ -550,6 +618,330 @@ static int dmatest_alloc_test_data(struct dmatest_data *d,
 	return -ENOMEM;
 }
 
+/*
+ * Copy @len bytes from @src to @dst the way users of the copy offload
+ * service do, in page-sized batch entries, on the thread's channel.
+ */
+static int dmatest_copy_offload(struct dmatest_thread *thread,
+				struct dmatest_params *params,
+				u8 *dst, u8 *src, unsigned int len)
+{
+	struct dmatest_done *done = &thread->test_done;
+	struct dma_copy_batch batch;
+	unsigned int this_len;
+
+	while (len) {
+		dma_copy_batch_init(&batch);
+		while (len && batch.nr < DMA_COPY_BATCH_MAX) {
+			this_len = min3(len,
+					(unsigned int)(PAGE_SIZE - offset_in_page(src)),
+					(unsigned int)(PAGE_SIZE - offset_in_page(dst)));
+			dma_copy_batch_add(&batch, virt_to_page(dst),
+					   offset_in_page(dst), virt_to_page(src),
+					   offset_in_page(src), this_len);
+			src += this_len;
+			dst += this_len;
+			len -= this_len;
+		}
+
+		done->done = false;
+		dma_copy_submit_chan(thread->chan, &batch, dmatest_callback,
+				     done);
+		wait_event_freezable_timeout(thread->done_wait, done->done,
+					     msecs_to_jiffies(params->timeout));
+		if (!done->done)
+			return -ETIMEDOUT;
+	}
+
+	return 0;
+}
+
+static struct dma_async_tx_descriptor *
+dmatest_prep(struct dmatest_thread *thread, dma_addr_t *srcs, dma_addr_t *dsts,
+	     dma_addr_t *dma_pq, u8 *pq_coefs, unsigned int len,
+	     enum dma_ctrl_flags flags)
+{
+	struct dmatest_data *src = &thread->src;
+	struct dmatest_data *dst = &thread->dst;
+	struct dma_chan *chan = thread->chan;
+	struct dma_device *dev = chan->device;
+	int i;
+
+	if (thread->type == DMA_MEMCPY)
+		return dev->device_prep_dma_memcpy(chan, dsts[0] + dst->off,
+						   srcs[0], len, flags);
+	if (thread->type == DMA_MEMSET)
+		return dev->device_prep_dma_memset(chan, dsts[0] + dst->off,
+						*(src->aligned[0] + src->off),
+						len, flags);
+	if (thread->type == DMA_XOR)
+		return dev->device_prep_dma_xor(chan, dsts[0] + dst->off,
+						srcs, src->cnt, len, flags);
+	if (thread->type == DMA_PQ) {
+		for (i = 0; i < dst->cnt; i++)
+			dma_pq[i] = dsts[i] + dst->off;
+		return dev->device_prep_dma_pq(chan, dma_pq, srcs, src->cnt,
+					       pq_coefs, len, flags);
+	}
+	return NULL;
+}
+
+/* Map the first @len bytes of the buffers, do one transfer and wait for it */
+static int dmatest_bench_xfer(struct dmatest_thread *thread, unsigned int len,
+			      dma_addr_t *srcs, dma_addr_t *dma_pq,
+			      u8 *pq_coefs, enum dma_ctrl_flags flags)
+{
+	struct dmatest_params *params = &thread->info->params;
+	struct device *dma_dev = dmaengine_get_dma_device(thread->chan);
+	struct dmatest_done *done = &thread->test_done;
+	struct dmatest_data *src = &thread->src;
+	struct dmatest_data *dst = &thread->dst;
+	struct dma_async_tx_descriptor *tx;
+	struct dmaengine_unmap_data *um;
+	dma_cookie_t cookie;
+	dma_addr_t *dsts;
+	int i, ret = -EIO;
+
+	um = dmaengine_get_unmap_data(dma_dev, src->cnt + dst->cnt,
+				      GFP_KERNEL);
+	if (!um)
+		return -ENOMEM;
+
+	um->len = len;
+	for (i = 0; i < src->cnt; i++) {
+		void *buf = src->aligned[i];
+
+		um->addr[i] = dma_map_page(dma_dev, virt_to_page(buf),
+					   offset_in_page(buf), len,
+					   DMA_TO_DEVICE);
+		if (dma_mapping_error(dma_dev, um->addr[i]))
+			goto out;
+		srcs[i] = um->addr[i];
+		um->to_cnt++;
+	}
+	dsts = &um->addr[src->cnt];
+	for (i = 0; i < dst->cnt; i++) {
+		void *buf = dst->aligned[i];
+
+		dsts[i] = dma_map_page(dma_dev, virt_to_page(buf),
+				       offset_in_page(buf), len,
+				       DMA_BIDIRECTIONAL);
+		if (dma_mapping_error(dma_dev, dsts[i]))
+			goto out;
+		um->bidi_cnt++;
+	}
+
+	tx = dmatest_prep(thread, srcs, dsts, dma_pq, pq_coefs, len, flags);
+	if (!tx)
+		goto out;
+
+	done->done = false;
+	if (!params->polled) {
+		tx->callback = dmatest_callback;
+		tx->callback_param = done;
+	}
+	cookie = dmaengine_submit(tx);
+	if (dma_submit_error(cookie))
+		goto out;
+
+	if (params->polled) {
+		if (dma_sync_wait(thread->chan, cookie) == DMA_COMPLETE)
+			ret = 0;
+	} else {
+		dma_async_issue_pending(thread->chan);
+		wait_event_freezable_timeout(thread->done_wait, done->done,
+					msecs_to_jiffies(params->timeout));
+		ret = done->done ? 0 : -ETIMEDOUT;
+	}
+out:
+	dmaengine_unmap_put(um);
+	return ret;
+}
+
+/* Time the CPU doing what the channel did, where the kernel can */
+static void dmatest_bench_cpu(struct dmatest_thread *thread,
+			      struct dmatest_bench_result *res)
+{
+	struct dmatest_data *src = &thread->src;
+	struct dmatest_data *dst = &thread->dst;
+	unsigned int len = res->size, i;
+	void **ptrs = NULL;
+	u64 start;
+
+	if ((thread->type == DMA_XOR &&
+	     (!IS_REACHABLE(CONFIG_XOR_BLOCKS) || !IS_ALIGNED(len, 64))) ||
+	    (thread->type == DMA_PQ &&
+	     (!IS_REACHABLE(CONFIG_RAID6_PQ) || !IS_ALIGNED(len, 512) ||
+	      src->cnt < 2)))
+		return;
+
+	if (thread->type == DMA_PQ) {
+		ptrs = kmalloc_array(src->cnt + 2, sizeof(*ptrs), GFP_KERNEL);
+		if (!ptrs)
+			return;
+		memcpy(ptrs, src->aligned, src->cnt * sizeof(*ptrs));
+		ptrs[src->cnt] = dst->aligned[0];
+		ptrs[src->cnt + 1] = dst->aligned[1];
+	}
+
+	start = ktime_get_ns();
+	for (i = 0; i < res->count; i++) {
+		switch (thread->type) {
+		case DMA_MEMCPY:
+			memcpy(dst->aligned[0], src->aligned[0], len);
+			break;
+		case DMA_MEMSET:
+			memset(dst->aligned[0], *src->aligned[0], len);
+			break;
+		case DMA_XOR:
+#if IS_REACHABLE(CONFIG_XOR_BLOCKS)
+		{
+			unsigned int j, n;
+
+			memcpy(dst->aligned[0], src->aligned[0], len);
+			for (j = 1; j < src->cnt; j += n) {
+				n = min_t(unsigned int, src->cnt - j,
+					  MAX_XOR_BLOCKS);
+				xor_blocks(n, len, dst->aligned[0],
+					   (void **)&src->aligned[j]);
+			}
+		}
+#endif
+			break;
+		case DMA_PQ:
+#if IS_REACHABLE(CONFIG_RAID6_PQ)
+			raid6_call.gen_syndrome(src->cnt + 2, len, ptrs);
+#endif
+			break;
+		default:
+			break;
+		}
+		cond_resched();
+	}
+	res->cpu_ns = ktime_get_ns() - start;
+
+	kfree(ptrs);
+}
+
+static u64 dmatest_busy_ns(void)
+{
+	struct kernel_cpustat kcs;
+	u64 busy = 0;
+	int cpu;
+
+	for_each_online_cpu(cpu) {
+		kcpustat_cpu_fetch(&kcs, cpu);
+		busy += kcs.cpustat[CPUTIME_USER] + kcs.cpustat[CPUTIME_NICE] +
+			kcs.cpustat[CPUTIME_SYSTEM] + kcs.cpustat[CPUTIME_IRQ] +
+			kcs.cpustat[CPUTIME_SOFTIRQ];
+	}
+	return busy;
+}
+
+static int dmatest_cmp_u64(const void *a, const void *b)
+{
+	u64 x = *(const u64 *)a, y = *(const u64 *)b;
+
+	return x < y ? -1 : x > y;
+}
+
+static int dmatest_bench_size(struct dmatest_thread *thread,
+			      struct dmatest_bench_result *res, u64 *lat,
+			      unsigned int iterations, dma_addr_t *srcs,
+			      dma_addr_t *dma_pq, u8 *pq_coefs,
+			      enum dma_ctrl_flags flags)
+{
+	u64 start, busy, cpu, t;
+	unsigned int n;
+	int ret = 0;
+
+	busy = dmatest_busy_ns();
+	cpu = current->se.sum_exec_runtime;
+	start = ktime_get_ns();
+	for (n = 0; n < iterations && !kthread_should_stop(); n++) {
+		t = ktime_get_ns();
+		ret = dmatest_bench_xfer(thread, res->size, srcs, dma_pq,
+					 pq_coefs, flags);
+		if (ret) {
+			res->failed++;
+			break;
+		}
+		lat[n] = ktime_get_ns() - t;
+	}
+	res->ns = ktime_get_ns() - start;
+	res->thread_cpu_ns = current->se.sum_exec_runtime - cpu;
+	res->busy_ns = dmatest_busy_ns() - busy;
+	res->count = n;
+
+	if (n) {
+		sort(lat, n, sizeof(*lat), dmatest_cmp_u64, NULL);
+		res->lat_ns[0] = lat[n * 50 / 100];
+		res->lat_ns[1] = lat[n * 90 / 100];
+		res->lat_ns[2] = lat[n * 99 / 100];
+		res->lat_ns[3] = lat[n - 1];
+	}
+
+	return ret;
+}
+
+/*
+ * Sweep transfer sizes by powers of two from bench_min_size to
+ * bench_max_size, timing each transfer from mapping to completion, and
+ * record one result per size for the results file. Buffers are not
+ * verified, run the test for that.
+ */
+static int dmatest_bench(struct dmatest_thread *thread, u8 align,
+			 dma_addr_t *srcs, dma_addr_t *dma_pq, u8 *pq_coefs,
+			 enum dma_ctrl_flags flags)
+{
+	struct dmatest_info *info = thread->info;
+	struct dmatest_params *params = &info->params;
+	unsigned int iterations = params->iterations ?: BENCH_ITERATIONS;
+	unsigned int max_size = params->bench_max_size ?: params->buf_size;
+	struct dmatest_bench_result *res;
+	unsigned int size, nr = 0;
+	int ret = 0;
+	u64 *lat;
+
+	lat = kvmalloc_array(iterations, sizeof(*lat), GFP_KERNEL);
+	if (!lat)
+		return -ENOMEM;
+
+	max_size = min(max_size, params->buf_size);
+	size = roundup_pow_of_two(max(params->bench_min_size, 1U << align));
+	thread->src.off = 0;
+	thread->dst.off = 0;
+
+	for (; size <= max_size && !kthread_should_stop(); size <<= 1) {
+		res = kzalloc(sizeof(*res), GFP_KERNEL);
+		if (!res) {
+			ret = -ENOMEM;
+			break;
+		}
+		strscpy(res->thread, current->comm, sizeof(res->thread));
+		res->channels = info->nr_channels;
+		res->threads = params->threads_per_chan;
+		res->size = size;
+
+		ret = dmatest_bench_size(thread, res, lat, iterations, srcs,
+					 dma_pq, pq_coefs, flags);
+		if (res->count)
+			dmatest_bench_cpu(thread, res);
+
+		mutex_lock(&dmatest_results_lock);
+		list_add_tail(&res->node, &dmatest_results);
+		mutex_unlock(&dmatest_results_lock);
+		nr++;
+
+		if (ret || size > max_size / 2)
+			break;
+	}
+
+	kvfree(lat);
+	pr_info("%s: benchmarked %u sizes (%d)\n", current->comm, nr, ret);
+	return ret;
+}
+
 /*
  * This function repeatedly tests DMA transfers of various lengths and
  * offsets for a given operation type until it is told to exit by
@@ -679,10 +1071,16 @@ static int dmatest_func(void *data)
 	else
 		flags = DMA_CTRL_ACK | DMA_PREP_INTERRUPT;
 
+	if (params->bench) {
+		ret = dmatest_bench(thread, align, srcs, dma_pq, pq_coefs,
+				    flags);
+		goto err_pq_array;
+	}
+
 	ktime = ktime_get();
 	while (!(kthread_should_stop() ||
 	       (params->iterations && total_tests >= params->iterations))) {
-		struct dma_async_tx_descriptor *tx = NULL;
+		struct dma_async_tx_descriptor *tx;
 		struct dmaengine_unmap_data *um;
 		dma_addr_t *dsts;
 		unsigned int len;
@@ -732,6 +1130,19 @@ static int dmatest_func(void *data)
 			filltime = ktime_add(filltime, diff);
 		}
 
+		if (params->copy_offload && thread->type == DMA_MEMCPY) {
+			if (dmatest_copy_offload(thread, params,
+						 dst->aligned[0] + dst->off,
+						 src->aligned[0] + src->off,
+						 len)) {
+				result("test timed out", total_tests, src->off,
+				       dst->off, len, 0);
+				failed_tests++;
+				continue;
+			}
+			goto verify;
+		}
+
 		um = dmaengine_get_unmap_data(dma_dev, src->cnt + dst->cnt,
 					      GFP_KERNEL);
 		if (!um) {
@@ -776,28 +1187,8 @@ static int dmatest_func(void *data)
 			um->bidi_cnt++;
 		}
 
-		if (thread->type == DMA_MEMCPY)
-			tx = dev->device_prep_dma_memcpy(chan,
-							 dsts[0] + dst->off,
-							 srcs[0], len, flags);
-		else if (thread->type == DMA_MEMSET)
-			tx = dev->device_prep_dma_memset(chan,
-						dsts[0] + dst->off,
-						*(src->aligned[0] + src->off),
-						len, flags);
-		else if (thread->type == DMA_XOR)
-			tx = dev->device_prep_dma_xor(chan,
-						      dsts[0] + dst->off,
-						      srcs, src->cnt,
-						      len, flags);
-		else if (thread->type == DMA_PQ) {
-			for (i = 0; i < dst->cnt; i++)
-				dma_pq[i] = dsts[i] + dst->off;
-			tx = dev->device_prep_dma_pq(chan, dma_pq, srcs,
-						     src->cnt, pq_coefs,
-						     len, flags);
-		}
-
+		tx = dmatest_prep(thread, srcs, dsts, dma_pq, pq_coefs, len,
+				  flags);
 		if (!tx) {
 			result("prep error", total_tests, src->off,
 			       dst->off, len, ret);
@@ -852,6 +1243,7 @@ static int dmatest_func(void *data)
 
 		dmaengine_unmap_put(um);
 
+verify:
 		if (params->noverify) {
 			verbose_result("test passed", total_tests, src->off,
 				       dst->off, len, 0);
@@ -905,6 +1297,7 @@ static int dmatest_func(void *data)
 	runtime = ktime_to_us(ktime);
 
 	ret = 0;
+err_pq_array:
 	kfree(dma_pq);
 err_srcs_array:
 	kfree(srcs);
@@ -915,11 +1308,13 @@ static int dmatest_func(void *data)
 err_free_coefs:
 	kfree(pq_coefs);
 err_thread_type:
-	iops = dmatest_persec(runtime, total_tests);
-	pr_info("%s: summary %u tests, %u failures %llu.%02llu iops %llu KB/s (%d)\n",
-		current->comm, total_tests, failed_tests,
-		FIXPT_TO_INT(iops), FIXPT_GET_FRAC(iops),
-		dmatest_KBs(runtime, total_len), ret);
+	if (!params->bench) {
+		iops = dmatest_persec(runtime, total_tests);
+		pr_info("%s: summary %u tests, %u failures %llu.%02llu iops %llu KB/s (%d)\n",
+			current->comm, total_tests, failed_tests,
+			FIXPT_TO_INT(iops), FIXPT_GET_FRAC(iops),
+			dmatest_KBs(runtime, total_len), ret);
+	}
 
 	/* terminate all transfers on specified channels */
 	if (ret || failed_tests)
@@ -1107,6 +1502,10 @@ static void add_threaded_test(struct dmatest_info *info)
 	params->alignment = alignment;
 	params->transfer_size = transfer_size;
 	params->polled = polled;
+	params->copy_offload = copy_offload;
+	params->bench = bench;
+	params->bench_min_size = bench_min_size;
+	params->bench_max_size = bench_max_size;
 
 	request_channels(info, DMA_MEMCPY);
 	request_channels(info, DMA_MEMSET);
@@ -1114,11 +1513,24 @@ static void add_threaded_test(struct dmatest_info *info)
 	request_channels(info, DMA_PQ);
 }
 
+static void dmatest_free_results(void)
+{
+	struct dmatest_bench_result *res, *_res;
+
+	mutex_lock(&dmatest_results_lock);
+	list_for_each_entry_safe(res, _res, &dmatest_results, node) {
+		list_del(&res->node);
+		kfree(res);
+	}
+	mutex_unlock(&dmatest_results_lock);
+}
+
 static void run_pending_tests(struct dmatest_info *info)
 {
 	struct dmatest_chan *dtc;
 	unsigned int thread_count = 0;
 
+	dmatest_free_results();
 	list_for_each_entry(dtc, &info->channels, node) {
 		struct dmatest_thread *thread;
 
@@ -1321,11 +1733,46 @@ static int dmatest_test_list_get(char *val, const struct kernel_param *kp)
 	return 0;
 }
 
+/*
+ * One line per thread and transfer size of the last benchmark run.
+ * Throughputs are in MB/s, CPU use in percent of the transfer time, for
+ * busy_% of all online CPUs together.
+ */
+static int dmatest_results_show(struct seq_file *s, void *unused)
+{
+	struct dmatest_bench_result *res;
+
+	seq_puts(s, "thread channels threads size transfers failures MB/s p50_ns p90_ns p99_ns max_ns thread_cpu_% busy_% cpu_MB/s\n");
+
+	mutex_lock(&dmatest_results_lock);
+	list_for_each_entry(res, &dmatest_results, node) {
+		u64 bytes = (u64)res->count * res->size * 1000;
+		u64 ns = max_t(u64, res->ns, 1);
+
+		seq_printf(s, "%s %u %u %u %u %u %llu %llu %llu %llu %llu %llu %llu %llu\n",
+			   res->thread, res->channels, res->threads, res->size,
+			   res->count, res->failed, div64_u64(bytes, ns),
+			   res->lat_ns[0], res->lat_ns[1], res->lat_ns[2],
+			   res->lat_ns[3],
+			   div64_u64(res->thread_cpu_ns * 100, ns),
+			   div64_u64(res->busy_ns * 100, ns * num_online_cpus()),
+			   res->cpu_ns ? div64_u64(bytes, res->cpu_ns) : 0);
+	}
+	mutex_unlock(&dmatest_results_lock);
+
+	return 0;
+}
+DEFINE_SHOW_ATTRIBUTE(dmatest_results);
+
 static int __init dmatest_init(void)
 {
 	struct dmatest_info *info = &test_info;
 	struct dmatest_params *params = &info->params;
 
+	dmatest_debugfs = debugfs_create_dir("dmatest", NULL);
+	debugfs_create_file("results", 0444, dmatest_debugfs, NULL,
+			    &dmatest_results_fops);
+
 	if (dmatest_run) {
 		mutex_lock(&info->lock);
 		add_threaded_test(info);
@@ -1350,9 +1797,13 @@ static void __exit dmatest_exit(void)
 {
 	struct dmatest_info *info = &test_info;
 
+	debugfs_remove_recursive(dmatest_debugfs);
+
 	mutex_lock(&info->lock);
 	stop_threaded_test(info);
 	mutex_unlock(&info->lock);
+
+	dmatest_free_results();
 }
 module_exit(dmatest_exit);
 
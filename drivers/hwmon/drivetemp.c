@@ -93,6 +93,14 @@
  *   the temperature.
  * - Otherwise, if SMART attribute 190 is supported, it is used to read
  *   the temperature.
+ *
+ * Reading the temperature takes a non-queued command, which drains the
+ * NCQ queue of a busy drive. Readings are therefore cached for max_age_ms.
+ * Once a reading is stale and the drive has commands in flight, the old
+ * value is returned and a new one is taken at the next moment the queue
+ * is idle, or after at most DRIVETEMP_MAX_DEFER times max_age_ms. Drives
+ * that are runtime suspended or report standby with CHECK POWER MODE are
+ * not sampled, so monitoring never spins them up.
  */
 
 #include <linux/ata.h>
@@ -103,6 +111,8 @@
 #include <linux/list.h>
 #include <linux/module.h>
 #include <linux/mutex.h>
+#include <linux/pm_runtime.h>
+#include <linux/workqueue.h>
 #include <scsi/scsi_cmnd.h>
 #include <scsi/scsi_device.h>
 #include <scsi/scsi_driver.h>
@@ -114,8 +124,16 @@ struct drivetemp_data {
 	struct scsi_device *sdev;	/* SCSI device */
 	struct device *dev;		/* instantiating device */
 	struct device *hwdev;		/* hardware monitoring device */
-	u8 smartdata[ATA_SECT_SIZE];	/* local buffer */
+	u8 smartdata[ATA_SECT_SIZE];	/* local buffer, holds last sample */
+	int (*read_temp)(struct drivetemp_data *st);
 	int (*get_temp)(struct drivetemp_data *st, u32 attr, long *val);
+	struct delayed_work refresh;	/* sample once the queue is idle */
+	unsigned long sampled;		/* jiffies of the last sample */
+	bool have_sample;		/* smartdata holds a valid sample */
+	unsigned long commands;		/* commands issued to the drive */
+	unsigned long cache_hits;	/* reads served from the last sample */
+	unsigned long busy_deferrals;	/* stale reads while drive was busy */
+	unsigned long standby_skips;	/* samples skipped in standby */
 	bool have_temp_lowest;		/* lowest temp in SCT status */
 	bool have_temp_highest;		/* highest temp in SCT status */
 	bool have_temp_min;		/* have min temp */
@@ -130,6 +148,13 @@ struct drivetemp_data {
 
 static LIST_HEAD(drivetemp_devlist);
 
+static unsigned int max_age_ms = 5000;
+module_param(max_age_ms, uint, 0644);
+MODULE_PARM_DESC(max_age_ms, "Maximum age of a cached temperature reading");
+
+#define DRIVETEMP_MAX_DEFER	4
+#define DRIVETEMP_IDLE_POLL	msecs_to_jiffies(100)
+
 #define ATA_MAX_SMART_ATTRS	30
 #define SMART_TEMP_PROP_190	190
 #define SMART_TEMP_PROP_194	194
@@ -192,6 +217,7 @@ static int drivetemp_scsi_command(struct drivetemp_data *st,
 	scsi_cmd[12] = lba_high;
 	scsi_cmd[14] = ata_command;
 
+	st->commands++;
 	return scsi_execute_req(st->sdev, scsi_cmd, data_dir,
 				st->smartdata, ATA_SECT_SIZE, NULL, HZ, 5,
 				NULL);
@@ -204,6 +230,11 @@ static int drivetemp_ata_command(struct drivetemp_data *st, u8 feature,
 				     ATA_SMART_LBAM_PASS, ATA_SMART_LBAH_PASS);
 }
 
+static int drivetemp_read_smarttemp(struct drivetemp_data *st)
+{
+	return drivetemp_ata_command(st, ATA_SMART_READ_VALUES, 0);
+}
+
 static int drivetemp_get_smarttemp(struct drivetemp_data *st, u32 attr,
 				  long *temp)
 {
@@ -211,13 +242,8 @@ static int drivetemp_get_smarttemp(struct drivetemp_data *st, u32 attr,
 	bool have_temp = false;
 	u8 temp_raw;
 	u8 csum;
-	int err;
 	int i;
 
-	err = drivetemp_ata_command(st, ATA_SMART_READ_VALUES, 0);
-	if (err)
-		return err;
-
 	/* Checksum the read value table */
 	csum = 0;
 	for (i = 0; i < ATA_SECT_SIZE; i++)
@@ -254,14 +280,16 @@ static int drivetemp_get_smarttemp(struct drivetemp_data *st, u32 attr,
 	return -ENXIO;
 }
 
+static int drivetemp_read_scttemp(struct drivetemp_data *st)
+{
+	return drivetemp_ata_command(st, SMART_READ_LOG, SCT_STATUS_REQ_ADDR);
+}
+
 static int drivetemp_get_scttemp(struct drivetemp_data *st, u32 attr, long *val)
 {
 	u8 *buf = st->smartdata;
-	int err;
+	int err = 0;
 
-	err = drivetemp_ata_command(st, SMART_READ_LOG, SCT_STATUS_REQ_ADDR);
-	if (err)
-		return err;
 	switch (attr) {
 	case hwmon_temp_input:
 		if (!temp_is_valid(buf[SCT_STATUS_TEMP]))
@@ -421,13 +449,18 @@ static int drivetemp_identify_sata(struct drivetemp_data *st)
 
 skip_sct_data:
 	if (have_sct_temp) {
+		st->read_temp = drivetemp_read_scttemp;
 		st->get_temp = drivetemp_get_scttemp;
 		return 0;
 	}
 skip_sct:
 	if (!have_smart)
 		return -ENODEV;
+	st->read_temp = drivetemp_read_smarttemp;
 	st->get_temp = drivetemp_get_smarttemp;
+	err = drivetemp_read_smarttemp(st);
+	if (err)
+		return err;
 	return drivetemp_get_smarttemp(st, hwmon_temp_input, &temp);
 }
 
@@ -446,6 +479,90 @@ static int drivetemp_identify(struct drivetemp_data *st)
 	return drivetemp_identify_sata(st);
 }
 
+/* Whether the drive is spun down, in which case it should not be woken */
+static bool drivetemp_in_standby(struct drivetemp_data *st)
+{
+	u8 sense[SCSI_SENSE_BUFFERSIZE] = { };
+	u8 scsi_cmd[MAX_COMMAND_SIZE] = { };
+
+	if (pm_runtime_suspended(&st->sdev->sdev_gendev))
+		return true;
+
+	scsi_cmd[0] = ATA_16;
+	scsi_cmd[1] = (3 << 1);	/* Non-data */
+	scsi_cmd[2] = 0x20;	/* CK_COND, return the ATA registers */
+	scsi_cmd[14] = ATA_CMD_CHK_POWER;
+
+	st->commands++;
+	scsi_execute(st->sdev, scsi_cmd, DMA_NONE, NULL, 0, sense, NULL, HZ,
+		     1, 0, 0, NULL);
+
+	/* ATA Status Return descriptor, a sector count of 0 means standby */
+	return sense[0] == 0x72 && sense[8] == 0x09 && sense[13] == 0x00;
+}
+
+/* Called with st->lock held */
+static int drivetemp_sample(struct drivetemp_data *st)
+{
+	int err;
+
+	if (drivetemp_in_standby(st)) {
+		st->standby_skips++;
+		if (!st->have_sample)
+			return -EAGAIN;
+		/* Check again once the reading expires */
+		st->sampled = jiffies;
+		return 0;
+	}
+
+	err = st->read_temp(st);
+	st->have_sample = !err;
+	if (!err)
+		st->sampled = jiffies;
+	return err;
+}
+
+/* Called with st->lock held */
+static int drivetemp_refresh(struct drivetemp_data *st)
+{
+	unsigned long max_age = msecs_to_jiffies(READ_ONCE(max_age_ms));
+
+	if (st->have_sample && time_before(jiffies, st->sampled + max_age)) {
+		st->cache_hits++;
+		return 0;
+	}
+
+	/* Do not stall queued IO, use the old reading for now */
+	if (st->have_sample && scsi_device_busy(st->sdev) &&
+	    time_before(jiffies, st->sampled + DRIVETEMP_MAX_DEFER * max_age)) {
+		st->busy_deferrals++;
+		schedule_delayed_work(&st->refresh, DRIVETEMP_IDLE_POLL);
+		return 0;
+	}
+
+	return drivetemp_sample(st);
+}
+
+static void drivetemp_refresh_work(struct work_struct *work)
+{
+	struct drivetemp_data *st = container_of(to_delayed_work(work),
+						 struct drivetemp_data,
+						 refresh);
+	unsigned long max_age = msecs_to_jiffies(READ_ONCE(max_age_ms));
+
+	mutex_lock(&st->lock);
+	if (!st->have_sample || !time_before(jiffies, st->sampled + max_age)) {
+		if (scsi_device_busy(st->sdev) &&
+		    time_before(jiffies,
+				st->sampled + DRIVETEMP_MAX_DEFER * max_age))
+			schedule_delayed_work(&st->refresh,
+					      DRIVETEMP_IDLE_POLL);
+		else
+			drivetemp_sample(st);
+	}
+	mutex_unlock(&st->lock);
+}
+
 static int drivetemp_read(struct device *dev, enum hwmon_sensor_types type,
 			 u32 attr, int channel, long *val)
 {
@@ -460,7 +577,9 @@ static int drivetemp_read(struct device *dev, enum hwmon_sensor_types type,
 	case hwmon_temp_lowest:
 	case hwmon_temp_highest:
 		mutex_lock(&st->lock);
-		err = st->get_temp(st, attr, val);
+		err = drivetemp_refresh(st);
+		if (!err)
+			err = st->get_temp(st, attr, val);
 		mutex_unlock(&st->lock);
 		break;
 	case hwmon_temp_lcrit:
@@ -547,6 +666,30 @@ static const struct hwmon_chip_info drivetemp_chip_info = {
 	.info = drivetemp_info,
 };
 
+#define DRIVETEMP_COUNTER_ATTR(_name)					\
+static ssize_t _name##_show(struct device *dev,				\
+			    struct device_attribute *attr, char *buf)	\
+{									\
+	struct drivetemp_data *st = dev_get_drvdata(dev);		\
+									\
+	return sysfs_emit(buf, "%lu\n", READ_ONCE(st->_name));		\
+}									\
+static DEVICE_ATTR_RO(_name)
+
+DRIVETEMP_COUNTER_ATTR(commands);
+DRIVETEMP_COUNTER_ATTR(cache_hits);
+DRIVETEMP_COUNTER_ATTR(busy_deferrals);
+DRIVETEMP_COUNTER_ATTR(standby_skips);
+
+static struct attribute *drivetemp_attrs[] = {
+	&dev_attr_commands.attr,
+	&dev_attr_cache_hits.attr,
+	&dev_attr_busy_deferrals.attr,
+	&dev_attr_standby_skips.attr,
+	NULL
+};
+ATTRIBUTE_GROUPS(drivetemp);
+
 /*
  * The device argument points to sdev->sdev_dev. Its parent is
  * sdev->sdev_gendev, which we can use to get the scsi_device pointer.
@@ -564,6 +707,7 @@ static int drivetemp_add(struct device *dev, struct class_interface *intf)
 	st->sdev = sdev;
 	st->dev = dev;
 	mutex_init(&st->lock);
+	INIT_DELAYED_WORK(&st->refresh, drivetemp_refresh_work);
 
 	if (drivetemp_identify(st)) {
 		err = -ENODEV;
@@ -572,7 +716,7 @@ static int drivetemp_add(struct device *dev, struct class_interface *intf)
 
 	st->hwdev = hwmon_device_register_with_info(dev->parent, "drivetemp",
 						    st, &drivetemp_chip_info,
-						    NULL);
+						    drivetemp_groups);
 	if (IS_ERR(st->hwdev)) {
 		err = PTR_ERR(st->hwdev);
 		goto abort;
@@ -594,6 +738,7 @@ static void drivetemp_remove(struct device *dev, struct class_interface *intf)
 		if (st->dev == dev) {
 			list_del(&st->list);
 			hwmon_device_unregister(st->hwdev);
+			cancel_delayed_work_sync(&st->refresh);
 			kfree(st);
 			break;
 		}
@@ -5,36 +5,171 @@
  * Copyright 2006 Openedhand Ltd.
  *
  * Author: Richard Purdie <rpurdie@openedhand.com>
+ *
+ * Completed commands are only counted. A work item samples the counters
+ * at most once per interval_ms and blinks the LEDs of every trigger whose
+ * counters moved, so the cost per command stays a counter increment
+ * however fast the disks are. Besides the global triggers, each disk
+ * registered with ledtrig_disk_register() gets a trigger of its own.
  */
 
 #include <linux/kernel.h>
 #include <linux/init.h>
 #include <linux/leds.h>
+#include <linux/list.h>
+#include <linux/moduleparam.h>
+#include <linux/mutex.h>
+#include <linux/percpu.h>
+#include <linux/slab.h>
+#include <linux/workqueue.h>
 
-#define BLINK_DELAY 30
+static unsigned int interval_ms = 60;
+module_param(interval_ms, uint, 0644);
+MODULE_PARM_DESC(interval_ms, "Activity sampling interval in milliseconds");
 
 DEFINE_LED_TRIGGER(ledtrig_disk);
 DEFINE_LED_TRIGGER(ledtrig_disk_read);
 DEFINE_LED_TRIGGER(ledtrig_disk_write);
 DEFINE_LED_TRIGGER(ledtrig_ide);
 
-void ledtrig_disk_activity(bool write)
+struct ledtrig_disk {
+	struct led_trigger	trig;
+	struct list_head	list;
+	unsigned long		reads;		/* written by the driver only */
+	unsigned long		writes;
+	unsigned long		last;		/* used by the sampler only */
+	char			name[16];
+};
+
+static DEFINE_PER_CPU(unsigned long, ledtrig_disk_reads);
+static DEFINE_PER_CPU(unsigned long, ledtrig_disk_writes);
+static unsigned long ledtrig_disk_last_reads, ledtrig_disk_last_writes;
+
+static LIST_HEAD(ledtrig_disk_list);
+static DEFINE_MUTEX(ledtrig_disk_mutex);
+
+static void ledtrig_disk_sample(struct work_struct *work);
+static DECLARE_DELAYED_WORK(ledtrig_disk_work, ledtrig_disk_sample);
+
+static void ledtrig_disk_blink(struct led_trigger *trig)
+{
+	unsigned long blink_delay = max(READ_ONCE(interval_ms) / 2, 1U);
+
+	led_trigger_blink_oneshot(trig, &blink_delay, &blink_delay, 0);
+}
+
+static void ledtrig_disk_sample(struct work_struct *work)
 {
-	unsigned long blink_delay = BLINK_DELAY;
+	unsigned long reads = 0, writes = 0, count;
+	struct ledtrig_disk *disk;
+	int cpu;
 
-	led_trigger_blink_oneshot(ledtrig_disk,
-				  &blink_delay, &blink_delay, 0);
-	led_trigger_blink_oneshot(ledtrig_ide,
-				  &blink_delay, &blink_delay, 0);
+	for_each_possible_cpu(cpu) {
+		reads += per_cpu(ledtrig_disk_reads, cpu);
+		writes += per_cpu(ledtrig_disk_writes, cpu);
+	}
+
+	if (reads != ledtrig_disk_last_reads ||
+	    writes != ledtrig_disk_last_writes) {
+		ledtrig_disk_blink(ledtrig_disk);
+		ledtrig_disk_blink(ledtrig_ide);
+	}
+	if (reads != ledtrig_disk_last_reads)
+		ledtrig_disk_blink(ledtrig_disk_read);
+	if (writes != ledtrig_disk_last_writes)
+		ledtrig_disk_blink(ledtrig_disk_write);
+	ledtrig_disk_last_reads = reads;
+	ledtrig_disk_last_writes = writes;
+
+	mutex_lock(&ledtrig_disk_mutex);
+	list_for_each_entry(disk, &ledtrig_disk_list, list) {
+		count = READ_ONCE(disk->reads) + READ_ONCE(disk->writes);
+		if (count != disk->last)
+			ledtrig_disk_blink(&disk->trig);
+		disk->last = count;
+	}
+	mutex_unlock(&ledtrig_disk_mutex);
+}
+
+/**
+ * ledtrig_disk_count - account a completed disk command
+ * @disk: trigger of the disk, or NULL to only account it globally
+ * @write: whether the command wrote to the disk
+ *
+ * Calls for the same @disk must be serialized by the caller, e.g. by the
+ * port lock. Activity is picked up by the next sample; the sample is only
+ * scheduled when none is pending, so no timer is touched per command.
+ */
+void ledtrig_disk_count(struct ledtrig_disk *disk, bool write)
+{
 	if (write)
-		led_trigger_blink_oneshot(ledtrig_disk_write,
-					  &blink_delay, &blink_delay, 0);
+		this_cpu_inc(ledtrig_disk_writes);
 	else
-		led_trigger_blink_oneshot(ledtrig_disk_read,
-					  &blink_delay, &blink_delay, 0);
+		this_cpu_inc(ledtrig_disk_reads);
+
+	if (disk) {
+		if (write)
+			WRITE_ONCE(disk->writes, disk->writes + 1);
+		else
+			WRITE_ONCE(disk->reads, disk->reads + 1);
+	}
+
+	if (!delayed_work_pending(&ledtrig_disk_work))
+		schedule_delayed_work(&ledtrig_disk_work,
+				      msecs_to_jiffies(READ_ONCE(interval_ms)));
+}
+EXPORT_SYMBOL(ledtrig_disk_count);
+
+void ledtrig_disk_activity(bool write)
+{
+	ledtrig_disk_count(NULL, write);
 }
 EXPORT_SYMBOL(ledtrig_disk_activity);
 
+/**
+ * ledtrig_disk_register - create the activity trigger of a disk
+ * @name: trigger name, e.g. "ata1"
+ *
+ * Return: the trigger to pass to ledtrig_disk_count(), or NULL on failure,
+ * in which case activity is still accounted to the global triggers.
+ */
+struct ledtrig_disk *ledtrig_disk_register(const char *name)
+{
+	struct ledtrig_disk *disk;
+
+	disk = kzalloc(sizeof(*disk), GFP_KERNEL);
+	if (!disk)
+		return NULL;
+
+	strscpy(disk->name, name, sizeof(disk->name));
+	disk->trig.name = disk->name;
+	if (led_trigger_register(&disk->trig)) {
+		kfree(disk);
+		return NULL;
+	}
+
+	mutex_lock(&ledtrig_disk_mutex);
+	list_add_tail(&disk->list, &ledtrig_disk_list);
+	mutex_unlock(&ledtrig_disk_mutex);
+
+	return disk;
+}
+EXPORT_SYMBOL(ledtrig_disk_register);
+
+void ledtrig_disk_unregister(struct ledtrig_disk *disk)
+{
+	if (!disk)
+		return;
+
+	mutex_lock(&ledtrig_disk_mutex);
+	list_del(&disk->list);
+	mutex_unlock(&ledtrig_disk_mutex);
+
+	led_trigger_unregister(&disk->trig);
+	kfree(disk);
+}
+EXPORT_SYMBOL(ledtrig_disk_unregister);
+
 static int __init ledtrig_disk_init(void)
 {
 	led_trigger_register_simple("disk-activity", &ledtrig_disk);
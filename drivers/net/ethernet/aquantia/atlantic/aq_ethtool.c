@@ -16,6 +16,7 @@
 #include "aq_main.h"
 
 #include <linux/ptp_clock_kernel.h>
+#include <net/page_pool.h>
 
 static void aq_ethtool_get_regs(struct net_device *ndev,
 				struct ethtool_regs *regs, void *p)
@@ -98,9 +99,6 @@ static const char * const aq_ethtool_queue_rx_stat_names[] = {
 	"%sQueue[%d] AllocFails",
 	"%sQueue[%d] SkbAllocFails",
 	"%sQueue[%d] Polls",
-	"%sQueue[%d] PageFlips",
-	"%sQueue[%d] PageReuses",
-	"%sQueue[%d] PageFrees",
 	"%sQueue[%d] XdpAbort",
 	"%sQueue[%d] XdpDrop",
 	"%sQueue[%d] XdpPass",
@@ -178,6 +176,13 @@ static const char aq_ethtool_priv_flag_names[][ETH_GSTRING_LEN] = {
 	"PHYExternalLoopback",
 };
 
+static const char * const aq_ethtool_vec_stat_names[] = {
+	"Vec[%d] RxModerationUsecs",
+	"Vec[%d] TxModerationUsecs",
+	"Vec[%d] RxModerationChanges",
+	"Vec[%d] TxModerationChanges",
+};
+
 static u32 aq_ethtool_n_stats(struct net_device *ndev)
 {
 	const int rx_stat_cnt = ARRAY_SIZE(aq_ethtool_queue_rx_stat_names);
@@ -185,13 +190,18 @@ static u32 aq_ethtool_n_stats(struct net_device *ndev)
 	struct aq_nic_s *nic = netdev_priv(ndev);
 	struct aq_nic_cfg_s *cfg = aq_nic_get_cfg(nic);
 	u32 n_stats = ARRAY_SIZE(aq_ethtool_stat_names) +
-		      (rx_stat_cnt + tx_stat_cnt) * cfg->vecs * cfg->tcs;
+		      (rx_stat_cnt + tx_stat_cnt) * cfg->vecs * cfg->tcs +
+		      ARRAY_SIZE(aq_ethtool_vec_stat_names) * cfg->vecs;
 
 #if IS_REACHABLE(CONFIG_PTP_1588_CLOCK)
 	n_stats += rx_stat_cnt * aq_ptp_get_ring_cnt(nic, ATL_RING_RX) +
 		   tx_stat_cnt * aq_ptp_get_ring_cnt(nic, ATL_RING_TX);
 #endif
 
+#ifdef CONFIG_PAGE_POOL_STATS
+	n_stats += page_pool_ethtool_stats_get_count();
+#endif
+
 #if IS_ENABLED(CONFIG_MACSEC)
 	if (nic->macsec_cfg) {
 		n_stats += ARRAY_SIZE(aq_macsec_stat_names) +
@@ -217,6 +227,9 @@ static void aq_ethtool_stats(struct net_device *ndev,
 #if IS_REACHABLE(CONFIG_PTP_1588_CLOCK)
 	data = aq_ptp_get_stats(aq_nic, data);
 #endif
+#ifdef CONFIG_PAGE_POOL_STATS
+	data = aq_nic_get_page_pool_stats(aq_nic, data);
+#endif
 #if IS_ENABLED(CONFIG_MACSEC)
 	data = aq_macsec_get_stats(aq_nic, data);
 #endif
@@ -293,6 +306,14 @@ static void aq_ethtool_get_strings(struct net_device *ndev,
 				}
 			}
 		}
+		for (i = 0; i < cfg->vecs; i++) {
+			for (si = 0; si < ARRAY_SIZE(aq_ethtool_vec_stat_names);
+			     si++) {
+				snprintf(p, ETH_GSTRING_LEN,
+					 aq_ethtool_vec_stat_names[si], i);
+				p += ETH_GSTRING_LEN;
+			}
+		}
 #if IS_REACHABLE(CONFIG_PTP_1588_CLOCK)
 		if (nic->aq_ptp) {
 			const int rx_ring_cnt = aq_ptp_get_ring_cnt(nic, ATL_RING_RX);
@@ -322,6 +343,9 @@ static void aq_ethtool_get_strings(struct net_device *ndev,
 			}
 		}
 #endif
+#ifdef CONFIG_PAGE_POOL_STATS
+		p = page_pool_ethtool_stats_get_strings(p);
+#endif
 #if IS_ENABLED(CONFIG_MACSEC)
 		if (!nic->macsec_cfg)
 			break;
@@ -579,6 +603,9 @@ static int aq_ethtool_get_coalesce(struct net_device *ndev,
 		coal->tx_max_coalesced_frames = 1;
 	}
 
+	coal->use_adaptive_rx_coalesce = cfg->is_rx_dim;
+	coal->use_adaptive_tx_coalesce = cfg->is_tx_dim;
+
 	return 0;
 }
 
@@ -609,8 +636,17 @@ static int aq_ethtool_set_coalesce(struct net_device *ndev,
 	    coal->tx_coalesce_usecs > AQ_CFG_INTERRUPT_MODERATION_USEC_MAX)
 		return -EINVAL;
 
+	/* Adaptive moderation needs per ring moderation in hardware */
+	if ((coal->use_adaptive_rx_coalesce ||
+	     coal->use_adaptive_tx_coalesce) &&
+	    !aq_nic->aq_hw_ops->hw_ring_interrupt_moderation_set)
+		return -EOPNOTSUPP;
+
 	cfg->itr = AQ_CFG_INTERRUPT_MODERATION_ON;
 
+	cfg->is_rx_dim = !!coal->use_adaptive_rx_coalesce;
+	cfg->is_tx_dim = !!coal->use_adaptive_tx_coalesce;
+
 	cfg->rx_itr = coal->rx_coalesce_usecs;
 	cfg->tx_itr = coal->tx_coalesce_usecs;
 
@@ -988,7 +1024,8 @@ static int aq_ethtool_set_phy_tunable(struct net_device *ndev,
 
 const struct ethtool_ops aq_ethtool_ops = {
 	.supported_coalesce_params = ETHTOOL_COALESCE_USECS |
-				     ETHTOOL_COALESCE_MAX_FRAMES,
+				     ETHTOOL_COALESCE_MAX_FRAMES |
+				     ETHTOOL_COALESCE_USE_ADAPTIVE,
 	.get_link            = aq_ethtool_get_link,
 	.get_regs_len        = aq_ethtool_get_regs_len,
 	.get_regs            = aq_ethtool_get_regs,
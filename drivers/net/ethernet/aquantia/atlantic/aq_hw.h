@@ -286,6 +286,10 @@ struct aq_hw_ops {
 
 	int (*hw_interrupt_moderation_set)(struct aq_hw_s *self);
 
+	int (*hw_ring_interrupt_moderation_set)(struct aq_hw_s *self,
+						struct aq_ring_s *aq_ring,
+						u32 usecs);
+
 	int (*hw_rss_set)(struct aq_hw_s *self,
 			  struct aq_rss_parameters *rss_params);
 
@@ -21,6 +21,7 @@
 #include <linux/ip.h>
 #include <linux/udp.h>
 #include <net/pkt_cls.h>
+#include <net/xdp_sock_drv.h>
 #include <linux/filter.h>
 
 MODULE_LICENSE("GPL v2");
@@ -481,11 +482,78 @@ static int aq_xdp_setup(struct net_device *ndev, struct bpf_prog *prog,
 	return 0;
 }
 
+/* Rings pick their AF_XDP buffer pool up when they are allocated, so
+ * restart the interface if the change affects the running rings.
+ */
+static int aq_xsk_pool_setup(struct net_device *ndev,
+			     struct xsk_buff_pool *pool, u16 qid)
+{
+	struct aq_nic_s *aq_nic = netdev_priv(ndev);
+	struct device *dev = aq_nic_get_dev(aq_nic);
+	bool enable = !!pool;
+	bool need_update;
+	int err = 0;
+
+	if (qid >= aq_nic->aq_vecs)
+		return -EINVAL;
+
+	if (enable) {
+		/* Hardware buffers are AQ_CFG_RX_FRAME_MAX long */
+		if (xsk_pool_get_rx_frame_size(pool) < AQ_CFG_RX_FRAME_MAX)
+			return -EINVAL;
+
+		err = xsk_pool_dma_map(pool, dev, 0);
+		if (err)
+			return err;
+	} else {
+		pool = xsk_get_pool_from_qid(ndev, qid);
+		if (!pool || !test_bit(qid, aq_nic->xsk_zc))
+			return -EINVAL;
+	}
+
+	need_update = netif_running(ndev) && aq_nic->xdp_prog;
+	if (need_update)
+		aq_ndev_close(ndev);
+
+	if (enable)
+		set_bit(qid, aq_nic->xsk_zc);
+	else
+		clear_bit(qid, aq_nic->xsk_zc);
+
+	if (need_update)
+		err = aq_ndev_open(ndev);
+
+	if (err && enable)
+		clear_bit(qid, aq_nic->xsk_zc);
+	if (err || !enable)
+		xsk_pool_dma_unmap(pool, 0);
+
+	return err;
+}
+
+static int aq_xsk_wakeup(struct net_device *ndev, u32 qid, u32 flags)
+{
+	struct aq_nic_s *aq_nic = netdev_priv(ndev);
+
+	if (!netif_running(ndev) || !aq_nic->xdp_prog)
+		return -ENETDOWN;
+
+	if (qid >= aq_nic->aq_vecs || !aq_nic->aq_ring_tx[qid] ||
+	    !aq_nic->aq_ring_tx[qid]->xsk_pool)
+		return -EINVAL;
+
+	aq_vec_kick(aq_nic->aq_vec[qid]);
+
+	return 0;
+}
+
 static int aq_xdp(struct net_device *dev, struct netdev_bpf *xdp)
 {
 	switch (xdp->command) {
 	case XDP_SETUP_PROG:
 		return aq_xdp_setup(dev, xdp->prog, xdp->extack);
+	case XDP_SETUP_XSK_POOL:
+		return aq_xsk_pool_setup(dev, xdp->xsk.pool, xdp->xsk.queue_id);
 	default:
 		return -EINVAL;
 	}
@@ -506,6 +574,7 @@ static const struct net_device_ops aq_ndev_ops = {
 	.ndo_setup_tc = aq_ndo_setup_tc,
 	.ndo_bpf = aq_xdp,
 	.ndo_xdp_xmit = aq_xdp_xmit,
+	.ndo_xsk_wakeup = aq_xsk_wakeup,
 };
 
 static int __init aq_ndev_init_module(void)
@@ -26,6 +26,7 @@
 #include <linux/ip.h>
 #include <linux/tcp.h>
 #include <net/ip.h>
+#include <net/page_pool.h>
 #include <net/pkt_cls.h>
 
 static unsigned int aq_itr = AQ_CFG_INTERRUPT_MODERATION_AUTO;
@@ -105,6 +106,9 @@ void aq_nic_cfg_start(struct aq_nic_s *self)
 	cfg->itr = aq_itr;
 	cfg->tx_itr = aq_itr_tx;
 	cfg->rx_itr = aq_itr_rx;
+	cfg->is_rx_dim = aq_itr == AQ_CFG_INTERRUPT_MODERATION_AUTO &&
+			 self->aq_hw_ops->hw_ring_interrupt_moderation_set;
+	cfg->is_tx_dim = cfg->is_rx_dim;
 
 	cfg->rxpageorder = AQ_CFG_RX_PAGEORDER;
 	cfg->is_rss = AQ_CFG_IS_RSS_DEF;
@@ -906,7 +910,20 @@ int aq_nic_xmit(struct aq_nic_s *self, struct sk_buff *skb)
 
 int aq_nic_update_interrupt_moderation_settings(struct aq_nic_s *self)
 {
-	return self->aq_hw_ops->hw_interrupt_moderation_set(self->aq_hw);
+	unsigned int i;
+	int err;
+
+	err = self->aq_hw_ops->hw_interrupt_moderation_set(self->aq_hw);
+	if (err)
+		return err;
+
+	for (i = 0U; self->aq_vecs > i; ++i) {
+		if (!self->aq_vec[i])
+			break;
+		aq_vec_dim_restore(self->aq_vec[i]);
+	}
+
+	return 0;
 }
 
 int aq_nic_set_packet_filter(struct aq_nic_s *self, unsigned int flags)
@@ -1070,11 +1087,38 @@ u64 *aq_nic_get_stats(struct aq_nic_s *self, u64 *data)
 	}
 
 	data += count;
+	count = 0U;
+
+	for (i = 0U; self->aq_vecs > i; ++i) {
+		if (!self->aq_vec[i])
+			break;
+		data += count;
+		count = aq_vec_get_dim_stats(self->aq_vec[i], data);
+	}
+
+	data += count;
 
 err_exit:
 	return data;
 }
 
+#ifdef CONFIG_PAGE_POOL_STATS
+/* The page pools of all RX rings are reported as a single set */
+u64 *aq_nic_get_page_pool_stats(struct aq_nic_s *self, u64 *data)
+{
+	struct page_pool_stats stats = { 0 };
+	unsigned int i;
+
+	for (i = 0U; self->aq_vecs > i; ++i) {
+		if (!self->aq_vec[i])
+			break;
+		aq_vec_get_page_pool_stats(self->aq_vec[i], &stats);
+	}
+
+	return page_pool_ethtool_stats_get(data, &stats);
+}
+#endif
+
 static void aq_nic_update_ndev_stats(struct aq_nic_s *self)
 {
 	struct aq_stats_s *stats = self->aq_hw_ops->hw_get_hw_stats(self->aq_hw);
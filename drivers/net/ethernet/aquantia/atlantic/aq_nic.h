@@ -67,6 +67,8 @@ struct aq_nic_cfg_s {
 	bool is_qos;
 	bool is_ptp;
 	bool is_media_detect;
+	bool is_rx_dim;
+	bool is_tx_dim;
 	int downshift_counter;
 	enum aq_tc_mode tc_mode;
 	u32 priv_flags;
@@ -163,6 +165,8 @@ struct aq_nic_s {
 	/* PTP support */
 	struct aq_ptp_s *aq_ptp;
 	struct aq_hw_rx_fltrs_s aq_hw_rx_fltrs;
+	/* queues with an AF_XDP zero-copy buffer pool */
+	DECLARE_BITMAP(xsk_zc, AQ_CFG_VECS_MAX);
 };
 
 static inline struct device *aq_nic_get_dev(struct aq_nic_s *self)
@@ -188,6 +192,9 @@ int aq_nic_xmit(struct aq_nic_s *self, struct sk_buff *skb);
 int aq_nic_get_regs(struct aq_nic_s *self, struct ethtool_regs *regs, void *p);
 int aq_nic_get_regs_count(struct aq_nic_s *self);
 u64 *aq_nic_get_stats(struct aq_nic_s *self, u64 *data);
+#ifdef CONFIG_PAGE_POOL_STATS
+u64 *aq_nic_get_page_pool_stats(struct aq_nic_s *self, u64 *data);
+#endif
 int aq_nic_stop(struct aq_nic_s *self);
 void aq_nic_deinit(struct aq_nic_s *self, bool link_down);
 void aq_nic_set_power(struct aq_nic_s *self);
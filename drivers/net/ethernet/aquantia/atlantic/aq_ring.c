@@ -14,16 +14,24 @@
 #include "aq_vec.h"
 #include "aq_main.h"
 
+#include <net/page_pool.h>
 #include <net/xdp.h>
+#include <net/xdp_sock_drv.h>
 #include <linux/filter.h>
 #include <linux/bpf_trace.h>
 #include <linux/netdevice.h>
 #include <linux/etherdevice.h>
 
-static void aq_get_rxpages_xdp(struct aq_ring_buff_s *buff,
-			       struct xdp_buff *xdp)
+/* Give back the pages of a frame the XDP program did not keep. Only the head
+ * buffer up to the furthest point the CPU may have touched, either the
+ * received @len or the end the program left, is synced for the device.
+ */
+static void aq_put_rxpages_xdp(struct aq_ring_s *rx_ring,
+			       struct aq_ring_buff_s *buff,
+			       struct xdp_buff *xdp, unsigned int len)
 {
 	struct skb_shared_info *sinfo;
+	unsigned int sync_len;
 	int i;
 
 	if (xdp_buff_has_frags(xdp)) {
@@ -32,104 +40,51 @@ static void aq_get_rxpages_xdp(struct aq_ring_buff_s *buff,
 		for (i = 0; i < sinfo->nr_frags; i++) {
 			skb_frag_t *frag = &sinfo->frags[i];
 
-			page_ref_inc(skb_frag_page(frag));
+			page_pool_put_full_page(rx_ring->page_pool,
+						skb_frag_page(frag), true);
 		}
 	}
-	page_ref_inc(buff->rxdata.page);
-}
-
-static inline void aq_free_rxpage(struct aq_rxpage *rxpage, struct device *dev)
-{
-	unsigned int len = PAGE_SIZE << rxpage->order;
 
-	dma_unmap_page(dev, rxpage->daddr, len, DMA_FROM_DEVICE);
-
-	/* Drop the ref for being in the ring. */
-	__free_pages(rxpage->page, rxpage->order);
-	rxpage->page = NULL;
+	sync_len = xdp->data_end - xdp->data_hard_start - rx_ring->page_offset;
+	page_pool_put_page(rx_ring->page_pool, buff->rxdata.page,
+			   max(sync_len, len), true);
+	buff->rxdata.page = NULL;
 }
 
-static int aq_alloc_rxpages(struct aq_rxpage *rxpage, struct aq_ring_s *rx_ring)
+static int aq_get_rxpages(struct aq_ring_s *self, struct aq_ring_buff_s *rxbuf)
 {
-	struct device *dev = aq_nic_get_dev(rx_ring->aq_nic);
-	unsigned int order = rx_ring->page_order;
 	struct page *page;
-	int ret = -ENOMEM;
-	dma_addr_t daddr;
 
-	page = dev_alloc_pages(order);
-	if (unlikely(!page))
-		goto err_exit;
+	/* Buffers skipped on a receive error still own their page */
+	if (rxbuf->rxdata.page)
+		return 0;
 
-	daddr = dma_map_page(dev, page, 0, PAGE_SIZE << order,
-			     DMA_FROM_DEVICE);
-
-	if (unlikely(dma_mapping_error(dev, daddr)))
-		goto free_page;
+	page = page_pool_dev_alloc_pages(self->page_pool);
+	if (unlikely(!page)) {
+		u64_stats_update_begin(&self->stats.rx.syncp);
+		self->stats.rx.alloc_fails++;
+		u64_stats_update_end(&self->stats.rx.syncp);
+		return -ENOMEM;
+	}
 
-	rxpage->page = page;
-	rxpage->daddr = daddr;
-	rxpage->order = order;
-	rxpage->pg_off = rx_ring->page_offset;
+	rxbuf->rxdata.page = page;
+	rxbuf->rxdata.daddr = page_pool_get_dma_addr(page);
+	rxbuf->rxdata.pg_off = self->page_offset;
 
 	return 0;
-
-free_page:
-	__free_pages(page, order);
-
-err_exit:
-	return ret;
 }
 
-static int aq_get_rxpages(struct aq_ring_s *self, struct aq_ring_buff_s *rxbuf)
+/* Only the rings of tc 0 map to the AF_XDP queue ids, and zero-copy is
+ * only used while an XDP program is attached.
+ */
+static struct xsk_buff_pool *aq_ring_xsk_pool(struct aq_nic_s *aq_nic,
+					      unsigned int idx)
 {
-	unsigned int order = self->page_order;
-	u16 page_offset = self->page_offset;
-	u16 frame_max = self->frame_max;
-	u16 tail_size = self->tail_size;
-	int ret;
-
-	if (rxbuf->rxdata.page) {
-		/* One means ring is the only user and can reuse */
-		if (page_ref_count(rxbuf->rxdata.page) > 1) {
-			/* Try reuse buffer */
-			rxbuf->rxdata.pg_off += frame_max + page_offset +
-						tail_size;
-			if (rxbuf->rxdata.pg_off + frame_max + tail_size <=
-			    (PAGE_SIZE << order)) {
-				u64_stats_update_begin(&self->stats.rx.syncp);
-				self->stats.rx.pg_flips++;
-				u64_stats_update_end(&self->stats.rx.syncp);
-
-			} else {
-				/* Buffer exhausted. We have other users and
-				 * should release this page and realloc
-				 */
-				aq_free_rxpage(&rxbuf->rxdata,
-					       aq_nic_get_dev(self->aq_nic));
-				u64_stats_update_begin(&self->stats.rx.syncp);
-				self->stats.rx.pg_losts++;
-				u64_stats_update_end(&self->stats.rx.syncp);
-			}
-		} else {
-			rxbuf->rxdata.pg_off = page_offset;
-			u64_stats_update_begin(&self->stats.rx.syncp);
-			self->stats.rx.pg_reuses++;
-			u64_stats_update_end(&self->stats.rx.syncp);
-		}
-	}
-
-	if (!rxbuf->rxdata.page) {
-		ret = aq_alloc_rxpages(&rxbuf->rxdata, self);
-		if (ret) {
-			u64_stats_update_begin(&self->stats.rx.syncp);
-			self->stats.rx.alloc_fails++;
-			u64_stats_update_end(&self->stats.rx.syncp);
-		}
-		return ret;
-	}
+	if (!READ_ONCE(aq_nic->xdp_prog) || idx >= aq_nic->aq_vecs ||
+	    !test_bit(idx, aq_nic->xsk_zc))
+		return NULL;
 
-	return 0;
+	return xsk_get_pool_from_qid(aq_nic->ndev, idx);
 }
 
 static struct aq_ring_s *aq_ring_alloc(struct aq_ring_s *self,
@@ -173,6 +128,7 @@ struct aq_ring_s *aq_ring_tx_alloc(struct aq_ring_s *self,
 	self->idx = idx;
 	self->size = aq_nic_cfg->txds;
 	self->dx_size = aq_nic_cfg->aq_hw_caps->txd_size;
+	self->xsk_pool = aq_ring_xsk_pool(aq_nic, idx);
 
 	self = aq_ring_alloc(self, aq_nic);
 	if (!self) {
@@ -194,6 +150,7 @@ struct aq_ring_s *aq_ring_rx_alloc(struct aq_ring_s *self,
 				   unsigned int idx,
 				   struct aq_nic_cfg_s *aq_nic_cfg)
 {
+	struct page_pool_params pp_params = { 0 };
 	int err = 0;
 
 	self->aq_nic = aq_nic;
@@ -202,6 +159,7 @@ struct aq_ring_s *aq_ring_rx_alloc(struct aq_ring_s *self,
 	self->dx_size = aq_nic_cfg->aq_hw_caps->rxd_size;
 	self->xdp_prog = aq_nic->xdp_prog;
 	self->frame_max = AQ_CFG_RX_FRAME_MAX;
+	self->xsk_pool = aq_ring_xsk_pool(aq_nic, idx);
 
 	/* Only order-2 is allowed if XDP is enabled */
 	if (READ_ONCE(self->xdp_prog)) {
@@ -223,6 +181,29 @@ struct aq_ring_s *aq_ring_rx_alloc(struct aq_ring_s *self,
 		goto err_exit;
 	}
 
+	/* zero-copy rings receive straight into AF_XDP buffers */
+	if (self->xsk_pool)
+		return self;
+
+	/* The pool maps each page once and, when a page comes back, syncs
+	 * for the device only the area the hardware may write.
+	 */
+	pp_params.flags = PP_FLAG_DMA_MAP | PP_FLAG_DMA_SYNC_DEV;
+	pp_params.order = self->page_order;
+	pp_params.pool_size = self->size;
+	pp_params.nid = NUMA_NO_NODE;
+	pp_params.dev = aq_nic_get_dev(aq_nic);
+	pp_params.dma_dir = DMA_FROM_DEVICE;
+	pp_params.offset = self->page_offset;
+	pp_params.max_len = self->frame_max;
+
+	self->page_pool = page_pool_create(&pp_params);
+	if (IS_ERR(self->page_pool)) {
+		err = PTR_ERR(self->page_pool);
+		self->page_pool = NULL;
+		goto err_exit;
+	}
+
 err_exit:
 	if (err < 0) {
 		aq_ring_free(self);
@@ -314,6 +295,7 @@ void aq_ring_queue_stop(struct aq_ring_s *ring)
 bool aq_ring_tx_clean(struct aq_ring_s *self)
 {
 	struct device *dev = aq_nic_get_dev(self->aq_nic);
+	unsigned int xsk_frames = 0U;
 	unsigned int budget;
 
 	for (budget = AQ_CFG_TX_CLEAN_BUDGET;
@@ -352,6 +334,12 @@ bool aq_ring_tx_clean(struct aq_ring_s *self)
 			self->stats.tx.bytes += xdp_get_frame_len(buff->xdpf);
 			u64_stats_update_end(&self->stats.tx.syncp);
 			xdp_return_frame_rx_napi(buff->xdpf);
+		} else if (buff->is_xsk) {
+			u64_stats_update_begin(&self->stats.tx.syncp);
+			++self->stats.tx.packets;
+			self->stats.tx.bytes += buff->len;
+			u64_stats_update_end(&self->stats.tx.syncp);
+			xsk_frames++;
 		}
 
 out:
@@ -362,9 +350,61 @@ bool aq_ring_tx_clean(struct aq_ring_s *self)
 		self->sw_head = aq_ring_next_dx(self, self->sw_head);
 	}
 
+	if (xsk_frames)
+		xsk_tx_completed(self->xsk_pool, xsk_frames);
+
 	return !!budget;
 }
 
+/* Send frames from the AF_XDP TX queue. The ring is shared with the stack,
+ * so take the queue lock and leave it room for a fully fragmented skb.
+ * Returns false when the budget ran out and the poll should go on.
+ */
+bool aq_ring_xsk_xmit(struct aq_ring_s *self, unsigned int budget)
+{
+	struct xsk_buff_pool *pool = self->xsk_pool;
+	struct aq_nic_s *aq_nic = self->aq_nic;
+	struct aq_ring_buff_s *buff;
+	struct netdev_queue *nq;
+	unsigned int sent = 0U;
+	struct xdp_desc desc;
+
+	nq = netdev_get_tx_queue(aq_nic_get_ndev(aq_nic), self->idx);
+	__netif_tx_lock(nq, smp_processor_id());
+
+	while (sent < budget &&
+	       aq_ring_avail_dx(self) > AQ_CFG_SKB_FRAGS_MAX + 1 &&
+	       xsk_tx_peek_desc(pool, &desc)) {
+		buff = &self->buff_ring[self->sw_tail];
+		buff->flags = 0U;
+		buff->pa = xsk_buff_raw_get_dma(pool, desc.addr);
+		xsk_buff_raw_dma_sync_for_device(pool, buff->pa, desc.len);
+		buff->len = desc.len;
+		buff->is_sop = 1U;
+		buff->is_eop = 1U;
+		buff->is_xsk = 1U;
+		buff->eop_index = self->sw_tail;
+		buff->skb = NULL;
+		buff->xdpf = NULL;
+
+		/* hw_ring_tx_xmit takes the number of descriptors to send,
+		 * each AF_XDP frame needs exactly one
+		 */
+		aq_nic->aq_hw_ops->hw_ring_tx_xmit(aq_nic->aq_hw, self, 1U);
+		sent++;
+	}
+
+	if (sent)
+		xsk_tx_release(pool);
+
+	__netif_tx_unlock(nq);
+
+	if (xsk_uses_need_wakeup(pool))
+		xsk_set_tx_need_wakeup(pool);
+
+	return sent < budget;
+}
+
 static void aq_rx_checksum(struct aq_ring_s *self,
 			   struct aq_ring_buff_s *buff,
 			   struct sk_buff *skb)
@@ -415,7 +455,8 @@ int aq_xdp_xmit(struct net_device *dev, int num_frames,
 static struct sk_buff *aq_xdp_run_prog(struct aq_nic_s *aq_nic,
 				       struct xdp_buff *xdp,
 				       struct aq_ring_s *rx_ring,
-				       struct aq_ring_buff_s *buff)
+				       struct aq_ring_buff_s *buff,
+				       unsigned int len)
 {
 	int result = NETDEV_TX_BUSY;
 	struct aq_ring_s *tx_ring;
@@ -452,7 +493,9 @@ static struct sk_buff *aq_xdp_run_prog(struct aq_nic_s *aq_nic,
 		u64_stats_update_begin(&rx_ring->stats.rx.syncp);
 		++rx_ring->stats.rx.xdp_pass;
 		u64_stats_update_end(&rx_ring->stats.rx.syncp);
-		aq_get_rxpages_xdp(buff, xdp);
+		/* The skb owns the pages now and returns them to the pool */
+		skb_mark_for_recycle(skb);
+		buff->rxdata.page = NULL;
 		return skb;
 	case XDP_TX:
 		xdpf = xdp_convert_buff_to_frame(xdp);
@@ -465,7 +508,7 @@ static struct sk_buff *aq_xdp_run_prog(struct aq_nic_s *aq_nic,
 		u64_stats_update_begin(&rx_ring->stats.rx.syncp);
 		++rx_ring->stats.rx.xdp_tx;
 		u64_stats_update_end(&rx_ring->stats.rx.syncp);
-		aq_get_rxpages_xdp(buff, xdp);
+		buff->rxdata.page = NULL;
 		break;
 	case XDP_REDIRECT:
 		if (xdp_do_redirect(aq_nic->ndev, xdp, prog) < 0)
@@ -474,7 +517,7 @@ static struct sk_buff *aq_xdp_run_prog(struct aq_nic_s *aq_nic,
 		u64_stats_update_begin(&rx_ring->stats.rx.syncp);
 		++rx_ring->stats.rx.xdp_redirect;
 		u64_stats_update_end(&rx_ring->stats.rx.syncp);
-		aq_get_rxpages_xdp(buff, xdp);
+		buff->rxdata.page = NULL;
 		break;
 	default:
 		fallthrough;
@@ -485,11 +528,13 @@ static struct sk_buff *aq_xdp_run_prog(struct aq_nic_s *aq_nic,
 		u64_stats_update_end(&rx_ring->stats.rx.syncp);
 		trace_xdp_exception(aq_nic->ndev, prog, act);
 		bpf_warn_invalid_xdp_action(aq_nic->ndev, prog, act);
+		aq_put_rxpages_xdp(rx_ring, buff, xdp, len);
 		break;
 	case XDP_DROP:
 		u64_stats_update_begin(&rx_ring->stats.rx.syncp);
 		++rx_ring->stats.rx.xdp_drop;
 		u64_stats_update_end(&rx_ring->stats.rx.syncp);
+		aq_put_rxpages_xdp(rx_ring, buff, xdp, len);
 		break;
 	}
 
@@ -508,8 +553,11 @@ static bool aq_add_rx_fragment(struct device *dev,
 	do {
 		skb_frag_t *frag;
 
-		if (unlikely(sinfo->nr_frags >= MAX_SKB_FRAGS))
+		if (unlikely(sinfo->nr_frags >= MAX_SKB_FRAGS)) {
+			/* let the caller give back what was attached */
+			xdp_buff_set_frags_flag(xdp);
 			return true;
+		}
 
 		frag = &sinfo->frags[sinfo->nr_frags++];
 		buff_ = &ring->buff_ring[buff_->next];
@@ -533,6 +581,9 @@ static bool aq_add_rx_fragment(struct device *dev,
 		if (page_is_pfmemalloc(buff_->rxdata.page))
 			xdp_buff_set_frag_pfmemalloc(xdp);
 
+		/* the frame owns the page from here on */
+		buff_->rxdata.page = NULL;
+
 	} while (!buff_->is_eop);
 
 	xdp_buff_set_frags_flag(xdp);
@@ -554,6 +605,7 @@ static int __aq_ring_rx_clean(struct aq_ring_s *self, struct napi_struct *napi,
 		struct aq_ring_buff_s *buff_ = NULL;
 		struct sk_buff *skb = NULL;
 		unsigned int next_ = 0U;
+		unsigned int sync_len;
 		unsigned int i = 0U;
 		u16 hdr_len;
 
@@ -622,6 +674,7 @@ static int __aq_ring_rx_clean(struct aq_ring_s *self, struct napi_struct *napi,
 					      buff->rxdata.daddr,
 					      buff->rxdata.pg_off,
 					      buff->len, DMA_FROM_DEVICE);
+		sync_len = buff->len;
 
 		skb = napi_alloc_skb(napi, AQ_CFG_RX_HDR_SIZE);
 		if (unlikely(!skb)) {
@@ -646,13 +699,19 @@ static int __aq_ring_rx_clean(struct aq_ring_s *self, struct napi_struct *napi,
 		memcpy(__skb_put(skb, hdr_len), aq_buf_vaddr(&buff->rxdata),
 		       ALIGN(hdr_len, sizeof(long)));
 
-		if (buff->len - hdr_len > 0) {
+		/* Pages attached to the skb go back to the pool when it is
+		 * freed, a fully copied one is recycled right away.
+		 */
+		skb_mark_for_recycle(skb);
+		if (buff->len - hdr_len > 0)
 			skb_add_rx_frag(skb, i++, buff->rxdata.page,
 					buff->rxdata.pg_off + hdr_len,
 					buff->len - hdr_len,
 					self->frame_max);
-			page_ref_inc(buff->rxdata.page);
-		}
+		else
+			page_pool_put_page(self->page_pool, buff->rxdata.page,
+					   sync_len, true);
+		buff->rxdata.page = NULL;
 
 		if (!buff->is_eop) {
 			buff_ = buff;
@@ -670,7 +729,7 @@ static int __aq_ring_rx_clean(struct aq_ring_s *self, struct napi_struct *napi,
 						buff_->rxdata.pg_off,
 						buff_->len,
 						self->frame_max);
-				page_ref_inc(buff_->rxdata.page);
+				buff_->rxdata.page = NULL;
 				buff_->is_cleaned = 1;
 
 				buff->is_ip_cso &= buff_->is_ip_cso;
@@ -730,6 +789,7 @@ static int __aq_ring_xdp_clean(struct aq_ring_s *rx_ring,
 		struct aq_ring_buff_s *buff_ = NULL;
 		struct sk_buff *skb = NULL;
 		unsigned int next_ = 0U;
+		unsigned int sync_len;
 		struct xdp_buff xdp;
 		void *hard_start;
 
@@ -793,8 +853,8 @@ static int __aq_ring_xdp_clean(struct aq_ring_s *rx_ring,
 					      buff->rxdata.daddr,
 					      buff->rxdata.pg_off,
 					      buff->len, DMA_FROM_DEVICE);
-		hard_start = page_address(buff->rxdata.page) +
-			     buff->rxdata.pg_off - rx_ring->page_offset;
+		sync_len = buff->len;
+		hard_start = page_address(buff->rxdata.page);
 
 		if (is_ptp_ring)
 			buff->len -=
@@ -812,11 +872,13 @@ static int __aq_ring_xdp_clean(struct aq_ring_s *rx_ring,
 				rx_ring->stats.rx.bytes += xdp_get_buff_len(&xdp);
 				++rx_ring->stats.rx.xdp_aborted;
 				u64_stats_update_end(&rx_ring->stats.rx.syncp);
+				aq_put_rxpages_xdp(rx_ring, buff, &xdp,
+						   sync_len);
 				continue;
 			}
 		}
 
-		skb = aq_xdp_run_prog(aq_nic, &xdp, rx_ring, buff);
+		skb = aq_xdp_run_prog(aq_nic, &xdp, rx_ring, buff, sync_len);
 		if (IS_ERR(skb) || !skb)
 			continue;
 
@@ -842,11 +904,187 @@ static int __aq_ring_xdp_clean(struct aq_ring_s *rx_ring,
 	return err;
 }
 
+static struct sk_buff *aq_xsk_construct_skb(struct aq_ring_s *rx_ring,
+					    struct napi_struct *napi,
+					    struct xdp_buff *xdp)
+{
+	unsigned int metasize = xdp->data - xdp->data_meta;
+	unsigned int datasize = xdp->data_end - xdp->data;
+	struct sk_buff *skb;
+
+	skb = __napi_alloc_skb(napi, xdp->data_end - xdp->data_hard_start,
+			       GFP_ATOMIC | __GFP_NOWARN);
+	if (unlikely(!skb))
+		return NULL;
+
+	skb_reserve(skb, xdp->data - xdp->data_hard_start);
+	memcpy(__skb_put(skb, datasize), xdp->data, datasize);
+	if (metasize)
+		skb_metadata_set(skb, metasize);
+
+	return skb;
+}
+
+/* Zero-copy counterpart of __aq_ring_xdp_clean(). Buffers come from the
+ * AF_XDP fill queue and frames spanning several of them cannot be handed
+ * to a socket, so those are dropped. Passed frames are copied into an skb.
+ */
+static int aq_ring_xsk_rx_clean(struct aq_ring_s *rx_ring,
+				struct napi_struct *napi, int *work_done,
+				int budget)
+{
+	struct aq_nic_s *aq_nic = rx_ring->aq_nic;
+	struct net_device *ndev = aq_nic_get_ndev(aq_nic);
+	struct bpf_prog *prog = READ_ONCE(rx_ring->xdp_prog);
+	bool do_flush = false;
+	int err = 0;
+
+	for (; (rx_ring->sw_head != rx_ring->hw_head) && budget;
+		rx_ring->sw_head = aq_ring_next_dx(rx_ring, rx_ring->sw_head),
+		--budget, ++(*work_done)) {
+		struct aq_ring_buff_s *buff = &rx_ring->buff_ring[rx_ring->sw_head];
+		struct xdp_buff *xdp = buff->rxdata.xsk_buff;
+		struct aq_ring_buff_s *buff_ = NULL;
+		struct aq_ring_s *tx_ring;
+		struct xdp_frame *xdpf;
+		struct sk_buff *skb;
+		unsigned int next_;
+		u32 act;
+
+		if (buff->is_cleaned)
+			continue;
+
+		if (!buff->is_eop) {
+			buff_ = buff;
+			do {
+				if (buff_->next >= rx_ring->size) {
+					err = -EIO;
+					goto err_exit;
+				}
+				next_ = buff_->next;
+				buff_ = &rx_ring->buff_ring[next_];
+				if (!aq_ring_dx_in_range(rx_ring->sw_head,
+							 next_,
+							 rx_ring->hw_head))
+					goto err_exit;
+			} while (!buff_->is_eop);
+
+			buff_ = buff;
+			do {
+				buff_ = &rx_ring->buff_ring[buff_->next];
+				xsk_buff_free(buff_->rxdata.xsk_buff);
+				buff_->rxdata.xsk_buff = NULL;
+				buff_->is_cleaned = 1;
+			} while (!buff_->is_eop);
+			buff->is_error = 1;
+		}
+
+		buff->rxdata.xsk_buff = NULL;
+
+		if (buff->is_error) {
+			xsk_buff_free(xdp);
+			u64_stats_update_begin(&rx_ring->stats.rx.syncp);
+			++rx_ring->stats.rx.errors;
+			u64_stats_update_end(&rx_ring->stats.rx.syncp);
+			continue;
+		}
+
+		xsk_buff_set_size(xdp, buff->len);
+		xsk_buff_dma_sync_for_cpu(xdp, rx_ring->xsk_pool);
+
+		u64_stats_update_begin(&rx_ring->stats.rx.syncp);
+		++rx_ring->stats.rx.packets;
+		rx_ring->stats.rx.bytes += buff->len;
+		u64_stats_update_end(&rx_ring->stats.rx.syncp);
+
+		act = bpf_prog_run_xdp(prog, xdp);
+		switch (act) {
+		case XDP_PASS:
+			skb = aq_xsk_construct_skb(rx_ring, napi, xdp);
+			xsk_buff_free(xdp);
+			if (unlikely(!skb)) {
+				u64_stats_update_begin(&rx_ring->stats.rx.syncp);
+				++rx_ring->stats.rx.skb_alloc_fails;
+				u64_stats_update_end(&rx_ring->stats.rx.syncp);
+				continue;
+			}
+
+			if (buff->is_vlan)
+				__vlan_hwaccel_put_tag(skb, htons(ETH_P_8021Q),
+						       buff->vlan_rx_tag);
+			skb->protocol = eth_type_trans(skb, ndev);
+			aq_rx_checksum(rx_ring, buff, skb);
+			skb_set_hash(skb, buff->rss_hash,
+				     buff->is_hash_l4 ? PKT_HASH_TYPE_L4 :
+				     PKT_HASH_TYPE_NONE);
+			skb_record_rx_queue(skb,
+					    AQ_NIC_RING2QMAP(aq_nic,
+							     rx_ring->idx));
+			u64_stats_update_begin(&rx_ring->stats.rx.syncp);
+			++rx_ring->stats.rx.xdp_pass;
+			u64_stats_update_end(&rx_ring->stats.rx.syncp);
+			napi_gro_receive(napi, skb);
+			continue;
+		case XDP_TX:
+			/* copies the frame and releases the buffer */
+			xdpf = xdp_convert_buff_to_frame(xdp);
+			if (unlikely(!xdpf))
+				goto out_aborted;
+			tx_ring = aq_nic->aq_ring_tx[rx_ring->idx];
+			if (aq_nic_xmit_xdpf(aq_nic, tx_ring, xdpf) ==
+			    NETDEV_TX_BUSY) {
+				xdp_return_frame_rx_napi(xdpf);
+				xdp = NULL;
+				goto out_aborted;
+			}
+			u64_stats_update_begin(&rx_ring->stats.rx.syncp);
+			++rx_ring->stats.rx.xdp_tx;
+			u64_stats_update_end(&rx_ring->stats.rx.syncp);
+			continue;
+		case XDP_REDIRECT:
+			if (xdp_do_redirect(ndev, xdp, prog) < 0)
+				goto out_aborted;
+			do_flush = true;
+			u64_stats_update_begin(&rx_ring->stats.rx.syncp);
+			++rx_ring->stats.rx.xdp_redirect;
+			u64_stats_update_end(&rx_ring->stats.rx.syncp);
+			continue;
+		default:
+			fallthrough;
+		case XDP_ABORTED:
+out_aborted:
+			u64_stats_update_begin(&rx_ring->stats.rx.syncp);
+			++rx_ring->stats.rx.xdp_aborted;
+			u64_stats_update_end(&rx_ring->stats.rx.syncp);
+			trace_xdp_exception(ndev, prog, act);
+			bpf_warn_invalid_xdp_action(ndev, prog, act);
+			break;
+		case XDP_DROP:
+			u64_stats_update_begin(&rx_ring->stats.rx.syncp);
+			++rx_ring->stats.rx.xdp_drop;
+			u64_stats_update_end(&rx_ring->stats.rx.syncp);
+			break;
+		}
+
+		if (xdp)
+			xsk_buff_free(xdp);
+	}
+
+err_exit:
+	/* one flush per poll keeps the socket wakeups batched */
+	if (do_flush)
+		xdp_do_flush();
+
+	return err;
+}
+
 int aq_ring_rx_clean(struct aq_ring_s *self,
 		     struct napi_struct *napi,
 		     int *work_done,
 		     int budget)
 {
+	if (self->xsk_pool)
+		return aq_ring_xsk_rx_clean(self, napi, work_done, budget);
 	if (static_branch_unlikely(&aq_xdp_locking_key))
 		return __aq_ring_xdp_clean(self, napi, work_done, budget);
 	else
@@ -870,12 +1108,70 @@ void aq_ring_hwts_rx_clean(struct aq_ring_s *self, struct aq_nic_s *aq_nic)
 #endif
 }
 
+/* Posts AF_XDP fill queue buffers to the free descriptors, reading the
+ * fill queue in batches. An empty fill queue is not an error: what was
+ * allocated is posted and false is returned, so that the caller can keep
+ * polling or, with need_wakeup, have the application kick us once it has
+ * added buffers.
+ */
+bool aq_ring_xsk_rx_fill(struct aq_ring_s *self)
+{
+	struct xdp_buff *xdp[AQ_CFG_RX_REFILL_THRES];
+	struct xsk_buff_pool *pool = self->xsk_pool;
+	unsigned int avail = aq_ring_avail_dx(self);
+	bool filled = true;
+	u32 i, n, got;
+
+	if (avail < min_t(unsigned int, AQ_CFG_RX_REFILL_THRES,
+			  self->size / 2))
+		return true;
+
+	while (avail) {
+		n = min3(avail, self->size - self->sw_tail,
+			 AQ_CFG_RX_REFILL_THRES);
+		got = xsk_buff_alloc_batch(pool, xdp, n);
+
+		for (i = 0; i < got; i++) {
+			struct aq_ring_buff_s *buff =
+				&self->buff_ring[self->sw_tail];
+
+			buff->flags = 0U;
+			buff->len = self->frame_max;
+			buff->rxdata.xsk_buff = xdp[i];
+			buff->rxdata.daddr = xsk_buff_xdp_get_dma(xdp[i]);
+			buff->rxdata.pg_off = 0;
+			buff->pa = buff->rxdata.daddr;
+			self->sw_tail = aq_ring_next_dx(self, self->sw_tail);
+		}
+
+		avail -= got;
+		if (got < n) {
+			filled = false;
+			break;
+		}
+	}
+
+	if (xsk_uses_need_wakeup(pool)) {
+		if (filled)
+			xsk_clear_rx_need_wakeup(pool);
+		else
+			xsk_set_rx_need_wakeup(pool);
+	}
+
+	return filled;
+}
+
 int aq_ring_rx_fill(struct aq_ring_s *self)
 {
 	struct aq_ring_buff_s *buff = NULL;
 	int err = 0;
 	int i = 0;
 
+	if (self->xsk_pool) {
+		aq_ring_xsk_rx_fill(self);
+		return 0;
+	}
+
 	if (aq_ring_avail_dx(self) < min_t(unsigned int, AQ_CFG_RX_REFILL_THRES,
 					   self->size / 2))
 		return err;
@@ -901,15 +1197,28 @@ int aq_ring_rx_fill(struct aq_ring_s *self)
 
 void aq_ring_rx_deinit(struct aq_ring_s *self)
 {
+	unsigned int i;
+
 	if (!self)
 		return;
 
-	for (; self->sw_head != self->sw_tail;
-		self->sw_head = aq_ring_next_dx(self, self->sw_head)) {
-		struct aq_ring_buff_s *buff = &self->buff_ring[self->sw_head];
+	/* Slots skipped on receive errors may hold a page outside of the
+	 * posted range, walk the whole ring so that none stays in flight.
+	 */
+	for (i = 0; i < self->size; i++) {
+		struct aq_ring_buff_s *buff = &self->buff_ring[i];
+
+		if (!buff->rxdata.page)
+			continue;
 
-		aq_free_rxpage(&buff->rxdata, aq_nic_get_dev(self->aq_nic));
+		if (self->xsk_pool)
+			xsk_buff_free(buff->rxdata.xsk_buff);
+		else
+			page_pool_put_full_page(self->page_pool,
+						buff->rxdata.page, false);
+		buff->rxdata.page = NULL;
 	}
+	self->sw_head = self->sw_tail;
 }
 
 void aq_ring_free(struct aq_ring_s *self)
@@ -919,6 +1228,12 @@ void aq_ring_free(struct aq_ring_s *self)
 
 	kfree(self->buff_ring);
 
+	if (self->page_pool) {
+		page_pool_destroy(self->page_pool);
+		self->page_pool = NULL;
+	}
+	self->xsk_pool = NULL;
+
 	if (self->dx_ring)
 		dma_free_coherent(aq_nic_get_dev(self->aq_nic),
 				  self->size * self->dx_size, self->dx_ring,
@@ -942,9 +1257,6 @@ unsigned int aq_ring_fill_stats_data(struct aq_ring_s *self, u64 *data)
 			data[++count] = self->stats.rx.alloc_fails;
 			data[++count] = self->stats.rx.skb_alloc_fails;
 			data[++count] = self->stats.rx.polls;
-			data[++count] = self->stats.rx.pg_flips;
-			data[++count] = self->stats.rx.pg_reuses;
-			data[++count] = self->stats.rx.pg_losts;
 			data[++count] = self->stats.rx.xdp_aborted;
 			data[++count] = self->stats.rx.xdp_drop;
 			data[++count] = self->stats.rx.xdp_pass;
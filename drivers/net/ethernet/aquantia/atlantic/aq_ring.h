@@ -17,12 +17,17 @@
 #define AQ_XDP_TAILROOM		SKB_DATA_ALIGN(sizeof(struct skb_shared_info))
 
 struct page;
+struct page_pool;
+struct xsk_buff_pool;
 struct aq_nic_cfg_s;
 
 struct aq_rxpage {
-	struct page *page;
+	union {
+		struct page *page;
+		/* zero-copy rings post AF_XDP buffers instead */
+		struct xdp_buff *xsk_buff;
+	};
 	dma_addr_t daddr;
-	unsigned int order;
 	unsigned int pg_off;
 };
 
@@ -85,7 +90,8 @@ struct __packed aq_ring_buff_s {
 			u32 is_error:1;
 			u32 is_vlan:1;
 			u32 is_lro:1;
-			u32 rsvd3:3;
+			u32 is_xsk:1;
+			u32 rsvd3:2;
 			u16 eop_index;
 			u16 rsvd4;
 		};
@@ -103,9 +109,6 @@ struct aq_ring_stats_rx_s {
 	u64 alloc_fails;
 	u64 skb_alloc_fails;
 	u64 polls;
-	u64 pg_losts;
-	u64 pg_flips;
-	u64 pg_reuses;
 	u64 xdp_aborted;
 	u64 xdp_drop;
 	u64 xdp_pass;
@@ -152,6 +155,8 @@ struct aq_ring_s {
 	struct bpf_prog *xdp_prog;
 	enum atl_ring_type ring_type;
 	struct xdp_rxq_info xdp_rxq;
+	struct page_pool *page_pool;	/* RX buffers, one frame per page */
+	struct xsk_buff_pool *xsk_pool;	/* AF_XDP zero-copy, tc 0 rings */
 };
 
 struct aq_ring_param_s {
@@ -199,6 +204,8 @@ void aq_ring_update_queue_state(struct aq_ring_s *ring);
 void aq_ring_queue_wake(struct aq_ring_s *ring);
 void aq_ring_queue_stop(struct aq_ring_s *ring);
 bool aq_ring_tx_clean(struct aq_ring_s *self);
+bool aq_ring_xsk_xmit(struct aq_ring_s *self, unsigned int budget);
+bool aq_ring_xsk_rx_fill(struct aq_ring_s *self);
 int aq_xdp_xmit(struct net_device *dev, int num_frames,
 		struct xdp_frame **frames, u32 flags);
 int aq_ring_rx_clean(struct aq_ring_s *self,
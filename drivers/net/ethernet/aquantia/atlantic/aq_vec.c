@@ -11,6 +11,10 @@
 
 #include "aq_vec.h"
 
+#include <linux/dim.h>
+#include <net/page_pool.h>
+#include <net/xdp_sock_drv.h>
+
 struct aq_vec_s {
 	const struct aq_hw_ops *aq_hw_ops;
 	struct aq_hw_s *aq_hw;
@@ -20,17 +24,101 @@ struct aq_vec_s {
 	struct aq_ring_param_s aq_ring_param;
 	struct napi_struct napi;
 	struct aq_ring_s ring[AQ_CFG_TCS_MAX][2];
+	struct dim dim[2];		/* indexed by AQ_VEC_*_ID */
+	u16 dim_events;
+	u32 itr_usecs[2];		/* moderation picked by DIM, 0 if none */
+	u64 itr_changes[2];
 };
 
 #define AQ_VEC_TX_ID 0
 #define AQ_VEC_RX_ID 1
 
+static void aq_vec_itr_set(struct aq_vec_s *self, unsigned int id)
+{
+	unsigned int rings = id == AQ_VEC_TX_ID ? self->tx_rings :
+						  self->rx_rings;
+	unsigned int i;
+
+	for (i = 0U; rings > i; ++i)
+		self->aq_hw_ops->hw_ring_interrupt_moderation_set(self->aq_hw,
+							&self->ring[i][id],
+							self->itr_usecs[id]);
+}
+
+static void aq_vec_dim_apply(struct aq_vec_s *self, unsigned int id,
+			     struct dim_cq_moder moder)
+{
+	self->itr_usecs[id] = min_t(u32, moder.usec,
+				    AQ_CFG_INTERRUPT_MODERATION_USEC_MAX);
+	self->itr_changes[id]++;
+	aq_vec_itr_set(self, id);
+
+	self->dim[id].state = DIM_START_MEASURE;
+}
+
+static void aq_vec_rx_dim_work(struct work_struct *work)
+{
+	struct dim *dim = container_of(work, struct dim, work);
+	struct aq_vec_s *self = container_of(dim, struct aq_vec_s,
+					     dim[AQ_VEC_RX_ID]);
+
+	aq_vec_dim_apply(self, AQ_VEC_RX_ID,
+			 net_dim_get_rx_moderation(dim->mode, dim->profile_ix));
+}
+
+static void aq_vec_tx_dim_work(struct work_struct *work)
+{
+	struct dim *dim = container_of(work, struct dim, work);
+	struct aq_vec_s *self = container_of(dim, struct aq_vec_s,
+					     dim[AQ_VEC_TX_ID]);
+
+	aq_vec_dim_apply(self, AQ_VEC_TX_ID,
+			 net_dim_get_tx_moderation(dim->mode, dim->profile_ix));
+}
+
+/* Feed the traffic seen since the last interrupt to DIM. Called from NAPI,
+ * which is also where the ring counters are updated.
+ */
+static void aq_vec_dim_update(struct aq_vec_s *self)
+{
+	struct aq_nic_cfg_s *cfg = aq_nic_get_cfg(self->aq_nic);
+	struct dim_sample sample = {};
+	u64 packets, bytes;
+	unsigned int i;
+
+	self->dim_events++;
+
+	if (cfg->is_rx_dim) {
+		packets = 0U;
+		bytes = 0U;
+		for (i = 0U; self->rx_rings > i; ++i) {
+			packets += self->ring[i][AQ_VEC_RX_ID].stats.rx.packets;
+			bytes += self->ring[i][AQ_VEC_RX_ID].stats.rx.bytes;
+		}
+		dim_update_sample(self->dim_events, packets, bytes, &sample);
+		net_dim(&self->dim[AQ_VEC_RX_ID], sample);
+	}
+
+	if (cfg->is_tx_dim) {
+		packets = 0U;
+		bytes = 0U;
+		for (i = 0U; self->tx_rings > i; ++i) {
+			packets += self->ring[i][AQ_VEC_TX_ID].stats.tx.packets;
+			bytes += self->ring[i][AQ_VEC_TX_ID].stats.tx.bytes;
+		}
+		dim_update_sample(self->dim_events, packets, bytes, &sample);
+		net_dim(&self->dim[AQ_VEC_TX_ID], sample);
+	}
+}
+
 static int aq_vec_poll(struct napi_struct *napi, int budget)
 {
 	struct aq_vec_s *self = container_of(napi, struct aq_vec_s, napi);
 	unsigned int sw_tail_old = 0U;
+	struct xsk_buff_pool *pool = NULL;
 	struct aq_ring_s *ring = NULL;
 	bool was_tx_cleaned = true;
+	bool rx_starved = false;
 	unsigned int i = 0U;
 	int work_done = 0;
 	int err = 0;
@@ -57,13 +145,21 @@ static int aq_vec_poll(struct napi_struct *napi, int budget)
 				aq_ring_update_queue_state(&ring[AQ_VEC_TX_ID]);
 			}
 
+			if (ring[AQ_VEC_TX_ID].xsk_pool &&
+			    !aq_ring_xsk_xmit(&ring[AQ_VEC_TX_ID], budget))
+				was_tx_cleaned = false;
+
 			err = self->aq_hw_ops->hw_ring_rx_receive(self->aq_hw,
 					    &ring[AQ_VEC_RX_ID]);
 			if (err < 0)
 				goto err_exit;
 
+			/* A zero-copy ring may have been starved by an empty
+			 * fill queue, so refill it on every poll.
+			 */
 			if (ring[AQ_VEC_RX_ID].sw_head !=
-				ring[AQ_VEC_RX_ID].hw_head) {
+				ring[AQ_VEC_RX_ID].hw_head ||
+			    ring[AQ_VEC_RX_ID].xsk_pool) {
 				err = aq_ring_rx_clean(&ring[AQ_VEC_RX_ID],
 						       napi,
 						       &work_done,
@@ -73,24 +169,40 @@ static int aq_vec_poll(struct napi_struct *napi, int budget)
 
 				sw_tail_old = ring[AQ_VEC_RX_ID].sw_tail;
 
-				err = aq_ring_rx_fill(&ring[AQ_VEC_RX_ID]);
-				if (err < 0)
-					goto err_exit;
-
-				err = self->aq_hw_ops->hw_ring_rx_fill(
-					self->aq_hw,
-					&ring[AQ_VEC_RX_ID], sw_tail_old);
-				if (err < 0)
-					goto err_exit;
+				/* Without need_wakeup nothing tells us when the
+				 * fill queue gets buffers again, and a ring left
+				 * without descriptors raises no interrupt, so
+				 * keep polling until it is refilled.
+				 */
+				pool = ring[AQ_VEC_RX_ID].xsk_pool;
+				if (pool) {
+					if (!aq_ring_xsk_rx_fill(&ring[AQ_VEC_RX_ID]) &&
+					    !xsk_uses_need_wakeup(pool))
+						rx_starved = true;
+				} else {
+					err = aq_ring_rx_fill(&ring[AQ_VEC_RX_ID]);
+					if (err < 0)
+						goto err_exit;
+				}
+
+				/* one tail write for all the buffers posted */
+				if (ring[AQ_VEC_RX_ID].sw_tail != sw_tail_old) {
+					err = self->aq_hw_ops->hw_ring_rx_fill(
+						self->aq_hw,
+						&ring[AQ_VEC_RX_ID], sw_tail_old);
+					if (err < 0)
+						goto err_exit;
+				}
 			}
 		}
 
 err_exit:
-		if (!was_tx_cleaned)
+		if (!was_tx_cleaned || rx_starved)
 			work_done = budget;
 
 		if (work_done < budget) {
 			napi_complete_done(napi, work_done);
+			aq_vec_dim_update(self);
 			self->aq_hw_ops->hw_irq_enable(self->aq_hw,
 					1U << self->aq_ring_param.vec_idx);
 		}
@@ -121,6 +233,11 @@ struct aq_vec_s *aq_vec_alloc(struct aq_nic_s *aq_nic, unsigned int idx,
 
 	netif_napi_add(aq_nic_get_ndev(aq_nic), &self->napi, aq_vec_poll);
 
+	INIT_WORK(&self->dim[AQ_VEC_RX_ID].work, aq_vec_rx_dim_work);
+	INIT_WORK(&self->dim[AQ_VEC_TX_ID].work, aq_vec_tx_dim_work);
+	self->dim[AQ_VEC_RX_ID].mode = DIM_CQ_PERIOD_MODE_START_FROM_EQE;
+	self->dim[AQ_VEC_TX_ID].mode = DIM_CQ_PERIOD_MODE_START_FROM_EQE;
+
 err_exit:
 	return self;
 }
@@ -153,12 +270,6 @@ int aq_vec_ring_alloc(struct aq_vec_s *self, struct aq_nic_s *aq_nic,
 			err = -ENOMEM;
 			goto err_exit;
 		}
-		if (xdp_rxq_info_reg_mem_model(&self->ring[i][AQ_VEC_RX_ID].xdp_rxq,
-					       MEM_TYPE_PAGE_SHARED, NULL) < 0) {
-			xdp_rxq_info_unreg(&self->ring[i][AQ_VEC_RX_ID].xdp_rxq);
-			err = -ENOMEM;
-			goto err_exit;
-		}
 
 		ring = aq_ring_rx_alloc(&self->ring[i][AQ_VEC_RX_ID], aq_nic,
 					idx_ring, aq_nic_cfg);
@@ -168,6 +279,24 @@ int aq_vec_ring_alloc(struct aq_vec_s *self, struct aq_nic_s *aq_nic,
 			goto err_exit;
 		}
 
+		/* XDP frames are returned to the pool the ring receives from */
+		if (ring->xsk_pool)
+			err = xdp_rxq_info_reg_mem_model(&ring->xdp_rxq,
+							 MEM_TYPE_XSK_BUFF_POOL,
+							 NULL);
+		else
+			err = xdp_rxq_info_reg_mem_model(&ring->xdp_rxq,
+							 MEM_TYPE_PAGE_POOL,
+							 ring->page_pool);
+		if (err < 0) {
+			xdp_rxq_info_unreg(&ring->xdp_rxq);
+			aq_ring_free(ring);
+			err = -ENOMEM;
+			goto err_exit;
+		}
+		if (ring->xsk_pool)
+			xsk_pool_set_rxq_info(ring->xsk_pool, &ring->xdp_rxq);
+
 		++self->rx_rings;
 	}
 
@@ -266,6 +395,9 @@ void aq_vec_stop(struct aq_vec_s *self)
 	}
 
 	napi_disable(&self->napi);
+
+	cancel_work_sync(&self->dim[AQ_VEC_RX_ID].work);
+	cancel_work_sync(&self->dim[AQ_VEC_TX_ID].work);
 }
 
 void aq_vec_deinit(struct aq_vec_s *self)
@@ -358,6 +490,50 @@ irqreturn_t aq_vec_isr_legacy(int irq, void *private)
 	return IRQ_HANDLED;
 }
 
+/* hw_interrupt_moderation_set() programs every ring with the static
+ * settings, put back the moderation DIM picked for this vector, or forget
+ * it if DIM has been turned off.
+ */
+void aq_vec_dim_restore(struct aq_vec_s *self)
+{
+	struct aq_nic_cfg_s *cfg = aq_nic_get_cfg(self->aq_nic);
+
+	if (!cfg->is_rx_dim)
+		self->itr_usecs[AQ_VEC_RX_ID] = 0;
+	else if (self->itr_usecs[AQ_VEC_RX_ID])
+		aq_vec_itr_set(self, AQ_VEC_RX_ID);
+	if (!cfg->is_tx_dim)
+		self->itr_usecs[AQ_VEC_TX_ID] = 0;
+	else if (self->itr_usecs[AQ_VEC_TX_ID])
+		aq_vec_itr_set(self, AQ_VEC_TX_ID);
+}
+
+/* This data should mimic aq_ethtool_vec_stat_names structure */
+unsigned int aq_vec_get_dim_stats(struct aq_vec_s *self, u64 *data)
+{
+	unsigned int count = 0U;
+
+	data[count] = self->itr_usecs[AQ_VEC_RX_ID];
+	data[++count] = self->itr_usecs[AQ_VEC_TX_ID];
+	data[++count] = self->itr_changes[AQ_VEC_RX_ID];
+	data[++count] = self->itr_changes[AQ_VEC_TX_ID];
+
+	return ++count;
+}
+
+/* Run the poll of the vector on behalf of an AF_XDP socket. If it is
+ * already running it is told to go around once more.
+ */
+void aq_vec_kick(struct aq_vec_s *self)
+{
+	if (napi_if_scheduled_mark_missed(&self->napi))
+		return;
+
+	local_bh_disable();
+	napi_schedule(&self->napi);
+	local_bh_enable();
+}
+
 cpumask_t *aq_vec_get_affinity_mask(struct aq_vec_s *self)
 {
 	return &self->aq_ring_param.affinity_mask;
@@ -380,3 +556,19 @@ unsigned int aq_vec_get_sw_stats(struct aq_vec_s *self, const unsigned int tc, u
 
 	return count;
 }
+
+#ifdef CONFIG_PAGE_POOL_STATS
+void aq_vec_get_page_pool_stats(struct aq_vec_s *self,
+				struct page_pool_stats *stats)
+{
+	struct page_pool *pool;
+	unsigned int tc;
+
+	for (tc = 0U; tc < self->rx_rings; tc++) {
+		pool = self->ring[tc][AQ_VEC_RX_ID].page_pool;
+		/* zero-copy rings have no page pool */
+		if (pool)
+			page_pool_get_stats(pool, stats);
+	}
+}
+#endif
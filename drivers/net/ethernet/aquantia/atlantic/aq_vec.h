@@ -27,6 +27,7 @@ struct aq_nic_s;
 struct aq_nic_cfg_s;
 struct aq_ring_stats_rx_s;
 struct aq_ring_stats_tx_s;
+struct page_pool_stats;
 
 irqreturn_t aq_vec_isr(int irq, void *private);
 irqreturn_t aq_vec_isr_legacy(int irq, void *private);
@@ -41,8 +42,15 @@ void aq_vec_free(struct aq_vec_s *self);
 void aq_vec_ring_free(struct aq_vec_s *self);
 int aq_vec_start(struct aq_vec_s *self);
 void aq_vec_stop(struct aq_vec_s *self);
+void aq_vec_dim_restore(struct aq_vec_s *self);
+unsigned int aq_vec_get_dim_stats(struct aq_vec_s *self, u64 *data);
+void aq_vec_kick(struct aq_vec_s *self);
 cpumask_t *aq_vec_get_affinity_mask(struct aq_vec_s *self);
 bool aq_vec_is_valid_tc(struct aq_vec_s *self, const unsigned int tc);
 unsigned int aq_vec_get_sw_stats(struct aq_vec_s *self, const unsigned int tc, u64 *data);
+#ifdef CONFIG_PAGE_POOL_STATS
+void aq_vec_get_page_pool_stats(struct aq_vec_s *self,
+				struct page_pool_stats *stats);
+#endif
 
 #endif /* AQ_VEC_H */
@@ -36,6 +36,7 @@
 #define MACVLAN_HASH_BITS	8
 #define MACVLAN_HASH_SIZE	(1<<MACVLAN_HASH_BITS)
 #define MACVLAN_DEFAULT_BC_QUEUE_LEN	1000
+#define MACVLAN_BC_BATCH	64
 
 #define MACVLAN_F_PASSTHRU	1
 #define MACVLAN_F_ADDRCHANGE	2
@@ -47,6 +48,13 @@ struct macvlan_port {
 	struct sk_buff_head	bc_queue;
 	struct work_struct	bc_work;
 	u32			bc_queue_len_used;
+	u64			bc_dropped;	/* under bc_queue.lock */
+	struct u64_stats_sync	bc_syncp;	/* updated by bc_work only */
+	u64_stats_t		bc_frames;
+	u64_stats_t		bc_deliveries;
+	u64_stats_t		bc_clones;
+	u64_stats_t		bc_batches;
+	u64_stats_t		bc_time_ns;
 	u32			flags;
 	int			count;
 	struct hlist_head	vlan_source_hash[MACVLAN_HASH_SIZE];
@@ -257,6 +265,17 @@ static unsigned int mc_hash(const struct macvlan_dev *vlan,
 	return hash_32(val, MACVLAN_MC_FILTER_BITS);
 }
 
+static bool macvlan_broadcast_match(const struct macvlan_dev *vlan,
+				    const struct ethhdr *eth,
+				    const struct net_device *src,
+				    enum macvlan_mode mode)
+{
+	if (vlan->dev == src || !(vlan->mode & mode))
+		return false;
+
+	return test_bit(mc_hash(vlan, eth->h_dest), vlan->mc_filter);
+}
+
 static void macvlan_broadcast(struct sk_buff *skb,
 			      const struct macvlan_port *port,
 			      struct net_device *src,
@@ -267,17 +286,12 @@ static void macvlan_broadcast(struct sk_buff *skb,
 	struct sk_buff *nskb;
 	unsigned int i;
 	int err;
-	unsigned int hash;
 
 	if (skb->protocol == htons(ETH_P_PAUSE))
 		return;
 
 	hash_for_each_rcu(port->vlan_hash, i, vlan, hlist) {
-		if (vlan->dev == src || !(vlan->mode & mode))
-			continue;
-
-		hash = mc_hash(vlan, eth->h_dest);
-		if (!test_bit(hash, vlan->mc_filter))
+		if (!macvlan_broadcast_match(vlan, eth, src, mode))
 			continue;
 
 		err = NET_RX_DROP;
@@ -291,12 +305,82 @@ static void macvlan_broadcast(struct sk_buff *skb,
 	}
 }
 
+/* Queue @skb on @rx_list for every macvlan that wants it, and return the
+ * number of copies queued. Only the first matches get a clone, the last one
+ * is handed @skb itself. @skb is always consumed.
+ */
+static unsigned int macvlan_broadcast_list(struct sk_buff *skb,
+					   const struct macvlan_port *port,
+					   struct net_device *src,
+					   enum macvlan_mode mode,
+					   struct list_head *rx_list)
+{
+	const struct macvlan_dev *vlan, *last = NULL;
+	const struct ethhdr *eth = eth_hdr(skb);
+	unsigned int len = skb->len + ETH_HLEN;
+	unsigned int i, queued = 0;
+	struct sk_buff *nskb;
+
+	if (skb->protocol == htons(ETH_P_PAUSE))
+		goto consume;
+
+	hash_for_each_rcu(port->vlan_hash, i, vlan, hlist) {
+		if (!macvlan_broadcast_match(vlan, eth, src, mode))
+			continue;
+
+		if (last) {
+			nskb = skb_clone(skb, GFP_ATOMIC);
+			if (likely(nskb)) {
+				macvlan_broadcast_one(nskb, last, eth, false);
+				list_add_tail(&nskb->list, rx_list);
+				queued++;
+			}
+			macvlan_count_rx(last, len, !!nskb, true);
+		}
+		last = vlan;
+	}
+
+	if (last) {
+		macvlan_broadcast_one(skb, last, eth, false);
+		list_add_tail(&skb->list, rx_list);
+		macvlan_count_rx(last, len, true, true);
+		return queued + 1;
+	}
+consume:
+	consume_skb(skb);
+	return queued;
+}
+
+static enum macvlan_mode macvlan_broadcast_mode(const struct macvlan_dev *src)
+{
+	/* frame comes from an external address */
+	if (!src)
+		return MACVLAN_MODE_PRIVATE |
+		       MACVLAN_MODE_VEPA    |
+		       MACVLAN_MODE_PASSTHRU|
+		       MACVLAN_MODE_BRIDGE;
+
+	/* flood to everyone except source */
+	if (src->mode == MACVLAN_MODE_VEPA)
+		return MACVLAN_MODE_VEPA | MACVLAN_MODE_BRIDGE;
+
+	/*
+	 * flood only to VEPA ports, bridge ports
+	 * already saw the frame on the way out.
+	 */
+	return MACVLAN_MODE_VEPA;
+}
+
 static void macvlan_process_broadcast(struct work_struct *w)
 {
 	struct macvlan_port *port = container_of(w, struct macvlan_port,
 						 bc_work);
-	struct sk_buff *skb;
+	unsigned int frames = 0, queued = 0, clones = 0, batches = 0;
+	unsigned int n, copies;
+	u64 start, time_ns = 0;
 	struct sk_buff_head list;
+	LIST_HEAD(rx_list);
+	struct sk_buff *skb;
 
 	__skb_queue_head_init(&list);
 
@@ -304,39 +388,54 @@ static void macvlan_process_broadcast(struct work_struct *w)
 	skb_queue_splice_tail_init(&port->bc_queue, &list);
 	spin_unlock_bh(&port->bc_queue.lock);
 
-	while ((skb = __skb_dequeue(&list))) {
-		const struct macvlan_dev *src = MACVLAN_SKB_CB(skb)->src;
-
+	while (!skb_queue_empty(&list)) {
+		/* Fan out up to MACVLAN_BC_BATCH frames, then give all the
+		 * copies to the stack in one go instead of one netif_rx()
+		 * and backlog pass per copy.
+		 */
+		local_bh_disable();
+		start = ktime_get_ns();
 		rcu_read_lock();
-
-		if (!src)
-			/* frame comes from an external address */
-			macvlan_broadcast(skb, port, NULL,
-					  MACVLAN_MODE_PRIVATE |
-					  MACVLAN_MODE_VEPA    |
-					  MACVLAN_MODE_PASSTHRU|
-					  MACVLAN_MODE_BRIDGE);
-		else if (src->mode == MACVLAN_MODE_VEPA)
-			/* flood to everyone except source */
-			macvlan_broadcast(skb, port, src->dev,
-					  MACVLAN_MODE_VEPA |
-					  MACVLAN_MODE_BRIDGE);
-		else
-			/*
-			 * flood only to VEPA ports, bridge ports
-			 * already saw the frame on the way out.
-			 */
-			macvlan_broadcast(skb, port, src->dev,
-					  MACVLAN_MODE_VEPA);
-
+		for (n = 0; n < MACVLAN_BC_BATCH; n++) {
+			const struct macvlan_dev *src;
+
+			skb = __skb_dequeue(&list);
+			if (!skb)
+				break;
+
+			src = MACVLAN_SKB_CB(skb)->src;
+			copies = macvlan_broadcast_list(skb, port,
+						src ? src->dev : NULL,
+						macvlan_broadcast_mode(src),
+						&rx_list);
+			/* the queued frame itself went to one destination */
+			clones += copies ? copies - 1 : 0;
+			queued += copies;
+			if (src)
+				dev_put(src->dev);
+		}
 		rcu_read_unlock();
 
-		if (src)
-			dev_put(src->dev);
-		consume_skb(skb);
+		netif_receive_skb_list(&rx_list);
+		INIT_LIST_HEAD(&rx_list);
+		time_ns += ktime_get_ns() - start;
+		local_bh_enable();
 
+		frames += n;
+		batches++;
 		cond_resched();
 	}
+
+	/* the writer must not be preempted on 32-bit */
+	local_bh_disable();
+	u64_stats_update_begin(&port->bc_syncp);
+	u64_stats_add(&port->bc_frames, frames);
+	u64_stats_add(&port->bc_deliveries, queued);
+	u64_stats_add(&port->bc_clones, clones);
+	u64_stats_add(&port->bc_batches, batches);
+	u64_stats_add(&port->bc_time_ns, time_ns);
+	u64_stats_update_end(&port->bc_syncp);
+	local_bh_enable();
 }
 
 static void macvlan_broadcast_enqueue(struct macvlan_port *port,
@@ -358,6 +457,8 @@ static void macvlan_broadcast_enqueue(struct macvlan_port *port,
 			dev_hold(src->dev);
 		__skb_queue_tail(&port->bc_queue, nskb);
 		err = 0;
+	} else {
+		port->bc_dropped++;
 	}
 	spin_unlock(&port->bc_queue.lock);
 
@@ -1075,6 +1176,52 @@ static int macvlan_ethtool_get_ts_info(struct net_device *dev,
 	return 0;
 }
 
+/* Broadcast delivery cost of the port, shared by all its macvlans */
+static const char macvlan_bc_stat_names[][ETH_GSTRING_LEN] = {
+	"port_bc_frames",
+	"port_bc_deliveries",
+	"port_bc_clones",
+	"port_bc_batches",
+	"port_bc_time_ns",
+	"port_bc_dropped",
+};
+
+static int macvlan_ethtool_get_sset_count(struct net_device *dev, int sset)
+{
+	if (sset != ETH_SS_STATS)
+		return -EOPNOTSUPP;
+	return ARRAY_SIZE(macvlan_bc_stat_names);
+}
+
+static void macvlan_ethtool_get_strings(struct net_device *dev, u32 sset,
+					u8 *data)
+{
+	if (sset == ETH_SS_STATS)
+		memcpy(data, macvlan_bc_stat_names,
+		       sizeof(macvlan_bc_stat_names));
+}
+
+static void macvlan_ethtool_get_stats(struct net_device *dev,
+				      struct ethtool_stats *stats, u64 *data)
+{
+	const struct macvlan_dev *vlan = netdev_priv(dev);
+	struct macvlan_port *port = vlan->port;
+	unsigned int start;
+
+	do {
+		start = u64_stats_fetch_begin(&port->bc_syncp);
+		data[0] = u64_stats_read(&port->bc_frames);
+		data[1] = u64_stats_read(&port->bc_deliveries);
+		data[2] = u64_stats_read(&port->bc_clones);
+		data[3] = u64_stats_read(&port->bc_batches);
+		data[4] = u64_stats_read(&port->bc_time_ns);
+	} while (u64_stats_fetch_retry(&port->bc_syncp, start));
+
+	spin_lock_bh(&port->bc_queue.lock);
+	data[5] = port->bc_dropped;
+	spin_unlock_bh(&port->bc_queue.lock);
+}
+
 static netdev_features_t macvlan_fix_features(struct net_device *dev,
 					      netdev_features_t features)
 {
@@ -1150,6 +1297,9 @@ static const struct ethtool_ops macvlan_ethtool_ops = {
 	.get_link_ksettings	= macvlan_ethtool_get_link_ksettings,
 	.get_drvinfo		= macvlan_ethtool_get_drvinfo,
 	.get_ts_info		= macvlan_ethtool_get_ts_info,
+	.get_sset_count		= macvlan_ethtool_get_sset_count,
+	.get_strings		= macvlan_ethtool_get_strings,
+	.get_ethtool_stats	= macvlan_ethtool_get_stats,
 };
 
 static const struct net_device_ops macvlan_netdev_ops = {
@@ -1237,6 +1387,7 @@ static int macvlan_port_create(struct net_device *dev)
 
 	port->bc_queue_len_used = 0;
 	skb_queue_head_init(&port->bc_queue);
+	u64_stats_init(&port->bc_syncp);
 	INIT_WORK(&port->bc_work, macvlan_process_broadcast);
 
 	err = netdev_rx_handler_register(dev, macvlan_handle_frame, port);
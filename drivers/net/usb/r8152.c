@@ -741,6 +741,7 @@ enum rtl_register_content {
 
 #define RTL8152_MAX_TX		4
 #define RTL8152_MAX_RX		10
+#define RTL8152_AGG_WINDOW	64
 #define INTBUFSIZE		2
 #define TX_ALIGN		4
 #define RX_ALIGN		8
@@ -854,6 +855,15 @@ struct tx_agg {
 	void *head;
 	u32 skb_num;
 	u32 skb_len;
+	u32 bql_len;
+};
+
+/* Aggregate fill levels, also used to adapt the aggregate sizes */
+struct agg_stats {
+	u64 aggs;
+	u64 bytes;
+	u64 full;	/* aggregates with no room left for more data */
+	u32 win_aggs, win_bytes, win_full;	/* current adaptation window */
 };
 
 struct r8152 {
@@ -934,6 +944,11 @@ struct r8152 {
 	u32 rx_buf_sz;
 	u32 rx_copybreak;
 	u32 rx_pending;
+	u32 rx_slots;		/* rx aggregates to keep submitted */
+	u32 rx_inflight;
+	u32 tx_buf_sz;		/* allocated size of a tx aggregate */
+	u32 tx_agg_sz;		/* current fill limit of a tx aggregate */
+	struct agg_stats rx_agg_stats, tx_agg_stats;
 	u32 fc_pause_on, fc_pause_off;
 
 	unsigned int pipe_in, pipe_out, pipe_intr, pipe_ctrl_in, pipe_ctrl_out;
@@ -1193,7 +1208,8 @@ enum tx_csum_stat {
 static const int multicast_filter_limit = 32;
 static unsigned int agg_buf_sz = 16384;
 
-#define RTL_LIMITED_TSO_SIZE	(size_to_mtu(agg_buf_sz) - sizeof(struct tx_desc))
+#define RTL_LIMITED_TSO_SIZE(tp)	\
+	(size_to_mtu((tp)->tx_buf_sz) - sizeof(struct tx_desc))
 
 static
 int get_registers(struct r8152 *tp, u16 value, u16 index, u16 size, void *data)
@@ -1798,6 +1814,24 @@ static void read_bulk_callback(struct urb *urb)
 	r8152_submit_rx(tp, agg, GFP_ATOMIC);
 }
 
+/* Bytes charged to BQL by rtl8152_start_xmit(). The length of the packet
+ * may change before it reaches the device, see r8152_csum_workaround().
+ */
+#define rtl_tx_bql_len(skb)	(*(u32 *)(skb)->cb)
+
+/* BQL completions come from urb callbacks as well as from the tx tasklet
+ * and process context, tp->tx_lock serializes them.
+ */
+static void rtl_tx_completed(struct r8152 *tp, unsigned int pkts,
+			     unsigned int bytes)
+{
+	unsigned long flags;
+
+	spin_lock_irqsave(&tp->tx_lock, flags);
+	netdev_completed_queue(tp->netdev, pkts, bytes);
+	spin_unlock_irqrestore(&tp->tx_lock, flags);
+}
+
 static void write_bulk_callback(struct urb *urb)
 {
 	struct net_device_stats *stats;
@@ -1827,6 +1861,7 @@ static void write_bulk_callback(struct urb *urb)
 	}
 
 	spin_lock_irqsave(&tp->tx_lock, flags);
+	netdev_completed_queue(netdev, agg->skb_num, agg->bql_len);
 	list_add_tail(&agg->list, &tp->tx_free);
 	spin_unlock_irqrestore(&tp->tx_lock, flags);
 
@@ -2031,13 +2066,13 @@ static int alloc_all_mem(struct r8152 *tp)
 		struct urb *urb;
 		u8 *buf;
 
-		buf = kmalloc_node(agg_buf_sz, GFP_KERNEL, node);
+		buf = kmalloc_node(tp->tx_buf_sz, GFP_KERNEL, node);
 		if (!buf)
 			goto err1;
 
 		if (buf != tx_agg_align(buf)) {
 			kfree(buf);
-			buf = kmalloc_node(agg_buf_sz + TX_ALIGN, GFP_KERNEL,
+			buf = kmalloc_node(tp->tx_buf_sz + TX_ALIGN, GFP_KERNEL,
 					   node);
 			if (!buf)
 				goto err1;
@@ -2118,8 +2153,11 @@ static void r8152_csum_workaround(struct r8152 *tp, struct sk_buff *skb,
 
 		__skb_queue_head_init(&seg_list);
 
+		/* the first segment carries the bytes charged for skb */
 		skb_list_walk_safe(segs, seg, next) {
 			skb_mark_not_on_list(seg);
+			rtl_tx_bql_len(seg) = seg == segs ?
+					      rtl_tx_bql_len(skb) : 0;
 			__skb_queue_tail(&seg_list, seg);
 		}
 
@@ -2136,6 +2174,7 @@ static void r8152_csum_workaround(struct r8152 *tp, struct sk_buff *skb,
 drop:
 		stats = &tp->netdev->stats;
 		stats->tx_dropped++;
+		rtl_tx_completed(tp, 1, rtl_tx_bql_len(skb));
 		dev_kfree_skb(skb);
 	}
 }
@@ -2247,9 +2286,55 @@ static int r8152_tx_csum(struct r8152 *tp, struct tx_desc *desc,
 	return ret;
 }
 
+/* Account an aggregate of @used bytes. Returns true at the end of an
+ * adaptation window; the window totals are then left in @st until the
+ * caller clears them with rtl_agg_window_reset().
+ */
+static bool rtl_agg_account(struct agg_stats *st, u32 used, bool full)
+{
+	st->aggs++;
+	st->bytes += used;
+	st->full += full;
+
+	st->win_aggs++;
+	st->win_bytes += used;
+	st->win_full += full;
+
+	return st->win_aggs >= RTL8152_AGG_WINDOW;
+}
+
+static void rtl_agg_window_reset(struct agg_stats *st)
+{
+	st->win_aggs = 0;
+	st->win_bytes = 0;
+	st->win_full = 0;
+}
+
+/* Grow the tx aggregate while most of them run out of room with packets
+ * still queued, shrink it again when they stay mostly empty so that each
+ * transfer, and therefore each BQL completion, stays short.
+ */
+static void rtl_tx_agg_adapt(struct r8152 *tp, u32 used, bool full)
+{
+	struct agg_stats *st = &tp->tx_agg_stats;
+	u32 size = tp->tx_agg_sz;
+
+	if (!rtl_agg_account(st, used, full))
+		return;
+
+	if (st->win_full > RTL8152_AGG_WINDOW / 2)
+		size = min(size * 2, tp->tx_buf_sz);
+	else if (!st->win_full && st->win_bytes / st->win_aggs < size / 4)
+		size = max(size / 2, agg_buf_sz);
+
+	WRITE_ONCE(tp->tx_agg_sz, size);
+	rtl_agg_window_reset(st);
+}
+
 static int r8152_tx_agg_fill(struct r8152 *tp, struct tx_agg *agg)
 {
 	struct sk_buff_head skb_head, *tx_queue = &tp->tx_queue;
+	u32 limit = READ_ONCE(tp->tx_agg_sz);
 	int remain, ret;
 	u8 *tx_data;
 
@@ -2261,9 +2346,10 @@ static int r8152_tx_agg_fill(struct r8152 *tp, struct tx_agg *agg)
 	tx_data = agg->head;
 	agg->skb_num = 0;
 	agg->skb_len = 0;
-	remain = agg_buf_sz;
+	agg->bql_len = 0;
+	remain = limit;
 
-	while (remain >= ETH_ZLEN + sizeof(struct tx_desc)) {
+	while (remain >= (int)(ETH_ZLEN + sizeof(struct tx_desc))) {
 		struct tx_desc *tx_desc;
 		struct sk_buff *skb;
 		unsigned int len;
@@ -2274,7 +2360,9 @@ static int r8152_tx_agg_fill(struct r8152 *tp, struct tx_agg *agg)
 
 		len = skb->len + sizeof(*tx_desc);
 
-		if (len > remain) {
+		/* a packet above the current limit still goes out alone */
+		if ((int)len > remain &&
+		    (tx_data != agg->head || len > tp->tx_buf_sz)) {
 			__skb_queue_head(&skb_head, skb);
 			break;
 		}
@@ -2296,6 +2384,7 @@ static int r8152_tx_agg_fill(struct r8152 *tp, struct tx_agg *agg)
 			struct net_device_stats *stats = &tp->netdev->stats;
 
 			stats->tx_dropped++;
+			agg->bql_len += rtl_tx_bql_len(skb);
 			dev_kfree_skb_any(skb);
 			tx_data -= sizeof(*tx_desc);
 			continue;
@@ -2304,15 +2393,21 @@ static int r8152_tx_agg_fill(struct r8152 *tp, struct tx_agg *agg)
 		tx_data += len;
 		agg->skb_len += len;
 		agg->skb_num += skb_shinfo(skb)->gso_segs ?: 1;
+		agg->bql_len += rtl_tx_bql_len(skb);
 
 		dev_kfree_skb_any(skb);
 
-		remain = agg_buf_sz - (int)(tx_agg_align(tx_data) - agg->head);
+		/* negative after a lone packet above the limit */
+		remain = max_t(int, limit - (tx_agg_align(tx_data) - agg->head),
+			       0);
 
 		if (tp->dell_tb_rx_agg_bug)
 			break;
 	}
 
+	rtl_tx_agg_adapt(tp, tx_data - (u8 *)agg->head,
+			 !skb_queue_empty(&skb_head));
+
 	if (!skb_queue_empty(&skb_head)) {
 		spin_lock(&tx_queue->lock);
 		skb_queue_splice(&skb_head, tx_queue);
@@ -2374,7 +2469,38 @@ static u8 r8152_rx_csum(struct r8152 *tp, struct rx_desc *rx_desc)
 
 static inline bool rx_count_exceed(struct r8152 *tp)
 {
-	return atomic_read(&tp->rx_count) > RTL8152_MAX_RX;
+	return atomic_read(&tp->rx_count) > tp->rx_slots;
+}
+
+/* The memory limit is rx_pending, leave half of it for the aggregates
+ * whose pages are still attached to skbs.
+ */
+static inline u32 rtl_rx_slots_max(struct r8152 *tp)
+{
+	return clamp_t(u32, tp->rx_pending / 2, RTL8152_MAX_RX,
+		       RTL8152_MAX_RX * 4);
+}
+
+/* Keep more aggregates submitted while the device keeps filling them up,
+ * give them back when they come back mostly empty. Called from NAPI.
+ */
+static void rtl_rx_agg_adapt(struct r8152 *tp, u32 used)
+{
+	struct agg_stats *st = &tp->rx_agg_stats;
+	bool full;
+
+	/* the device closes an aggregate once a full frame no longer fits */
+	full = used + rx_reserved_size(tp->netdev->mtu) >= tp->rx_buf_sz;
+	if (!rtl_agg_account(st, used, full))
+		return;
+
+	if (st->win_full > RTL8152_AGG_WINDOW / 2)
+		tp->rx_slots = min(tp->rx_slots + 1, rtl_rx_slots_max(tp));
+	else if (!st->win_full &&
+		 st->win_bytes / st->win_aggs < tp->rx_buf_sz / 4)
+		tp->rx_slots = max_t(u32, tp->rx_slots - 1, RTL8152_MAX_RX);
+
+	rtl_agg_window_reset(st);
 }
 
 static inline int agg_offset(struct rx_agg *agg, void *addr)
@@ -2460,6 +2586,8 @@ static int rx_bottom(struct r8152 *tp, int budget)
 		if (urb->status != 0 || urb->actual_length < ETH_ZLEN)
 			goto submit;
 
+		rtl_rx_agg_adapt(tp, urb->actual_length);
+
 		agg_free = rtl_get_free_rx(tp, GFP_ATOMIC);
 
 		rx_desc = agg->buffer;
@@ -2544,7 +2672,12 @@ static int rx_bottom(struct r8152 *tp, int budget)
 		}
 
 submit:
-		if (!ret) {
+		if (tp->rx_inflight > tp->rx_slots) {
+			tp->rx_inflight--;
+			spin_lock_irqsave(&tp->rx_lock, flags);
+			list_add_tail(&agg->list, &tp->rx_used);
+			spin_unlock_irqrestore(&tp->rx_lock, flags);
+		} else if (!ret) {
 			ret = r8152_submit_rx(tp, agg, GFP_ATOMIC);
 		} else {
 			urb->actual_length = 0;
@@ -2552,6 +2685,16 @@ static int rx_bottom(struct r8152 *tp, int budget)
 		}
 	}
 
+	while (!ret && tp->rx_inflight < tp->rx_slots) {
+		struct rx_agg *agg = rtl_get_free_rx(tp, GFP_ATOMIC);
+
+		if (!agg)
+			break;
+
+		tp->rx_inflight++;
+		ret = r8152_submit_rx(tp, agg, GFP_ATOMIC);
+	}
+
 	if (!list_empty(&rx_queue)) {
 		spin_lock_irqsave(&tp->rx_lock, flags);
 		list_splice_tail(&rx_queue, &tp->rx_done);
@@ -2582,6 +2725,7 @@ static void tx_bottom(struct r8152 *tp)
 			continue;
 
 		if (res == -ENODEV) {
+			rtl_tx_completed(tp, agg->skb_num, agg->bql_len);
 			rtl_set_unplug(tp);
 			netif_device_detach(netdev);
 		} else {
@@ -2593,6 +2737,8 @@ static void tx_bottom(struct r8152 *tp)
 			stats->tx_dropped += agg->skb_num;
 
 			spin_lock_irqsave(&tp->tx_lock, flags);
+			netdev_completed_queue(netdev, agg->skb_num,
+					       agg->bql_len);
 			list_add_tail(&agg->list, &tp->tx_free);
 			spin_unlock_irqrestore(&tp->tx_lock, flags);
 		}
@@ -2677,6 +2823,7 @@ static void rtl_drop_queued_tx(struct r8152 *tp)
 {
 	struct net_device_stats *stats = &tp->netdev->stats;
 	struct sk_buff_head skb_head, *tx_queue = &tp->tx_queue;
+	unsigned int pkts = 0, bytes = 0;
 	struct sk_buff *skb;
 
 	if (skb_queue_empty(tx_queue))
@@ -2688,9 +2835,13 @@ static void rtl_drop_queued_tx(struct r8152 *tp)
 	spin_unlock_bh(&tx_queue->lock);
 
 	while ((skb = __skb_dequeue(&skb_head))) {
+		pkts++;
+		bytes += rtl_tx_bql_len(skb);
 		dev_kfree_skb(skb);
 		stats->tx_dropped++;
 	}
+
+	rtl_tx_completed(tp, pkts, bytes);
 }
 
 static void rtl8152_tx_timeout(struct net_device *netdev, unsigned int txqueue)
@@ -2765,13 +2916,14 @@ static netdev_features_t
 rtl8152_features_check(struct sk_buff *skb, struct net_device *dev,
 		       netdev_features_t features)
 {
+	struct r8152 *tp = netdev_priv(dev);
 	u32 mss = skb_shinfo(skb)->gso_size;
 	int max_offset = mss ? GTTCPHO_MAX : TCPHO_MAX;
 
 	if ((mss || skb->ip_summed == CHECKSUM_PARTIAL) &&
 	    skb_transport_offset(skb) > max_offset)
 		features &= ~(NETIF_F_CSUM_MASK | NETIF_F_GSO_MASK);
-	else if ((skb->len + sizeof(struct tx_desc)) > agg_buf_sz)
+	else if ((skb->len + sizeof(struct tx_desc)) > tp->tx_buf_sz)
 		features &= ~NETIF_F_GSO_MASK;
 
 	return features;
@@ -2784,6 +2936,9 @@ static netdev_tx_t rtl8152_start_xmit(struct sk_buff *skb,
 
 	skb_tx_timestamp(skb);
 
+	rtl_tx_bql_len(skb) = skb->len;
+	netdev_sent_queue(netdev, skb->len);
+
 	skb_queue_tail(&tp->tx_queue, skb);
 
 	if (!list_empty(&tp->tx_free)) {
@@ -2860,7 +3015,7 @@ static void rtl8152_nic_reset(struct r8152 *tp)
 
 static void set_tx_qlen(struct r8152 *tp)
 {
-	tp->tx_qlen = agg_buf_sz / (mtu_to_size(tp->netdev->mtu) + sizeof(struct tx_desc));
+	tp->tx_qlen = tp->tx_buf_sz / (mtu_to_size(tp->netdev->mtu) + sizeof(struct tx_desc));
 }
 
 static inline u16 rtl8152_get_speed(struct r8152 *tp)
@@ -2921,8 +3076,8 @@ static int rtl_start_rx(struct r8152 *tp)
 	list_for_each_entry_safe(agg, agg_next, &tmp_list, info_list) {
 		INIT_LIST_HEAD(&agg->list);
 
-		/* Only RTL8152_MAX_RX rx_agg need to be submitted. */
-		if (++i > RTL8152_MAX_RX) {
+		/* Only rx_slots rx_agg need to be submitted. */
+		if (++i > tp->rx_slots) {
 			spin_lock_irqsave(&tp->rx_lock, flags);
 			list_add_tail(&agg->list, &tp->rx_used);
 			spin_unlock_irqrestore(&tp->rx_lock, flags);
@@ -2940,6 +3095,9 @@ static int rtl_start_rx(struct r8152 *tp)
 	list_splice(&tmp_list, &tp->rx_info);
 	spin_unlock_irqrestore(&tp->rx_lock, flags);
 
+	/* rx_bottom() submits more if rx_info held fewer than rx_slots */
+	tp->rx_inflight = min_t(u32, i, tp->rx_slots);
+
 	return ret;
 }
 
@@ -6633,6 +6791,24 @@ static void r8156_mdio_force_mode(struct r8152 *tp)
 	}
 }
 
+/* Start from aggregate sizes matching the link speed, rtl_tx_agg_adapt()
+ * and rtl_rx_agg_adapt() follow the traffic from there.
+ */
+static void rtl_agg_reset(struct r8152 *tp, u16 speed)
+{
+	if (speed & _2500bps) {
+		tp->tx_agg_sz = tp->tx_buf_sz;
+		tp->rx_slots = min_t(u32, RTL8152_MAX_RX * 2,
+				     rtl_rx_slots_max(tp));
+	} else {
+		tp->tx_agg_sz = agg_buf_sz;
+		tp->rx_slots = RTL8152_MAX_RX;
+	}
+
+	rtl_agg_window_reset(&tp->tx_agg_stats);
+	rtl_agg_window_reset(&tp->rx_agg_stats);
+}
+
 static void set_carrier(struct r8152 *tp)
 {
 	struct net_device *netdev = tp->netdev;
@@ -6647,6 +6823,7 @@ static void set_carrier(struct r8152 *tp)
 			netif_stop_queue(netdev);
 			napi_disable(napi);
 			netif_carrier_on(netdev);
+			rtl_agg_reset(tp, speed);
 			rtl_start_rx(tp);
 			clear_bit(RTL8152_SET_RX_MODE, &tp->flags);
 			_rtl8152_set_rx_mode(netdev);
@@ -6795,6 +6972,7 @@ static int rtl8152_open(struct net_device *netdev)
 	tp->rtl_ops.up(tp);
 
 	netif_carrier_off(netdev);
+	netdev_reset_queue(netdev);
 	netif_start_queue(netdev);
 	set_bit(WORK_ENABLE, &tp->flags);
 
@@ -8731,6 +8909,14 @@ static const char rtl8152_gstrings[][ETH_GSTRING_LEN] = {
 	"rx_multicast",
 	"tx_aborted",
 	"tx_underrun",
+	"tx_aggs",
+	"tx_agg_bytes",
+	"tx_agg_full",
+	"tx_agg_size",
+	"rx_aggs",
+	"rx_agg_bytes",
+	"rx_agg_full",
+	"rx_agg_inflight",
 };
 
 static int rtl8152_get_sset_count(struct net_device *dev, int sset)
@@ -8769,6 +8955,14 @@ static void rtl8152_get_ethtool_stats(struct net_device *dev,
 	data[10] = le32_to_cpu(tally.rx_multicast);
 	data[11] = le16_to_cpu(tally.tx_aborted);
 	data[12] = le16_to_cpu(tally.tx_underrun);
+	data[13] = tp->tx_agg_stats.aggs;
+	data[14] = tp->tx_agg_stats.bytes;
+	data[15] = tp->tx_agg_stats.full;
+	data[16] = READ_ONCE(tp->tx_agg_sz);
+	data[17] = tp->rx_agg_stats.aggs;
+	data[18] = tp->rx_agg_stats.bytes;
+	data[19] = tp->rx_agg_stats.full;
+	data[20] = READ_ONCE(tp->rx_inflight);
 }
 
 static void rtl8152_get_strings(struct net_device *dev, u32 stringset, u8 *data)
@@ -9062,10 +9256,12 @@ static int rtl8152_set_ringparam(struct net_device *netdev,
 			mutex_lock(&tp->control);
 			napi_disable(&tp->napi);
 			tp->rx_pending = ring->rx_pending;
+			tp->rx_slots = min(tp->rx_slots, rtl_rx_slots_max(tp));
 			napi_enable(&tp->napi);
 			mutex_unlock(&tp->control);
 		} else {
 			tp->rx_pending = ring->rx_pending;
+			tp->rx_slots = min(tp->rx_slots, rtl_rx_slots_max(tp));
 		}
 	}
 
@@ -9307,6 +9503,8 @@ static int rtl_ops_init(struct r8152 *tp)
 	struct rtl_ops *ops = &tp->rtl_ops;
 	int ret = 0;
 
+	tp->tx_buf_sz = agg_buf_sz;
+
 	switch (tp->version) {
 	case RTL_VER_01:
 	case RTL_VER_02:
@@ -9388,6 +9586,7 @@ static int rtl_ops_init(struct r8152 *tp)
 		ops->autosuspend_en	= rtl8156_runtime_enable;
 		ops->change_mtu		= rtl8156_change_mtu;
 		tp->rx_buf_sz		= 48 * 1024;
+		tp->tx_buf_sz		= 32 * 1024;
 		tp->support_2500full	= 1;
 		break;
 
@@ -9411,6 +9610,7 @@ static int rtl_ops_init(struct r8152 *tp)
 		ops->autosuspend_en	= rtl8156_runtime_enable;
 		ops->change_mtu		= rtl8156_change_mtu;
 		tp->rx_buf_sz		= 48 * 1024;
+		tp->tx_buf_sz		= 32 * 1024;
 		break;
 
 	case RTL_VER_14:
@@ -9696,7 +9896,7 @@ static int rtl8152_probe(struct usb_interface *intf,
 	}
 
 	netdev->ethtool_ops = &ops;
-	netif_set_tso_max_size(netdev, RTL_LIMITED_TSO_SIZE);
+	netif_set_tso_max_size(netdev, RTL_LIMITED_TSO_SIZE(tp));
 
 	/* MTU range: 68 - 1500 or 9194 */
 	netdev->min_mtu = ETH_MIN_MTU;
@@ -9752,6 +9952,8 @@ static int rtl8152_probe(struct usb_interface *intf,
 
 	tp->rx_copybreak = RTL8152_RXFG_HEADSZ;
 	tp->rx_pending = 10 * RTL8152_MAX_RX;
+	tp->rx_slots = RTL8152_MAX_RX;
+	tp->tx_agg_sz = agg_buf_sz;
 
 	intf->needs_remote_wakeup = 1;
 
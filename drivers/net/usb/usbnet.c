@@ -429,6 +429,37 @@ static void __usbnet_queue_skb(struct sk_buff_head *list,
 
 /*-------------------------------------------------------------------------*/
 
+/* Byte queue limits are charged with the length of the packets the stack
+ * hands to usbnet_start_xmit(), before tx_fixup() adds any framing.  With
+ * FLAG_MULTI_PACKET the minidriver may hold on to packets, so the bytes are
+ * collected in dev->tx_bql_pending until an urb is submitted and then
+ * completed along with that urb.  Completions are serialized by
+ * dev->txq.lock.
+ */
+static void usbnet_bql_completed(struct usbnet *dev, unsigned long packets,
+				 unsigned int bytes)
+{
+	lockdep_assert_held(&dev->txq.lock);
+
+	netdev_completed_queue(dev->net, packets, bytes);
+}
+
+static void usbnet_bql_reset(struct usbnet *dev)
+{
+	struct sk_buff *skb;
+	unsigned long flags;
+
+	spin_lock_irqsave(&dev->txq.lock, flags);
+	/* urbs left behind by FLAG_AVOID_UNLINK_URBS must not complete
+	 * bytes charged before the reset
+	 */
+	skb_queue_walk(&dev->txq, skb)
+		((struct skb_data *)skb->cb)->bql_bytes = 0;
+	dev->tx_bql_pending = 0;
+	netdev_reset_queue(dev->net);
+	spin_unlock_irqrestore(&dev->txq.lock, flags);
+}
+
 /* some LK 2.4 HCDs oopsed if we freed or resubmitted urbs from
  * completion callbacks.  2.5 should have fixed those bugs...
  */
@@ -445,6 +476,9 @@ static enum skb_state defer_bh(struct usbnet *dev, struct sk_buff *skb,
 	entry->state = state;
 	__skb_unlink(skb, list);
 
+	if (state == tx_done)
+		usbnet_bql_completed(dev, entry->packets, entry->bql_bytes);
+
 	/* defer_bh() is never called with list == &dev->done.
 	 * spin_lock_nested() tells lockdep that it is OK to take
 	 * dev->done.lock here with list->lock held.
@@ -916,6 +950,7 @@ int usbnet_open (struct net_device *net)
 	}
 
 	set_bit(EVENT_DEV_OPEN, &dev->flags);
+	usbnet_bql_reset(dev);
 	netif_start_queue (net);
 	netif_info(dev, ifup, dev->net,
 		   "open: enable queueing (rx %d, tx %d) mtu %d %s framing\n",
@@ -1358,8 +1393,11 @@ netdev_tx_t usbnet_start_xmit (struct sk_buff *skb,
 	unsigned long		flags;
 	int retval;
 
-	if (skb)
+	if (skb) {
 		skb_tx_timestamp(skb);
+		netdev_sent_queue(net, skb->len);
+		dev->tx_bql_pending += skb->len;
+	}
 
 	// some devices want funky USB-level framing, for
 	// win32 driver (usually) and/or hardware quirks
@@ -1382,6 +1420,7 @@ netdev_tx_t usbnet_start_xmit (struct sk_buff *skb,
 	entry = (struct skb_data *) skb->cb;
 	entry->urb = urb;
 	entry->dev = dev;
+	entry->bql_bytes = dev->tx_bql_pending;
 
 	usb_fill_bulk_urb (urb, dev->udev, dev->out,
 			skb->data, skb->len, tx_complete, skb);
@@ -1443,6 +1482,7 @@ netdev_tx_t usbnet_start_xmit (struct sk_buff *skb,
 	if (test_bit(EVENT_DEV_ASLEEP, &dev->flags)) {
 		/* transmission will be done in resume */
 		usb_anchor_urb(urb, &dev->deferred);
+		dev->tx_bql_pending = 0;
 		/* no use to process more packets */
 		netif_stop_queue(net);
 		usb_put_urb(urb);
@@ -1466,6 +1506,7 @@ netdev_tx_t usbnet_start_xmit (struct sk_buff *skb,
 	case 0:
 		netif_trans_update(net);
 		__usbnet_queue_skb(&dev->txq, skb, tx_start);
+		dev->tx_bql_pending = 0;
 		if (dev->txq.qlen >= TX_QLEN (dev))
 			netif_stop_queue (net);
 	}
@@ -1475,6 +1516,13 @@ netdev_tx_t usbnet_start_xmit (struct sk_buff *skb,
 		netif_dbg(dev, tx_err, dev->net, "drop, code %d\n", retval);
 drop:
 		dev->net->stats.tx_dropped++;
+		/* everything collected so far went down with this skb */
+		if (dev->tx_bql_pending) {
+			spin_lock_irqsave(&dev->txq.lock, flags);
+			usbnet_bql_completed(dev, 1, dev->tx_bql_pending);
+			spin_unlock_irqrestore(&dev->txq.lock, flags);
+			dev->tx_bql_pending = 0;
+		}
 not_drop:
 		if (skb)
 			dev_kfree_skb_any (skb);
@@ -1915,6 +1963,11 @@ int usbnet_resume (struct usb_interface *intf)
 			skb = (struct sk_buff *)res->context;
 			retval = usb_submit_urb(res, GFP_ATOMIC);
 			if (retval < 0) {
+				struct skb_data *entry =
+					(struct skb_data *)skb->cb;
+
+				usbnet_bql_completed(dev, entry->packets,
+						     entry->bql_bytes);
 				dev_kfree_skb_any(skb);
 				kfree(res->sg);
 				usb_free_urb(res);
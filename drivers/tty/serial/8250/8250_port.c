@@ -31,6 +31,7 @@
 #include <linux/uaccess.h>
 #include <linux/pm_runtime.h>
 #include <linux/ktime.h>
+#include <linux/sched/clock.h>
 
 #include <asm/io.h>
 #include <asm/irq.h>
@@ -1503,10 +1504,56 @@ static void __stop_tx_rs485(struct uart_8250_port *p, u64 stop_delay)
 	}
 }
 
+#ifdef CONFIG_SERIAL_8250_CONSOLE_BUFFERED
+#define CONS_XMIT_SIZE	(1 << CONFIG_SERIAL_8250_CONSOLE_BUF_SHIFT)
+
+/* Caller holds uart port lock */
+static inline bool serial8250_cons_pending(struct uart_8250_port *up)
+{
+	return up->cons_xmit.head != up->cons_xmit.tail;
+}
+
+/*
+ * Load the FIFO with queued console output. Returns true if anything was
+ * sent, the tty output then waits for the next THRE interrupt.
+ */
+static bool serial8250_cons_tx_chars(struct uart_8250_port *up)
+{
+	struct circ_buf *cb = &up->cons_xmit;
+	int count = up->tx_loadsz;
+
+	if (!serial8250_cons_pending(up))
+		return false;
+
+	do {
+		serial_out(up, UART_TX, cb->buf[cb->tail]);
+		if (up->bugs & UART_BUG_TXRACE)
+			serial_in(up, UART_SCR);
+		cb->tail = (cb->tail + 1) & (CONS_XMIT_SIZE - 1);
+	} while (--count > 0 && serial8250_cons_pending(up));
+
+	return true;
+}
+#else
+static inline bool serial8250_cons_pending(struct uart_8250_port *up)
+{
+	return false;
+}
+
+static inline bool serial8250_cons_tx_chars(struct uart_8250_port *up)
+{
+	return false;
+}
+#endif
+
 static inline void __stop_tx(struct uart_8250_port *p)
 {
 	struct uart_8250_em485 *em485 = p->em485;
 
+	/* Queued console output still needs the TX interrupt */
+	if (serial8250_cons_pending(p))
+		return;
+
 	if (em485) {
 		u16 lsr = serial_lsr_in(p);
 		u64 stop_delay = 0;
@@ -1818,6 +1865,9 @@ void serial8250_tx_chars(struct uart_8250_port *up)
 		uart_xchar_out(port, UART_TX);
 		return;
 	}
+	/* Console output goes first and ignores tty flow control */
+	if (serial8250_cons_tx_chars(up))
+		return;
 	if (uart_tx_stopped(port)) {
 		serial8250_stop_tx(port);
 		return;
@@ -2116,6 +2166,34 @@ static void wait_for_xmitr(struct uart_8250_port *up, int bits)
 	}
 }
 
+#ifdef CONFIG_SERIAL_8250_CONSOLE_BUFFERED
+/* Write out queued console output by polling, caller holds uart port lock */
+static void serial8250_cons_flush(struct uart_8250_port *up)
+{
+	while (serial8250_cons_pending(up)) {
+		wait_for_xmitr(up, UART_LSR_THRE);
+		serial8250_cons_tx_chars(up);
+	}
+}
+
+/*
+ * Poll out the oldest queued console output until @room bytes are free,
+ * caller holds uart port lock
+ */
+static void serial8250_cons_make_room(struct uart_8250_port *up,
+				      unsigned int room)
+{
+	struct circ_buf *cb = &up->cons_xmit;
+
+	while (CIRC_SPACE(cb->head, cb->tail, CONS_XMIT_SIZE) < room) {
+		wait_for_xmitr(up, UART_LSR_THRE);
+		serial8250_cons_tx_chars(up);
+	}
+}
+#else
+static inline void serial8250_cons_flush(struct uart_8250_port *up) { }
+#endif
+
 #ifdef CONFIG_CONSOLE_POLL
 /*
  * Console polling routines for writing and reading from the uart while
@@ -2470,9 +2548,11 @@ void serial8250_do_shutdown(struct uart_port *port)
 
 	serial8250_rpm_get(up);
 	/*
-	 * Disable interrupts from this port
+	 * Disable interrupts from this port, once the console output that
+	 * was left to them has been sent.
 	 */
 	spin_lock_irqsave(&port->lock, flags);
+	serial8250_cons_flush(up);
 	up->ier = 0;
 	serial_port_out(port, UART_IER, 0);
 	spin_unlock_irqrestore(&port->lock, flags);
@@ -3163,20 +3243,65 @@ static ssize_t rx_trig_bytes_store(struct device *dev,
 
 static DEVICE_ATTR_RW(rx_trig_bytes);
 
+#ifdef CONFIG_SERIAL_8250_CONSOLE
+/*
+ * Console write statistics: calls, total and longest time spent in
+ * serial8250_console_write() in ns, chars left to the TX interrupt, chars
+ * written by polling and writes that found the console buffer full.
+ */
+static ssize_t console_stats_show(struct device *dev,
+	struct device_attribute *attr, char *buf)
+{
+	struct tty_port *port = dev_get_drvdata(dev);
+	struct uart_state *state = container_of(port, struct uart_state, port);
+	struct uart_8250_port *up = up_to_u8250p(state->uart_port);
+	struct uart_8250_cons_stats stats;
+	unsigned long flags;
+
+	spin_lock_irqsave(&up->port.lock, flags);
+	stats = up->cons_stats;
+	spin_unlock_irqrestore(&up->port.lock, flags);
+
+	return sysfs_emit(buf, "%llu %llu %llu %llu %llu %llu\n",
+			  stats.writes, stats.time_ns, stats.max_ns,
+			  stats.buffered, stats.sync, stats.overflows);
+}
+
+static DEVICE_ATTR_RO(console_stats);
+#endif
+
 static struct attribute *serial8250_dev_attrs[] = {
 	&dev_attr_rx_trig_bytes.attr,
+#ifdef CONFIG_SERIAL_8250_CONSOLE
+	&dev_attr_console_stats.attr,
+#endif
 	NULL
 };
 
+static umode_t serial8250_dev_attr_visible(struct kobject *kobj,
+					   struct attribute *attr, int idx)
+{
+	struct tty_port *port = dev_get_drvdata(kobj_to_dev(kobj));
+	struct uart_state *state = container_of(port, struct uart_state, port);
+	const struct serial8250_config *conf_type =
+		&uart_config[state->uart_port->type];
+
+	if (attr == &dev_attr_rx_trig_bytes.attr && !conf_type->rxtrig_bytes[0])
+		return 0;
+
+	return attr->mode;
+}
+
 static struct attribute_group serial8250_dev_attr_group = {
 	.attrs = serial8250_dev_attrs,
+	.is_visible = serial8250_dev_attr_visible,
 };
 
 static void register_dev_spec_attr_grp(struct uart_8250_port *up)
 {
 	const struct serial8250_config *conf_type = &uart_config[up->port.type];
 
-	if (conf_type->rxtrig_bytes[0])
+	if (conf_type->rxtrig_bytes[0] || IS_ENABLED(CONFIG_SERIAL_8250_CONSOLE))
 		up->port.attr_group = &serial8250_dev_attr_group;
 }
 
@@ -3368,6 +3493,111 @@ static void serial8250_console_fifo_write(struct uart_8250_port *up,
 	}
 }
 
+#ifdef CONFIG_SERIAL_8250_CONSOLE_BUFFERED
+/*
+ * Console output can only be left to the TX interrupt while the port is
+ * open, and when the interrupt handler drives the FIFO by itself.
+ */
+static bool serial8250_cons_buffered(struct uart_8250_port *up)
+{
+	struct uart_port *port = &up->port;
+
+	return up->cons_xmit.buf && !oops_in_progress && !up->canary &&
+		port->state &&
+		test_bit(TTY_PORT_INITIALIZED, &port->state->port.iflags) &&
+		!up->dma && !up->em485 &&
+		!(up->capabilities & (UART_CAP_MINI | UART_CAP_HFIFO)) &&
+		!(port->flags & UPF_CONS_FLOW);
+}
+
+/*
+ * Queue the string, expanding LF to CRLF, and start the transmitter.
+ * Returns false if the caller has to write it synchronously. When the
+ * buffer is full, only as much of the older output as this string needs is
+ * polled out, never the whole buffer. Caller holds uart port lock.
+ */
+static bool serial8250_console_queue(struct uart_8250_port *up,
+				     const char *s, unsigned int count)
+{
+	struct circ_buf *cb = &up->cons_xmit;
+	bool waited = false;
+	unsigned int i, need;
+
+	if (!serial8250_cons_buffered(up))
+		return false;
+
+	for (i = 0; i < count; i++) {
+		need = s[i] == '\n' ? 2 : 1;
+		if (CIRC_SPACE(cb->head, cb->tail, CONS_XMIT_SIZE) < need) {
+			serial8250_cons_make_room(up, need);
+			waited = true;
+		}
+		if (s[i] == '\n') {
+			cb->buf[cb->head] = '\r';
+			cb->head = (cb->head + 1) & (CONS_XMIT_SIZE - 1);
+		}
+		cb->buf[cb->head] = s[i];
+		cb->head = (cb->head + 1) & (CONS_XMIT_SIZE - 1);
+	}
+	up->cons_stats.buffered += count;
+	if (waited)
+		up->cons_stats.overflows++;
+
+	if (count) {
+		serial8250_rpm_get_tx(up);
+		__start_tx(&up->port);
+	}
+	return true;
+}
+
+static void serial8250_console_buf_alloc(struct uart_8250_port *up)
+{
+	unsigned long flags;
+	char *buf;
+
+	if (up->cons_xmit.buf)
+		return;
+
+	/* The console still works synchronously without it */
+	buf = kmalloc(CONS_XMIT_SIZE, GFP_KERNEL);
+	if (!buf)
+		return;
+
+	spin_lock_irqsave(&up->port.lock, flags);
+	if (!up->cons_xmit.buf) {
+		up->cons_xmit.buf = buf;
+		up->cons_xmit.head = up->cons_xmit.tail = 0;
+		buf = NULL;
+	}
+	spin_unlock_irqrestore(&up->port.lock, flags);
+
+	kfree(buf);
+}
+
+static void serial8250_console_buf_free(struct uart_8250_port *up)
+{
+	unsigned long flags;
+	char *buf;
+
+	spin_lock_irqsave(&up->port.lock, flags);
+	serial8250_cons_flush(up);
+	buf = up->cons_xmit.buf;
+	up->cons_xmit.buf = NULL;
+	spin_unlock_irqrestore(&up->port.lock, flags);
+
+	kfree(buf);
+}
+#else
+static inline bool serial8250_console_queue(struct uart_8250_port *up,
+					    const char *s, unsigned int count)
+{
+	return false;
+}
+
+static inline void serial8250_console_buf_alloc(struct uart_8250_port *up) { }
+static inline void serial8250_console_buf_free(struct uart_8250_port *up) { }
+#endif
+
 /*
  *	Print a string to the serial port trying not to disturb
  *	any possible real use of the port...
@@ -3376,12 +3606,16 @@ static void serial8250_console_fifo_write(struct uart_8250_port *up,
  *
  *	Doing runtime PM is really a bad idea for the kernel console.
  *	Thus, we assume the function is called when device is powered up.
+ *
+ *	With CONFIG_SERIAL_8250_CONSOLE_BUFFERED the string is queued for
+ *	the TX interrupt instead whenever possible.
  */
 void serial8250_console_write(struct uart_8250_port *up, const char *s,
 			      unsigned int count)
 {
 	struct uart_8250_em485 *em485 = up->em485;
 	struct uart_port *port = &up->port;
+	u64 start = local_clock();
 	unsigned long flags;
 	unsigned int ier, use_fifo;
 	int locked = 1;
@@ -3393,6 +3627,9 @@ void serial8250_console_write(struct uart_8250_port *up, const char *s,
 	else
 		spin_lock_irqsave(&port->lock, flags);
 
+	if (locked && serial8250_console_queue(up, s, count))
+		goto out;
+
 	/*
 	 *	First save the IER then disable the interrupts
 	 */
@@ -3405,6 +3642,12 @@ void serial8250_console_write(struct uart_8250_port *up, const char *s,
 		up->canary = 0;
 	}
 
+	/* Output queued earlier goes first, if it is safe to touch */
+	if (locked) {
+		serial8250_cons_flush(up);
+		up->cons_stats.sync += count;
+	}
+
 	if (em485) {
 		if (em485->tx_stopped)
 			up->rs485_start_tx(up);
@@ -3460,8 +3703,17 @@ void serial8250_console_write(struct uart_8250_port *up, const char *s,
 	if (up->msr_saved_flags)
 		serial8250_modem_status(up);
 
-	if (locked)
+out:
+	if (locked) {
+		struct uart_8250_cons_stats *stats = &up->cons_stats;
+		u64 delta = local_clock() - start;
+
+		stats->writes++;
+		stats->time_ns += delta;
+		if (delta > stats->max_ns)
+			stats->max_ns = delta;
 		spin_unlock_irqrestore(&port->lock, flags);
+	}
 }
 
 static unsigned int probe_baud(struct uart_port *port)
@@ -3502,11 +3754,15 @@ int serial8250_console_setup(struct uart_port *port, char *options, bool probe)
 	if (port->dev)
 		pm_runtime_get_sync(port->dev);
 
+	serial8250_console_buf_alloc(up_to_u8250p(port));
+
 	return 0;
 }
 
 int serial8250_console_exit(struct uart_port *port)
 {
+	serial8250_console_buf_free(up_to_u8250p(port));
+
 	if (port->dev)
 		pm_runtime_put_sync(port->dev);
 
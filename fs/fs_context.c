@@ -79,6 +79,26 @@ static int vfs_parse_sb_flag(struct fs_context *fc, const char *key)
 	return -ENOPARAM;
 }
 
+/*
+ * Check for a common mount option that sets a superblock value.
+ */
+static int vfs_parse_sb_value(struct fs_context *fc, const char *key,
+			      const char *value)
+{
+	char *end;
+
+	if (strcmp(key, "cache_budget") != 0)
+		return -ENOPARAM;
+
+	if (!value || !*value)
+		return invalf(fc, "cache_budget: Size required");
+	fc->cache_budget = memparse(value, &end);
+	if (*end)
+		return invalf(fc, "cache_budget: Bad size '%s'", value);
+	fc->cache_budget_set = true;
+	return 0;
+}
+
 /**
  * vfs_parse_fs_param_source - Handle setting "source" via parameter
  * @fc: The filesystem context to modify
@@ -135,6 +155,12 @@ int vfs_parse_fs_param(struct fs_context *fc, struct fs_parameter *param)
 	if (ret != -ENOPARAM)
 		return ret;
 
+	ret = vfs_parse_sb_value(fc, param->key,
+				 param->type == fs_value_is_string ?
+				 param->string : NULL);
+	if (ret != -ENOPARAM)
+		return ret;
+
 	ret = security_fs_context_parse_param(fc, param);
 	if (ret != -ENOPARAM)
 		/* Param belongs to the LSM or is disallowed by the LSM; so
@@ -576,12 +602,48 @@ static int legacy_parse_param(struct fs_context *fc, struct fs_parameter *param)
 	return 0;
 }
 
+/*
+ * Remove the options handled by vfs_parse_sb_value() from legacy mount data,
+ * the way the LSM takes out its own, so the filesystem never sees them.
+ */
+static int legacy_eat_sb_values(struct fs_context *fc, char *options)
+{
+	char *from = options, *to = options, *opt, *eq;
+	size_t len;
+	int ret;
+
+	if (!strstr(options, "cache_budget"))
+		return 0;
+
+	while ((opt = strsep(&from, ",")) != NULL) {
+		eq = strchr(opt, '=');
+		if (eq)
+			*eq = '\0';
+		ret = vfs_parse_sb_value(fc, opt, eq ? eq + 1 : NULL);
+		if (eq)
+			*eq = '=';
+		if (!ret)
+			continue;
+		if (ret != -ENOPARAM)
+			return ret;
+
+		if (to != options)
+			*to++ = ',';
+		len = strlen(opt);
+		memmove(to, opt, len);
+		to += len;
+	}
+	*to = '\0';
+	return 0;
+}
+
 /*
  * Add monolithic mount data.
  */
 static int legacy_parse_monolithic(struct fs_context *fc, void *data)
 {
 	struct legacy_fs_context *ctx = fc->fs_private;
+	int ret;
 
 	if (ctx->param_type != LEGACY_FS_UNSET_PARAMS) {
 		pr_warn("VFS: Can't mix monolithic and individual options\n");
@@ -595,6 +657,9 @@ static int legacy_parse_monolithic(struct fs_context *fc, void *data)
 
 	if (fc->fs_type->fs_flags & FS_BINARY_MOUNTDATA)
 		return 0;
+	ret = legacy_eat_sb_values(fc, ctx->legacy_data);
+	if (ret)
+		return ret;
 	return security_sb_eat_lsm_opts(ctx->legacy_data, &fc->security);
 }
 
@@ -490,9 +490,13 @@ static void inode_lru_list_del(struct inode *inode)
  */
 void inode_sb_list_add(struct inode *inode)
 {
-	spin_lock(&inode->i_sb->s_inode_list_lock);
-	list_add(&inode->i_sb_list, &inode->i_sb->s_inodes);
-	spin_unlock(&inode->i_sb->s_inode_list_lock);
+	struct super_block *sb = inode->i_sb;
+
+	spin_lock(&sb->s_inode_list_lock);
+	list_add(&inode->i_sb_list, &sb->s_inodes);
+	sb->s_nr_inodes++;
+	spin_unlock(&sb->s_inode_list_lock);
+	sb_cache_budget_check(sb);
 }
 EXPORT_SYMBOL_GPL(inode_sb_list_add);
 
@@ -501,6 +505,7 @@ static inline void inode_sb_list_del(struct inode *inode)
 	if (!list_empty(&inode->i_sb_list)) {
 		spin_lock(&inode->i_sb->s_inode_list_lock);
 		list_del_init(&inode->i_sb_list);
+		inode->i_sb->s_nr_inodes--;
 		spin_unlock(&inode->i_sb->s_inode_list_lock);
 	}
 }
@@ -120,6 +120,16 @@ extern bool trylock_super(struct super_block *sb);
 struct super_block *user_get_super(dev_t, bool excl);
 void put_super(struct super_block *sb);
 extern bool mount_capable(struct fs_context *);
+unsigned long sb_cache_usage(struct super_block *sb);
+void sb_set_cache_budget(struct super_block *sb, unsigned long budget);
+void __sb_cache_budget_check(struct super_block *sb);
+
+/* Called after a dentry or inode has been added to @sb */
+static inline void sb_cache_budget_check(struct super_block *sb)
+{
+	if (READ_ONCE(sb->s_cache_budget))
+		__sb_cache_budget_check(sb);
+}
 
 /*
  * open.c
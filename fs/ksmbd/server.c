@@ -502,14 +502,23 @@ static ssize_t debug_store(struct class *class, struct class_attribute *attr,
 	return len;
 }
 
+/* "hits misses evictions entries" of the security descriptor cache */
+static ssize_t sd_cache_show(struct class *class, struct class_attribute *attr,
+			     char *buf)
+{
+	return ksmbd_sd_cache_show(buf);
+}
+
 static CLASS_ATTR_RO(stats);
 static CLASS_ATTR_WO(kill_server);
 static CLASS_ATTR_RW(debug);
+static CLASS_ATTR_RO(sd_cache);
 
 static struct attribute *ksmbd_control_class_attrs[] = {
 	&class_attr_stats.attr,
 	&class_attr_kill_server.attr,
 	&class_attr_debug.attr,
+	&class_attr_sd_cache.attr,
 	NULL,
 };
 ATTRIBUTE_GROUPS(ksmbd_control_class);
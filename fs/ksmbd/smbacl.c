@@ -13,6 +13,7 @@
 
 #include "smbacl.h"
 #include "smb_common.h"
+#include "vfs_cache.h"
 #include "server.h"
 #include "misc.h"
 #include "mgmt/share_config.h"
@@ -1007,6 +1008,20 @@ int smb_inherit_dacl(struct ksmbd_conn *conn,
 	int rc = 0, num_aces, dacloffset, pntsd_type, pntsd_size, acl_len, aces_size;
 	char *aces_base;
 	bool is_dir = S_ISDIR(d_inode(path->dentry)->i_mode);
+	int kind = is_dir ? KSMBD_SD_INHERIT_DIR : KSMBD_SD_INHERIT_FILE;
+	struct ksmbd_sd_stamp stamp;
+
+	/* Siblings created by the same user inherit the same descriptor */
+	ksmbd_sd_cache_stamp(&stamp);
+	if (ksmbd_sd_cache_lookup(user_ns, d_inode(parent), &stamp, kind,
+				  uid, gid, &parent_pntsd, &pntsd_size)) {
+		if (pntsd_size > 0) {
+			ksmbd_vfs_set_sd_xattr(conn, user_ns, path->dentry,
+					       parent_pntsd, pntsd_size);
+			kfree(parent_pntsd);
+		}
+		return 0;
+	}
 
 	pntsd_size = ksmbd_vfs_get_sd_xattr(conn, user_ns,
 					    parent, &parent_pntsd);
@@ -1162,9 +1177,15 @@ int smb_inherit_dacl(struct ksmbd_conn *conn,
 			pntsd_size += sizeof(struct smb_acl) + nt_size;
 		}
 
+		/* Before ksmbd_vfs_set_sd_xattr() converts it to NDR offsets */
+		ksmbd_sd_cache_insert(user_ns, d_inode(parent), &stamp, kind,
+				      uid, gid, pntsd, pntsd_size);
 		ksmbd_vfs_set_sd_xattr(conn, user_ns,
 				       path->dentry, pntsd, pntsd_size);
 		kfree(pntsd);
+	} else {
+		ksmbd_sd_cache_insert(user_ns, d_inode(parent), &stamp, kind,
+				      uid, gid, NULL, 0);
 	}
 
 free_aces_base:
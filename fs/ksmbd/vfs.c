@@ -1357,6 +1357,7 @@ int ksmbd_vfs_remove_sd_xattrs(struct user_namespace *user_ns,
 				ksmbd_debug(SMB, "remove xattr failed : %s\n", name);
 		}
 	}
+	ksmbd_sd_cache_invalidate(d_inode(dentry));
 out:
 	kvfree(xattr_list);
 	return err;
@@ -1492,6 +1493,7 @@ int ksmbd_vfs_set_sd_xattr(struct ksmbd_conn *conn,
 				sd_ndr.offset, 0);
 	if (rc < 0)
 		pr_err("Failed to store XATTR ntacl :%d\n", rc);
+	ksmbd_sd_cache_invalidate(inode);
 
 	kfree(sd_ndr.data);
 out:
@@ -1513,10 +1515,20 @@ int ksmbd_vfs_get_sd_xattr(struct ksmbd_conn *conn,
 	struct xattr_ntacl acl;
 	struct xattr_smb_acl *smb_acl = NULL, *def_smb_acl = NULL;
 	__u8 cmp_hash[XATTR_SD_HASH_SIZE] = {0};
+	struct ksmbd_sd_stamp stamp;
+
+	ksmbd_sd_cache_stamp(&stamp);
+	if (ksmbd_sd_cache_lookup(user_ns, inode, &stamp, KSMBD_SD_OWN, 0, 0,
+				  pntsd, &rc))
+		return rc;
 
 	rc = ksmbd_vfs_getxattr(user_ns, dentry, XATTR_NAME_SD, &n.data);
-	if (rc <= 0)
+	if (rc <= 0) {
+		if (rc == -ENODATA)
+			ksmbd_sd_cache_insert(user_ns, inode, &stamp,
+					      KSMBD_SD_OWN, 0, 0, NULL, rc);
 		return rc;
+	}
 
 	n.length = rc;
 	rc = ndr_decode_v4_ntacl(&n, &acl);
@@ -1562,6 +1574,8 @@ int ksmbd_vfs_get_sd_xattr(struct ksmbd_conn *conn,
 					   NDR_NTSD_OFFSETOF);
 
 	rc = acl.sd_size;
+	ksmbd_sd_cache_insert(user_ns, inode, &stamp, KSMBD_SD_OWN, 0, 0,
+			      *pntsd, rc);
 out_free:
 	kfree(acl_ndr.data);
 	kfree(smb_acl);
@@ -5,7 +5,10 @@
  */
 
 #include <linux/fs.h>
+#include <linux/fsnotify_backend.h>
+#include <linux/hashtable.h>
 #include <linux/slab.h>
+#include <linux/sysfs.h>
 #include <linux/vmalloc.h>
 
 #include "glob.h"
@@ -688,6 +691,9 @@ void ksmbd_destroy_file_table(struct ksmbd_file_table *ft)
 	ft->idr = NULL;
 }
 
+static int ksmbd_sd_cache_init(void);
+static void ksmbd_sd_cache_exit(void);
+
 int ksmbd_init_file_cache(void)
 {
 	filp_cache = kmem_cache_create("ksmbd_file_cache",
@@ -696,6 +702,11 @@ int ksmbd_init_file_cache(void)
 	if (!filp_cache)
 		goto out;
 
+	if (ksmbd_sd_cache_init()) {
+		kmem_cache_destroy(filp_cache);
+		goto out;
+	}
+
 	return 0;
 
 out:
@@ -706,4 +717,380 @@ int ksmbd_init_file_cache(void)
 void ksmbd_exit_file_cache(void)
 {
 	kmem_cache_destroy(filp_cache);
+	ksmbd_sd_cache_exit();
+}
+
+/*
+ * Security descriptor cache
+ *
+ * Decoding security.NTACL costs an xattr read, an NDR decode and a hash of
+ * the POSIX ACLs, and an open can need it for both the file and its parent.
+ * Keep the decoded descriptors, and the descriptors new files and
+ * directories inherit, keyed by inode. A cached inode carries an evictable
+ * fsnotify mark, and its entries are dropped on FS_ATTRIB, which setxattr,
+ * setfacl, chmod and chown raise, and when the inode is evicted. Creating
+ * or removing entries in a directory does not raise it on the directory,
+ * so siblings keep sharing the inherited descriptor. A lookup does not
+ * touch the filesystem.
+ */
+#define SD_CACHE_BITS		10
+#define SD_CACHE_MAX_ENTRIES	4096
+#define SD_CACHE_MAX_SIZE	(8 * 1024)
+
+struct ksmbd_sd_entry {
+	struct hlist_node	hnode;
+	struct list_head	lru;
+	refcount_t		refcount;
+	struct super_block	*sb;
+	unsigned long		ino;
+	u32			generation;
+	struct user_namespace	*user_ns;
+	int			kind;
+	unsigned int		uid;
+	unsigned int		gid;
+	/* descriptor size, 0 if there is none to inherit, or -ENODATA */
+	int			size;
+	char			sd[];
+};
+
+struct ksmbd_sd_mark {
+	struct fsnotify_mark	fsn_mark;
+	struct list_head	list;		/* on sd_cache_marks */
+	struct super_block	*sb;
+	unsigned long		ino;
+	u32			generation;
+};
+
+static DEFINE_HASHTABLE(sd_cache, SD_CACHE_BITS);
+static LIST_HEAD(sd_cache_lru);
+static LIST_HEAD(sd_cache_marks);
+static DEFINE_SPINLOCK(sd_cache_lock);
+static struct fsnotify_group *sd_cache_group;
+static unsigned int sd_cache_entries;
+/* Bumped under sd_cache_lock whenever entries are invalidated */
+static atomic64_t sd_cache_seq;
+static atomic64_t sd_cache_hits;
+static atomic64_t sd_cache_misses;
+static atomic64_t sd_cache_evictions;
+
+static unsigned long sd_cache_hash(struct super_block *sb, unsigned long ino)
+{
+	return (unsigned long)sb ^ ino;
+}
+
+static bool sd_entry_match(struct ksmbd_sd_entry *e, struct super_block *sb,
+			   unsigned long ino, u32 generation)
+{
+	return e->sb == sb && e->ino == ino && e->generation == generation;
+}
+
+static void sd_entry_put(struct ksmbd_sd_entry *e)
+{
+	if (refcount_dec_and_test(&e->refcount)) {
+		put_user_ns(e->user_ns);
+		kfree(e);
+	}
+}
+
+/* Must be called with sd_cache_lock held */
+static void sd_entry_unhash(struct ksmbd_sd_entry *e)
+{
+	hash_del(&e->hnode);
+	list_del(&e->lru);
+	sd_cache_entries--;
+	sd_entry_put(e);
+}
+
+/* Must be called with sd_cache_lock held */
+static void sd_cache_drop(struct super_block *sb, unsigned long ino,
+			  u32 generation)
+{
+	struct ksmbd_sd_entry *e;
+	struct hlist_node *n;
+
+	atomic64_inc(&sd_cache_seq);
+	hash_for_each_possible_safe(sd_cache, e, n, hnode,
+				    sd_cache_hash(sb, ino)) {
+		if (sd_entry_match(e, sb, ino, generation))
+			sd_entry_unhash(e);
+	}
+}
+
+static int sd_cache_handle_event(struct fsnotify_mark *mark, u32 mask,
+				 struct inode *inode, struct inode *dir,
+				 const struct qstr *name, u32 cookie)
+{
+	if (inode)
+		ksmbd_sd_cache_invalidate(inode);
+	return 0;
+}
+
+/* The mark is gone, with the inode or on exit: so is our reference */
+static void sd_cache_freeing_mark(struct fsnotify_mark *mark,
+				  struct fsnotify_group *group)
+{
+	struct ksmbd_sd_mark *m = container_of(mark, struct ksmbd_sd_mark,
+					       fsn_mark);
+
+	spin_lock(&sd_cache_lock);
+	list_del_init(&m->list);
+	sd_cache_drop(m->sb, m->ino, m->generation);
+	spin_unlock(&sd_cache_lock);
+	fsnotify_put_mark(mark);
+}
+
+static void sd_cache_free_mark(struct fsnotify_mark *mark)
+{
+	kfree(container_of(mark, struct ksmbd_sd_mark, fsn_mark));
+}
+
+static const struct fsnotify_ops sd_cache_fsnotify_ops = {
+	.handle_inode_event = sd_cache_handle_event,
+	.freeing_mark = sd_cache_freeing_mark,
+	.free_mark = sd_cache_free_mark,
+};
+
+/* Have @inode report its changes before its descriptor gets read */
+static int sd_cache_watch(struct inode *inode)
+{
+	struct fsnotify_mark *mark;
+	struct ksmbd_sd_mark *m;
+	int err;
+
+	mark = fsnotify_find_mark(&inode->i_fsnotify_marks, sd_cache_group);
+	if (mark) {
+		fsnotify_put_mark(mark);
+		return 0;
+	}
+
+	m = kzalloc(sizeof(*m), GFP_KERNEL);
+	if (!m)
+		return -ENOMEM;
+
+	fsnotify_init_mark(&m->fsn_mark, sd_cache_group);
+	m->fsn_mark.mask = FS_ATTRIB;
+	/* Don't pin the inode, evicting it drops the mark and the entries */
+	m->fsn_mark.flags |= FSNOTIFY_MARK_FLAG_NO_IREF;
+	m->sb = inode->i_sb;
+	m->ino = inode->i_ino;
+	m->generation = inode->i_generation;
+
+	/* Listed first, sd_cache_freeing_mark() may run as soon as it is added */
+	spin_lock(&sd_cache_lock);
+	list_add(&m->list, &sd_cache_marks);
+	spin_unlock(&sd_cache_lock);
+
+	err = fsnotify_add_inode_mark(&m->fsn_mark, inode, 0);
+	if (err) {
+		spin_lock(&sd_cache_lock);
+		list_del(&m->list);
+		spin_unlock(&sd_cache_lock);
+		fsnotify_put_mark(&m->fsn_mark);
+		/* someone else added it */
+		if (err == -EEXIST)
+			err = 0;
+	}
+	return err;
+}
+
+static int ksmbd_sd_cache_init(void)
+{
+	sd_cache_group = fsnotify_alloc_group(&sd_cache_fsnotify_ops, 0);
+	if (IS_ERR(sd_cache_group)) {
+		sd_cache_group = NULL;
+		return -ENOMEM;
+	}
+	return 0;
+}
+
+static void ksmbd_sd_cache_exit(void)
+{
+	struct ksmbd_sd_mark *m;
+
+	for (;;) {
+		spin_lock(&sd_cache_lock);
+		m = list_first_entry_or_null(&sd_cache_marks,
+					     struct ksmbd_sd_mark, list);
+		if (m)
+			fsnotify_get_mark(&m->fsn_mark);
+		spin_unlock(&sd_cache_lock);
+		if (!m)
+			break;
+
+		fsnotify_destroy_mark(&m->fsn_mark, sd_cache_group);
+		fsnotify_put_mark(&m->fsn_mark);
+	}
+
+	fsnotify_put_group(sd_cache_group);
+	fsnotify_wait_marks_destroyed();
+	ksmbd_sd_cache_invalidate(NULL);
+}
+
+/**
+ * ksmbd_sd_cache_stamp() - sample the cache before computing a descriptor
+ * @stamp:	passed to ksmbd_sd_cache_lookup() and ksmbd_sd_cache_insert()
+ *
+ * A descriptor computed after the stamp is only inserted if nothing was
+ * invalidated in between, so that a change racing with the computation
+ * can't leave a stale entry behind.
+ */
+void ksmbd_sd_cache_stamp(struct ksmbd_sd_stamp *stamp)
+{
+	stamp->cacheable = true;
+	stamp->seq = atomic64_read(&sd_cache_seq);
+}
+
+/**
+ * ksmbd_sd_cache_lookup() - look up a cached descriptor
+ * @user_ns:	user namespace of the mount the descriptor is read through
+ * @inode:	inode the descriptor belongs to
+ * @stamp:	sampled by ksmbd_sd_cache_stamp()
+ * @kind:	KSMBD_SD_OWN or one of the inherited descriptors
+ * @uid:	owner of the new object, for inherited descriptors
+ * @gid:	group of the new object, for inherited descriptors
+ * @pntsd:	set to a copy of the descriptor, to be freed by the caller
+ * @size:	descriptor size, 0 or a negative errno if there is none
+ *
+ * On a miss, @inode is watched from then on, the caller then reads and
+ * computes the descriptor and passes it to ksmbd_sd_cache_insert().
+ *
+ * Return:	true on a hit
+ */
+bool ksmbd_sd_cache_lookup(struct user_namespace *user_ns, struct inode *inode,
+			   struct ksmbd_sd_stamp *stamp, int kind,
+			   unsigned int uid, unsigned int gid,
+			   struct smb_ntsd **pntsd, int *size)
+{
+	struct ksmbd_sd_entry *e, *found = NULL;
+
+	spin_lock(&sd_cache_lock);
+	hash_for_each_possible(sd_cache, e, hnode,
+			       sd_cache_hash(inode->i_sb, inode->i_ino)) {
+		if (!sd_entry_match(e, inode->i_sb, inode->i_ino,
+				    inode->i_generation) ||
+		    e->user_ns != user_ns || e->kind != kind)
+			continue;
+		if (kind != KSMBD_SD_OWN && (e->uid != uid || e->gid != gid))
+			continue;
+		list_move(&e->lru, &sd_cache_lru);
+		refcount_inc(&e->refcount);
+		found = e;
+		break;
+	}
+	spin_unlock(&sd_cache_lock);
+
+	if (!found)
+		goto miss;
+
+	if (found->size > 0) {
+		*pntsd = kmemdup(found->sd, found->size, GFP_KERNEL);
+		if (!*pntsd) {
+			sd_entry_put(found);
+			goto miss;
+		}
+	}
+	*size = found->size;
+	sd_entry_put(found);
+	atomic64_inc(&sd_cache_hits);
+	return true;
+
+miss:
+	if (sd_cache_watch(inode))
+		stamp->cacheable = false;
+	atomic64_inc(&sd_cache_misses);
+	return false;
+}
+
+/**
+ * ksmbd_sd_cache_insert() - cache a descriptor
+ * @user_ns:	user namespace of the mount the descriptor was read through
+ * @inode:	inode the descriptor belongs to
+ * @stamp:	passed to the ksmbd_sd_cache_lookup() that missed
+ * @kind:	KSMBD_SD_OWN or one of the inherited descriptors
+ * @uid:	owner of the new object, for inherited descriptors
+ * @gid:	group of the new object, for inherited descriptors
+ * @pntsd:	the descriptor, copied
+ * @size:	descriptor size, 0 or a negative errno if there is none
+ */
+void ksmbd_sd_cache_insert(struct user_namespace *user_ns, struct inode *inode,
+			   struct ksmbd_sd_stamp *stamp, int kind,
+			   unsigned int uid, unsigned int gid,
+			   struct smb_ntsd *pntsd, int size)
+{
+	unsigned long hash = sd_cache_hash(inode->i_sb, inode->i_ino);
+	struct ksmbd_sd_entry *e, *old;
+	struct hlist_node *tmp;
+
+	if (!stamp->cacheable || size > SD_CACHE_MAX_SIZE)
+		return;
+
+	e = kmalloc(struct_size(e, sd, max(size, 0)), GFP_KERNEL);
+	if (!e)
+		return;
+
+	refcount_set(&e->refcount, 1);
+	e->sb = inode->i_sb;
+	e->ino = inode->i_ino;
+	e->generation = inode->i_generation;
+	e->user_ns = get_user_ns(user_ns);
+	e->kind = kind;
+	e->uid = uid;
+	e->gid = gid;
+	e->size = size;
+	if (size > 0)
+		memcpy(e->sd, pntsd, size);
+
+	spin_lock(&sd_cache_lock);
+	if (atomic64_read(&sd_cache_seq) != stamp->seq) {
+		/* something changed while the descriptor was computed */
+		spin_unlock(&sd_cache_lock);
+		sd_entry_put(e);
+		return;
+	}
+	hash_for_each_possible_safe(sd_cache, old, tmp, hnode, hash) {
+		if (sd_entry_match(old, e->sb, e->ino, e->generation) &&
+		    old->user_ns == user_ns && old->kind == kind &&
+		    old->uid == uid && old->gid == gid)
+			sd_entry_unhash(old);
+	}
+	hash_add(sd_cache, &e->hnode, hash);
+	list_add(&e->lru, &sd_cache_lru);
+	if (++sd_cache_entries > SD_CACHE_MAX_ENTRIES) {
+		sd_entry_unhash(list_last_entry(&sd_cache_lru,
+						struct ksmbd_sd_entry, lru));
+		atomic64_inc(&sd_cache_evictions);
+	}
+	spin_unlock(&sd_cache_lock);
+}
+
+/**
+ * ksmbd_sd_cache_invalidate() - drop the cached descriptors of an inode
+ * @inode:	inode whose descriptor changed, or NULL to drop everything
+ */
+void ksmbd_sd_cache_invalidate(struct inode *inode)
+{
+	struct ksmbd_sd_entry *e, *tmp;
+
+	/* Only watched inodes have entries, or a descriptor being computed */
+	if (inode && !(READ_ONCE(inode->i_fsnotify_mask) & FS_ATTRIB))
+		return;
+
+	spin_lock(&sd_cache_lock);
+	if (!inode) {
+		atomic64_inc(&sd_cache_seq);
+		list_for_each_entry_safe(e, tmp, &sd_cache_lru, lru)
+			sd_entry_unhash(e);
+	} else {
+		sd_cache_drop(inode->i_sb, inode->i_ino, inode->i_generation);
+	}
+	spin_unlock(&sd_cache_lock);
+}
+
+ssize_t ksmbd_sd_cache_show(char *buf)
+{
+	return sysfs_emit(buf, "%llu %llu %llu %u\n",
+			  atomic64_read(&sd_cache_hits),
+			  atomic64_read(&sd_cache_misses),
+			  atomic64_read(&sd_cache_evictions),
+			  READ_ONCE(sd_cache_entries));
 }
@@ -163,4 +163,30 @@ void ksmbd_fd_set_delete_on_close(struct ksmbd_file *fp,
 				  int file_info);
 int ksmbd_init_file_cache(void);
 void ksmbd_exit_file_cache(void);
+
+/*
+ * Security descriptor cache
+ */
+enum {
+	KSMBD_SD_OWN,		/* the inode's own descriptor */
+	KSMBD_SD_INHERIT_FILE,	/* what a new file inherits from the inode */
+	KSMBD_SD_INHERIT_DIR,	/* what a new directory inherits */
+};
+
+struct ksmbd_sd_stamp {
+	bool			cacheable;
+	s64			seq;		/* invalidations seen so far */
+};
+
+void ksmbd_sd_cache_stamp(struct ksmbd_sd_stamp *stamp);
+bool ksmbd_sd_cache_lookup(struct user_namespace *user_ns, struct inode *inode,
+			   struct ksmbd_sd_stamp *stamp, int kind,
+			   unsigned int uid, unsigned int gid,
+			   struct smb_ntsd **pntsd, int *size);
+void ksmbd_sd_cache_insert(struct user_namespace *user_ns, struct inode *inode,
+			   struct ksmbd_sd_stamp *stamp, int kind,
+			   unsigned int uid, unsigned int gid,
+			   struct smb_ntsd *pntsd, int size);
+void ksmbd_sd_cache_invalidate(struct inode *inode);
+ssize_t ksmbd_sd_cache_show(char *buf);
 #endif /* __VFS_CACHE_H__ */
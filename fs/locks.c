@@ -61,6 +61,7 @@
 #include <linux/rcupdate.h>
 #include <linux/pid_namespace.h>
 #include <linux/hashtable.h>
+#include <linux/interval_tree_generic.h>
 #include <linux/percpu.h>
 #include <linux/sysctl.h>
 
@@ -187,6 +188,8 @@ locks_get_lock_context(struct inode *inode, int type)
 	INIT_LIST_HEAD(&ctx->flc_flock);
 	INIT_LIST_HEAD(&ctx->flc_posix);
 	INIT_LIST_HEAD(&ctx->flc_lease);
+	ctx->flc_posix_ranges = RB_ROOT_CACHED;
+	ctx->flc_posix_owners = RB_ROOT;
 
 	/*
 	 * Assign the pointer if it's not already assigned. If it is, then
@@ -261,6 +264,8 @@ static void locks_init_lock_heads(struct file_lock *fl)
 	INIT_LIST_HEAD(&fl->fl_list);
 	INIT_LIST_HEAD(&fl->fl_blocked_requests);
 	INIT_LIST_HEAD(&fl->fl_blocked_member);
+	RB_CLEAR_NODE(&fl->fl_range_node);
+	RB_CLEAR_NODE(&fl->fl_owner_node);
 	init_waitqueue_head(&fl->fl_wait);
 }
 
@@ -835,6 +840,119 @@ locks_delete_lock_ctx(struct file_lock *fl, struct list_head *dispose)
 		locks_free_lock(fl);
 }
 
+/*
+ * Besides flc_posix, POSIX locks are indexed by range in an interval tree,
+ * which finds conflicting locks without walking the locks of every other
+ * owner, and by (owner, start) in flc_posix_owners, which finds where the
+ * locks of one owner start in flc_posix. The list stays the reference for
+ * ordering; both trees are updated under flc_lock whenever a lock is
+ * inserted, removed or has its range changed.
+ */
+#define posix_lock_start(fl)	((fl)->fl_start)
+#define posix_lock_last(fl)	((fl)->fl_end)
+
+INTERVAL_TREE_DEFINE(struct file_lock, fl_range_node, loff_t, fl_range_last,
+		     posix_lock_start, posix_lock_last, static, posix_range)
+
+static int posix_owner_cmp(struct file_lock *fl, fl_owner_t owner,
+			   loff_t start)
+{
+	if (fl->fl_owner != owner)
+		return fl->fl_owner < owner ? -1 : 1;
+	if (fl->fl_start != start)
+		return fl->fl_start < start ? -1 : 1;
+	return 0;
+}
+
+static void posix_index_insert(struct file_lock_context *ctx,
+			       struct file_lock *fl)
+{
+	struct rb_node **p = &ctx->flc_posix_owners.rb_node, *parent = NULL;
+
+	while (*p) {
+		parent = *p;
+		if (posix_owner_cmp(rb_entry(parent, struct file_lock,
+					     fl_owner_node),
+				    fl->fl_owner, fl->fl_start) < 0)
+			p = &parent->rb_right;
+		else
+			p = &parent->rb_left;
+	}
+	rb_link_node(&fl->fl_owner_node, parent, p);
+	rb_insert_color(&fl->fl_owner_node, &ctx->flc_posix_owners);
+
+	posix_range_insert(fl, &ctx->flc_posix_ranges);
+}
+
+static void posix_index_remove(struct file_lock_context *ctx,
+			       struct file_lock *fl)
+{
+	posix_range_remove(fl, &ctx->flc_posix_ranges);
+	RB_CLEAR_NODE(&fl->fl_range_node);
+	rb_erase(&fl->fl_owner_node, &ctx->flc_posix_owners);
+	RB_CLEAR_NODE(&fl->fl_owner_node);
+}
+
+static void posix_insert_lock(struct file_lock_context *ctx,
+			      struct file_lock *fl, struct list_head *before)
+{
+	locks_insert_lock_ctx(fl, before);
+	posix_index_insert(ctx, fl);
+}
+
+static void posix_delete_lock(struct file_lock_context *ctx,
+			      struct file_lock *fl, struct list_head *dispose)
+{
+	posix_index_remove(ctx, fl);
+	locks_delete_lock_ctx(fl, dispose);
+}
+
+/* Change the range of a lock already on flc_posix */
+static void posix_lock_set_range(struct file_lock_context *ctx,
+				 struct file_lock *fl, loff_t start, loff_t end)
+{
+	posix_index_remove(ctx, fl);
+	fl->fl_start = start;
+	fl->fl_end = end;
+	posix_index_insert(ctx, fl);
+}
+
+/*
+ * Return the lock of @request's owner that posix_lock_inode() has to start
+ * merging from: the last one starting before @request, or else the first
+ * one. Locks of the same owner never overlap, so none before that one can
+ * touch @request. If the owner holds no lock, return the list head.
+ */
+static struct file_lock *posix_owner_first(struct file_lock_context *ctx,
+					   struct file_lock *request)
+{
+	struct rb_node *node = ctx->flc_posix_owners.rb_node;
+	struct file_lock *fl, *before = NULL, *after = NULL;
+
+	while (node) {
+		fl = rb_entry(node, struct file_lock, fl_owner_node);
+		if (posix_owner_cmp(fl, request->fl_owner,
+				    request->fl_start) < 0) {
+			before = fl;
+			node = node->rb_right;
+		} else {
+			after = fl;
+			node = node->rb_left;
+		}
+	}
+
+	if (before && before->fl_owner == request->fl_owner)
+		return before;
+	if (after && after->fl_owner == request->fl_owner)
+		return after;
+	return list_entry(&ctx->flc_posix, struct file_lock, fl_list);
+}
+
+#define for_each_posix_lock_in_range(fl, ctx, start, end)		\
+	for (fl = posix_range_iter_first(&(ctx)->flc_posix_ranges,	\
+					 start, end);			\
+	     fl; fl = posix_range_iter_next(fl, start, end))
+
 /* Determine if lock sys_fl blocks lock caller_fl. Common functionality
  * checks for shared/exclusive status of overlapping locks.
  */
@@ -899,7 +1017,7 @@ posix_test_lock(struct file *filp, struct file_lock *fl)
 
 retry:
 	spin_lock(&ctx->flc_lock);
-	list_for_each_entry(cfl, &ctx->flc_posix, fl_list) {
+	for_each_posix_lock_in_range(cfl, ctx, fl->fl_start, fl->fl_end) {
 		if (!posix_locks_conflict(fl, cfl))
 			continue;
 		if (cfl->fl_lmops && cfl->fl_lmops->lm_lock_expirable
@@ -1111,12 +1229,14 @@ static int posix_lock_inode(struct inode *inode, struct file_lock *request,
 	percpu_down_read(&file_rwsem);
 	spin_lock(&ctx->flc_lock);
 	/*
-	 * New lock request. Walk all POSIX locks and look for conflicts. If
-	 * there are any, either return error or put the request on the
-	 * blocker's list of waiters and the global blocked_hash.
+	 * New lock request. Look for conflicts among the POSIX locks that
+	 * overlap it. If there are any, either return error or put the
+	 * request on the blocker's list of waiters and the global
+	 * blocked_hash.
 	 */
 	if (request->fl_type != F_UNLCK) {
-		list_for_each_entry(fl, &ctx->flc_posix, fl_list) {
+		for_each_posix_lock_in_range(fl, ctx, request->fl_start,
+					     request->fl_end) {
 			if (!posix_locks_conflict(request, fl))
 				continue;
 			if (fl->fl_lmops && fl->fl_lmops->lm_lock_expirable
@@ -1161,11 +1281,8 @@ static int posix_lock_inode(struct inode *inode, struct file_lock *request,
 	if (request->fl_flags & FL_ACCESS)
 		goto out;
 
-	/* Find the first old lock with the same owner as the new lock */
-	list_for_each_entry(fl, &ctx->flc_posix, fl_list) {
-		if (posix_same_owner(request, fl))
-			break;
-	}
+	/* Find the first old lock with the same owner that may be affected */
+	fl = posix_owner_first(ctx, request);
 
 	/* Process locks with this owner. */
 	list_for_each_entry_safe_from(fl, tmp, &ctx->flc_posix, fl_list) {
@@ -1191,18 +1308,18 @@ static int posix_lock_inode(struct inode *inode, struct file_lock *request,
 			 * lock yielding from the lower start address of both
 			 * locks to the higher end address.
 			 */
-			if (fl->fl_start > request->fl_start)
-				fl->fl_start = request->fl_start;
-			else
-				request->fl_start = fl->fl_start;
-			if (fl->fl_end < request->fl_end)
-				fl->fl_end = request->fl_end;
-			else
-				request->fl_end = fl->fl_end;
+			posix_lock_set_range(ctx, fl,
+					min(fl->fl_start, request->fl_start),
+					max(fl->fl_end, request->fl_end));
 			if (added) {
-				locks_delete_lock_ctx(fl, &dispose);
+				/* request is on the list as well */
+				posix_lock_set_range(ctx, request,
+						     fl->fl_start, fl->fl_end);
+				posix_delete_lock(ctx, fl, &dispose);
 				continue;
 			}
+			request->fl_start = fl->fl_start;
+			request->fl_end = fl->fl_end;
 			request = fl;
 			added = true;
 		} else {
@@ -1229,7 +1346,7 @@ static int posix_lock_inode(struct inode *inode, struct file_lock *request,
 				 * one (This may happen several times).
 				 */
 				if (added) {
-					locks_delete_lock_ctx(fl, &dispose);
+					posix_delete_lock(ctx, fl, &dispose);
 					continue;
 				}
 				/*
@@ -1246,8 +1363,8 @@ static int posix_lock_inode(struct inode *inode, struct file_lock *request,
 				locks_move_blocks(new_fl, request);
 				request = new_fl;
 				new_fl = NULL;
-				locks_insert_lock_ctx(request, &fl->fl_list);
-				locks_delete_lock_ctx(fl, &dispose);
+				posix_insert_lock(ctx, request, &fl->fl_list);
+				posix_delete_lock(ctx, fl, &dispose);
 				added = true;
 			}
 		}
@@ -1276,7 +1393,7 @@ static int posix_lock_inode(struct inode *inode, struct file_lock *request,
 		}
 		locks_copy_lock(new_fl, request);
 		locks_move_blocks(new_fl, request);
-		locks_insert_lock_ctx(new_fl, &fl->fl_list);
+		posix_insert_lock(ctx, new_fl, &fl->fl_list);
 		fl = new_fl;
 		new_fl = NULL;
 	}
@@ -1288,13 +1405,15 @@ static int posix_lock_inode(struct inode *inode, struct file_lock *request,
 			left = new_fl2;
 			new_fl2 = NULL;
 			locks_copy_lock(left, right);
-			locks_insert_lock_ctx(left, &fl->fl_list);
+			posix_insert_lock(ctx, left, &fl->fl_list);
 		}
-		right->fl_start = request->fl_end + 1;
+		posix_lock_set_range(ctx, right, request->fl_end + 1,
+				     right->fl_end);
 		locks_wake_up_blocks(right);
 	}
 	if (left) {
-		left->fl_end = request->fl_start - 1;
+		posix_lock_set_range(ctx, left, left->fl_start,
+				     request->fl_start - 1);
 		locks_wake_up_blocks(left);
 	}
  out:
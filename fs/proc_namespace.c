@@ -57,6 +57,8 @@ static int show_sb_opts(struct seq_file *m, struct super_block *sb)
 		if (sb->s_flags & fs_infop->flag)
 			seq_puts(m, fs_infop->str);
 	}
+	if (sb->s_cache_budget)
+		seq_printf(m, ",cache_budget=%lu", sb->s_cache_budget);
 
 	return security_sb_show_options(m, sb);
 }
@@ -234,6 +236,16 @@ static int show_vfsstat(struct seq_file *m, struct vfsmount *mnt)
 		err = sb->s_op->show_stats(m, mnt_path.dentry);
 	}
 
+	/* dentry and inode cache of a budgeted superblock */
+	if (!err && sb->s_cache_budget)
+		seq_printf(m, "\n\tvfscache: dentries %lld inodes %ld unused %lu %lu bytes %lu budget %lu pruned %ld",
+			   percpu_counter_sum_positive(&sb->s_nr_dentry),
+			   READ_ONCE(sb->s_nr_inodes),
+			   list_lru_count(&sb->s_dentry_lru),
+			   list_lru_count(&sb->s_inode_lru),
+			   sb_cache_usage(sb), sb->s_cache_budget,
+			   atomic_long_read(&sb->s_cache_budget_pruned));
+
 	seq_putc(m, '\n');
 out:
 	return err;
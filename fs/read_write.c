@@ -20,6 +20,10 @@
 #include <linux/compat.h>
 #include <linux/mount.h>
 #include <linux/fs.h>
+#include <linux/fadvise.h>
+#include <linux/sched/signal.h>
+#include <linux/sizes.h>
+#include <linux/writeback.h>
 #include "internal.h"
 
 #include <linux/uaccess.h>
@@ -1363,6 +1367,18 @@ COMPAT_SYSCALL_DEFINE4(sendfile64, int, out_fd, int, in_fd,
 }
 #endif
 
+/*
+ * Copies larger than one chunk are pipelined: readahead for the next chunk
+ * is started before the current one is spliced, and every chunk written is
+ * handed to writeback right away, so that reads from the source and writes
+ * to the destination are in flight at the same time. Writeback of all but
+ * the last two chunks is waited for, which bounds the dirty data a single
+ * copy can build up. The copy stops early, returning a short count, when a
+ * signal is pending.
+ */
+#define COPY_CHUNK_SIZE		SZ_4M
+#define COPY_PIPE_SLOTS		(SZ_1M / PAGE_SIZE)
+
 /**
  * generic_copy_file_range - copy data between two files
  * @file_in:	file structure to read from
@@ -1388,10 +1404,57 @@ ssize_t generic_copy_file_range(struct file *file_in, loff_t pos_in,
 				struct file *file_out, loff_t pos_out,
 				size_t len, unsigned int flags)
 {
+	struct address_space *mapping = file_out->f_mapping;
+	loff_t wait_start = pos_out, prev_start = pos_out;
+	struct pipe_inode_info *pipe;
+	size_t copied = 0;
+	ssize_t ret = 0;
+
 	lockdep_assert(sb_write_started(file_inode(file_out)->i_sb));
 
-	return do_splice_direct(file_in, &pos_in, file_out, &pos_out,
-				len > MAX_RW_COUNT ? MAX_RW_COUNT : len, 0);
+	len = min_t(size_t, len, MAX_RW_COUNT);
+	if (len <= COPY_CHUNK_SIZE)
+		return do_splice_direct(file_in, &pos_in, file_out, &pos_out,
+					len, 0);
+
+	while (copied < len) {
+		size_t chunk = min_t(size_t, len - copied, COPY_CHUNK_SIZE);
+		loff_t chunk_start = pos_out;
+
+		if (copied && signal_pending(current))
+			break;
+
+		if (len - copied > chunk)
+			vfs_fadvise(file_in, pos_in + chunk,
+				    min_t(size_t, len - copied - chunk,
+					  COPY_CHUNK_SIZE),
+				    POSIX_FADV_WILLNEED);
+
+		ret = do_splice_direct(file_in, &pos_in, file_out, &pos_out,
+				       chunk, 0);
+		if (ret <= 0)
+			break;
+		copied += ret;
+
+		/* The task's splice pipe exists now, move more per splice */
+		pipe = current->splice_pipe;
+		if (pipe && pipe->ring_size < COPY_PIPE_SLOTS)
+			pipe_resize_ring(pipe, COPY_PIPE_SLOTS);
+
+		__filemap_fdatawrite_range(mapping, chunk_start, pos_out - 1,
+					   WB_SYNC_NONE);
+		if (prev_start > wait_start) {
+			filemap_fdatawait_range_keep_errors(mapping, wait_start,
+							    prev_start - 1);
+			wait_start = prev_start;
+		}
+		prev_start = chunk_start;
+
+		if (ret < chunk)
+			break;
+	}
+
+	return copied ? copied : ret;
 }
 EXPORT_SYMBOL(generic_copy_file_range);
 
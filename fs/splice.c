@@ -19,8 +19,10 @@
  *
  */
 #include <linux/bvec.h>
+#include <linux/dma-copy.h>
 #include <linux/fs.h>
 #include <linux/file.h>
+#include <linux/fsnotify.h>
 #include <linux/pagemap.h>
 #include <linux/splice.h>
 #include <linux/memcontrol.h>
@@ -597,23 +599,174 @@ ssize_t splice_from_pipe(struct pipe_inode_info *pipe, struct file *out,
 	return ret;
 }
 
-/**
- * iter_file_splice_write - splice data from a pipe to a file
- * @pipe:	pipe info
- * @out:	file to write to
- * @ppos:	position in @out
- * @len:	number of bytes to splice
- * @flags:	splice modifier flags
- *
- * Description:
- *    Will either move or copy pages (determined by @flags options) from
- *    the given pipe inode to the given file.
- *    This one is ->write_iter-based.
- *
+#ifdef CONFIG_DMA_COPY_OFFLOAD
+/*
+ * Large splices to a file written by generic_file_write_iter() copy the
+ * pipe pages into the page cache with dma_copy_sync() rather than through
+ * ->write_iter(). Since that is known to be generic_perform_write() under
+ * the inode lock, the same steps are done here around the copy, except that
+ * up to DMA_COPY_BATCH_MAX pages are prepared with ->write_begin(), in index
+ * order, before one batch copies all of them, so that the mapping and
+ * interrupt cost is paid once per batch rather than once per page.
  */
-ssize_t
-iter_file_splice_write(struct pipe_inode_info *pipe, struct file *out,
-			  loff_t *ppos, size_t len, unsigned int flags)
+static bool splice_offload_ok(struct file *out, size_t len)
+{
+	const struct address_space_operations *aops = out->f_mapping->a_ops;
+
+	return out->f_op->write_iter == generic_file_write_iter &&
+	       out->f_op->splice_write == iter_file_splice_write &&
+	       aops->write_begin && aops->write_end &&
+	       !(out->f_flags & (O_DIRECT | O_APPEND)) &&
+	       dma_copy_worthwhile(len);
+}
+
+static ssize_t splice_offload_write(struct file *out, struct iov_iter *from,
+				    loff_t *ppos)
+{
+	struct address_space *mapping = out->f_mapping;
+	const struct address_space_operations *aops = mapping->a_ops;
+	struct inode *inode = mapping->host;
+	const struct bio_vec *bvec = from->bvec;
+	struct dma_copy_batch batch;
+	size_t skip = 0, count;
+	ssize_t written = 0;
+	struct kiocb kiocb;
+	ssize_t ret;
+
+	ret = rw_verify_area(WRITE, out, ppos, iov_iter_count(from));
+	if (ret)
+		return ret;
+
+	init_sync_kiocb(&kiocb, out);
+	kiocb.ki_pos = *ppos;
+
+	inode_lock(inode);
+	ret = generic_write_checks(&kiocb, from);
+	if (ret <= 0)
+		goto out_unlock;
+	ret = file_modified(out);
+	if (ret)
+		goto out_unlock;
+
+	current->backing_dev_info = inode_to_bdi(inode);
+	count = iov_iter_count(from);
+	while (count) {
+		struct page *pages[DMA_COPY_BATCH_MAX];
+		void *fsdata[DMA_COPY_BATCH_MAX];
+		size_t lens[DMA_COPY_BATCH_MAX];
+		loff_t pos = kiocb.ki_pos;
+		size_t left = count;
+		bool begin_failed = false, stop = false;
+		unsigned int nr, i;
+		ssize_t copied;
+
+		if (fatal_signal_pending(current)) {
+			ret = -EINTR;
+			break;
+		}
+
+		dma_copy_batch_init(&batch);
+		for (nr = 0; nr < DMA_COPY_BATCH_MAX && left; nr++) {
+			unsigned int offset = offset_in_page(pos);
+			size_t bytes = min_t(size_t, PAGE_SIZE - offset, left);
+			size_t filled = 0;
+
+			fsdata[nr] = NULL;
+			ret = aops->write_begin(out, mapping, pos, bytes,
+						&pages[nr], &fsdata[nr]);
+			if (ret) {
+				begin_failed = true;
+				break;
+			}
+
+			while (filled < bytes) {
+				size_t src_off = bvec->bv_offset + skip;
+				struct page *src = nth_page(bvec->bv_page,
+							src_off >> PAGE_SHIFT);
+				size_t this_len = min3(bytes - filled,
+						(size_t)bvec->bv_len - skip,
+						(size_t)(PAGE_SIZE -
+							 offset_in_page(src_off)));
+
+				/* only if the source is very fragmented */
+				if (!dma_copy_batch_add(&batch, pages[nr],
+							offset + filled, src,
+							offset_in_page(src_off),
+							this_len)) {
+					dma_copy_sync(&batch);
+					dma_copy_batch_init(&batch);
+					continue;
+				}
+				filled += this_len;
+				skip += this_len;
+				if (skip == bvec->bv_len) {
+					bvec++;
+					skip = 0;
+				}
+			}
+			lens[nr] = bytes;
+			pos += bytes;
+			left -= bytes;
+		}
+		if (batch.nr)
+			dma_copy_sync(&batch);
+
+		/*
+		 * Every page that was begun must be ended. After a short or
+		 * failed one, the rest are ended with nothing copied.
+		 */
+		pos = kiocb.ki_pos;
+		for (i = 0; i < nr; i++) {
+			flush_dcache_page(pages[i]);
+			copied = aops->write_end(out, mapping, pos, lens[i],
+						 stop ? 0 : lens[i], pages[i],
+						 fsdata[i]);
+			pos += lens[i];
+			if (stop)
+				continue;
+			if (copied <= 0) {
+				ret = copied;
+				stop = true;
+				continue;
+			}
+			kiocb.ki_pos += copied;
+			written += copied;
+			count -= copied;
+			if (copied < lens[i])
+				stop = true;
+		}
+		balance_dirty_pages_ratelimited(mapping);
+		if (begin_failed || stop)
+			break;
+	}
+	current->backing_dev_info = NULL;
+out_unlock:
+	inode_unlock(inode);
+
+	if (written <= 0)
+		return ret;
+
+	*ppos = kiocb.ki_pos;
+	fsnotify_modify(out);
+	return generic_write_sync(&kiocb, written);
+}
+#else
+static inline bool splice_offload_ok(struct file *out, size_t len)
+{
+	return false;
+}
+
+static inline ssize_t splice_offload_write(struct file *out,
+					   struct iov_iter *from, loff_t *ppos)
+{
+	return -EOPNOTSUPP;
+}
+#endif
+
+static ssize_t __iter_file_splice_write(struct pipe_inode_info *pipe,
+					struct file *out, loff_t *ppos,
+					size_t len, unsigned int flags,
+					bool offload)
 {
 	struct splice_desc sd = {
 		.total_len = len,
@@ -683,7 +836,10 @@ iter_file_splice_write(struct pipe_inode_info *pipe, struct file *out,
 		}
 
 		iov_iter_bvec(&from, ITER_SOURCE, array, n, sd.total_len - left);
-		ret = vfs_iter_write(out, &from, &sd.pos, 0);
+		if (offload)
+			ret = splice_offload_write(out, &from, &sd.pos);
+		else
+			ret = vfs_iter_write(out, &from, &sd.pos, 0);
 		if (ret <= 0)
 			break;
 
@@ -722,6 +878,27 @@ iter_file_splice_write(struct pipe_inode_info *pipe, struct file *out,
 	return ret;
 }
 
+/**
+ * iter_file_splice_write - splice data from a pipe to a file
+ * @pipe:	pipe info
+ * @out:	file to write to
+ * @ppos:	position in @out
+ * @len:	number of bytes to splice
+ * @flags:	splice modifier flags
+ *
+ * Description:
+ *    Will either move or copy pages (determined by @flags options) from
+ *    the given pipe inode to the given file.
+ *    This one is ->write_iter-based.
+ *
+ */
+ssize_t
+iter_file_splice_write(struct pipe_inode_info *pipe, struct file *out,
+			  loff_t *ppos, size_t len, unsigned int flags)
+{
+	return __iter_file_splice_write(pipe, out, ppos, len, flags, false);
+}
+
 EXPORT_SYMBOL(iter_file_splice_write);
 
 /**
@@ -928,6 +1105,10 @@ static int direct_splice_actor(struct pipe_inode_info *pipe,
 {
 	struct file *file = sd->u.file;
 
+	if (splice_offload_ok(file, sd->total_len))
+		return __iter_file_splice_write(pipe, file, sd->opos,
+						sd->total_len, sd->flags, true);
+
 	return do_splice_from(pipe, file, sd->opos, sd->total_len,
 			      sd->flags);
 }
@@ -36,6 +36,7 @@
 #include <linux/lockdep.h>
 #include <linux/user_namespace.h>
 #include <linux/fs_context.h>
+#include <linux/memcontrol.h>
 #include <uapi/linux/mount.h>
 #include "internal.h"
 
@@ -153,6 +154,109 @@ static unsigned long super_cache_count(struct shrinker *shrink,
 	return total_objects;
 }
 
+/**
+ * sb_cache_usage - approximate memory used by the VFS caches of a superblock
+ * @sb: superblock to measure
+ *
+ * Counts every dentry and inode of @sb, in use or not, at the size of the
+ * VFS structures. Filesystem-private inode data and external names are not
+ * included, so this is a lower bound meant for budgeting, not accounting.
+ */
+unsigned long sb_cache_usage(struct super_block *sb)
+{
+	return percpu_counter_read_positive(&sb->s_nr_dentry) *
+			sizeof(struct dentry) +
+	       max(READ_ONCE(sb->s_nr_inodes), 0L) * sizeof(struct inode);
+}
+
+void __sb_cache_budget_check(struct super_block *sb)
+{
+	if (work_pending(&sb->s_cache_budget_work))
+		return;
+	if (sb_cache_usage(sb) <= READ_ONCE(sb->s_cache_budget))
+		return;
+	if (!list_lru_count(&sb->s_dentry_lru) &&
+	    !list_lru_count(&sb->s_inode_lru))
+		return;
+	queue_work(system_unbound_wq, &sb->s_cache_budget_work);
+}
+
+/*
+ * Bring the dentry and inode caches of a superblock back under its budget,
+ * with some slack so that we don't run again on the next allocation. Unused
+ * objects are taken from every memcg and node LRU in proportion to their
+ * share of the excess, through the same isolate callbacks the shrinker uses,
+ * so referenced entries still get another trip around the LRU.
+ */
+static void super_cache_budget_work(struct work_struct *work)
+{
+	struct super_block *sb = container_of(work, struct super_block,
+					      s_cache_budget_work);
+	struct shrink_control sc = { .gfp_mask = GFP_KERNEL };
+	unsigned long budget, usage, target, unused, ratio;
+	struct mem_cgroup *memcg;
+	long freed;
+	int pass, nid;
+
+	if (!trylock_super(sb))
+		return;
+
+	for (pass = 0; pass < 4; pass++) {
+		budget = READ_ONCE(sb->s_cache_budget);
+		usage = sb_cache_usage(sb);
+		if (!budget || usage <= budget)
+			break;
+
+		unused = list_lru_count(&sb->s_dentry_lru) *
+				sizeof(struct dentry) +
+			 list_lru_count(&sb->s_inode_lru) *
+				sizeof(struct inode);
+		if (!unused)
+			break;
+		target = budget - budget / 8;
+		ratio = mult_frac(min(usage - target, unused), 1024UL, unused);
+
+		freed = 0;
+		memcg = mem_cgroup_iter(NULL, NULL, NULL);
+		do {
+			sc.memcg = memcg;
+			for_each_online_node(nid) {
+				sc.nid = nid;
+				/* dentries first, they pin the inodes */
+				sc.nr_to_scan = mult_frac(list_lru_shrink_count(
+						&sb->s_dentry_lru, &sc),
+						ratio, 1024UL) + 1;
+				freed += prune_dcache_sb(sb, &sc);
+				sc.nr_to_scan = mult_frac(list_lru_shrink_count(
+						&sb->s_inode_lru, &sc),
+						ratio, 1024UL) + 1;
+				freed += prune_icache_sb(sb, &sc);
+			}
+			cond_resched();
+		} while ((memcg = mem_cgroup_iter(NULL, memcg, NULL)) != NULL);
+
+		atomic_long_add(freed, &sb->s_cache_budget_pruned);
+		if (!freed)
+			break;
+	}
+
+	up_read(&sb->s_umount);
+}
+
+/**
+ * sb_set_cache_budget - set the dentry and inode cache budget of a superblock
+ * @sb: superblock to limit
+ * @budget: limit in bytes as measured by sb_cache_usage(), 0 for none
+ *
+ * The caller must hold @sb->s_umount for writing. Lowering the budget below
+ * the current usage prunes the caches asynchronously.
+ */
+void sb_set_cache_budget(struct super_block *sb, unsigned long budget)
+{
+	WRITE_ONCE(sb->s_cache_budget, budget);
+	sb_cache_budget_check(sb);
+}
+
 static void destroy_super_work(struct work_struct *work)
 {
 	struct super_block *s = container_of(work, struct super_block,
@@ -161,6 +265,7 @@ static void destroy_super_work(struct work_struct *work)
 
 	for (i = 0; i < SB_FREEZE_LEVELS; i++)
 		percpu_free_rwsem(&s->s_writers.rw_sem[i]);
+	percpu_counter_destroy(&s->s_nr_dentry);
 	kfree(s);
 }
 
@@ -248,6 +353,9 @@ static struct super_block *alloc_super(struct file_system_type *type, int flags,
 	spin_lock_init(&s->s_inode_list_lock);
 	INIT_LIST_HEAD(&s->s_inodes_wb);
 	spin_lock_init(&s->s_inode_wblist_lock);
+	if (percpu_counter_init(&s->s_nr_dentry, 0, GFP_USER))
+		goto fail;
+	INIT_WORK(&s->s_cache_budget_work, super_cache_budget_work);
 
 	s->s_count = 1;
 	atomic_set(&s->s_active, 1);
@@ -329,7 +437,10 @@ void deactivate_locked_super(struct super_block *s)
 	struct file_system_type *fs = s->s_type;
 	if (atomic_dec_and_test(&s->s_active)) {
 		unregister_shrinker(&s->s_shrink);
+		WRITE_ONCE(s->s_cache_budget, 0);
 		fs->kill_sb(s);
+		/* nothing can queue it any more, the caches are empty */
+		cancel_work_sync(&s->s_cache_budget_work);
 
 		/*
 		 * Since list_lru_destroy() may sleep, we cannot call it from
@@ -947,6 +1058,8 @@ int reconfigure_super(struct fs_context *fc)
 	/* Needs to be ordered wrt mnt_is_readonly() */
 	smp_wmb();
 	sb->s_readonly_remount = 0;
+	if (fc->cache_budget_set)
+		sb_set_cache_budget(sb, fc->cache_budget);
 
 	/*
 	 * Some filesystems modify their metadata via some other path than the
@@ -1526,6 +1639,8 @@ int vfs_get_tree(struct fs_context *fc)
 	WARN((sb->s_maxbytes < 0), "%s set sb->s_maxbytes to "
 		"negative value (%lld)\n", fc->fs_type->name, sb->s_maxbytes);
 
+	if (fc->cache_budget_set)
+		sb_set_cache_budget(sb, fc->cache_budget);
 	return 0;
 }
 EXPORT_SYMBOL(vfs_get_tree);
@@ -466,6 +466,11 @@ struct request_queue {
 	struct kobject *crypto_kobject;
 #endif
 
+#ifdef CONFIG_PSI
+	/* IO pressure of the tasks waiting on this queue */
+	struct psi_group	*psi;
+#endif
+
 	unsigned int		rq_timeout;
 	int			poll_nsec;
 
@@ -0,0 +1,60 @@
+/* SPDX-License-Identifier: GPL-2.0 */
+/*
+ * BPF programmable I/O scheduler (struct_ops based elevator).
+ */
+#ifndef _LINUX_BPF_IOSCHED_H
+#define _LINUX_BPF_IOSCHED_H
+
+#include <linux/types.h>
+#include <linux/list.h>
+
+#define BPF_IOSCHED_NAME_MAX	16
+
+/*
+ * Read-only view of a request handed to the BPF policy. @id is an opaque
+ * cookie that the policy returns from ->dispatch() to select the request.
+ * It stays valid until the request is dispatched, merged into another
+ * request or the policy is detached from the queue.
+ */
+struct bpf_iosched_rq {
+	u64	id;
+	u64	sector;
+	u32	nr_sectors;
+	u32	opf;		/* REQ_OP_* and REQ_* flags */
+	u32	dev;		/* disk_devt() of the queue */
+	u16	ioprio;
+	u16	hctx;
+	u64	start_time_ns;	/* allocation time, ktime_get_ns() */
+};
+
+/* Read-only view of the queue passed to ->dispatch(). */
+struct bpf_iosched_queue {
+	u32	dev;
+	u32	hctx;		/* hardware queue asking for work */
+	u32	nr_queued;	/* requests currently owned by the policy */
+	u32	nr_busy;	/* requests dispatched but not completed */
+};
+
+struct bpf_iosched_ops {
+	/*
+	 * A request has been handed to the scheduler. Return 0 to take
+	 * ownership of it, or a negative value to leave it to the built-in
+	 * FIFO.
+	 */
+	int (*insert)(const struct bpf_iosched_rq *rq);
+	/*
+	 * Return the id of the next request to dispatch, or 0 to let the
+	 * built-in FIFO pick one. Ids that do not (or no longer) designate a
+	 * request queued on @q are counted as errors.
+	 */
+	u64 (*dispatch)(const struct bpf_iosched_queue *q);
+	/* optional: a request owned by the policy completed at @now_ns */
+	void (*completed)(const struct bpf_iosched_rq *rq, u64 now_ns);
+
+	char name[BPF_IOSCHED_NAME_MAX];
+
+	/* managed by the kernel */
+	struct list_head list;
+};
+
+#endif /* _LINUX_BPF_IOSCHED_H */
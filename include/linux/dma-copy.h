@@ -0,0 +1,110 @@
+/* SPDX-License-Identifier: GPL-2.0 */
+/*
+ * Offload of bulk page-to-page copies to a DMA_MEMCPY capable channel.
+ *
+ * Users collect the copies of one operation in a struct dma_copy_batch and
+ * hand it to dma_copy_submit() or dma_copy_sync(). Whether the batch runs
+ * on a DMA channel or on the CPU is up to the service; either way all of
+ * it has been copied when the completion callback runs or dma_copy_sync()
+ * returns.
+ */
+#ifndef _LINUX_DMA_COPY_H
+#define _LINUX_DMA_COPY_H
+
+#include <linux/highmem.h>
+#include <linux/types.h>
+
+#define DMA_COPY_BATCH_MAX	16
+
+struct dma_chan;
+
+struct dma_copy_batch {
+	unsigned int		nr;
+	size_t			bytes;
+	struct dma_copy_ent {
+		struct page	*dst;
+		struct page	*src;
+		unsigned int	dst_off;
+		unsigned int	src_off;
+		unsigned int	len;
+	} ent[DMA_COPY_BATCH_MAX];
+};
+
+typedef void (*dma_copy_done_t)(void *param);
+
+static inline void dma_copy_batch_init(struct dma_copy_batch *batch)
+{
+	batch->nr = 0;
+	batch->bytes = 0;
+}
+
+/*
+ * Add a copy that stays within both pages. Returns false if the batch is
+ * full, in which case it must be submitted before adding more.
+ */
+static inline bool dma_copy_batch_add(struct dma_copy_batch *batch,
+				      struct page *dst, unsigned int dst_off,
+				      struct page *src, unsigned int src_off,
+				      unsigned int len)
+{
+	struct dma_copy_ent *ent;
+
+	if (batch->nr == DMA_COPY_BATCH_MAX)
+		return false;
+
+	ent = &batch->ent[batch->nr++];
+	ent->dst = dst;
+	ent->dst_off = dst_off;
+	ent->src = src;
+	ent->src_off = src_off;
+	ent->len = len;
+	batch->bytes += len;
+	return true;
+}
+
+static inline void dma_copy_cpu(const struct dma_copy_batch *batch)
+{
+	unsigned int i;
+
+	for (i = 0; i < batch->nr; i++)
+		memcpy_page(batch->ent[i].dst, batch->ent[i].dst_off,
+			    batch->ent[i].src, batch->ent[i].src_off,
+			    batch->ent[i].len);
+}
+
+#ifdef CONFIG_DMA_COPY_OFFLOAD
+bool dma_copy_worthwhile(size_t len);
+void dma_copy_submit(const struct dma_copy_batch *batch,
+		     dma_copy_done_t done, void *param);
+void dma_copy_sync(const struct dma_copy_batch *batch);
+void dma_copy_submit_chan(struct dma_chan *chan,
+			  const struct dma_copy_batch *batch,
+			  dma_copy_done_t done, void *param);
+#else
+static inline bool dma_copy_worthwhile(size_t len)
+{
+	return false;
+}
+
+static inline void dma_copy_submit(const struct dma_copy_batch *batch,
+				   dma_copy_done_t done, void *param)
+{
+	dma_copy_cpu(batch);
+	done(param);
+}
+
+static inline void dma_copy_sync(const struct dma_copy_batch *batch)
+{
+	dma_copy_cpu(batch);
+}
+
+static inline void dma_copy_submit_chan(struct dma_chan *chan,
+					const struct dma_copy_batch *batch,
+					dma_copy_done_t done, void *param)
+{
+	dma_copy_cpu(batch);
+	done(param);
+}
+#endif
+
+#endif /* _LINUX_DMA_COPY_H */
@@ -1103,6 +1103,9 @@ struct file_lock {
 	struct file *fl_file;
 	loff_t fl_start;
 	loff_t fl_end;
+	struct rb_node fl_range_node;	/* POSIX locks by range */
+	loff_t fl_range_last;		/* highest fl_end in the subtree */
+	struct rb_node fl_owner_node;	/* POSIX locks by owner and start */
 
 	struct fasync_struct *	fl_fasync; /* for lease break notifications */
 	/* for lease breaks: */
@@ -1130,6 +1133,9 @@ struct file_lock_context {
 	struct list_head	flc_flock;
 	struct list_head	flc_posix;
 	struct list_head	flc_lease;
+	/* indexes of flc_posix, see posix_lock_inode() */
+	struct rb_root_cached	flc_posix_ranges;
+	struct rb_root		flc_posix_owners;
 };
 
 /* The following constant reflects the upper bound of the file/locking space */
@@ -1602,6 +1608,17 @@ struct super_block {
 
 	spinlock_t		s_inode_wblist_lock;
 	struct list_head	s_inodes_wb;	/* writeback inodes */
+
+	/*
+	 * Optional limit on the dentry and inode cache of this sb, in bytes;
+	 * 0 leaves it to the global shrinkers. s_nr_inodes is protected by
+	 * s_inode_list_lock.
+	 */
+	unsigned long		s_cache_budget;
+	long			s_nr_inodes;
+	struct percpu_counter	s_nr_dentry;
+	atomic_long_t		s_cache_budget_pruned;
+	struct work_struct	s_cache_budget_work;
 } __randomize_layout;
 
 static inline struct user_namespace *i_user_ns(const struct inode *inode)
@@ -465,10 +465,21 @@ static inline void *led_get_trigger_data(struct led_classdev *led_cdev)
 #endif /* CONFIG_LEDS_TRIGGERS */
 
 /* Trigger specific functions */
+struct ledtrig_disk;
 #ifdef CONFIG_LEDS_TRIGGER_DISK
 void ledtrig_disk_activity(bool write);
+void ledtrig_disk_count(struct ledtrig_disk *disk, bool write);
+struct ledtrig_disk *ledtrig_disk_register(const char *name);
+void ledtrig_disk_unregister(struct ledtrig_disk *disk);
 #else
 static inline void ledtrig_disk_activity(bool write) {}
+static inline void ledtrig_disk_count(struct ledtrig_disk *disk,
+				      bool write) {}
+static inline struct ledtrig_disk *ledtrig_disk_register(const char *name)
+{
+	return NULL;
+}
+static inline void ledtrig_disk_unregister(struct ledtrig_disk *disk) {}
 #endif
 
 #ifdef CONFIG_LEDS_TRIGGER_MTD
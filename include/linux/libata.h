@@ -851,6 +851,8 @@ struct ata_port {
 
 	async_cookie_t		cookie;
 
+	struct ledtrig_disk	*ledtrig;	/* "ata<print_id>" LED trigger */
+
 	int			em_message_type;
 	void			*private_data;
 
@@ -367,6 +367,10 @@ struct napi_struct {
 	struct hlist_node	napi_hash_node;
 	unsigned int		napi_id;
 	struct task_struct	*thread;
+	/* threaded mode, see net/core/napi_placement.c */
+	int			irq_cpu;	/* last CPU to wake the thread */
+	u64			poll_ns;	/* time spent polling by the thread */
+	u64			poll_ns_seen;
 };
 
 enum {
@@ -30,6 +30,30 @@ void psi_trigger_destroy(struct psi_trigger *t);
 __poll_t psi_trigger_poll(void **trigger_ptr, struct file *file,
 			poll_table *wait);
 
+struct psi_group *psi_group_alloc(void);
+void psi_group_free(struct psi_group *group);
+
+/**
+ * psi_iodev_enter - attribute the caller's IO waits to a device group
+ * @group: pressure group of the device being waited on, may be NULL
+ *
+ * Until the matching psi_iodev_leave(), any iowait sleep of the calling
+ * task is accounted to @group in addition to the task's own groups.
+ * Returns the previous group, which must be passed to psi_iodev_leave().
+ */
+static inline struct psi_group *psi_iodev_enter(struct psi_group *group)
+{
+	struct psi_group *prev = current->psi_iodev;
+
+	current->psi_iodev = group;
+	return prev;
+}
+
+static inline void psi_iodev_leave(struct psi_group *prev)
+{
+	current->psi_iodev = prev;
+}
+
 #ifdef CONFIG_CGROUPS
 static inline struct psi_group *cgroup_psi(struct cgroup *cgrp)
 {
@@ -49,6 +73,12 @@ static inline void psi_init(void) {}
 static inline void psi_memstall_enter(unsigned long *flags) {}
 static inline void psi_memstall_leave(unsigned long *flags) {}
 
+static inline struct psi_group *psi_iodev_enter(struct psi_group *group)
+{
+	return NULL;
+}
+static inline void psi_iodev_leave(struct psi_group *prev) {}
+
 #ifdef CONFIG_CGROUPS
 static inline int psi_cgroup_alloc(struct cgroup *cgrp)
 {
@@ -195,11 +195,16 @@ void *ring_buffer_alloc_read_page(struct trace_buffer *buffer, int cpu);
 void ring_buffer_free_read_page(struct trace_buffer *buffer, int cpu, void *data);
 int ring_buffer_read_page(struct trace_buffer *buffer, void **data_page,
 			  size_t len, int cpu, int full);
+size_t ring_buffer_read_page_size(struct trace_buffer *buffer);
+
+int ring_buffer_subbuf_size_get(struct trace_buffer *buffer);
+int ring_buffer_subbuf_size_set(struct trace_buffer *buffer, unsigned int size);
 
 struct trace_seq;
 
 int ring_buffer_print_entry_header(struct trace_seq *s);
-int ring_buffer_print_page_header(struct trace_seq *s);
+int ring_buffer_print_page_header(struct trace_buffer *buffer,
+				  struct trace_seq *s);
 
 enum ring_buffer_flags {
 	RB_FL_OVERWRITE		= 1 << 0,
@@ -57,6 +57,7 @@ struct nsproxy;
 struct perf_event_context;
 struct pid_namespace;
 struct pipe_inode_info;
+struct psi_group;
 struct rcu_node;
 struct reclaim_state;
 struct robust_list_head;
@@ -1199,6 +1200,8 @@ struct task_struct {
 #ifdef CONFIG_PSI
 	/* Pressure stall state */
 	unsigned int			psi_flags;
+	/* Device group charged for iowait, see psi_iodev_enter() */
+	struct psi_group		*psi_iodev;
 #endif
 #ifdef CONFIG_TASK_XACCT
 	/* Accumulated RSS usage: */
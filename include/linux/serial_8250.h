@@ -92,6 +92,16 @@ struct uart_8250_em485 {
  * dependent on the 8250 driver.
  */
 
+/* Console write statistics, protected by the port lock */
+struct uart_8250_cons_stats {
+	u64			writes;		/* console_write() calls */
+	u64			time_ns;	/* time spent in console_write() */
+	u64			max_ns;		/* longest console_write() */
+	u64			buffered;	/* chars queued for the TX irq */
+	u64			sync;		/* chars written by polling */
+	u64			overflows;	/* writes that waited for space */
+};
+
 struct uart_8250_port {
 	struct uart_port	port;
 	struct timer_list	timer;		/* "no irq" timer */
@@ -139,6 +149,13 @@ struct uart_8250_port {
 	/* Serial port overrun backoff */
 	struct delayed_work overrun_backoff;
 	u32 overrun_backoff_time_ms;
+
+#ifdef CONFIG_SERIAL_8250_CONSOLE
+	struct uart_8250_cons_stats cons_stats;
+#endif
+#ifdef CONFIG_SERIAL_8250_CONSOLE_BUFFERED
+	struct circ_buf		cons_xmit;	/* console output for the TX irq */
+#endif
 };
 
 static inline struct uart_8250_port *up_to_u8250p(struct uart_port *up)
@@ -29,6 +29,7 @@ struct usbnet {
 	unsigned char		pkt_cnt, pkt_err;
 	unsigned short		rx_qlen, tx_qlen;
 	unsigned		can_dma_sg:1;
+	unsigned int		tx_bql_pending;	/* BQL bytes not in an urb yet */
 
 	/* i/o info: pipes etc */
 	unsigned		in, out;
@@ -227,6 +228,7 @@ struct skb_data {	/* skb->cb is one of these */
 	struct urb		*urb;
 	struct usbnet		*dev;
 	enum skb_state		state;
+	unsigned int		bql_bytes;	/* charged to BQL by this urb */
 	long			length;
 	unsigned long		packets;
 };
@@ -78,6 +78,10 @@ struct xdp_sock {
 #ifdef CONFIG_XDP_SOCKETS
 
 int xsk_generic_rcv(struct xdp_sock *xs, struct xdp_buff *xdp);
+int xsk_generic_redirect(struct xdp_sock *xs, struct xdp_buff *xdp,
+			 struct sk_buff *skb);
+void xsk_generic_batch_begin(void);
+void xsk_generic_batch_end(void);
 int __xsk_map_redirect(struct xdp_sock *xs, struct xdp_buff *xdp);
 void __xsk_map_flush(void);
 
@@ -88,6 +92,21 @@ static inline int xsk_generic_rcv(struct xdp_sock *xs, struct xdp_buff *xdp)
 	return -ENOTSUPP;
 }
 
+static inline int xsk_generic_redirect(struct xdp_sock *xs,
+				       struct xdp_buff *xdp,
+				       struct sk_buff *skb)
+{
+	return -ENOTSUPP;
+}
+
+static inline void xsk_generic_batch_begin(void)
+{
+}
+
+static inline void xsk_generic_batch_end(void)
+{
+}
+
 static inline int __xsk_map_redirect(struct xdp_sock *xs, struct xdp_buff *xdp)
 {
 	return -EOPNOTSUPP;
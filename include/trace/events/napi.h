@@ -36,6 +36,38 @@ TRACE_EVENT(napi_poll,
 		  __entry->work, __entry->budget)
 );
 
+TRACE_EVENT(napi_thread_placement,
+
+	TP_PROTO(const char *dev_name, unsigned int napi_id, int irq_cpu,
+		 int consumer_cpu, int cpu, const struct cpumask *allowed),
+
+	TP_ARGS(dev_name, napi_id, irq_cpu, consumer_cpu, cpu, allowed),
+
+	TP_STRUCT__entry(
+		__string(	dev_name,	dev_name)
+		__field(	unsigned int,	napi_id)
+		__field(	int,		irq_cpu)
+		__field(	int,		consumer_cpu)
+		__field(	int,		cpu)
+		__bitmask(	allowed,	num_possible_cpus())
+	),
+
+	TP_fast_assign(
+		__assign_str(dev_name, dev_name);
+		__entry->napi_id = napi_id;
+		__entry->irq_cpu = irq_cpu;
+		__entry->consumer_cpu = consumer_cpu;
+		__entry->cpu = cpu;
+		__assign_bitmask(allowed, cpumask_bits(allowed),
+				 num_possible_cpus());
+	),
+
+	TP_printk("napi thread for device %s napi_id %u irq_cpu %d consumer_cpu %d preferred cpu %d allowed %s",
+		  __get_str(dev_name), __entry->napi_id, __entry->irq_cpu,
+		  __entry->consumer_cpu, __entry->cpu,
+		  __get_bitmask(allowed))
+);
+
 #undef NO_DEV
 
 #endif /* _TRACE_NAPI_H */
@@ -924,6 +924,8 @@ enum {
 
 	TCA_FQ_HORIZON_DROP,	/* drop packets beyond horizon, or cap their EDT */
 
+	TCA_FQ_TIMER_WHEEL,	/* timer wheel and hashed flow table, set at creation */
+
 	__TCA_FQ_MAX
 };
 
@@ -9,4 +9,8 @@ BPF_STRUCT_OPS_TYPE(bpf_dummy_ops)
 #include <net/tcp.h>
 BPF_STRUCT_OPS_TYPE(tcp_congestion_ops)
 #endif
+#ifdef CONFIG_BPF_IOSCHED
+#include <linux/bpf_iosched.h>
+BPF_STRUCT_OPS_TYPE(bpf_iosched_ops)
+#endif
 #endif
@@ -2179,6 +2179,7 @@ static __latent_entropy struct task_struct *copy_process(
 
 #ifdef CONFIG_PSI
 	p->psi_flags = 0;
+	p->psi_iodev = NULL;
 #endif
 
 	task_io_accounting_init(&p->ioac);
@@ -867,6 +867,27 @@ static inline struct psi_group *task_psi_group(struct task_struct *task)
 	return &psi_system;
 }
 
+/*
+ * Device groups only track the iowait of the tasks that are inside a
+ * psi_iodev_enter() section. The task cannot change its device group
+ * while it has TSK_IOWAIT set, as that only happens while it is off
+ * the CPU, so the set and the clear always hit the same group.
+ */
+static inline void psi_iodev_change(struct task_struct *task, int cpu,
+				    unsigned int clear, unsigned int set,
+				    u64 now, bool wake_clock)
+{
+	struct psi_group *group = task->psi_iodev;
+
+	if (likely(!group))
+		return;
+
+	clear &= TSK_IOWAIT;
+	set &= TSK_IOWAIT;
+	if (clear | set)
+		psi_group_change(group, cpu, clear, set, now, wake_clock);
+}
+
 static void psi_flags_change(struct task_struct *task, int clear, int set)
 {
 	if (((task->psi_flags & set) ||
@@ -899,6 +920,8 @@ void psi_task_change(struct task_struct *task, int clear, int set)
 	do {
 		psi_group_change(group, cpu, clear, set, now, true);
 	} while ((group = group->parent));
+
+	psi_iodev_change(task, cpu, clear, set, now, true);
 }
 
 void psi_task_switch(struct task_struct *prev, struct task_struct *next,
@@ -975,6 +998,8 @@ void psi_task_switch(struct task_struct *prev, struct task_struct *next,
 			for (; group; group = group->parent)
 				psi_group_change(group, cpu, clear, set, now, wake_clock);
 		}
+
+		psi_iodev_change(prev, cpu, 0, set, now, wake_clock);
 	}
 }
 
@@ -1073,6 +1098,50 @@ void psi_memstall_leave(unsigned long *flags)
 }
 EXPORT_SYMBOL_GPL(psi_memstall_leave);
 
+/**
+ * psi_group_alloc - allocate a standalone pressure group
+ *
+ * The group is not part of the cgroup hierarchy. Tasks are charged to it
+ * only through psi_iodev_enter(), so it reports the IO pressure caused by
+ * a single device. Its "full" state equals "some", as the group never
+ * sees the running tasks that would tell the two apart.
+ *
+ * Returns NULL when PSI is disabled, or an ERR_PTR() on failure.
+ */
+struct psi_group *psi_group_alloc(void)
+{
+	struct psi_group *group;
+
+	if (static_branch_likely(&psi_disabled))
+		return NULL;
+
+	group = kzalloc(sizeof(*group), GFP_KERNEL);
+	if (!group)
+		return ERR_PTR(-ENOMEM);
+
+	group->pcpu = alloc_percpu(struct psi_group_cpu);
+	if (!group->pcpu) {
+		kfree(group);
+		return ERR_PTR(-ENOMEM);
+	}
+	group_init(group);
+	return group;
+}
+EXPORT_SYMBOL_GPL(psi_group_alloc);
+
+void psi_group_free(struct psi_group *group)
+{
+	if (!group)
+		return;
+
+	cancel_delayed_work_sync(&group->avgs_work);
+	free_percpu(group->pcpu);
+	/* All triggers must be removed by now */
+	WARN_ONCE(group->poll_states, "psi: trigger leak\n");
+	kfree(group);
+}
+EXPORT_SYMBOL_GPL(psi_group_free);
+
 #ifdef CONFIG_CGROUPS
 int psi_cgroup_alloc(struct cgroup *cgroup)
 {
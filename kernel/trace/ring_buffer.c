@@ -23,6 +23,7 @@
 #include <linux/slab.h>
 #include <linux/init.h>
 #include <linux/hash.h>
+#include <linux/log2.h>
 #include <linux/list.h>
 #include <linux/cpu.h>
 #include <linux/oom.h>
@@ -331,6 +332,7 @@ struct buffer_page {
 	unsigned	 read;		/* index for next read */
 	local_t		 entries;	/* entries on this page */
 	unsigned long	 real_end;	/* real end of data */
+	unsigned	 shift;		/* log2 size of the data page */
 	struct buffer_data_page *page;	/* Actual data page */
 };
 
@@ -354,13 +356,42 @@ static void rb_init_page(struct buffer_data_page *bpage)
 	local_set(&bpage->commit, 0);
 }
 
+/*
+ * Data pages are 1 << shift bytes. Sub-page sizes come from kmalloc, which
+ * returns naturally aligned objects for power of two sizes, so masking an
+ * address inside the data page still finds its start. Larger sizes are
+ * high order pages.
+ */
+static struct buffer_data_page *
+rb_alloc_data_page(int cpu, unsigned int shift, gfp_t gfp)
+{
+	struct page *page;
+
+	if (shift < PAGE_SHIFT)
+		return kmalloc_node(1 << shift, gfp, cpu_to_node(cpu));
+
+	page = alloc_pages_node(cpu_to_node(cpu), gfp | __GFP_COMP,
+				shift - PAGE_SHIFT);
+	if (!page)
+		return NULL;
+	return page_address(page);
+}
+
+static void rb_free_data_page(void *data, unsigned int shift)
+{
+	if (shift < PAGE_SHIFT)
+		kfree(data);
+	else
+		free_pages((unsigned long)data, shift - PAGE_SHIFT);
+}
+
 /*
  * Also stolen from mm/slob.c. Thanks to Mathieu Desnoyers for pointing
  * this issue out.
  */
 static void free_buffer_page(struct buffer_page *bpage)
 {
-	free_page((unsigned long)bpage->page);
+	rb_free_data_page(bpage->page, bpage->shift);
 	kfree(bpage);
 }
 
@@ -374,12 +405,20 @@ static inline int test_time_stamp(u64 delta)
 	return 0;
 }
 
-#define BUF_PAGE_SIZE (PAGE_SIZE - BUF_PAGE_HDR_SIZE)
+/*
+ * The sub-buffer (data page) size is selectable per buffer, from 1K up to
+ * 64K. The write index of a page is a 20 bit counter (RB_WRITE_MASK) that
+ * may run past the end of the page by at most one event, which bounds the
+ * upper limit.
+ */
+#define RB_SUBBUF_SHIFT_MIN	10
+#define RB_SUBBUF_SHIFT_MAX	16
 
-/* Max payload is BUF_PAGE_SIZE - header (8bytes) */
-#define BUF_MAX_DATA_SIZE (BUF_PAGE_SIZE - (sizeof(u32) * 2))
+/* Max payload is the sub-buffer size - header (8bytes) */
+#define RB_MAX_DATA_SIZE(subbuf_size)	((subbuf_size) - (sizeof(u32) * 2))
 
-int ring_buffer_print_page_header(struct trace_seq *s)
+int ring_buffer_print_page_header(struct trace_buffer *buffer,
+				  struct trace_seq *s)
 {
 	struct buffer_data_page field;
 
@@ -403,7 +442,7 @@ int ring_buffer_print_page_header(struct trace_seq *s)
 	trace_seq_printf(s, "\tfield: char data;\t"
 			 "offset:%u;\tsize:%u;\tsigned:%u;\n",
 			 (unsigned int)offsetof(typeof(field), data),
-			 (unsigned int)BUF_PAGE_SIZE,
+			 buffer->subbuf_size,
 			 (unsigned int)is_signed_type(char));
 
 	return !trace_seq_has_overflowed(s);
@@ -555,6 +594,10 @@ struct trace_buffer {
 
 	struct rb_irq_work		irq_work;
 	bool				time_stamp_abs;
+
+	unsigned int			subbuf_shift;	/* log2 of the data page size */
+	unsigned int			subbuf_size;	/* usable bytes per data page */
+	unsigned int			max_data_size;	/* largest event payload */
 };
 
 struct ring_buffer_iter {
@@ -1636,7 +1679,7 @@ static int rb_check_pages(struct ring_buffer_per_cpu *cpu_buffer)
 }
 
 static int __rb_allocate_pages(struct ring_buffer_per_cpu *cpu_buffer,
-		long nr_pages, struct list_head *pages)
+		long nr_pages, unsigned int shift, struct list_head *pages)
 {
 	struct buffer_page *bpage, *tmp;
 	bool user_thread = current->mm != NULL;
@@ -1651,6 +1694,8 @@ static int __rb_allocate_pages(struct ring_buffer_per_cpu *cpu_buffer,
 	 * not going to succeed.
 	 */
 	i = si_mem_available();
+	if (shift > PAGE_SHIFT)
+		i >>= shift - PAGE_SHIFT;
 	if (i < nr_pages)
 		return -ENOMEM;
 
@@ -1673,8 +1718,6 @@ static int __rb_allocate_pages(struct ring_buffer_per_cpu *cpu_buffer,
 	if (user_thread)
 		set_current_oom_origin();
 	for (i = 0; i < nr_pages; i++) {
-		struct page *page;
-
 		bpage = kzalloc_node(ALIGN(sizeof(*bpage), cache_line_size()),
 				    mflags, cpu_to_node(cpu_buffer->cpu));
 		if (!bpage)
@@ -1684,10 +1727,10 @@ static int __rb_allocate_pages(struct ring_buffer_per_cpu *cpu_buffer,
 
 		list_add(&bpage->list, pages);
 
-		page = alloc_pages_node(cpu_to_node(cpu_buffer->cpu), mflags, 0);
-		if (!page)
+		bpage->shift = shift;
+		bpage->page = rb_alloc_data_page(cpu_buffer->cpu, shift, mflags);
+		if (!bpage->page)
 			goto free_pages;
-		bpage->page = page_address(page);
 		rb_init_page(bpage->page);
 
 		if (user_thread && fatal_signal_pending(current))
@@ -1716,7 +1759,8 @@ static int rb_allocate_pages(struct ring_buffer_per_cpu *cpu_buffer,
 
 	WARN_ON(!nr_pages);
 
-	if (__rb_allocate_pages(cpu_buffer, nr_pages, &pages))
+	if (__rb_allocate_pages(cpu_buffer, nr_pages,
+				cpu_buffer->buffer->subbuf_shift, &pages))
 		return -ENOMEM;
 
 	/*
@@ -1739,7 +1783,6 @@ rb_allocate_cpu_buffer(struct trace_buffer *buffer, long nr_pages, int cpu)
 {
 	struct ring_buffer_per_cpu *cpu_buffer;
 	struct buffer_page *bpage;
-	struct page *page;
 	int ret;
 
 	cpu_buffer = kzalloc_node(ALIGN(sizeof(*cpu_buffer), cache_line_size()),
@@ -1766,10 +1809,10 @@ rb_allocate_cpu_buffer(struct trace_buffer *buffer, long nr_pages, int cpu)
 	rb_check_bpage(cpu_buffer, bpage);
 
 	cpu_buffer->reader_page = bpage;
-	page = alloc_pages_node(cpu_to_node(cpu), GFP_KERNEL, 0);
-	if (!page)
+	bpage->shift = buffer->subbuf_shift;
+	bpage->page = rb_alloc_data_page(cpu, bpage->shift, GFP_KERNEL);
+	if (!bpage->page)
 		goto fail_free_reader;
-	bpage->page = page_address(page);
 	rb_init_page(bpage->page);
 
 	INIT_LIST_HEAD(&cpu_buffer->reader_page->list);
@@ -1845,7 +1888,11 @@ struct trace_buffer *__ring_buffer_alloc(unsigned long size, unsigned flags,
 	if (!zalloc_cpumask_var(&buffer->cpumask, GFP_KERNEL))
 		goto fail_free_buffer;
 
-	nr_pages = DIV_ROUND_UP(size, BUF_PAGE_SIZE);
+	buffer->subbuf_shift = PAGE_SHIFT;
+	buffer->subbuf_size = PAGE_SIZE - BUF_PAGE_HDR_SIZE;
+	buffer->max_data_size = RB_MAX_DATA_SIZE(buffer->subbuf_size);
+
+	nr_pages = DIV_ROUND_UP(size, buffer->subbuf_size);
 	buffer->flags = flags;
 	buffer->clock = trace_clock_local;
 	buffer->reader_lock_key = key;
@@ -2039,7 +2086,8 @@ rb_remove_pages(struct ring_buffer_per_cpu *cpu_buffer, unsigned long nr_pages)
 			 * Increment overrun to account for the lost events.
 			 */
 			local_add(page_entries, &cpu_buffer->overrun);
-			local_sub(BUF_PAGE_SIZE, &cpu_buffer->entries_bytes);
+			local_sub(cpu_buffer->buffer->subbuf_size,
+				  &cpu_buffer->entries_bytes);
 			local_inc(&cpu_buffer->pages_lost);
 		}
 
@@ -2164,7 +2212,7 @@ static void update_pages_handler(struct work_struct *work)
  * @size: the new size.
  * @cpu_id: the cpu buffer to resize
  *
- * Minimum size is 2 * BUF_PAGE_SIZE.
+ * Minimum size is 2 * the sub-buffer size.
  *
  * Returns 0 on success and < 0 on failure.
  */
@@ -2186,16 +2234,15 @@ int ring_buffer_resize(struct trace_buffer *buffer, unsigned long size,
 	    !cpumask_test_cpu(cpu_id, buffer->cpumask))
 		return 0;
 
-	nr_pages = DIV_ROUND_UP(size, BUF_PAGE_SIZE);
+	/* prevent another thread from changing buffer sizes */
+	mutex_lock(&buffer->mutex);
+
+	nr_pages = DIV_ROUND_UP(size, buffer->subbuf_size);
 
 	/* we need a minimum of two pages */
 	if (nr_pages < 2)
 		nr_pages = 2;
 
-	/* prevent another thread from changing buffer sizes */
-	mutex_lock(&buffer->mutex);
-
-
 	if (cpu_id == RING_BUFFER_ALL_CPUS) {
 		/*
 		 * Don't succeed if resizing is disabled, as a reader might be
@@ -2227,6 +2274,7 @@ int ring_buffer_resize(struct trace_buffer *buffer, unsigned long size,
 			 */
 			INIT_LIST_HEAD(&cpu_buffer->new_pages);
 			if (__rb_allocate_pages(cpu_buffer, cpu_buffer->nr_pages_to_update,
+						buffer->subbuf_shift,
 						&cpu_buffer->new_pages)) {
 				/* not enough memory for new pages */
 				err = -ENOMEM;
@@ -2297,6 +2345,7 @@ int ring_buffer_resize(struct trace_buffer *buffer, unsigned long size,
 		INIT_LIST_HEAD(&cpu_buffer->new_pages);
 		if (cpu_buffer->nr_pages_to_update > 0 &&
 			__rb_allocate_pages(cpu_buffer, cpu_buffer->nr_pages_to_update,
+					    buffer->subbuf_shift,
 					    &cpu_buffer->new_pages)) {
 			err = -ENOMEM;
 			goto out_err;
@@ -2429,7 +2478,8 @@ rb_iter_head_event(struct ring_buffer_iter *iter)
 	 */
 	barrier();
 
-	if ((iter->head + length) > commit || length > BUF_MAX_DATA_SIZE)
+	if ((iter->head + length) > commit ||
+	    length > iter->cpu_buffer->buffer->max_data_size)
 		/* Writer corrupted the read? */
 		goto reset;
 
@@ -2468,12 +2518,20 @@ rb_commit_index(struct ring_buffer_per_cpu *cpu_buffer)
 	return rb_page_commit(cpu_buffer->commit_page);
 }
 
+/* Mask that finds the start of the data page an event is on */
+static __always_inline unsigned long
+rb_subbuf_mask(struct ring_buffer_per_cpu *cpu_buffer)
+{
+	return ~((1UL << cpu_buffer->buffer->subbuf_shift) - 1);
+}
+
 static __always_inline unsigned
-rb_event_index(struct ring_buffer_event *event)
+rb_event_index(struct ring_buffer_per_cpu *cpu_buffer,
+	       struct ring_buffer_event *event)
 {
 	unsigned long addr = (unsigned long)event;
 
-	return (addr & ~PAGE_MASK) - BUF_PAGE_HDR_SIZE;
+	return (addr & ~rb_subbuf_mask(cpu_buffer)) - BUF_PAGE_HDR_SIZE;
 }
 
 static void rb_inc_iter(struct ring_buffer_iter *iter)
@@ -2542,7 +2600,8 @@ rb_handle_head_page(struct ring_buffer_per_cpu *cpu_buffer,
 		 * the counters.
 		 */
 		local_add(entries, &cpu_buffer->overrun);
-		local_sub(BUF_PAGE_SIZE, &cpu_buffer->entries_bytes);
+		local_sub(cpu_buffer->buffer->subbuf_size,
+			  &cpu_buffer->entries_bytes);
 		local_inc(&cpu_buffer->pages_lost);
 
 		/*
@@ -2662,6 +2721,7 @@ static inline void
 rb_reset_tail(struct ring_buffer_per_cpu *cpu_buffer,
 	      unsigned long tail, struct rb_event_info *info)
 {
+	unsigned long bsize = READ_ONCE(cpu_buffer->buffer->subbuf_size);
 	struct buffer_page *tail_page = info->tail_page;
 	struct ring_buffer_event *event;
 	unsigned long length = info->length;
@@ -2670,13 +2730,13 @@ rb_reset_tail(struct ring_buffer_per_cpu *cpu_buffer,
 	 * Only the event that crossed the page boundary
 	 * must fill the old tail_page with padding.
 	 */
-	if (tail >= BUF_PAGE_SIZE) {
+	if (tail >= bsize) {
 		/*
 		 * If the page was filled, then we still need
 		 * to update the real_end. Reset it to zero
 		 * and the reader will ignore it.
 		 */
-		if (tail == BUF_PAGE_SIZE)
+		if (tail == bsize)
 			tail_page->real_end = 0;
 
 		local_sub(length, &tail_page->write);
@@ -2686,7 +2746,7 @@ rb_reset_tail(struct ring_buffer_per_cpu *cpu_buffer,
 	event = __rb_page_index(tail_page, tail);
 
 	/* account for padding bytes */
-	local_add(BUF_PAGE_SIZE - tail, &cpu_buffer->entries_bytes);
+	local_add(bsize - tail, &cpu_buffer->entries_bytes);
 
 	/*
 	 * Save the original length to the meta data.
@@ -2706,7 +2766,7 @@ rb_reset_tail(struct ring_buffer_per_cpu *cpu_buffer,
 	 * If we are less than the minimum size, we don't need to
 	 * worry about it.
 	 */
-	if (tail > (BUF_PAGE_SIZE - RB_EVNT_MIN_SIZE)) {
+	if (tail > (bsize - RB_EVNT_MIN_SIZE)) {
 		/* No room for any events */
 
 		/* Mark the rest of the page with padding */
@@ -2721,7 +2781,7 @@ rb_reset_tail(struct ring_buffer_per_cpu *cpu_buffer,
 	}
 
 	/* Put in a discarded event */
-	event->array[0] = (BUF_PAGE_SIZE - tail) - RB_EVNT_HDR_SIZE;
+	event->array[0] = (bsize - tail) - RB_EVNT_HDR_SIZE;
 	event->type_len = RINGBUF_TYPE_PADDING;
 	/* time delta must be non zero */
 	event->time_delta = 1;
@@ -2730,7 +2790,7 @@ rb_reset_tail(struct ring_buffer_per_cpu *cpu_buffer,
 	smp_wmb();
 
 	/* Set write to end of buffer */
-	length = (tail + length) - BUF_PAGE_SIZE;
+	length = (tail + length) - bsize;
 	local_sub(length, &tail_page->write);
 }
 
@@ -2844,7 +2904,8 @@ rb_move_tail(struct ring_buffer_per_cpu *cpu_buffer,
 
 /* Slow path */
 static struct ring_buffer_event *
-rb_add_time_stamp(struct ring_buffer_event *event, u64 delta, bool abs)
+rb_add_time_stamp(struct ring_buffer_per_cpu *cpu_buffer,
+		  struct ring_buffer_event *event, u64 delta, bool abs)
 {
 	if (abs)
 		event->type_len = RINGBUF_TYPE_TIME_STAMP;
@@ -2852,7 +2913,7 @@ rb_add_time_stamp(struct ring_buffer_event *event, u64 delta, bool abs)
 		event->type_len = RINGBUF_TYPE_TIME_EXTEND;
 
 	/* Not the first event on the page, or not delta? */
-	if (abs || rb_event_index(event)) {
+	if (abs || rb_event_index(cpu_buffer, event)) {
 		event->time_delta = delta & TS_MASK;
 		event->array[0] = delta >> TS_SHIFT;
 	} else {
@@ -2926,7 +2987,7 @@ static void rb_add_timestamp(struct ring_buffer_per_cpu *cpu_buffer,
 		if (!abs)
 			info->delta = 0;
 	}
-	*event = rb_add_time_stamp(*event, info->delta, abs);
+	*event = rb_add_time_stamp(cpu_buffer, *event, info->delta, abs);
 	*length -= RB_LEN_TIME_EXTEND;
 	*delta = 0;
 }
@@ -3032,10 +3093,10 @@ rb_try_to_discard(struct ring_buffer_per_cpu *cpu_buffer,
 	u64 write_stamp;
 	u64 delta;
 
-	new_index = rb_event_index(event);
+	new_index = rb_event_index(cpu_buffer, event);
 	old_index = new_index + rb_event_ts_length(event);
 	addr = (unsigned long)event;
-	addr &= PAGE_MASK;
+	addr &= rb_subbuf_mask(cpu_buffer);
 
 	bpage = READ_ONCE(cpu_buffer->tail_page);
 
@@ -3620,7 +3681,7 @@ __rb_reserve_next(struct ring_buffer_per_cpu *cpu_buffer,
 	tail = write - info->length;
 
 	/* See if we shot pass the end of this buffer page */
-	if (unlikely(write > BUF_PAGE_SIZE)) {
+	if (unlikely(write > cpu_buffer->buffer->subbuf_size)) {
 		/* before and after may now different, fix it up*/
 		b_ok = rb_time_read(&cpu_buffer->before_stamp, &info->before);
 		a_ok = rb_time_read(&cpu_buffer->write_stamp, &info->after);
@@ -3829,7 +3890,7 @@ ring_buffer_lock_reserve(struct trace_buffer *buffer, unsigned long length)
 	if (unlikely(atomic_read(&cpu_buffer->record_disabled)))
 		goto out;
 
-	if (unlikely(length > BUF_MAX_DATA_SIZE))
+	if (unlikely(length > buffer->max_data_size))
 		goto out;
 
 	if (unlikely(trace_recursive_lock(cpu_buffer)))
@@ -3863,7 +3924,7 @@ rb_decrement_entry(struct ring_buffer_per_cpu *cpu_buffer,
 	struct buffer_page *bpage = cpu_buffer->commit_page;
 	struct buffer_page *start;
 
-	addr &= PAGE_MASK;
+	addr &= rb_subbuf_mask(cpu_buffer);
 
 	/* Do the likely case first */
 	if (likely(bpage->page == (void *)addr)) {
@@ -3979,7 +4040,7 @@ int ring_buffer_write(struct trace_buffer *buffer,
 	if (atomic_read(&cpu_buffer->record_disabled))
 		goto out;
 
-	if (length > BUF_MAX_DATA_SIZE)
+	if (length > buffer->max_data_size)
 		goto out;
 
 	if (unlikely(trace_recursive_lock(cpu_buffer)))
@@ -4695,7 +4756,8 @@ rb_get_reader_page(struct ring_buffer_per_cpu *cpu_buffer)
 #define USECS_WAIT	1000000
         for (nr_loops = 0; nr_loops < USECS_WAIT; nr_loops++) {
 		/* If the write is past the end of page, a writer is still updating it */
-		if (likely(!reader || rb_page_write(reader) <= BUF_PAGE_SIZE))
+		if (likely(!reader ||
+			   rb_page_write(reader) <= cpu_buffer->buffer->subbuf_size))
 			break;
 
 		udelay(1);
@@ -5132,7 +5194,7 @@ ring_buffer_read_prepare(struct trace_buffer *buffer, int cpu, gfp_t flags)
 	if (!iter)
 		return NULL;
 
-	iter->event = kmalloc(BUF_MAX_DATA_SIZE, flags);
+	iter->event = kmalloc(buffer->max_data_size, flags);
 	if (!iter->event) {
 		kfree(iter);
 		return NULL;
@@ -5257,7 +5319,7 @@ unsigned long ring_buffer_size(struct trace_buffer *buffer, int cpu)
 	if (!cpumask_test_cpu(cpu, buffer->cpumask))
 		return 0;
 
-	return BUF_PAGE_SIZE * buffer->buffers[cpu]->nr_pages;
+	return buffer->subbuf_size * buffer->buffers[cpu]->nr_pages;
 }
 EXPORT_SYMBOL_GPL(ring_buffer_size);
 
@@ -5515,6 +5577,9 @@ int ring_buffer_swap_cpu(struct trace_buffer *buffer_a,
 	if (cpu_buffer_a->nr_pages != cpu_buffer_b->nr_pages)
 		goto out;
 
+	if (buffer_a->subbuf_shift != buffer_b->subbuf_shift)
+		goto out;
+
 	ret = -EAGAIN;
 
 	if (atomic_read(&buffer_a->record_disabled))
@@ -5561,6 +5626,46 @@ int ring_buffer_swap_cpu(struct trace_buffer *buffer_a,
 EXPORT_SYMBOL_GPL(ring_buffer_swap_cpu);
 #endif /* CONFIG_RING_BUFFER_ALLOW_SWAP */
 
+/*
+ * Read pages hold one sub-buffer, but are never smaller than a page so that
+ * they can be spliced. They are always page allocations (with __GFP_COMP
+ * for higher orders), which lets them be freed without knowing the
+ * sub-buffer size they were allocated for.
+ */
+static unsigned int rb_read_page_shift(struct trace_buffer *buffer)
+{
+	return max_t(unsigned int, READ_ONCE(buffer->subbuf_shift), PAGE_SHIFT);
+}
+
+static size_t rb_read_page_bytes(void *data)
+{
+	return PAGE_SIZE << compound_order(virt_to_head_page(data));
+}
+
+static void rb_free_read_page(void *data)
+{
+	struct page *page;
+
+	if (!data)
+		return;
+	page = virt_to_head_page(data);
+	__free_pages(page, compound_order(page));
+}
+
+/**
+ * ring_buffer_read_page_size - size of the pages used to read the buffer
+ * @buffer: the buffer the pages are read from
+ *
+ * Returns the size of the pages returned by ring_buffer_alloc_read_page(),
+ * header included. It is the sub-buffer size, or PAGE_SIZE if the
+ * sub-buffers are smaller than a page.
+ */
+size_t ring_buffer_read_page_size(struct trace_buffer *buffer)
+{
+	return 1UL << rb_read_page_shift(buffer);
+}
+EXPORT_SYMBOL_GPL(ring_buffer_read_page_size);
+
 /**
  * ring_buffer_alloc_read_page - allocate a page to read from buffer
  * @buffer: the buffer to allocate for.
@@ -5581,12 +5686,14 @@ void *ring_buffer_alloc_read_page(struct trace_buffer *buffer, int cpu)
 {
 	struct ring_buffer_per_cpu *cpu_buffer;
 	struct buffer_data_page *bpage = NULL;
+	unsigned int shift;
 	unsigned long flags;
-	struct page *page;
 
 	if (!cpumask_test_cpu(cpu, buffer->cpumask))
 		return ERR_PTR(-ENODEV);
 
+	shift = rb_read_page_shift(buffer);
+
 	cpu_buffer = buffer->buffers[cpu];
 	local_irq_save(flags);
 	arch_spin_lock(&cpu_buffer->lock);
@@ -5599,16 +5706,15 @@ void *ring_buffer_alloc_read_page(struct trace_buffer *buffer, int cpu)
 	arch_spin_unlock(&cpu_buffer->lock);
 	local_irq_restore(flags);
 
-	if (bpage)
+	/* The cached page may predate a change of the sub-buffer size */
+	if (bpage && rb_read_page_bytes(bpage) == 1UL << shift)
 		goto out;
+	rb_free_read_page(bpage);
 
-	page = alloc_pages_node(cpu_to_node(cpu),
-				GFP_KERNEL | __GFP_NORETRY, 0);
-	if (!page)
+	bpage = rb_alloc_data_page(cpu, shift, GFP_KERNEL | __GFP_NORETRY);
+	if (!bpage)
 		return ERR_PTR(-ENOMEM);
 
-	bpage = page_address(page);
-
  out:
 	rb_init_page(bpage);
 
@@ -5628,13 +5734,17 @@ void ring_buffer_free_read_page(struct trace_buffer *buffer, int cpu, void *data
 {
 	struct ring_buffer_per_cpu *cpu_buffer = buffer->buffers[cpu];
 	struct buffer_data_page *bpage = data;
-	struct page *page = virt_to_page(bpage);
+	struct page *page = virt_to_head_page(bpage);
 	unsigned long flags;
 
 	/* If the page is still in use someplace else, we can't reuse it */
 	if (page_ref_count(page) > 1)
 		goto out;
 
+	/* Nor if it was sized for a previous sub-buffer size */
+	if (rb_read_page_bytes(bpage) != ring_buffer_read_page_size(buffer))
+		goto out;
+
 	local_irq_save(flags);
 	arch_spin_lock(&cpu_buffer->lock);
 
@@ -5647,7 +5757,7 @@ void ring_buffer_free_read_page(struct trace_buffer *buffer, int cpu, void *data
 	local_irq_restore(flags);
 
  out:
-	free_page((unsigned long)bpage);
+	rb_free_read_page(bpage);
 }
 EXPORT_SYMBOL_GPL(ring_buffer_free_read_page);
 
@@ -5675,6 +5785,9 @@ EXPORT_SYMBOL_GPL(ring_buffer_free_read_page);
  * When @full is set, the function will not return true unless
  * the writer is off the reader page.
  *
+ * The page is only swapped when it has the size of a sub-buffer. Buffers
+ * with sub-buffers smaller than PAGE_SIZE are always copied out.
+ *
  * Note: it is up to the calling functions to handle sleeps and wakeups.
  *  The ring buffer can be used anywhere in the kernel and can not
  *  blindly call wake_up. The layer that uses the ring buffer must be
@@ -5695,7 +5808,9 @@ int ring_buffer_read_page(struct trace_buffer *buffer,
 	unsigned long flags;
 	unsigned int commit;
 	unsigned int read;
+	size_t data_size;
 	u64 save_timestamp;
+	bool swap;
 	int ret = -1;
 
 	if (!cpumask_test_cpu(cpu, buffer->cpumask))
@@ -5717,8 +5832,15 @@ int ring_buffer_read_page(struct trace_buffer *buffer,
 	if (!bpage)
 		goto out;
 
+	/* Never trust @len beyond the page that was passed in */
+	data_size = rb_read_page_bytes(bpage) - BUF_PAGE_HDR_SIZE;
+	if (len > data_size)
+		len = data_size;
+
 	raw_spin_lock_irqsave(&cpu_buffer->reader_lock, flags);
 
+	swap = data_size == buffer->subbuf_size;
+
 	reader = rb_get_reader_page(cpu_buffer);
 	if (!reader)
 		goto out_unlock;
@@ -5738,7 +5860,7 @@ int ring_buffer_read_page(struct trace_buffer *buffer,
 	 * we must copy the data from the page to the buffer.
 	 * Otherwise, we can simply swap the page with the one passed in.
 	 */
-	if (read || (len < (commit - read)) ||
+	if (!swap || read || (len < (commit - read)) ||
 	    cpu_buffer->reader_page == cpu_buffer->commit_page) {
 		struct buffer_data_page *rpage = cpu_buffer->reader_page->page;
 		unsigned int rpos = read;
@@ -5752,7 +5874,7 @@ int ring_buffer_read_page(struct trace_buffer *buffer,
 		 * the reader page.
 		 */
 		if (full &&
-		    (!read || (len < (commit - read)) ||
+		    ((swap && !read) || (len < (commit - read)) ||
 		     cpu_buffer->reader_page == cpu_buffer->commit_page))
 			goto out_unlock;
 
@@ -5802,7 +5924,7 @@ int ring_buffer_read_page(struct trace_buffer *buffer,
 	} else {
 		/* update the entry counter */
 		cpu_buffer->read += rb_page_entries(reader);
-		cpu_buffer->read_bytes += BUF_PAGE_SIZE;
+		cpu_buffer->read_bytes += buffer->subbuf_size;
 
 		/* swap the pages */
 		rb_init_page(bpage);
@@ -5833,7 +5955,7 @@ int ring_buffer_read_page(struct trace_buffer *buffer,
 		/* If there is room at the end of the page to save the
 		 * missed events, then record it there.
 		 */
-		if (BUF_PAGE_SIZE - commit >= sizeof(missed_events)) {
+		if (data_size - commit >= sizeof(missed_events)) {
 			memcpy(&bpage->data[commit], &missed_events,
 			       sizeof(missed_events));
 			local_add(RB_MISSED_STORED, &bpage->commit);
@@ -5845,8 +5967,8 @@ int ring_buffer_read_page(struct trace_buffer *buffer,
 	/*
 	 * This page may be off to user land. Zero it out here.
 	 */
-	if (commit < BUF_PAGE_SIZE)
-		memset(&bpage->data[commit], 0, BUF_PAGE_SIZE - commit);
+	if (commit < data_size)
+		memset(&bpage->data[commit], 0, data_size - commit);
 
  out_unlock:
 	raw_spin_unlock_irqrestore(&cpu_buffer->reader_lock, flags);
@@ -5856,6 +5978,178 @@ int ring_buffer_read_page(struct trace_buffer *buffer,
 }
 EXPORT_SYMBOL_GPL(ring_buffer_read_page);
 
+/**
+ * ring_buffer_subbuf_size_get - get the size of the sub-buffers
+ * @buffer: the buffer to query
+ *
+ * Returns the size in bytes of the data pages the buffer is made of,
+ * header included.
+ */
+int ring_buffer_subbuf_size_get(struct trace_buffer *buffer)
+{
+	return 1 << READ_ONCE(buffer->subbuf_shift);
+}
+EXPORT_SYMBOL_GPL(ring_buffer_subbuf_size_get);
+
+static void rb_free_page_list(struct list_head *pages)
+{
+	struct buffer_page *bpage, *tmp;
+
+	list_for_each_entry_safe(bpage, tmp, pages, list) {
+		list_del_init(&bpage->list);
+		free_buffer_page(bpage);
+	}
+}
+
+/*
+ * Move the pages of @cpu_buffer, reader page included, to @old and
+ * install the pages preallocated on its new_pages list, the first of which
+ * becomes the reader page. The writers must be disabled.
+ */
+static void rb_swap_subbuf_pages(struct ring_buffer_per_cpu *cpu_buffer,
+				 unsigned long nr_pages, struct list_head *old)
+{
+	struct buffer_page *reader;
+	LIST_HEAD(pages);
+
+	rb_head_page_deactivate(cpu_buffer);
+	list_add_tail(&pages, cpu_buffer->pages);
+	list_add(&cpu_buffer->reader_page->list, &pages);
+	list_splice(&pages, old);
+
+	reader = list_first_entry(&cpu_buffer->new_pages,
+				  struct buffer_page, list);
+	list_del_init(&reader->list);
+	cpu_buffer->reader_page = reader;
+	cpu_buffer->pages = cpu_buffer->new_pages.next;
+	list_del_init(&cpu_buffer->new_pages);
+	cpu_buffer->nr_pages = nr_pages;
+
+	/* Sets up the head, tail and commit pages on the new list */
+	rb_reset_cpu(cpu_buffer);
+}
+
+/**
+ * ring_buffer_subbuf_size_set - change the size of the sub-buffers
+ * @buffer: the buffer to change
+ * @size: the new size in bytes of the data pages, header included
+ *
+ * @size must be a power of two from 1K to 64K. The number of sub-buffers
+ * of each per CPU buffer is adjusted to keep about the same amount of
+ * storage. The content of the buffer is discarded.
+ *
+ * Pages that were handed out to readers before the change keep working,
+ * but are copied into instead of swapped with the buffer, and are freed
+ * when they are returned.
+ *
+ * Returns 0 on success, -EINVAL for an unsupported size, -EBUSY if the
+ * buffer is being read with an iterator, or -ENOMEM.
+ */
+int ring_buffer_subbuf_size_set(struct trace_buffer *buffer, unsigned int size)
+{
+	struct ring_buffer_per_cpu *cpu_buffer;
+	struct buffer_data_page *free_page;
+	unsigned int old_shift, shift;
+	unsigned long nr_pages;
+	unsigned long flags;
+	LIST_HEAD(old);
+	int cpu, err;
+
+	if (!is_power_of_2(size))
+		return -EINVAL;
+
+	shift = ilog2(size);
+	if (shift < RB_SUBBUF_SHIFT_MIN || shift > RB_SUBBUF_SHIFT_MAX)
+		return -EINVAL;
+
+	/* prevent another thread from changing buffer sizes */
+	mutex_lock(&buffer->mutex);
+	cpus_read_lock();
+
+	old_shift = buffer->subbuf_shift;
+	if (shift == old_shift) {
+		err = 0;
+		goto out_unlock;
+	}
+
+	for_each_buffer_cpu(buffer, cpu) {
+		cpu_buffer = buffer->buffers[cpu];
+		if (atomic_read(&cpu_buffer->resize_disabled)) {
+			err = -EBUSY;
+			goto out_unlock;
+		}
+		INIT_LIST_HEAD(&cpu_buffer->new_pages);
+	}
+
+	/* Allocate everything first, this can still fail without harm */
+	for_each_buffer_cpu(buffer, cpu) {
+		cpu_buffer = buffer->buffers[cpu];
+
+		nr_pages = cpu_buffer->nr_pages << old_shift;
+		nr_pages = DIV_ROUND_UP(nr_pages, 1UL << shift);
+		if (nr_pages < 2)
+			nr_pages = 2;
+		cpu_buffer->nr_pages_to_update = nr_pages;
+
+		/* One more for the reader page */
+		if (__rb_allocate_pages(cpu_buffer, nr_pages + 1, shift,
+					&cpu_buffer->new_pages)) {
+			err = -ENOMEM;
+			goto out_err;
+		}
+	}
+
+	atomic_inc(&buffer->record_disabled);
+
+	/* Make sure all commits have finished */
+	synchronize_rcu();
+
+	for_each_buffer_cpu(buffer, cpu) {
+		cpu_buffer = buffer->buffers[cpu];
+
+		raw_spin_lock_irqsave(&cpu_buffer->reader_lock, flags);
+		arch_spin_lock(&cpu_buffer->lock);
+
+		rb_swap_subbuf_pages(cpu_buffer, cpu_buffer->nr_pages_to_update,
+				     &old);
+		cpu_buffer->nr_pages_to_update = 0;
+
+		free_page = cpu_buffer->free_page;
+		cpu_buffer->free_page = NULL;
+
+		arch_spin_unlock(&cpu_buffer->lock);
+		raw_spin_unlock_irqrestore(&cpu_buffer->reader_lock, flags);
+
+		rb_free_read_page(free_page);
+	}
+
+	WRITE_ONCE(buffer->subbuf_size, (1U << shift) - BUF_PAGE_HDR_SIZE);
+	WRITE_ONCE(buffer->max_data_size,
+		   RB_MAX_DATA_SIZE((1U << shift) - BUF_PAGE_HDR_SIZE));
+	WRITE_ONCE(buffer->subbuf_shift, shift);
+
+	atomic_dec(&buffer->record_disabled);
+
+	cpus_read_unlock();
+	mutex_unlock(&buffer->mutex);
+
+	rb_free_page_list(&old);
+
+	return 0;
+
+ out_err:
+	for_each_buffer_cpu(buffer, cpu) {
+		cpu_buffer = buffer->buffers[cpu];
+		cpu_buffer->nr_pages_to_update = 0;
+		rb_free_page_list(&cpu_buffer->new_pages);
+	}
+ out_unlock:
+	cpus_read_unlock();
+	mutex_unlock(&buffer->mutex);
+	return err;
+}
+EXPORT_SYMBOL_GPL(ring_buffer_subbuf_size_set);
+
 /*
  * We only allocate new buffers, never free them if the CPU goes down.
  * If we were to free the buffer, then the user would lose any trace that was in
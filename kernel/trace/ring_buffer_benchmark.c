@@ -10,12 +10,13 @@
 #include <uapi/linux/sched/types.h>
 #include <linux/module.h>
 #include <linux/ktime.h>
+#include <linux/log2.h>
 #include <asm/local.h>
 
 struct rb_page {
 	u64		ts;
 	local_t		commit;
-	char		data[4080];
+	char		data[];
 };
 
 /* run time and sleep time in seconds */
@@ -60,6 +61,23 @@ MODULE_PARM_DESC(producer_fifo, "use fifo for producer: 0 - disabled, 1 - low pr
 module_param(consumer_fifo, int, 0644);
 MODULE_PARM_DESC(consumer_fifo, "use fifo for consumer: 0 - disabled, 1 - low prio, 2 - fifo");
 
+/*
+ * Sub-buffer sizes to cycle through, in bytes. Each run uses the next
+ * power of two from subbuf_size_min to subbuf_size_max, and the cost per
+ * entry of every size is reported once all of them have run.
+ */
+static unsigned int subbuf_size_min;
+static unsigned int subbuf_size_max;
+
+module_param(subbuf_size_min, uint, 0444);
+MODULE_PARM_DESC(subbuf_size_min, "smallest sub-buffer size to test (0 - default only)");
+
+module_param(subbuf_size_max, uint, 0444);
+MODULE_PARM_DESC(subbuf_size_max, "largest sub-buffer size to test");
+
+/* ns per entry of the last run of each sub-buffer size, by log2 size */
+static unsigned long subbuf_ns[BITS_PER_LONG];
+
 static int read_events;
 
 static int test_error;
@@ -107,24 +125,26 @@ static enum event_status read_page(int cpu)
 	struct ring_buffer_event *event;
 	struct rb_page *rpage;
 	unsigned long commit;
+	size_t page_size;
 	void *bpage;
 	int *entry;
 	int ret;
 	int inc;
 	int i;
 
+	page_size = ring_buffer_read_page_size(buffer);
 	bpage = ring_buffer_alloc_read_page(buffer, cpu);
 	if (IS_ERR(bpage))
 		return EVENT_DROPPED;
 
-	ret = ring_buffer_read_page(buffer, &bpage, PAGE_SIZE, cpu, 1);
+	ret = ring_buffer_read_page(buffer, &bpage, page_size, cpu, 1);
 	if (ret >= 0) {
 		rpage = bpage;
 		/* The commit may have missed event flags set, clear them */
 		commit = local_read(&rpage->commit) & 0xfffff;
 		for (i = 0; i < commit && !test_error ; i += inc) {
 
-			if (i >= (PAGE_SIZE - offsetof(struct rb_page, data))) {
+			if (i >= (page_size - offsetof(struct rb_page, data))) {
 				TEST_ERROR();
 				break;
 			}
@@ -227,7 +247,8 @@ static void ring_buffer_consumer(void)
 	complete(&read_done);
 }
 
-static void ring_buffer_producer(void)
+/* Returns the average time per entry in nanosecs, 0 if unknown */
+static unsigned long ring_buffer_producer(void)
 {
 	ktime_t start_time, end_time, timeout;
 	unsigned long long time;
@@ -235,7 +256,7 @@ static void ring_buffer_producer(void)
 	unsigned long long overruns;
 	unsigned long missed = 0;
 	unsigned long hit = 0;
-	unsigned long avg;
+	unsigned long avg = 0;
 	int cnt = 0;
 
 	/*
@@ -322,6 +343,8 @@ static void ring_buffer_producer(void)
 	    producer_nice == MAX_NICE && consumer_nice == MAX_NICE)
 		trace_printk("WARNING!!! This test is running at lowest priority.\n");
 
+	trace_printk("Sub-buffer: %d bytes\n",
+		     ring_buffer_subbuf_size_get(buffer));
 	trace_printk("Time:     %lld (usecs)\n", time);
 	trace_printk("Overruns: %lld\n", overruns);
 	if (disable_reader)
@@ -366,6 +389,29 @@ static void ring_buffer_producer(void)
 		avg = NSEC_PER_MSEC / (hit + missed);
 		trace_printk("%ld ns per entry\n", avg);
 	}
+
+	return avg;
+}
+
+/* Switch to the next sub-buffer size, the consumer must be idle */
+static void next_subbuf_size(unsigned int size)
+{
+	size <<= 1;
+	if (size > subbuf_size_max)
+		size = subbuf_size_min;
+
+	if (ring_buffer_subbuf_size_set(buffer, size))
+		TEST_ERROR();
+}
+
+static void report_subbuf_sizes(void)
+{
+	unsigned int size;
+
+	trace_printk("Sub-buffer size summary:\n");
+	for (size = subbuf_size_min; size <= subbuf_size_max; size <<= 1)
+		trace_printk("  %6u bytes: %lu ns per entry\n",
+			     size, subbuf_ns[ilog2(size)]);
 }
 
 static void wait_to_die(void)
@@ -401,6 +447,8 @@ static int ring_buffer_consumer_thread(void *arg)
 static int ring_buffer_producer_thread(void *arg)
 {
 	while (!break_test()) {
+		unsigned int size;
+
 		ring_buffer_reset(buffer);
 
 		if (consumer) {
@@ -408,10 +456,17 @@ static int ring_buffer_producer_thread(void *arg)
 			wait_for_completion(&read_start);
 		}
 
-		ring_buffer_producer();
+		size = ring_buffer_subbuf_size_get(buffer);
+		subbuf_ns[ilog2(size)] = ring_buffer_producer();
 		if (break_test())
 			goto out_kill;
 
+		if (subbuf_size_min) {
+			if (size == subbuf_size_max)
+				report_subbuf_sizes();
+			next_subbuf_size(size);
+		}
+
 		trace_printk("Sleeping for 10 secs\n");
 		set_current_state(TASK_INTERRUPTIBLE);
 		if (break_test())
@@ -436,6 +491,19 @@ static int __init ring_buffer_benchmark_init(void)
 	if (!buffer)
 		return -ENOMEM;
 
+	if (subbuf_size_min) {
+		if (subbuf_size_max < subbuf_size_min)
+			subbuf_size_max = subbuf_size_min;
+		subbuf_size_max = rounddown_pow_of_two(subbuf_size_max);
+
+		/* Let the ring buffer validate both ends of the range */
+		ret = ring_buffer_subbuf_size_set(buffer, subbuf_size_max);
+		if (!ret)
+			ret = ring_buffer_subbuf_size_set(buffer, subbuf_size_min);
+		if (ret)
+			goto out_fail;
+	}
+
 	if (!disable_reader) {
 		consumer = kthread_create(ring_buffer_consumer_thread,
 					  NULL, "rb_consumer");
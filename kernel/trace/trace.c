@@ -4932,7 +4932,7 @@ static int tracing_release(struct inode *inode, struct file *file)
 	return 0;
 }
 
-static int tracing_release_generic_tr(struct inode *inode, struct file *file)
+int tracing_release_generic_tr(struct inode *inode, struct file *file)
 {
 	struct trace_array *tr = inode->i_private;
 
@@ -5493,7 +5493,8 @@ static const char readme_msg[] =
 	"  available_tracers\t- list of configured tracers for current_tracer\n"
 	"  error_log\t- error log for failed commands (that support it)\n"
 	"  buffer_size_kb\t- view and modify size of per cpu buffer\n"
-	"  buffer_total_size_kb  - view total size of all cpu buffers\n\n"
+	"  buffer_total_size_kb  - view total size of all cpu buffers\n"
+	"  buffer_subbuf_size_kb\t- view and modify size of the sub buffers\n\n"
 	"  trace_clock\t\t- change the clock used to order events\n"
 	"       local:   Per cpu clock but may not be synced across CPUs\n"
 	"      global:   Synced across CPUs but slows tracing down.\n"
@@ -7417,6 +7418,7 @@ struct ftrace_buffer_info {
 	struct trace_iterator	iter;
 	void			*spare;
 	unsigned int		spare_cpu;
+	unsigned int		spare_size;
 	unsigned int		read;
 };
 
@@ -8112,6 +8114,7 @@ tracing_buffers_read(struct file *filp, char __user *ubuf,
 {
 	struct ftrace_buffer_info *info = filp->private_data;
 	struct trace_iterator *iter = &info->iter;
+	size_t page_size;
 	ssize_t ret = 0;
 	ssize_t size;
 
@@ -8123,6 +8126,16 @@ tracing_buffers_read(struct file *filp, char __user *ubuf,
 		return -EBUSY;
 #endif
 
+	page_size = ring_buffer_read_page_size(iter->array_buffer->buffer);
+
+	/* Drop a fully read spare left over from another sub-buffer size */
+	if (info->spare && info->read >= info->spare_size &&
+	    info->spare_size != page_size) {
+		ring_buffer_free_read_page(iter->array_buffer->buffer,
+					   info->spare_cpu, info->spare);
+		info->spare = NULL;
+	}
+
 	if (!info->spare) {
 		info->spare = ring_buffer_alloc_read_page(iter->array_buffer->buffer,
 							  iter->cpu_file);
@@ -8131,13 +8144,14 @@ tracing_buffers_read(struct file *filp, char __user *ubuf,
 			info->spare = NULL;
 		} else {
 			info->spare_cpu = iter->cpu_file;
+			info->spare_size = page_size;
 		}
 	}
 	if (!info->spare)
 		return ret;
 
 	/* Do we have previous read data to read? */
-	if (info->read < PAGE_SIZE)
+	if (info->read < info->spare_size)
 		goto read;
 
  again:
@@ -8164,7 +8178,7 @@ tracing_buffers_read(struct file *filp, char __user *ubuf,
 
 	info->read = 0;
  read:
-	size = PAGE_SIZE - info->read;
+	size = info->spare_size - info->read;
 	if (size > count)
 		size = count;
 
@@ -8279,6 +8293,7 @@ tracing_buffers_splice_read(struct file *file, loff_t *ppos,
 		.spd_release	= buffer_spd_release,
 	};
 	struct buffer_ref *ref;
+	size_t page_size;
 	int entries, i;
 	ssize_t ret = 0;
 
@@ -8287,13 +8302,16 @@ tracing_buffers_splice_read(struct file *file, loff_t *ppos,
 		return -EBUSY;
 #endif
 
-	if (*ppos & (PAGE_SIZE - 1))
+	/* One pipe buffer per read page, which may span several pages */
+	page_size = ring_buffer_read_page_size(iter->array_buffer->buffer);
+
+	if (*ppos & (page_size - 1))
 		return -EINVAL;
 
-	if (len & (PAGE_SIZE - 1)) {
-		if (len < PAGE_SIZE)
+	if (len & (page_size - 1)) {
+		if (len < page_size)
 			return -EINVAL;
-		len &= PAGE_MASK;
+		len &= ~(page_size - 1);
 	}
 
 	if (splice_grow_spd(pipe, &spd))
@@ -8303,7 +8321,7 @@ tracing_buffers_splice_read(struct file *file, loff_t *ppos,
 	trace_access_lock(iter->cpu_file);
 	entries = ring_buffer_entries_cpu(iter->array_buffer->buffer, iter->cpu_file);
 
-	for (i = 0; i < spd.nr_pages_max && len && entries; i++, len -= PAGE_SIZE) {
+	for (i = 0; i < spd.nr_pages_max && len && entries; i++, len -= page_size) {
 		struct page *page;
 		int r;
 
@@ -8336,11 +8354,11 @@ tracing_buffers_splice_read(struct file *file, loff_t *ppos,
 		page = virt_to_page(ref->page);
 
 		spd.pages[i] = page;
-		spd.partial[i].len = PAGE_SIZE;
+		spd.partial[i].len = page_size;
 		spd.partial[i].offset = 0;
 		spd.partial[i].private = (unsigned long)ref;
 		spd.nr_pages++;
-		*ppos += PAGE_SIZE;
+		*ppos += page_size;
 
 		entries = ring_buffer_entries_cpu(iter->array_buffer->buffer, iter->cpu_file);
 	}
@@ -9163,6 +9181,74 @@ static const struct file_operations buffer_percent_fops = {
 	.llseek		= default_llseek,
 };
 
+static ssize_t
+buffer_subbuf_size_read(struct file *filp, char __user *ubuf,
+			size_t cnt, loff_t *ppos)
+{
+	struct trace_array *tr = filp->private_data;
+	char buf[64];
+	int r;
+
+	r = ring_buffer_subbuf_size_get(tr->array_buffer.buffer);
+	r = sprintf(buf, "%d\n", r >> 10);
+
+	return simple_read_from_buffer(ubuf, cnt, ppos, buf, r);
+}
+
+static ssize_t
+buffer_subbuf_size_write(struct file *filp, const char __user *ubuf,
+			 size_t cnt, loff_t *ppos)
+{
+	struct trace_array *tr = filp->private_data;
+	unsigned long val;
+	int old_size;
+	int ret;
+
+	ret = kstrtoul_from_user(ubuf, cnt, 10, &val);
+	if (ret)
+		return ret;
+
+	/* value is in KB */
+	if (!val || val > UINT_MAX >> 10)
+		return -EINVAL;
+	val <<= 10;
+
+	mutex_lock(&trace_types_lock);
+
+	old_size = ring_buffer_subbuf_size_get(tr->array_buffer.buffer);
+	if (old_size == val)
+		goto out;
+
+	ret = ring_buffer_subbuf_size_set(tr->array_buffer.buffer, val);
+	if (ret)
+		goto out;
+
+#ifdef CONFIG_TRACER_MAX_TRACE
+	/* The snapshot buffer is swapped with the main one, keep them alike */
+	ret = ring_buffer_subbuf_size_set(tr->max_buffer.buffer, val);
+	if (ret) {
+		if (WARN_ON_ONCE(ring_buffer_subbuf_size_set(tr->array_buffer.buffer,
+							     old_size)))
+			tracing_disabled = 1;
+		goto out;
+	}
+#endif
+
+	(*ppos)++;
+ out:
+	mutex_unlock(&trace_types_lock);
+
+	return ret ? ret : cnt;
+}
+
+static const struct file_operations buffer_subbuf_size_fops = {
+	.open		= tracing_open_generic_tr,
+	.read		= buffer_subbuf_size_read,
+	.write		= buffer_subbuf_size_write,
+	.release	= tracing_release_generic_tr,
+	.llseek		= default_llseek,
+};
+
 static struct dentry *trace_instance_dir;
 
 static void
@@ -9614,6 +9700,9 @@ init_tracer_tracefs(struct trace_array *tr, struct dentry *d_tracer)
 	trace_create_file("buffer_percent", TRACE_MODE_READ, d_tracer,
 			tr, &buffer_percent_fops);
 
+	trace_create_file("buffer_subbuf_size_kb", TRACE_MODE_WRITE, d_tracer,
+			  tr, &buffer_subbuf_size_fops);
+
 	create_trace_options_dir(tr);
 
 #ifdef CONFIG_TRACER_MAX_TRACE
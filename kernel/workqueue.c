@@ -51,6 +51,10 @@
 #include <linux/sched/isolation.h>
 #include <linux/nmi.h>
 #include <linux/kvm_para.h>
+#include <linux/debugfs.h>
+#include <linux/seq_file.h>
+#include <linux/sort.h>
+#include <linux/sched/clock.h>
 
 #include "workqueue_internal.h"
 
@@ -249,6 +253,7 @@ struct wq_flusher {
 };
 
 struct wq_device;
+struct wq_lat_stats;
 
 /*
  * The externally visible workqueue.  It relays the issued work items to
@@ -278,6 +283,9 @@ struct workqueue_struct {
 #ifdef CONFIG_SYSFS
 	struct wq_device	*wq_dev;	/* I: for sysfs interface */
 #endif
+#ifdef CONFIG_WQ_LATENCY_STATS
+	struct wq_lat_stats __percpu *lat_stats; /* I: latency histograms */
+#endif
 #ifdef CONFIG_LOCKDEP
 	char			*lock_name;
 	struct lock_class_key	key;
@@ -1336,6 +1344,129 @@ static int try_to_grab_pending(struct work_struct *work, bool is_dwork,
 	return -EAGAIN;
 }
 
+#ifdef CONFIG_WQ_LATENCY_STATS
+/*
+ * Latency statistics. When enabled through debugfs, insert_work() stamps
+ * each work item and process_one_work() accounts the delay until it
+ * started and how long it ran, per workqueue in log2(ns) buckets and per
+ * work function in a small open-addressed table. Counters are updated
+ * without locking and may be slightly off around a reset.
+ */
+#define WQ_HIST_BUCKETS		32	/* the last bucket takes everything above */
+#define WQ_FUNC_SLOTS		256	/* must be a power of two */
+#define WQ_FUNC_PROBES		8
+#define WQ_FUNC_SHOW		32
+
+struct wq_lat_stats {
+	u64			queued[WQ_HIST_BUCKETS]; /* queue to start */
+	u64			exec[WQ_HIST_BUCKETS];	 /* execution time */
+};
+
+struct wq_func_stats {
+	work_func_t		func;
+	atomic64_t		count;
+	atomic64_t		total_ns;
+	u64			max_ns;
+};
+
+static DEFINE_STATIC_KEY_FALSE(wq_stats_enabled);
+static u64 wq_stats_since;		/* local_clock() at the last enable */
+static struct wq_func_stats wq_func_stats[WQ_FUNC_SLOTS];
+static atomic64_t wq_func_dropped;	/* executions with no free slot */
+
+static int wq_stats_alloc(struct workqueue_struct *wq)
+{
+	wq->lat_stats = alloc_percpu(struct wq_lat_stats);
+	return wq->lat_stats ? 0 : -ENOMEM;
+}
+
+static void wq_stats_free(struct workqueue_struct *wq)
+{
+	free_percpu(wq->lat_stats);
+}
+
+static unsigned int wq_hist_bucket(u64 ns)
+{
+	return ns ? min_t(unsigned int, fls64(ns) - 1, WQ_HIST_BUCKETS - 1) : 0;
+}
+
+static struct wq_func_stats *wq_func_stats_get(work_func_t func)
+{
+	unsigned int i, slot = hash_ptr((void *)func, ilog2(WQ_FUNC_SLOTS));
+
+	for (i = 0; i < WQ_FUNC_PROBES; i++) {
+		struct wq_func_stats *fs = &wq_func_stats[slot];
+		work_func_t cur = READ_ONCE(fs->func);
+
+		if (!cur)
+			cur = cmpxchg(&fs->func, NULL, func) ?: func;
+		if (cur == func)
+			return fs;
+		slot = (slot + 1) & (WQ_FUNC_SLOTS - 1);
+	}
+	return NULL;
+}
+
+/* called with the pool lock held, before @work can be queued again */
+static __always_inline void wq_stats_queue(struct work_struct *work)
+{
+	if (static_branch_unlikely(&wq_stats_enabled))
+		work->queued_ns = local_clock();
+}
+
+/* returns the start time to pass to wq_stats_done(), 0 if not sampling */
+static __always_inline u64 wq_stats_start(struct pool_workqueue *pwq,
+					  struct work_struct *work)
+{
+	u64 now, queued;
+
+	if (!static_branch_unlikely(&wq_stats_enabled))
+		return 0;
+
+	now = local_clock();
+	queued = work->queued_ns;
+	work->queued_ns = 0;
+	/* ignore stamps left over from before the last enable */
+	if (queued >= READ_ONCE(wq_stats_since) && now >= queued)
+		this_cpu_inc(pwq->wq->lat_stats->queued[wq_hist_bucket(now - queued)]);
+	return now;
+}
+
+static __always_inline void wq_stats_done(struct pool_workqueue *pwq,
+					  work_func_t func, u64 start)
+{
+	struct wq_func_stats *fs;
+	u64 delta;
+
+	if (!start)
+		return;
+
+	delta = local_clock() - start;
+	this_cpu_inc(pwq->wq->lat_stats->exec[wq_hist_bucket(delta)]);
+
+	fs = wq_func_stats_get(func);
+	if (!fs) {
+		atomic64_inc(&wq_func_dropped);
+		return;
+	}
+	atomic64_inc(&fs->count);
+	atomic64_add(delta, &fs->total_ns);
+	if (delta > READ_ONCE(fs->max_ns))
+		WRITE_ONCE(fs->max_ns, delta);
+}
+#else
+static int wq_stats_alloc(struct workqueue_struct *wq) { return 0; }
+static void wq_stats_free(struct workqueue_struct *wq) { }
+static inline void wq_stats_queue(struct work_struct *work) { }
+static inline u64 wq_stats_start(struct pool_workqueue *pwq,
+				 struct work_struct *work)
+{
+	return 0;
+}
+static inline void wq_stats_done(struct pool_workqueue *pwq,
+				 work_func_t func, u64 start) { }
+#endif /* CONFIG_WQ_LATENCY_STATS */
+
 /**
  * insert_work - insert a work into a pool
  * @pwq: pwq @work belongs to
@@ -1357,6 +1488,8 @@ static void insert_work(struct pool_workqueue *pwq, struct work_struct *work,
 	/* record the work call stack in order to print it in KASAN reports */
 	kasan_record_aux_stack_noalloc(work);
 
+	wq_stats_queue(work);
+
 	/* we own @work, set data and link */
 	set_work_pwq(work, pwq, extra_flags);
 	list_add_tail(&work->entry, head);
@@ -2187,6 +2320,7 @@ __acquires(&pool->lock)
 	bool cpu_intensive = pwq->wq->flags & WQ_CPU_INTENSIVE;
 	unsigned long work_data;
 	struct worker *collision;
+	u64 stats_start;
 #ifdef CONFIG_LOCKDEP
 	/*
 	 * It is permissible to free the struct work_struct from
@@ -2251,6 +2385,9 @@ __acquires(&pool->lock)
 	if (need_more_worker(pool))
 		wake_up_worker(pool);
 
+	/* still PENDING, so @work cannot be requeued under us */
+	stats_start = wq_stats_start(pwq, work);
+
 	/*
 	 * Record the last pool and clear PENDING which should be the last
 	 * update to @work.  Also, do this inside @pool->lock so that
@@ -2292,6 +2429,7 @@ __acquires(&pool->lock)
 	 * point will only record its address.
 	 */
 	trace_workqueue_execute_end(work, worker->current_func);
+	wq_stats_done(pwq, worker->current_func, stats_start);
 	lock_map_release(&lockdep_map);
 	lock_map_release(&pwq->wq->lockdep_map);
 
@@ -3528,6 +3666,7 @@ static void rcu_free_wq(struct rcu_head *rcu)
 	else
 		free_workqueue_attrs(wq->unbound_attrs);
 
+	wq_stats_free(wq);
 	kfree(wq);
 }
 
@@ -4321,6 +4460,9 @@ struct workqueue_struct *alloc_workqueue(const char *fmt,
 			goto err_free_wq;
 	}
 
+	if (wq_stats_alloc(wq))
+		goto err_free_wq;
+
 	va_start(args, max_active);
 	vsnprintf(wq->name, sizeof(wq->name), fmt, args);
 	va_end(args);
@@ -4372,6 +4514,7 @@ struct workqueue_struct *alloc_workqueue(const char *fmt,
 	wq_unregister_lockdep(wq);
 	wq_free_lockdep(wq);
 err_free_wq:
+	wq_stats_free(wq);
 	free_workqueue_attrs(wq->unbound_attrs);
 	kfree(wq);
 	return NULL;
@@ -5793,6 +5936,214 @@ static void workqueue_sysfs_unregister(struct workqueue_struct *wq)
 static void workqueue_sysfs_unregister(struct workqueue_struct *wq)	{ }
 #endif	/* CONFIG_SYSFS */
 
+#ifdef CONFIG_WQ_LATENCY_STATS
+/*
+ * debugfs interface for the latency statistics, in
+ * /sys/kernel/debug/workqueue/:
+ *
+ *  enable	0 or 1, collection is off by default
+ *  latency	per workqueue log2 histograms of queueing and execution time
+ *  funcs	the work functions with the highest total execution time
+ *  reset	write anything to clear all statistics
+ */
+static DEFINE_MUTEX(wq_stats_mutex);	/* serializes enable and disable */
+
+static ssize_t wq_stats_enable_read(struct file *file, char __user *ubuf,
+				    size_t count, loff_t *ppos)
+{
+	char buf[3];
+
+	buf[0] = static_key_enabled(&wq_stats_enabled) ? '1' : '0';
+	buf[1] = '\n';
+	buf[2] = '\0';
+	return simple_read_from_buffer(ubuf, count, ppos, buf, 2);
+}
+
+static ssize_t wq_stats_enable_write(struct file *file,
+				     const char __user *ubuf,
+				     size_t count, loff_t *ppos)
+{
+	bool enable;
+	int ret;
+
+	ret = kstrtobool_from_user(ubuf, count, &enable);
+	if (ret)
+		return ret;
+
+	/*
+	 * Not under wq_pool_mutex: the static key takes the CPU hotplug
+	 * lock, which nests outside wq_pool_mutex.
+	 */
+	mutex_lock(&wq_stats_mutex);
+	if (enable && !static_key_enabled(&wq_stats_enabled)) {
+		WRITE_ONCE(wq_stats_since, local_clock());
+		static_branch_enable(&wq_stats_enabled);
+	} else if (!enable) {
+		static_branch_disable(&wq_stats_enabled);
+	}
+	mutex_unlock(&wq_stats_mutex);
+
+	return count;
+}
+
+static const struct file_operations wq_stats_enable_fops = {
+	.read	= wq_stats_enable_read,
+	.write	= wq_stats_enable_write,
+	.open	= simple_open,
+	.llseek	= default_llseek,
+};
+
+static int wq_stats_latency_show(struct seq_file *m, void *v)
+{
+	struct workqueue_struct *wq;
+	struct wq_lat_stats *sum;
+	unsigned int b;
+	int cpu;
+
+	sum = kmalloc(sizeof(*sum), GFP_KERNEL);
+	if (!sum)
+		return -ENOMEM;
+
+	mutex_lock(&wq_pool_mutex);
+	list_for_each_entry(wq, &workqueues, list) {
+		u64 total = 0;
+
+		memset(sum, 0, sizeof(*sum));
+		for_each_possible_cpu(cpu) {
+			struct wq_lat_stats *st = per_cpu_ptr(wq->lat_stats, cpu);
+
+			for (b = 0; b < WQ_HIST_BUCKETS; b++) {
+				sum->queued[b] += st->queued[b];
+				sum->exec[b] += st->exec[b];
+				total += st->queued[b] + st->exec[b];
+			}
+		}
+		if (!total)
+			continue;
+
+		seq_printf(m, "%s\n%14s %12s %12s\n", wq->name,
+			   "nsecs >=", "queued", "executed");
+		for (b = 0; b < WQ_HIST_BUCKETS; b++) {
+			if (!sum->queued[b] && !sum->exec[b])
+				continue;
+			seq_printf(m, "%14llu %12llu %12llu\n",
+				   b ? 1ULL << b : 0, sum->queued[b],
+				   sum->exec[b]);
+		}
+		seq_putc(m, '\n');
+	}
+	mutex_unlock(&wq_pool_mutex);
+
+	kfree(sum);
+	return 0;
+}
+DEFINE_SHOW_ATTRIBUTE(wq_stats_latency);
+
+struct wq_func_snap {
+	work_func_t		func;
+	u64			count;
+	u64			total_ns;
+	u64			max_ns;
+};
+
+static int wq_func_snap_cmp(const void *a, const void *b)
+{
+	const struct wq_func_snap *sa = a, *sb = b;
+
+	if (sa->total_ns == sb->total_ns)
+		return 0;
+	return sa->total_ns < sb->total_ns ? 1 : -1;
+}
+
+static int wq_stats_funcs_show(struct seq_file *m, void *v)
+{
+	struct wq_func_snap *snap;
+	unsigned int i, nr = 0;
+
+	snap = kmalloc_array(WQ_FUNC_SLOTS, sizeof(*snap), GFP_KERNEL);
+	if (!snap)
+		return -ENOMEM;
+
+	for (i = 0; i < WQ_FUNC_SLOTS; i++) {
+		struct wq_func_stats *fs = &wq_func_stats[i];
+		work_func_t func = READ_ONCE(fs->func);
+
+		if (!func || !atomic64_read(&fs->count))
+			continue;
+		snap[nr].func = func;
+		snap[nr].count = atomic64_read(&fs->count);
+		snap[nr].total_ns = atomic64_read(&fs->total_ns);
+		snap[nr].max_ns = READ_ONCE(fs->max_ns);
+		nr++;
+	}
+	sort(snap, nr, sizeof(*snap), wq_func_snap_cmp, NULL);
+
+	seq_printf(m, "%-48s %10s %12s %10s %10s\n", "function", "count",
+		   "total_us", "avg_us", "max_us");
+	for (i = 0; i < min_t(unsigned int, nr, WQ_FUNC_SHOW); i++)
+		seq_printf(m, "%-48ps %10llu %12llu %10llu %10llu\n",
+			   snap[i].func, snap[i].count,
+			   div_u64(snap[i].total_ns, NSEC_PER_USEC),
+			   div64_u64(snap[i].total_ns, snap[i].count) /
+			   NSEC_PER_USEC,
+			   div_u64(snap[i].max_ns, NSEC_PER_USEC));
+	if (atomic64_read(&wq_func_dropped))
+		seq_printf(m, "%lld executions not attributed, table full\n",
+			   (s64)atomic64_read(&wq_func_dropped));
+
+	kfree(snap);
+	return 0;
+}
+DEFINE_SHOW_ATTRIBUTE(wq_stats_funcs);
+
+static ssize_t wq_stats_reset_write(struct file *file,
+				    const char __user *ubuf,
+				    size_t count, loff_t *ppos)
+{
+	struct workqueue_struct *wq;
+	unsigned int i;
+	int cpu;
+
+	mutex_lock(&wq_pool_mutex);
+	list_for_each_entry(wq, &workqueues, list)
+		for_each_possible_cpu(cpu)
+			memset(per_cpu_ptr(wq->lat_stats, cpu), 0,
+			       sizeof(struct wq_lat_stats));
+	mutex_unlock(&wq_pool_mutex);
+
+	for (i = 0; i < WQ_FUNC_SLOTS; i++) {
+		struct wq_func_stats *fs = &wq_func_stats[i];
+
+		WRITE_ONCE(fs->func, NULL);
+		atomic64_set(&fs->count, 0);
+		atomic64_set(&fs->total_ns, 0);
+		WRITE_ONCE(fs->max_ns, 0);
+	}
+	atomic64_set(&wq_func_dropped, 0);
+
+	return count;
+}
+
+static const struct file_operations wq_stats_reset_fops = {
+	.write	= wq_stats_reset_write,
+	.open	= simple_open,
+	.llseek	= noop_llseek,
+};
+
+static int __init wq_stats_debugfs_init(void)
+{
+	struct dentry *dir = debugfs_create_dir("workqueue", NULL);
+
+	debugfs_create_file("enable", 0644, dir, NULL, &wq_stats_enable_fops);
+	debugfs_create_file("latency", 0444, dir, NULL,
+			    &wq_stats_latency_fops);
+	debugfs_create_file("funcs", 0444, dir, NULL, &wq_stats_funcs_fops);
+	debugfs_create_file("reset", 0200, dir, NULL, &wq_stats_reset_fops);
+	return 0;
+}
+late_initcall(wq_stats_debugfs_init);
+#endif	/* CONFIG_WQ_LATENCY_STATS */
+
 /*
  * Workqueue watchdog.
  *
@@ -147,6 +147,7 @@
 #include <linux/net_namespace.h>
 #include <linux/indirect_call_wrapper.h>
 #include <net/devlink.h>
+#include <net/xdp_sock.h>
 #include <linux/pm_runtime.h>
 #include <linux/prandom.h>
 #include <linux/once_lite.h>
@@ -4349,6 +4350,7 @@ static inline void ____napi_schedule(struct softnet_data *sd,
 			 */
 			if (READ_ONCE(thread->__state) != TASK_INTERRUPTIBLE)
 				set_bit(NAPI_STATE_SCHED_THREADED, &napi->state);
+			WRITE_ONCE(napi->irq_cpu, smp_processor_id());
 			wake_up_process(thread);
 			return;
 		}
@@ -6359,6 +6361,7 @@ void netif_napi_add_weight(struct net_device *dev, struct napi_struct *napi,
 	napi->skb = NULL;
 	INIT_LIST_HEAD(&napi->rx_list);
 	napi->rx_count = 0;
+	napi->irq_cpu = -1;
 	napi->poll = poll;
 	if (weight > NAPI_POLL_WEIGHT)
 		netdev_err_once(dev, "%s() called with weight %d\n", __func__,
@@ -6586,16 +6589,27 @@ static int napi_threaded_poll(void *data)
 
 	while (!napi_thread_wait(napi)) {
 		for (;;) {
+			bool placement = READ_ONCE(sysctl_napi_placement);
 			bool repoll = false;
+			u64 start = 0;
+
+			if (placement)
+				start = local_clock();
 
 			local_bh_disable();
 
 			have = netpoll_poll_lock(napi);
+			xsk_generic_batch_begin();
 			__napi_poll(napi, &repoll);
+			xsk_generic_batch_end();
 			netpoll_poll_unlock(have);
 
 			local_bh_enable();
 
+			if (placement)
+				WRITE_ONCE(napi->poll_ns,
+					   napi->poll_ns + local_clock() - start);
+
 			if (!repoll)
 				break;
 
@@ -6652,7 +6666,9 @@ static __latent_entropy void net_rx_action(struct softirq_action *h)
 		}
 
 		n = list_first_entry(&list, struct napi_struct, poll_list);
+		xsk_generic_batch_begin();
 		budget -= napi_poll(n, &repoll);
+		xsk_generic_batch_end();
 
 		/* If softirq window is exhausted then punt.
 		 * Allow this to run for 2 jiffies since which will allow
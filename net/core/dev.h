@@ -45,6 +45,12 @@ extern int		netdev_unregister_timeout_secs;
 extern int		weight_p;
 extern int		dev_weight_rx_bias;
 extern int		dev_weight_tx_bias;
+extern int		sysctl_napi_placement;
+extern unsigned int	sysctl_napi_placement_interval_ms;
+
+struct ctl_table;
+int napi_placement_sysctl_handler(struct ctl_table *table, int write,
+				  void *buffer, size_t *lenp, loff_t *ppos);
 
 /* rtnl helpers */
 extern struct list_head net_todo_list;
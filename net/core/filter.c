@@ -4341,10 +4341,9 @@ static int xdp_do_generic_redirect_map(struct net_device *dev,
 			goto err;
 		break;
 	case BPF_MAP_TYPE_XSKMAP:
-		err = xsk_generic_rcv(fwd, xdp);
+		err = xsk_generic_redirect(fwd, xdp, skb);
 		if (err)
 			goto err;
-		consume_skb(skb);
 		break;
 	case BPF_MAP_TYPE_CPUMAP:
 		err = cpu_map_generic_redirect(fwd, skb);
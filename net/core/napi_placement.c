@@ -0,0 +1,289 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+/*
+ * CPU placement of threaded NAPI kthreads.
+ *
+ * With net.core.napi_placement set, the kthreads of threaded NAPI instances
+ * are periodically moved away from the CPU that schedules them from the
+ * device interrupt and from the CPU where most socket consumers recorded by
+ * RFS run, towards the CPU that spent the least time in softirq and NAPI
+ * polling during the last interval. Mode 1 ("prefer") allows the thread on
+ * every remaining CPU, mode 2 ("pin") binds it to the cheapest one. Setting
+ * the mode back to 0 gives the threads their default affinity again.
+ *
+ * Decisions are reported by the napi:napi_thread_placement tracepoint and
+ * the current placement of each device is shown in
+ * /sys/class/net/<dev>/threaded_placement.
+ */
+
+#include <linux/kernel_stat.h>
+#include <linux/netdevice.h>
+#include <linux/rtnetlink.h>
+#include <linux/sched/isolation.h>
+#include <linux/sched/task.h>
+#include <linux/sysctl.h>
+#include <linux/workqueue.h>
+#include <net/net_namespace.h>
+#include <trace/events/napi.h>
+
+#include "dev.h"
+
+#define NAPI_PLACEMENT_MAX	64
+
+int sysctl_napi_placement __read_mostly;
+unsigned int sysctl_napi_placement_interval_ms __read_mostly = 1000;
+
+struct napi_placement_thread {
+	struct task_struct	*task;
+	char			dev_name[IFNAMSIZ];
+	unsigned int		napi_id;
+	int			irq_cpu;
+	int			cpu;		/* where it ran when collected */
+	u64			poll_ns;	/* during the last interval */
+};
+
+/* Only used by the work item, which never runs concurrently with itself */
+static struct napi_placement_thread napi_pl_threads[NAPI_PLACEMENT_MAX];
+static struct cpumask napi_pl_candidates;
+static bool napi_pl_active;
+
+struct napi_placement_cpu {
+	u64		softirq_prev;
+	u64		cost;		/* softirq and NAPI time, last interval */
+	unsigned int	flows;		/* RFS flows last consumed here */
+};
+
+static DEFINE_PER_CPU(struct napi_placement_cpu, napi_pl_cpu);
+
+static inline u64 *napi_pl_cost(int cpu)
+{
+	return &per_cpu_ptr(&napi_pl_cpu, cpu)->cost;
+}
+
+static void napi_placement_work_fn(struct work_struct *work);
+static DECLARE_DELAYED_WORK(napi_placement_work, napi_placement_work_fn);
+
+static int napi_placement_collect(u64 interval_ns)
+{
+	struct napi_struct *napi;
+	struct net_device *dev;
+	struct net *net;
+	int nr = 0;
+
+	/* napi->thread is not RCU managed: RTNL keeps it from being stopped
+	 * by napi deletion or dev_set_threaded() until we hold a reference.
+	 */
+	rtnl_lock();
+	rcu_read_lock();
+	for_each_net_rcu(net) {
+		for_each_netdev_rcu(net, dev) {
+			list_for_each_entry_rcu(napi, &dev->napi_list,
+						dev_list) {
+				struct napi_placement_thread *t;
+				struct task_struct *task;
+				u64 poll_ns;
+
+				task = READ_ONCE(napi->thread);
+				if (!task ||
+				    !test_bit(NAPI_STATE_THREADED, &napi->state))
+					continue;
+				if (nr == NAPI_PLACEMENT_MAX)
+					goto out;
+
+				t = &napi_pl_threads[nr++];
+				get_task_struct(task);
+				t->task = task;
+				strscpy(t->dev_name, dev->name, IFNAMSIZ);
+				t->napi_id = napi->napi_id;
+				t->irq_cpu = READ_ONCE(napi->irq_cpu);
+
+				/* May tear on 32-bit, bound the damage */
+				poll_ns = READ_ONCE(napi->poll_ns);
+				t->poll_ns = min(poll_ns - napi->poll_ns_seen,
+						 interval_ns);
+				napi->poll_ns_seen = poll_ns;
+			}
+		}
+	}
+out:
+	rcu_read_unlock();
+	rtnl_unlock();
+
+	return nr;
+}
+
+#ifdef CONFIG_RPS
+/* The CPU the most RFS-recorded flows were last consumed on, or -1 */
+static int napi_placement_consumer_cpu(void)
+{
+	struct rps_sock_flow_table *table;
+	unsigned int i, step, best = 0;
+	int cpu, best_cpu = -1;
+
+	for_each_possible_cpu(cpu)
+		per_cpu_ptr(&napi_pl_cpu, cpu)->flows = 0;
+
+	rcu_read_lock();
+	table = rcu_dereference(rps_sock_flow_table);
+	if (table) {
+		/* Sample large tables rather than walking all of them */
+		step = max(1U, (table->mask + 1) / 4096);
+		for (i = 0; i <= table->mask; i += step) {
+			u32 ent = READ_ONCE(table->ents[i]) & rps_cpu_mask;
+
+			if (ent < nr_cpu_ids && cpu_possible(ent))
+				per_cpu_ptr(&napi_pl_cpu, ent)->flows++;
+		}
+	}
+	rcu_read_unlock();
+
+	for_each_possible_cpu(cpu) {
+		if (per_cpu_ptr(&napi_pl_cpu, cpu)->flows > best) {
+			best = per_cpu_ptr(&napi_pl_cpu, cpu)->flows;
+			best_cpu = cpu;
+		}
+	}
+
+	return best_cpu;
+}
+#else
+static int napi_placement_consumer_cpu(void)
+{
+	return -1;
+}
+#endif
+
+/* Softirq time spent by each CPU since the last call, plus the polling
+ * time of the @nr collected threads on the CPU they currently run on. The
+ * threads poll in task context, so their time is accounted as system time
+ * and not as softirq.
+ */
+static void napi_placement_cost(u64 interval_ns, int nr)
+{
+	struct napi_placement_thread *t;
+	int cpu, i;
+
+	for_each_possible_cpu(cpu) {
+		struct napi_placement_cpu *pc = per_cpu_ptr(&napi_pl_cpu, cpu);
+		u64 now = kcpustat_cpu(cpu).cpustat[CPUTIME_SOFTIRQ];
+
+		pc->cost = min(now - pc->softirq_prev, interval_ns);
+		pc->softirq_prev = now;
+	}
+
+	for (i = 0; i < nr; i++) {
+		t = &napi_pl_threads[i];
+		t->cpu = task_cpu(t->task);
+		*napi_pl_cost(t->cpu) += t->poll_ns;
+	}
+}
+
+/* Fill napi_pl_candidates with the CPUs @t may run on, most preferred
+ * constraints first: neither the interrupt nor the consumer CPU, then not
+ * the interrupt CPU, then anything.
+ */
+static void napi_placement_candidates(struct napi_placement_thread *t,
+				      int consumer_cpu)
+{
+	const struct cpumask *base = housekeeping_cpumask(HK_TYPE_KTHREAD);
+
+	cpumask_and(&napi_pl_candidates, base, cpu_online_mask);
+	if (t->irq_cpu >= 0)
+		cpumask_clear_cpu(t->irq_cpu, &napi_pl_candidates);
+	if (consumer_cpu >= 0 &&
+	    cpumask_weight(&napi_pl_candidates) > 1)
+		cpumask_clear_cpu(consumer_cpu, &napi_pl_candidates);
+	if (cpumask_empty(&napi_pl_candidates))
+		cpumask_and(&napi_pl_candidates, base, cpu_online_mask);
+}
+
+static void napi_placement_place(struct napi_placement_thread *t, int mode,
+				 int consumer_cpu, u64 interval_ns)
+{
+	int cur = t->cpu;
+	int cpu, best = -1;
+
+	napi_placement_candidates(t, consumer_cpu);
+
+	/* Move the thread's own time off the CPU it runs on while choosing,
+	 * it is charged again to the CPU it ends up on.
+	 */
+	*napi_pl_cost(cur) -= min(*napi_pl_cost(cur), t->poll_ns);
+
+	for_each_cpu(cpu, &napi_pl_candidates) {
+		if (best < 0 || *napi_pl_cost(cpu) < *napi_pl_cost(best))
+			best = cpu;
+	}
+	if (best < 0) {
+		*napi_pl_cost(cur) += t->poll_ns;
+		return;
+	}
+
+	/* Do not ping-pong between CPUs with about the same load */
+	if (cpumask_test_cpu(cur, &napi_pl_candidates) &&
+	    *napi_pl_cost(cur) <= *napi_pl_cost(best) + (interval_ns >> 3))
+		best = cur;
+
+	if (mode == 2) {
+		cpumask_clear(&napi_pl_candidates);
+		cpumask_set_cpu(best, &napi_pl_candidates);
+	}
+	*napi_pl_cost(best) += t->poll_ns;
+
+	if (cpumask_equal(t->task->cpus_ptr, &napi_pl_candidates))
+		return;
+
+	trace_napi_thread_placement(t->dev_name, t->napi_id, t->irq_cpu,
+				    consumer_cpu, best, &napi_pl_candidates);
+	set_cpus_allowed_ptr(t->task, &napi_pl_candidates);
+}
+
+static void napi_placement_work_fn(struct work_struct *work)
+{
+	unsigned int interval_ms = READ_ONCE(sysctl_napi_placement_interval_ms);
+	int mode = READ_ONCE(sysctl_napi_placement);
+	u64 interval_ns = (u64)interval_ms * NSEC_PER_MSEC;
+	int consumer_cpu, nr, i;
+
+	nr = napi_placement_collect(interval_ns);
+
+	if (!mode) {
+		/* Policy switched off: hand the threads back */
+		for (i = 0; i < nr; i++) {
+			if (napi_pl_active)
+				set_cpus_allowed_ptr(napi_pl_threads[i].task,
+					housekeeping_cpumask(HK_TYPE_KTHREAD));
+			put_task_struct(napi_pl_threads[i].task);
+		}
+		napi_pl_active = false;
+		return;
+	}
+
+	napi_pl_active = true;
+	napi_placement_cost(interval_ns, nr);
+	consumer_cpu = napi_placement_consumer_cpu();
+
+	for (i = 0; i < nr; i++) {
+		if (nr_cpu_ids > 1)
+			napi_placement_place(&napi_pl_threads[i], mode,
+					     consumer_cpu, interval_ns);
+		put_task_struct(napi_pl_threads[i].task);
+	}
+
+	schedule_delayed_work(&napi_placement_work,
+			      msecs_to_jiffies(interval_ms));
+}
+
+int napi_placement_sysctl_handler(struct ctl_table *table, int write,
+				  void *buffer, size_t *lenp, loff_t *ppos)
+{
+	static DEFINE_MUTEX(napi_placement_mutex);
+	int ret;
+
+	mutex_lock(&napi_placement_mutex);
+	ret = proc_dointvec_minmax(table, write, buffer, lenp, ppos);
+	if (!ret && write)
+		mod_delayed_work(system_wq, &napi_placement_work, 0);
+	mutex_unlock(&napi_placement_mutex);
+
+	return ret;
+}
@@ -620,6 +620,39 @@ static ssize_t threaded_store(struct device *dev,
 }
 static DEVICE_ATTR_RW(threaded);
 
+/* One line per NAPI kthread: napi id, current CPU, interrupt CPU, allowed
+ * CPUs and total polling time, see net.core.napi_placement.
+ */
+static ssize_t threaded_placement_show(struct device *dev,
+				       struct device_attribute *attr,
+				       char *buf)
+{
+	struct net_device *netdev = to_net_dev(dev);
+	struct napi_struct *n;
+	ssize_t ret = 0;
+
+	if (!rtnl_trylock())
+		return restart_syscall();
+
+	if (dev_isalive(netdev)) {
+		list_for_each_entry(n, &netdev->napi_list, dev_list) {
+			if (!n->thread)
+				continue;
+			ret += sysfs_emit_at(buf, ret,
+					     "%u cpu %d irq_cpu %d allowed %*pbl poll_us %llu\n",
+					     n->napi_id, task_cpu(n->thread),
+					     READ_ONCE(n->irq_cpu),
+					     cpumask_pr_args(n->thread->cpus_ptr),
+					     div_u64(READ_ONCE(n->poll_ns),
+						     NSEC_PER_USEC));
+		}
+	}
+
+	rtnl_unlock();
+	return ret;
+}
+static DEVICE_ATTR_RO(threaded_placement);
+
 static struct attribute *net_class_attrs[] __ro_after_init = {
 	&dev_attr_netdev_group.attr,
 	&dev_attr_type.attr,
@@ -653,6 +686,7 @@ static struct attribute *net_class_attrs[] __ro_after_init = {
 	&dev_attr_carrier_up_count.attr,
 	&dev_attr_carrier_down_count.attr,
 	&dev_attr_threaded.attr,
+	&dev_attr_threaded_placement.attr,
 	NULL,
 };
 ATTRIBUTE_GROUPS(net_class);
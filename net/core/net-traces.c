@@ -58,6 +58,7 @@ EXPORT_TRACEPOINT_SYMBOL_GPL(neigh_cleanup_and_release);
 EXPORT_TRACEPOINT_SYMBOL_GPL(kfree_skb);
 
 EXPORT_TRACEPOINT_SYMBOL_GPL(napi_poll);
+EXPORT_TRACEPOINT_SYMBOL_GPL(napi_thread_placement);
 
 EXPORT_TRACEPOINT_SYMBOL_GPL(tcp_send_reset);
 EXPORT_TRACEPOINT_SYMBOL_GPL(tcp_bad_csum);
@@ -29,6 +29,7 @@ static int int_3600 = 3600;
 static int min_sndbuf = SOCK_MIN_SNDBUF;
 static int min_rcvbuf = SOCK_MIN_RCVBUF;
 static int max_skb_frags = MAX_SKB_FRAGS;
+static unsigned int napi_placement_min_interval = 100;
 
 static int net_msg_warn;	/* Unused, but still a sysctl */
 
@@ -544,6 +545,23 @@ static struct ctl_table net_core_table[] = {
 		.proc_handler	= proc_dointvec_minmax,
 		.extra1		= SYSCTL_ZERO,
 	},
+	{
+		.procname	= "napi_placement",
+		.data		= &sysctl_napi_placement,
+		.maxlen		= sizeof(int),
+		.mode		= 0644,
+		.proc_handler	= napi_placement_sysctl_handler,
+		.extra1		= SYSCTL_ZERO,
+		.extra2		= SYSCTL_TWO,
+	},
+	{
+		.procname	= "napi_placement_interval_ms",
+		.data		= &sysctl_napi_placement_interval_ms,
+		.maxlen		= sizeof(unsigned int),
+		.mode		= 0644,
+		.proc_handler	= proc_douintvec_minmax,
+		.extra1		= &napi_placement_min_interval,
+	},
 	{
 		.procname	= "fb_tunnels_only_for_init_net",
 		.data		= &sysctl_fb_tunnels_only_for_init_net,
@@ -12,6 +12,10 @@
  *  Flows are dynamically allocated and stored in a hash table of RB trees
  *  They are also part of one Round Robin 'queues' (new or old flows)
  *
+ *  With many paced flows, the qdisc can instead be created with a hash table
+ *  of plain lists and a hierarchical timer wheel for throttled flows
+ *  (TCA_FQ_TIMER_WHEEL), which keeps enqueue/dequeue O(1) in the flow count.
+ *
  *  Burst avoidance (aka pacing) capability :
  *
  *  Transport (eg TCP) can set in sk->sk_pacing_rate a rate, enqueue a
@@ -42,6 +46,7 @@
 #include <linux/slab.h>
 #include <linux/rbtree.h>
 #include <linux/hash.h>
+#include <linux/list_sort.h>
 #include <linux/prefetch.h>
 #include <linux/vmalloc.h>
 #include <net/netlink.h>
@@ -73,18 +78,25 @@ struct fq_flow {
 		struct sk_buff *tail;	/* last skb in the list */
 		unsigned long  age;	/* (jiffies | 1UL) when flow was emptied, for gc */
 	};
-	struct rb_node	fq_node;	/* anchor in fq_root[] trees */
+	union {
+		struct rb_node	  fq_node;	/* anchor in fq_root[] trees */
+		struct hlist_node fq_hnode;	/* anchor in fq_hash[] lists */
+	};
 	struct sock	*sk;
 	u32		socket_hash;	/* sk_hash */
 	int		qlen;		/* number of packets in flow queue */
 
 /* Second cache line, used in fq_dequeue() */
 	int		credit;
-	/* 32bit hole on 64bit arches */
+	u16		wheel_slot;	/* level and slot in q->wheel */
+	/* 16bit hole on 64bit arches */
 
 	struct fq_flow *next;		/* next pointer in RR lists */
 
-	struct rb_node  rate_node;	/* anchor in q->delayed tree */
+	union {
+		struct rb_node   rate_node;	/* anchor in q->delayed tree */
+		struct list_head wheel_node;	/* anchor in q->wheel slots */
+	};
 	u64		time_next_packet;
 } ____cacheline_aligned_in_smp;
 
@@ -93,12 +105,32 @@ struct fq_flow_head {
 	struct fq_flow *last;
 };
 
+/*
+ * Hierarchical timer wheel for throttled flows.
+ * Level L has FQ_WHEEL_SLOTS slots, each covering
+ * 2^(FQ_WHEEL_GRAN_SHIFT + L * FQ_WHEEL_BITS) ns. A flow is queued in the
+ * lowest level able to hold its time_next_packet, and moved to a lower
+ * level when its slot is reached before it is due.
+ */
+#define FQ_WHEEL_GRAN_SHIFT	10	/* ~1 usec level 0 slots */
+#define FQ_WHEEL_BITS		6
+#define FQ_WHEEL_SLOTS		(1U << FQ_WHEEL_BITS)
+#define FQ_WHEEL_MASK		(FQ_WHEEL_SLOTS - 1)
+#define FQ_WHEEL_LEVELS		4
+
+struct fq_wheel {
+	u64			clk;	/* in (1 << FQ_WHEEL_GRAN_SHIFT) ns units */
+	u64			pending[FQ_WHEEL_LEVELS];
+	struct list_head	slots[FQ_WHEEL_LEVELS][FQ_WHEEL_SLOTS];
+};
+
 struct fq_sched_data {
 	struct fq_flow_head new_flows;
 
 	struct fq_flow_head old_flows;
 
 	struct rb_root	delayed;	/* for rate limited flows */
+	struct fq_wheel	*wheel;		/* replaces delayed, if selected */
 	u64		time_next_delayed_flow;
 	u64		ktime_cache;	/* copy of last ktime_get_ns() */
 	unsigned long	unthrottle_latency_ns;
@@ -113,7 +145,10 @@ struct fq_sched_data {
 	u64		horizon;	/* horizon in ns */
 	u32		orphan_mask;	/* mask for orphaned skb */
 	u32		low_rate_threshold;
-	struct rb_root	*fq_root;
+	union {
+		struct rb_root	  *fq_root;
+		struct hlist_head *fq_hash;	/* if q->wheel */
+	};
 	u8		rate_enable;
 	u8		fq_trees_log;
 	u8		horizon_drop;
@@ -169,9 +204,59 @@ static void fq_flow_add_tail(struct fq_flow_head *head, struct fq_flow *flow)
 	flow->next = NULL;
 }
 
+static void fq_wheel_init(struct fq_wheel *w)
+{
+	unsigned int lvl, idx;
+
+	for (lvl = 0; lvl < FQ_WHEEL_LEVELS; lvl++) {
+		w->pending[lvl] = 0;
+		for (idx = 0; idx < FQ_WHEEL_SLOTS; idx++)
+			INIT_LIST_HEAD(&w->slots[lvl][idx]);
+	}
+}
+
+static void fq_wheel_insert(struct fq_wheel *w, struct fq_flow *f)
+{
+	u64 expires = f->time_next_packet >> FQ_WHEEL_GRAN_SHIFT;
+	unsigned int lvl, shift = 0, idx;
+	u64 base;
+
+	if (expires < w->clk)
+		expires = w->clk;
+
+	for (lvl = 0; lvl < FQ_WHEEL_LEVELS - 1; lvl++) {
+		if ((expires >> shift) - (w->clk >> shift) < FQ_WHEEL_SLOTS)
+			break;
+		shift += FQ_WHEEL_BITS;
+	}
+	base = w->clk >> shift;
+	expires >>= shift;
+	/* Beyond the wheel: park in the last slot, requeued when reached */
+	if (expires - base > FQ_WHEEL_MASK)
+		expires = base + FQ_WHEEL_MASK;
+	idx = expires & FQ_WHEEL_MASK;
+
+	list_add_tail(&f->wheel_node, &w->slots[lvl][idx]);
+	w->pending[lvl] |= 1ULL << idx;
+	f->wheel_slot = lvl * FQ_WHEEL_SLOTS + idx;
+}
+
+static void fq_wheel_remove(struct fq_wheel *w, struct fq_flow *f)
+{
+	unsigned int lvl = f->wheel_slot / FQ_WHEEL_SLOTS;
+	unsigned int idx = f->wheel_slot & FQ_WHEEL_MASK;
+
+	list_del(&f->wheel_node);
+	if (list_empty(&w->slots[lvl][idx]))
+		w->pending[lvl] &= ~(1ULL << idx);
+}
+
 static void fq_flow_unset_throttled(struct fq_sched_data *q, struct fq_flow *f)
 {
-	rb_erase(&f->rate_node, &q->delayed);
+	if (q->wheel)
+		fq_wheel_remove(q->wheel, f);
+	else
+		rb_erase(&f->rate_node, &q->delayed);
 	q->throttled_flows--;
 	fq_flow_add_tail(&q->old_flows, f);
 }
@@ -180,6 +265,14 @@ static void fq_flow_set_throttled(struct fq_sched_data *q, struct fq_flow *f)
 {
 	struct rb_node **p = &q->delayed.rb_node, *parent = NULL;
 
+	if (q->wheel) {
+		/* An empty wheel can be moved forward for free */
+		if (!q->throttled_flows)
+			q->wheel->clk = q->ktime_cache >> FQ_WHEEL_GRAN_SHIFT;
+		fq_wheel_insert(q->wheel, f);
+		goto out;
+	}
+
 	while (*p) {
 		struct fq_flow *aux;
 
@@ -192,6 +285,7 @@ static void fq_flow_set_throttled(struct fq_sched_data *q, struct fq_flow *f)
 	}
 	rb_link_node(&f->rate_node, parent, p);
 	rb_insert_color(&f->rate_node, &q->delayed);
+out:
 	q->throttled_flows++;
 	q->stat_throttled++;
 
@@ -258,6 +352,120 @@ static void fq_gc(struct fq_sched_data *q,
 	kmem_cache_free_bulk(fq_flow_cachep, fcnt, tofree);
 }
 
+static void fq_hash_gc(struct fq_sched_data *q,
+		       struct hlist_head *head,
+		       struct sock *sk)
+{
+	void *tofree[FQ_GC_MAX];
+	struct fq_flow *f;
+	int i, fcnt = 0;
+
+	hlist_for_each_entry(f, head, fq_hnode) {
+		if (f->sk == sk)
+			break;
+
+		if (fq_gc_candidate(f)) {
+			tofree[fcnt++] = f;
+			if (fcnt == FQ_GC_MAX)
+				break;
+		}
+	}
+
+	if (!fcnt)
+		return;
+
+	for (i = 0; i < fcnt; i++) {
+		f = tofree[i];
+		hlist_del(&f->fq_hnode);
+	}
+	q->flows -= fcnt;
+	q->inactive_flows -= fcnt;
+	q->stat_gc_flows += fcnt;
+
+	kmem_cache_free_bulk(fq_flow_cachep, fcnt, tofree);
+}
+
+/* Called when the flow of @sk was found in the flow table */
+static void fq_flow_found(struct sk_buff *skb, struct fq_sched_data *q,
+			  struct fq_flow *f)
+{
+	struct sock *sk = f->sk;
+
+	/* socket might have been reallocated, so check
+	 * if its sk_hash is the same.
+	 * It not, we need to refill credit with
+	 * initial quantum
+	 */
+	if (unlikely(skb->sk == sk &&
+		     f->socket_hash != sk->sk_hash)) {
+		f->credit = q->initial_quantum;
+		f->socket_hash = sk->sk_hash;
+		if (q->rate_enable)
+			smp_store_release(&sk->sk_pacing_status,
+					  SK_PACING_FQ);
+		if (fq_flow_is_throttled(f))
+			fq_flow_unset_throttled(q, f);
+		f->time_next_packet = 0ULL;
+	}
+}
+
+/* Allocate a new flow for @sk, the caller links it in the flow table */
+static struct fq_flow *fq_flow_alloc(struct sk_buff *skb,
+				     struct fq_sched_data *q,
+				     struct sock *sk)
+{
+	struct fq_flow *f;
+
+	f = kmem_cache_zalloc(fq_flow_cachep, GFP_ATOMIC | __GFP_NOWARN);
+	if (unlikely(!f)) {
+		q->stat_allocation_errors++;
+		return NULL;
+	}
+	/* f->t_root is already zeroed after kmem_cache_zalloc() */
+
+	fq_flow_set_detached(f);
+	f->sk = sk;
+	if (skb->sk == sk) {
+		f->socket_hash = sk->sk_hash;
+		if (q->rate_enable)
+			smp_store_release(&sk->sk_pacing_status,
+					  SK_PACING_FQ);
+	}
+	f->credit = q->initial_quantum;
+
+	q->flows++;
+	q->inactive_flows++;
+	return f;
+}
+
+static struct fq_flow *fq_hash_classify(struct sk_buff *skb,
+					struct fq_sched_data *q,
+					struct sock *sk)
+{
+	struct hlist_head *head;
+	struct fq_flow *f;
+
+	head = &q->fq_hash[hash_ptr(sk, q->fq_trees_log)];
+
+	if (q->flows >= (2U << q->fq_trees_log) &&
+	    q->inactive_flows > q->flows/2)
+		fq_hash_gc(q, head, sk);
+
+	hlist_for_each_entry(f, head, fq_hnode) {
+		if (f->sk == sk) {
+			fq_flow_found(skb, q, f);
+			return f;
+		}
+	}
+
+	f = fq_flow_alloc(skb, q, sk);
+	if (unlikely(!f))
+		return &q->internal;
+
+	hlist_add_head(&f->fq_hnode, head);
+	return f;
+}
+
 static struct fq_flow *fq_classify(struct sk_buff *skb, struct fq_sched_data *q)
 {
 	struct rb_node **p, *parent;
@@ -299,6 +507,9 @@ static struct fq_flow *fq_classify(struct sk_buff *skb, struct fq_sched_data *q)
 		sk = (struct sock *)((hash << 1) | 1UL);
 	}
 
+	if (q->wheel)
+		return fq_hash_classify(skb, q, sk);
+
 	root = &q->fq_root[hash_ptr(sk, q->fq_trees_log)];
 
 	if (q->flows >= (2U << q->fq_trees_log) &&
@@ -312,22 +523,7 @@ static struct fq_flow *fq_classify(struct sk_buff *skb, struct fq_sched_data *q)
 
 		f = rb_entry(parent, struct fq_flow, fq_node);
 		if (f->sk == sk) {
-			/* socket might have been reallocated, so check
-			 * if its sk_hash is the same.
-			 * It not, we need to refill credit with
-			 * initial quantum
-			 */
-			if (unlikely(skb->sk == sk &&
-				     f->socket_hash != sk->sk_hash)) {
-				f->credit = q->initial_quantum;
-				f->socket_hash = sk->sk_hash;
-				if (q->rate_enable)
-					smp_store_release(&sk->sk_pacing_status,
-							  SK_PACING_FQ);
-				if (fq_flow_is_throttled(f))
-					fq_flow_unset_throttled(q, f);
-				f->time_next_packet = 0ULL;
-			}
+			fq_flow_found(skb, q, f);
 			return f;
 		}
 		if (f->sk > sk)
@@ -336,28 +532,12 @@ static struct fq_flow *fq_classify(struct sk_buff *skb, struct fq_sched_data *q)
 			p = &parent->rb_left;
 	}
 
-	f = kmem_cache_zalloc(fq_flow_cachep, GFP_ATOMIC | __GFP_NOWARN);
-	if (unlikely(!f)) {
-		q->stat_allocation_errors++;
+	f = fq_flow_alloc(skb, q, sk);
+	if (unlikely(!f))
 		return &q->internal;
-	}
-	/* f->t_root is already zeroed after kmem_cache_zalloc() */
-
-	fq_flow_set_detached(f);
-	f->sk = sk;
-	if (skb->sk == sk) {
-		f->socket_hash = sk->sk_hash;
-		if (q->rate_enable)
-			smp_store_release(&sk->sk_pacing_status,
-					  SK_PACING_FQ);
-	}
-	f->credit = q->initial_quantum;
 
 	rb_link_node(&f->fq_node, parent, p);
 	rb_insert_color(&f->fq_node, root);
-
-	q->flows++;
-	q->inactive_flows++;
 	return f;
 }
 
@@ -496,20 +676,119 @@ static int fq_enqueue(struct sk_buff *skb, struct Qdisc *sch,
 	return NET_XMIT_SUCCESS;
 }
 
+/* Earliest time a throttled flow can be due. Exact for level 0, the start
+ * of the first pending slot for the upper levels.
+ */
+static u64 fq_wheel_next(const struct fq_wheel *w)
+{
+	unsigned int lvl, shift = 0;
+	u64 next = ~0ULL;
+
+	for (lvl = 0; lvl < FQ_WHEEL_LEVELS; lvl++, shift += FQ_WHEEL_BITS) {
+		u64 base = w->clk >> shift;
+		unsigned int off, start = base & FQ_WHEEL_MASK;
+		struct fq_flow *f;
+
+		if (!w->pending[lvl])
+			continue;
+		off = __ffs64(ror64(w->pending[lvl], start));
+		if (lvl) {
+			next = min(next, (base + off) <<
+					 (shift + FQ_WHEEL_GRAN_SHIFT));
+			continue;
+		}
+		list_for_each_entry(f, &w->slots[0][(start + off) & FQ_WHEEL_MASK],
+				    wheel_node)
+			next = min(next, f->time_next_packet);
+	}
+	return next;
+}
+
+/* Update unthrottle latency EWMA.
+ * This is cheap and can help diagnosing timer/latency problems.
+ */
+static void fq_unthrottle_latency(struct fq_sched_data *q, u64 sample)
+{
+	q->unthrottle_latency_ns -= q->unthrottle_latency_ns >> 3;
+	q->unthrottle_latency_ns += (unsigned long)sample >> 3;
+}
+
+static int fq_flow_due_cmp(void *priv, const struct list_head *a,
+			   const struct list_head *b)
+{
+	const struct fq_flow *fa = list_entry(a, struct fq_flow, wheel_node);
+	const struct fq_flow *fb = list_entry(b, struct fq_flow, wheel_node);
+
+	return fa->time_next_packet > fb->time_next_packet;
+}
+
+static void fq_wheel_check_throttled(struct fq_sched_data *q, u64 now)
+{
+	u64 clk = now >> FQ_WHEEL_GRAN_SHIFT;
+	struct fq_wheel *w = q->wheel;
+	unsigned int lvl, shift = 0;
+	struct fq_flow *f, *tmp;
+	LIST_HEAD(reached);
+	LIST_HEAD(due);
+
+	/* Collect the slots between the last run and now, level by level */
+	for (lvl = 0; lvl < FQ_WHEEL_LEVELS; lvl++, shift += FQ_WHEEL_BITS) {
+		u64 first = w->clk >> shift, last = clk >> shift;
+		unsigned int idx, start = first & FQ_WHEEL_MASK;
+		u64 due = ~0ULL;
+
+		if (last - first < FQ_WHEEL_MASK)
+			due = rol64(GENMASK_ULL(last - first, 0), start);
+		due &= w->pending[lvl];
+		w->pending[lvl] &= ~due;
+
+		while (due) {
+			idx = (__ffs64(ror64(due, start)) + start) & FQ_WHEEL_MASK;
+			due &= ~(1ULL << idx);
+			list_splice_tail_init(&w->slots[lvl][idx], &reached);
+		}
+	}
+	w->clk = clk;
+
+	list_for_each_entry_safe(f, tmp, &reached, wheel_node) {
+		if (f->time_next_packet > now) {
+			list_del(&f->wheel_node);
+			fq_wheel_insert(w, f);
+		} else {
+			list_move_tail(&f->wheel_node, &due);
+		}
+	}
+	q->time_next_delayed_flow = fq_wheel_next(w);
+
+	/* A wakeup for an upper level slot may only have cascaded flows */
+	if (list_empty(&due))
+		return;
+
+	/* Unthrottle in time_next_packet order, as the rbtree does */
+	list_sort(NULL, &due, fq_flow_due_cmp);
+	f = list_first_entry(&due, struct fq_flow, wheel_node);
+	fq_unthrottle_latency(q, now - f->time_next_packet);
+
+	list_for_each_entry_safe(f, tmp, &due, wheel_node) {
+		list_del(&f->wheel_node);
+		q->throttled_flows--;
+		fq_flow_add_tail(&q->old_flows, f);
+	}
+}
+
 static void fq_check_throttled(struct fq_sched_data *q, u64 now)
 {
-	unsigned long sample;
 	struct rb_node *p;
 
 	if (q->time_next_delayed_flow > now)
 		return;
 
-	/* Update unthrottle latency EWMA.
-	 * This is cheap and can help diagnosing timer/latency problems.
-	 */
-	sample = (unsigned long)(now - q->time_next_delayed_flow);
-	q->unthrottle_latency_ns -= q->unthrottle_latency_ns >> 3;
-	q->unthrottle_latency_ns += sample >> 3;
+	if (q->wheel) {
+		fq_wheel_check_throttled(q, now);
+		return;
+	}
+
+	fq_unthrottle_latency(q, now - q->time_next_delayed_flow);
 
 	q->time_next_delayed_flow = ~0ULL;
 	while ((p = rb_first(&q->delayed)) != NULL) {
@@ -662,6 +941,7 @@ static void fq_flow_purge(struct fq_flow *flow)
 static void fq_reset(struct Qdisc *sch)
 {
 	struct fq_sched_data *q = qdisc_priv(sch);
+	struct hlist_node *tmp;
 	struct rb_root *root;
 	struct rb_node *p;
 	struct fq_flow *f;
@@ -676,6 +956,15 @@ static void fq_reset(struct Qdisc *sch)
 		return;
 
 	for (idx = 0; idx < (1U << q->fq_trees_log); idx++) {
+		if (q->wheel) {
+			hlist_for_each_entry_safe(f, tmp, &q->fq_hash[idx],
+						  fq_hnode) {
+				hlist_del(&f->fq_hnode);
+				fq_flow_purge(f);
+				kmem_cache_free(fq_flow_cachep, f);
+			}
+			continue;
+		}
 		root = &q->fq_root[idx];
 		while ((p = rb_first(root)) != NULL) {
 			f = rb_entry(p, struct fq_flow, fq_node);
@@ -689,6 +978,8 @@ static void fq_reset(struct Qdisc *sch)
 	q->new_flows.first	= NULL;
 	q->old_flows.first	= NULL;
 	q->delayed		= RB_ROOT;
+	if (q->wheel)
+		fq_wheel_init(q->wheel);
 	q->flows		= 0;
 	q->inactive_flows	= 0;
 	q->throttled_flows	= 0;
@@ -739,6 +1030,32 @@ static void fq_rehash(struct fq_sched_data *q,
 	q->stat_gc_flows += fcnt;
 }
 
+static void fq_hash_rehash(struct fq_sched_data *q,
+			   struct hlist_head *old_array, u32 old_log,
+			   struct hlist_head *new_array, u32 new_log)
+{
+	struct hlist_node *tmp;
+	struct fq_flow *of;
+	int fcnt = 0;
+	u32 idx;
+
+	for (idx = 0; idx < (1U << old_log); idx++) {
+		hlist_for_each_entry_safe(of, tmp, &old_array[idx], fq_hnode) {
+			hlist_del(&of->fq_hnode);
+			if (fq_gc_candidate(of)) {
+				fcnt++;
+				kmem_cache_free(fq_flow_cachep, of);
+				continue;
+			}
+			hlist_add_head(&of->fq_hnode,
+				       &new_array[hash_ptr(of->sk, new_log)]);
+		}
+	}
+	q->flows -= fcnt;
+	q->inactive_flows -= fcnt;
+	q->stat_gc_flows += fcnt;
+}
+
 static void fq_free(void *addr)
 {
 	kvfree(addr);
@@ -749,24 +1066,34 @@ static int fq_resize(struct Qdisc *sch, u32 log)
 	struct fq_sched_data *q = qdisc_priv(sch);
 	struct rb_root *array;
 	void *old_fq_root;
+	size_t size;
 	u32 idx;
 
 	if (q->fq_root && log == q->fq_trees_log)
 		return 0;
 
+	size = q->wheel ? sizeof(struct hlist_head) : sizeof(struct rb_root);
+
 	/* If XPS was setup, we can allocate memory on right NUMA node */
-	array = kvmalloc_node(sizeof(struct rb_root) << log, GFP_KERNEL | __GFP_RETRY_MAYFAIL,
+	array = kvmalloc_node(size << log, GFP_KERNEL | __GFP_RETRY_MAYFAIL,
 			      netdev_queue_numa_node_read(sch->dev_queue));
 	if (!array)
 		return -ENOMEM;
 
-	for (idx = 0; idx < (1U << log); idx++)
-		array[idx] = RB_ROOT;
+	for (idx = 0; idx < (1U << log); idx++) {
+		if (q->wheel)
+			INIT_HLIST_HEAD(&((struct hlist_head *)array)[idx]);
+		else
+			array[idx] = RB_ROOT;
+	}
 
 	sch_tree_lock(sch);
 
 	old_fq_root = q->fq_root;
-	if (old_fq_root)
+	if (old_fq_root && q->wheel)
+		fq_hash_rehash(q, old_fq_root, q->fq_trees_log,
+			       (struct hlist_head *)array, log);
+	else if (old_fq_root)
 		fq_rehash(q, old_fq_root, q->fq_trees_log, array, log);
 
 	q->fq_root = array;
@@ -797,6 +1124,7 @@ static const struct nla_policy fq_policy[TCA_FQ_MAX + 1] = {
 	[TCA_FQ_TIMER_SLACK]		= { .type = NLA_U32 },
 	[TCA_FQ_HORIZON]		= { .type = NLA_U32 },
 	[TCA_FQ_HORIZON_DROP]		= { .type = NLA_U8 },
+	[TCA_FQ_TIMER_WHEEL]		= { .type = NLA_U8 },
 };
 
 static int fq_change(struct Qdisc *sch, struct nlattr *opt,
@@ -813,6 +1141,27 @@ static int fq_change(struct Qdisc *sch, struct nlattr *opt,
 	if (err < 0)
 		return err;
 
+	if (tb[TCA_FQ_TIMER_WHEEL]) {
+		bool wheel = nla_get_u8(tb[TCA_FQ_TIMER_WHEEL]);
+
+		/* The flow table and throttled flows layout is fixed once
+		 * the first flow table is allocated.
+		 */
+		if (q->fq_root && wheel != !!q->wheel) {
+			NL_SET_ERR_MSG_MOD(extack,
+					   "timer wheel can only be selected at creation");
+			return -EINVAL;
+		}
+		if (!q->fq_root && wheel && !q->wheel) {
+			q->wheel = kvmalloc_node(sizeof(*q->wheel), GFP_KERNEL,
+					netdev_queue_numa_node_read(sch->dev_queue));
+			if (!q->wheel)
+				return -ENOMEM;
+			fq_wheel_init(q->wheel);
+			q->wheel->clk = ktime_get_ns() >> FQ_WHEEL_GRAN_SHIFT;
+		}
+	}
+
 	sch_tree_lock(sch);
 
 	fq_log = q->fq_trees_log;
@@ -917,6 +1266,7 @@ static void fq_destroy(struct Qdisc *sch)
 
 	fq_reset(sch);
 	fq_free(q->fq_root);
+	fq_free(q->wheel);
 	qdisc_watchdog_cancel(&q->watchdog);
 }
 
@@ -937,6 +1287,7 @@ static int fq_init(struct Qdisc *sch, struct nlattr *opt,
 	q->new_flows.first	= NULL;
 	q->old_flows.first	= NULL;
 	q->delayed		= RB_ROOT;
+	q->wheel		= NULL;
 	q->fq_root		= NULL;
 	q->fq_trees_log		= ilog2(1024);
 	q->orphan_mask		= 1024 - 1;
@@ -992,7 +1343,8 @@ static int fq_dump(struct Qdisc *sch, struct sk_buff *skb)
 	    nla_put_u32(skb, TCA_FQ_BUCKETS_LOG, q->fq_trees_log) ||
 	    nla_put_u32(skb, TCA_FQ_TIMER_SLACK, q->timer_slack) ||
 	    nla_put_u32(skb, TCA_FQ_HORIZON, (u32)horizon) ||
-	    nla_put_u8(skb, TCA_FQ_HORIZON_DROP, q->horizon_drop))
+	    nla_put_u8(skb, TCA_FQ_HORIZON_DROP, q->horizon_drop) ||
+	    nla_put_u8(skb, TCA_FQ_TIMER_WHEEL, !!q->wheel))
 		goto nla_put_failure;
 
 	return nla_nest_end(skb, opts);
@@ -568,6 +568,7 @@ static void unix_sock_destructor(struct sock *sk)
 	struct unix_sock *u = unix_sk(sk);
 
 	skb_queue_purge(&sk->sk_receive_queue);
+	skb_queue_purge(&sk->sk_error_queue);
 
 	DEBUG_NET_WARN_ON_ONCE(refcount_read(&sk->sk_wmem_alloc));
 	DEBUG_NET_WARN_ON_ONCE(!sk_unhashed(sk));
@@ -2098,10 +2099,10 @@ static int unix_dgram_sendmsg(struct socket *sock, struct msghdr *msg,
 	return err;
 }
 
-/* We use paged skbs for stream sockets, and limit occupancy to 32768
+/* We use paged skbs for stream sockets, and limit occupancy to 65536
  * bytes, and a minimum of a full page.
  */
-#define UNIX_SKB_FRAGS_SZ (PAGE_SIZE << get_order(32768))
+#define UNIX_SKB_FRAGS_SZ (PAGE_SIZE << get_order(65536))
 
 #if IS_ENABLED(CONFIG_AF_UNIX_OOB)
 static int queue_oob(struct socket *sock, struct msghdr *msg, struct sock *other)
@@ -2150,6 +2151,46 @@ static int queue_oob(struct socket *sock, struct msghdr *msg, struct sock *other
 }
 #endif
 
+/* Build an skb that references the user pages of up to *size bytes of
+ * @msg instead of copying them. The pages stay pinned until the peer has
+ * consumed the data, then a completion is queued on the sender's error
+ * queue like for TCP MSG_ZEROCOPY. *size is updated to the bytes taken.
+ */
+static struct sk_buff *unix_stream_zerocopy_skb(struct sock *sk,
+						struct msghdr *msg,
+						struct scm_cookie *scm,
+						bool send_fds,
+						struct ubuf_info *uarg,
+						int *size, int *err)
+{
+	struct sk_buff *skb;
+	int copied;
+
+	skb = sock_alloc_send_pskb(sk, 0, 0, msg->msg_flags & MSG_DONTWAIT,
+				   err, 0);
+	if (!skb)
+		return NULL;
+
+	*err = unix_scm_to_skb(scm, skb, send_fds);
+	if (*err < 0)
+		goto free;
+
+	/* No socket here: the pinned pages are charged to sk_wmem_alloc
+	 * through skb->sk, not to the TCP stream memory accounting.
+	 */
+	copied = skb_zerocopy_iter_stream(NULL, skb, msg, *size, uarg);
+	if (copied < 0) {
+		*err = copied;
+		goto free;
+	}
+	*size = copied;
+	return skb;
+
+free:
+	kfree_skb(skb);
+	return NULL;
+}
+
 static int unix_stream_sendmsg(struct socket *sock, struct msghdr *msg,
 			       size_t len)
 {
@@ -2159,6 +2200,7 @@ static int unix_stream_sendmsg(struct socket *sock, struct msghdr *msg,
 	struct sk_buff *skb;
 	int sent = 0;
 	struct scm_cookie scm;
+	struct ubuf_info *uarg = NULL;
 	bool fds_sent = false;
 	int data_len;
 
@@ -2190,12 +2232,30 @@ static int unix_stream_sendmsg(struct socket *sock, struct msghdr *msg,
 	if (sk->sk_shutdown & SEND_SHUTDOWN)
 		goto pipe_err;
 
+	if ((msg->msg_flags & MSG_ZEROCOPY) && len &&
+	    sock_flag(sk, SOCK_ZEROCOPY)) {
+		uarg = msg_zerocopy_realloc(sk, len, NULL);
+		if (!uarg) {
+			err = -ENOBUFS;
+			goto out_err;
+		}
+	}
+
 	while (sent < len) {
 		size = len - sent;
 
 		/* Keep two messages in the pipe so it schedules better */
 		size = min_t(int, size, (sk->sk_sndbuf >> 1) - 64);
 
+		if (uarg) {
+			skb = unix_stream_zerocopy_skb(sk, msg, &scm, !fds_sent,
+						       uarg, &size, &err);
+			if (!skb)
+				goto out_err;
+			fds_sent = true;
+			goto queue;
+		}
+
 		/* allow fallback to order-0 allocations */
 		size = min_t(int, size, SKB_MAX_HEAD(0) + UNIX_SKB_FRAGS_SZ);
 
@@ -2226,6 +2286,7 @@ static int unix_stream_sendmsg(struct socket *sock, struct msghdr *msg,
 			goto out_err;
 		}
 
+queue:
 		unix_state_lock(other);
 
 		if (sock_flag(other, SOCK_DEAD) ||
@@ -2249,6 +2310,7 @@ static int unix_stream_sendmsg(struct socket *sock, struct msghdr *msg,
 	}
 #endif
 
+	net_zcopy_put(uarg);
 	scm_destroy(&scm);
 
 	return sent;
@@ -2261,6 +2323,11 @@ static int unix_stream_sendmsg(struct socket *sock, struct msghdr *msg,
 		send_sig(SIGPIPE, current, 0);
 	err = -EPIPE;
 out_err:
+	/* Queued zerocopy skbs still need their completion notification */
+	if (sent)
+		net_zcopy_put(uarg);
+	else
+		net_zcopy_put_abort(uarg, true);
 	scm_destroy(&scm);
 	return sent ? : err;
 }
@@ -2944,11 +3011,16 @@ static int unix_stream_recvmsg(struct socket *sock, struct msghdr *msg,
 		.size = size,
 		.flags = flags
 	};
-
-#ifdef CONFIG_BPF_SYSCALL
 	struct sock *sk = sock->sk;
+#ifdef CONFIG_BPF_SYSCALL
 	const struct proto *prot = READ_ONCE(sk->sk_prot);
+#endif
+
+	/* MSG_ZEROCOPY completions, reported like RDS does */
+	if (unlikely(flags & MSG_ERRQUEUE))
+		return sock_recv_errqueue(sk, msg, size, SOL_IP, IP_RECVERR);
 
+#ifdef CONFIG_BPF_SYSCALL
 	if (prot != &unix_stream_proto)
 		return prot->recvmsg(sk, msg, size, flags, NULL);
 #endif
@@ -2959,6 +3031,13 @@ static int unix_stream_splice_actor(struct sk_buff *skb,
 				    int skip, int chunk,
 				    struct unix_stream_read_state *state)
 {
+	int err;
+
+	/* Do not let the sender's pinned pages outlive the completion */
+	err = skb_orphan_frags_rx(skb, GFP_KERNEL);
+	if (err)
+		return err;
+
 	return skb_splice_bits(skb, state->socket->sk,
 			       UNIXCB(skb).consumed + skip,
 			       state->pipe, chunk, state->splice_flags);
@@ -3158,7 +3237,7 @@ static __poll_t unix_poll(struct file *file, struct socket *sock, poll_table *wa
 	mask = 0;
 
 	/* exceptional events? */
-	if (sk->sk_err)
+	if (sk->sk_err || !skb_queue_empty_lockless(&sk->sk_error_queue))
 		mask |= EPOLLERR;
 	if (sk->sk_shutdown == SHUTDOWN_MASK)
 		mask |= EPOLLHUP;
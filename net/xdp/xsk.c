@@ -31,9 +31,30 @@
 #include "xsk.h"
 
 #define TX_BATCH_SIZE 32
+#define RX_GENERIC_BATCH_SIZE 64
 
 static DEFINE_PER_CPU(struct list_head, xskmap_flush_list);
 
+/* Frames redirected to a socket in generic mode during one NAPI poll. They
+ * are copied into the umem, submitted and signalled together when the poll
+ * ends, when the batch is full or when another socket is targeted.
+ */
+struct xsk_generic_frame {
+	struct sk_buff *skb;
+	void *data_meta;
+	void *data;
+	void *data_end;
+};
+
+struct xsk_generic_batch {
+	bool active;
+	struct xdp_sock *xs;
+	unsigned int count;
+	struct xsk_generic_frame frames[RX_GENERIC_BATCH_SIZE];
+};
+
+static DEFINE_PER_CPU(struct xsk_generic_batch, xsk_generic_batch);
+
 void xsk_set_rx_need_wakeup(struct xsk_buff_pool *pool)
 {
 	if (pool->cached_need_wakeup & XDP_WAKEUP_RX)
@@ -247,6 +268,89 @@ int xsk_generic_rcv(struct xdp_sock *xs, struct xdp_buff *xdp)
 	return err;
 }
 
+static void xsk_generic_batch_flush(struct xsk_generic_batch *b)
+{
+	struct xdp_sock *xs = b->xs;
+	struct xdp_buff xdp;
+	u64 failed = 0;
+	unsigned int i;
+
+	if (!b->count)
+		return;
+
+	spin_lock(&xs->rx_lock);
+	for (i = 0; i < b->count; i++) {
+		struct xsk_generic_frame *frame = &b->frames[i];
+
+		xdp.data_meta = frame->data_meta;
+		xdp.data = frame->data;
+		xdp.data_end = frame->data_end;
+		if (__xsk_rcv(xs, &xdp))
+			failed |= BIT_ULL(i);
+	}
+	xsk_flush(xs);
+	spin_unlock(&xs->rx_lock);
+
+	for (i = 0; i < b->count; i++) {
+		if (failed & BIT_ULL(i))
+			kfree_skb(b->frames[i].skb);
+		else
+			consume_skb(b->frames[i].skb);
+	}
+	b->count = 0;
+	b->xs = NULL;
+}
+
+/* Called around the NAPI polls of net_rx_action() and threaded NAPI, with
+ * BH disabled. Outside of them, generic receive is not batched.
+ */
+void xsk_generic_batch_begin(void)
+{
+	this_cpu_ptr(&xsk_generic_batch)->active = true;
+}
+
+void xsk_generic_batch_end(void)
+{
+	struct xsk_generic_batch *b = this_cpu_ptr(&xsk_generic_batch);
+
+	xsk_generic_batch_flush(b);
+	b->active = false;
+}
+
+/* Redirect @xdp, built on top of @skb, to @xs in generic mode. On success
+ * @skb is owned by the socket code, and may only be consumed at the next
+ * batch flush.
+ */
+int xsk_generic_redirect(struct xdp_sock *xs, struct xdp_buff *xdp,
+			 struct sk_buff *skb)
+{
+	struct xsk_generic_batch *b = this_cpu_ptr(&xsk_generic_batch);
+	struct xsk_generic_frame *frame;
+	int err;
+
+	if (!b->active) {
+		err = xsk_generic_rcv(xs, xdp);
+		if (!err)
+			consume_skb(skb);
+		return err;
+	}
+
+	err = xsk_rcv_check(xs, xdp);
+	if (err)
+		return err;
+
+	if (b->xs != xs || b->count == RX_GENERIC_BATCH_SIZE)
+		xsk_generic_batch_flush(b);
+
+	b->xs = xs;
+	frame = &b->frames[b->count++];
+	frame->skb = skb;
+	frame->data_meta = xdp->data_meta;
+	frame->data = xdp->data;
+	frame->data_end = xdp->data_end;
+	return 0;
+}
+
 static int xsk_rcv(struct xdp_sock *xs, struct xdp_buff *xdp)
 {
 	int err;
@@ -0,0 +1,65 @@
+#!/bin/bash
+# SPDX-License-Identifier: GPL-2.0
+#
+# Compare the per-request overhead of the "bpf" I/O scheduler running the
+# bpf_deadline sample policy against mq-deadline and "none" on null_blk.
+# Requires fio, the null_blk module and a kernel with CONFIG_BPF_IOSCHED.
+
+RUNTIME=${RUNTIME:-20}
+JOBS=${JOBS:-$(nproc)}
+BS=${BS:-4k}
+DEV=nullb0
+
+cleanup() {
+	[ -n "$POLICY_PID" ] && kill "$POLICY_PID" 2>/dev/null && wait "$POLICY_PID"
+	modprobe -r null_blk 2>/dev/null
+}
+trap cleanup EXIT
+
+if [ "$(id -u)" != 0 ]; then
+	echo "must be run as root"
+	exit 1
+fi
+if ! command -v fio >/dev/null; then
+	echo "fio not found"
+	exit 1
+fi
+
+modprobe -r null_blk 2>/dev/null
+# Completion in softirq, no artificial latency: only scheduler cost remains.
+if ! modprobe null_blk queue_mode=2 irqmode=1 completion_nsec=0 \
+	hw_queue_depth=256 submit_queues=1 nr_devices=1; then
+	echo "failed to load null_blk"
+	exit 1
+fi
+
+cd "$(dirname "$0")" || exit 1
+./iosched_deadline -i 3600 >/dev/null &
+POLICY_PID=$!
+sleep 1
+
+run() {
+	local sched=$1 rw=$2
+
+	echo "$sched" > /sys/block/$DEV/queue/scheduler || return
+	if [ "$sched" = bpf ]; then
+		echo bpf_deadline > /sys/block/$DEV/queue/iosched/policy || return
+	fi
+	fio --name=bench --filename=/dev/$DEV --direct=1 --ioengine=io_uring \
+	    --rw="$rw" --bs="$BS" --iodepth=64 --numjobs="$JOBS" \
+	    --runtime="$RUNTIME" --time_based --group_reporting \
+	    --output-format=terse --terse-version=3 |
+	awk -F';' -v s="$sched" -v rw="$rw" '{
+		# fields: 8/49 read/write iops, 16/57 read/write mean clat
+		printf "%-12s %-10s read_iops %-9s write_iops %-9s read_clat_us %-8s write_clat_us %s\n",
+		       s, rw, $8, $49, $16, $57 }'
+	if [ "$sched" = bpf ] && [ -r /sys/kernel/debug/block/$DEV/sched/stats ]; then
+		sed 's/^/    /' /sys/kernel/debug/block/$DEV/sched/stats
+	fi
+}
+
+for rw in randread randrw; do
+	for sched in none mq-deadline bpf; do
+		run "$sched" "$rw"
+	done
+done
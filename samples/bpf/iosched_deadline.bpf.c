@@ -0,0 +1,154 @@
+// SPDX-License-Identifier: GPL-2.0
+/*
+ * Deadline-like policy for the "bpf" I/O scheduler.
+ *
+ * Reads and writes are kept in separate FIFOs. Reads are preferred, but a
+ * write batch is started once writes have been passed over writes_starved
+ * times or the oldest write has expired. Up to fifo_batch requests are
+ * dispatched in the same direction before the choice is made again.
+ * Unlike mq-deadline there is no sector-sorted list; the point of this
+ * policy is to serve as a reference for the struct_ops interface and to
+ * measure its overhead against mq-deadline.
+ *
+ * The FIFOs are shared by all queues the policy is attached to, so attach
+ * it to one device at a time.
+ */
+#include "vmlinux.h"
+#include <bpf/bpf_helpers.h>
+#include <bpf/bpf_tracing.h>
+
+char _license[] SEC("license") = "GPL";
+
+#define REQ_OP_MASK	0xff
+#define DL_READ		0
+#define DL_WRITE	1
+#define DL_LAT_SLOTS	32
+
+const volatile __u64 read_expire_ns = 500 * 1000 * 1000ULL;
+const volatile __u64 write_expire_ns = 5000 * 1000 * 1000ULL;
+const volatile __u32 writes_starved = 2;
+const volatile __u32 fifo_batch = 16;
+
+struct dl_entry {
+	__u64 id;
+	__u64 deadline;
+};
+
+struct {
+	__uint(type, BPF_MAP_TYPE_QUEUE);
+	__uint(max_entries, 4096);
+	__type(value, struct dl_entry);
+} fifo_read SEC(".maps");
+
+struct {
+	__uint(type, BPF_MAP_TYPE_QUEUE);
+	__uint(max_entries, 4096);
+	__type(value, struct dl_entry);
+} fifo_write SEC(".maps");
+
+/* log2 completion latency histogram, [dir * DL_LAT_SLOTS + slot] */
+struct {
+	__uint(type, BPF_MAP_TYPE_PERCPU_ARRAY);
+	__uint(max_entries, 2 * DL_LAT_SLOTS);
+	__type(key, __u32);
+	__type(value, __u64);
+} lat_hist SEC(".maps");
+
+__u32 last_dir;
+__u32 batching;
+__u32 starved;
+
+static __always_inline int dl_dir(__u32 opf)
+{
+	return (opf & REQ_OP_MASK) == 0 ? DL_READ : DL_WRITE;
+}
+
+static __always_inline void *dl_fifo(int dir)
+{
+	return dir == DL_READ ? (void *)&fifo_read : (void *)&fifo_write;
+}
+
+SEC("struct_ops/dl_insert")
+int BPF_PROG(dl_insert, const struct bpf_iosched_rq *rq)
+{
+	int dir = dl_dir(rq->opf);
+	struct dl_entry e = {
+		.id = rq->id,
+		.deadline = bpf_ktime_get_ns() +
+			    (dir == DL_READ ? read_expire_ns : write_expire_ns),
+	};
+
+	/* Queue full: leave the request to the kernel FIFO. */
+	return bpf_map_push_elem(dl_fifo(dir), &e, 0) ? -1 : 0;
+}
+
+static __always_inline __u64 dl_pop(int dir)
+{
+	struct dl_entry e;
+
+	if (bpf_map_pop_elem(dl_fifo(dir), &e))
+		return 0;
+	if (dir != last_dir)
+		batching = 0;
+	last_dir = dir;
+	batching++;
+	return e.id;
+}
+
+SEC("struct_ops/dl_dispatch")
+__u64 BPF_PROG(dl_dispatch, const struct bpf_iosched_queue *q)
+{
+	struct dl_entry r, w;
+	bool have_r, have_w;
+
+	have_r = !bpf_map_peek_elem(&fifo_read, &r);
+	have_w = !bpf_map_peek_elem(&fifo_write, &w);
+	if (!have_r && !have_w)
+		return 0;
+
+	/* Keep going in the current direction while the batch lasts. */
+	if (batching < fifo_batch) {
+		if (last_dir == DL_READ && have_r)
+			return dl_pop(DL_READ);
+		if (last_dir == DL_WRITE && have_w)
+			return dl_pop(DL_WRITE);
+	}
+
+	if (have_r) {
+		if (have_w && (starved >= writes_starved ||
+			       bpf_ktime_get_ns() >= w.deadline)) {
+			starved = 0;
+			return dl_pop(DL_WRITE);
+		}
+		if (have_w)
+			starved++;
+		return dl_pop(DL_READ);
+	}
+
+	starved = 0;
+	return dl_pop(DL_WRITE);
+}
+
+SEC("struct_ops/dl_completed")
+void BPF_PROG(dl_completed, const struct bpf_iosched_rq *rq, __u64 now_ns)
+{
+	__u64 lat = now_ns - rq->start_time_ns, *cnt;
+	__u32 slot = 0, key;
+
+	while (lat > 1 && slot < DL_LAT_SLOTS - 1) {
+		lat >>= 1;
+		slot++;
+	}
+	key = dl_dir(rq->opf) * DL_LAT_SLOTS + slot;
+	cnt = bpf_map_lookup_elem(&lat_hist, &key);
+	if (cnt)
+		(*cnt)++;
+}
+
+SEC(".struct_ops")
+struct bpf_iosched_ops deadline = {
+	.insert		= (void *)dl_insert,
+	.dispatch	= (void *)dl_dispatch,
+	.completed	= (void *)dl_completed,
+	.name		= "bpf_deadline",
+};
@@ -0,0 +1,134 @@
+// SPDX-License-Identifier: GPL-2.0
+static const char *__doc__ =
+"Load the bpf_deadline I/O scheduling policy and print completion latency\n"
+"histograms until interrupted.\n"
+"Usage: iosched_deadline [-i interval] [DEVICE]\n"
+"With DEVICE (e.g. sda), switch its scheduler to \"bpf\" and select the\n"
+"policy; otherwise select it by hand:\n"
+"  echo bpf > /sys/block/DEVICE/queue/scheduler\n"
+"  echo bpf_deadline > /sys/block/DEVICE/queue/iosched/policy\n";
+
+#include <errno.h>
+#include <getopt.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <bpf/bpf.h>
+#include <bpf/libbpf.h>
+#include "iosched_deadline.skel.h"
+
+#define DL_LAT_SLOTS	32
+
+static volatile sig_atomic_t exiting;
+
+static void sig_handler(int sig)
+{
+	exiting = 1;
+}
+
+static int write_sysfs(const char *dev, const char *attr, const char *val)
+{
+	char path[256];
+	FILE *f;
+	int ret;
+
+	snprintf(path, sizeof(path), "/sys/block/%s/queue/%s", dev, attr);
+	f = fopen(path, "w");
+	if (!f) {
+		fprintf(stderr, "open %s: %s\n", path, strerror(errno));
+		return -errno;
+	}
+	ret = fputs(val, f) < 0 ? -EIO : 0;
+	if (fclose(f))
+		ret = -errno;
+	if (ret)
+		fprintf(stderr, "write %s to %s failed\n", val, path);
+	return ret;
+}
+
+static void print_hist(int map_fd)
+{
+	static const char * const dir_name[] = { "read", "write" };
+	int nr_cpus = libbpf_num_possible_cpus();
+	__u64 values[nr_cpus];
+	__u32 dir, slot, key;
+	int cpu;
+
+	for (dir = 0; dir < 2; dir++) {
+		printf("%s latency (usecs):\n", dir_name[dir]);
+		for (slot = 0; slot < DL_LAT_SLOTS; slot++) {
+			__u64 sum = 0;
+
+			key = dir * DL_LAT_SLOTS + slot;
+			if (bpf_map_lookup_elem(map_fd, &key, values))
+				continue;
+			for (cpu = 0; cpu < nr_cpus; cpu++)
+				sum += values[cpu];
+			if (!sum)
+				continue;
+			/* slots are log2(ns), print them in usecs */
+			printf("  %10llu -> %-10llu : %llu\n",
+			       (1ULL << slot) / 1000,
+			       (2ULL << slot) / 1000, sum);
+		}
+	}
+}
+
+int main(int argc, char **argv)
+{
+	struct iosched_deadline *skel;
+	unsigned long interval = 2;
+	struct bpf_link *link;
+	const char *dev = NULL;
+	int opt, ret = 1;
+
+	while ((opt = getopt(argc, argv, "hi:")) != -1) {
+		switch (opt) {
+		case 'i':
+			interval = strtoul(optarg, NULL, 0);
+			break;
+		case 'h':
+		default:
+			fprintf(stderr, "%s", __doc__);
+			return opt == 'h' ? 0 : 1;
+		}
+	}
+	if (optind < argc)
+		dev = argv[optind];
+
+	skel = iosched_deadline__open_and_load();
+	if (!skel) {
+		fprintf(stderr, "Failed to load BPF skeleton: %s\n",
+			strerror(errno));
+		return 1;
+	}
+
+	link = bpf_map__attach_struct_ops(skel->maps.deadline);
+	if (!link) {
+		fprintf(stderr, "Failed to register policy: %s\n",
+			strerror(errno));
+		goto destroy;
+	}
+
+	if (dev && (write_sysfs(dev, "scheduler", "bpf") ||
+		    write_sysfs(dev, "iosched/policy", "bpf_deadline")))
+		goto detach;
+
+	signal(SIGINT, sig_handler);
+	signal(SIGTERM, sig_handler);
+
+	printf("bpf_deadline registered, Ctrl-C to unregister\n");
+	while (!exiting) {
+		sleep(interval);
+		print_hist(bpf_map__fd(skel->maps.lat_hist));
+	}
+	ret = 0;
+
+detach:
+	bpf_link__destroy(link);
+destroy:
+	iosched_deadline__destroy(skel);
+	return ret;
+}
@@ -21,14 +21,19 @@
 #include <stdlib.h>
 #include <string.h>
 #include <unistd.h>
+#include <limits.h>
 #include <sys/time.h>
 #include <errno.h>
+#ifdef HAVE_ARCH_ARM_SUPPORT
+#include <sys/auxv.h>
+#endif
 #include <linux/time64.h>
 #include <linux/zalloc.h>
 
 #define K 1024
 
 static const char	*size_str	= "1MB";
+static const char	*size_max_str;
 static const char	*function_str	= "all";
 static int		nr_loops	= 1;
 static bool		use_cycles;
@@ -39,6 +44,10 @@ static const struct option options[] = {
 		    "Specify the size of the memory buffers. "
 		    "Available units: B, KB, MB, GB and TB (case insensitive)"),
 
+	OPT_STRING(0, "size-max", &size_max_str, "8MB",
+		    "Sweep the buffer size from --size up to this size, doubling it at each step. "
+		    "Every step moves the same number of bytes in total"),
+
 	OPT_STRING('f', "function", &function_str, "all",
 		    "Specify the function to run, \"all\" runs all available functions, \"help\" lists them"),
 
@@ -61,8 +70,21 @@ struct function {
 		memcpy_t memcpy;
 		memset_t memset;
 	} fn;
+	/* optional, false when the CPU cannot run this variant */
+	bool (*available)(void);
 };
 
+#ifdef HAVE_ARCH_ARM_SUPPORT
+#ifndef HWCAP_NEON
+#define HWCAP_NEON	(1 << 12)
+#endif
+
+static bool arm_has_neon(void)
+{
+	return getauxval(AT_HWCAP) & HWCAP_NEON;
+}
+#endif
+
 static struct perf_event_attr cycle_attr = {
 	.type		= PERF_TYPE_HARDWARE,
 	.config		= PERF_COUNT_HW_CPU_CYCLES
@@ -109,41 +131,47 @@ static double timeval2double(struct timeval *ts)
 
 struct bench_mem_info {
 	const struct function *functions;
-	u64 (*do_cycles)(const struct function *r, size_t size, void *src, void *dst);
-	double (*do_gettimeofday)(const struct function *r, size_t size, void *src, void *dst);
+	u64 (*do_cycles)(const struct function *r, size_t size, int loops, void *src, void *dst);
+	double (*do_gettimeofday)(const struct function *r, size_t size, int loops, void *src, void *dst);
 	const char *const *usage;
 	bool alloc_src;
 };
 
-static void __bench_mem_function(struct bench_mem_info *info, int r_idx, size_t size, double size_total)
+static void size_to_str(char *buf, size_t len, size_t size)
 {
-	const struct function *r = &info->functions[r_idx];
-	double result_bps = 0.0;
-	u64 result_cycles = 0;
-	void *src = NULL, *dst = zalloc(size);
-
-	printf("# function '%s' (%s)\n", r->name, r->desc);
-
-	if (dst == NULL)
-		goto out_alloc_failed;
+	static const char units[] = "KMGT";
+	int i = -1;
 
-	if (info->alloc_src) {
-		src = zalloc(size);
-		if (src == NULL)
-			goto out_alloc_failed;
+	while (size >= K && !(size % K) && i < 3) {
+		size /= K;
+		i++;
 	}
+	if (i < 0)
+		snprintf(buf, len, "%zuB", size);
+	else
+		snprintf(buf, len, "%zu%cB", size, units[i]);
+}
 
-	if (bench_format == BENCH_FORMAT_DEFAULT)
-		printf("# Copying %s bytes ...\n\n", size_str);
+static void __bench_mem_size(struct bench_mem_info *info, const struct function *r,
+			     size_t size, int loops, bool sweep, void *src, void *dst)
+{
+	double size_total = (double)size * loops;
+	double result_bps = 0.0;
+	u64 result_cycles = 0;
+	char buf[32];
 
 	if (use_cycles) {
-		result_cycles = info->do_cycles(r, size, src, dst);
+		result_cycles = info->do_cycles(r, size, loops, src, dst);
 	} else {
-		result_bps = info->do_gettimeofday(r, size, src, dst);
+		result_bps = info->do_gettimeofday(r, size, loops, src, dst);
 	}
 
 	switch (bench_format) {
 	case BENCH_FORMAT_DEFAULT:
+		if (sweep) {
+			size_to_str(buf, sizeof(buf), size);
+			printf("%10s:", buf);
+		}
 		if (use_cycles) {
 			printf(" %14lf cycles/byte\n", (double)result_cycles/size_total);
 		} else {
@@ -152,6 +180,8 @@ static void __bench_mem_function(struct bench_mem_info *info, int r_idx, size_t
 		break;
 
 	case BENCH_FORMAT_SIMPLE:
+		if (sweep)
+			printf("%zu ", size);
 		if (use_cycles) {
 			printf("%lf\n", (double)result_cycles/size_total);
 		} else {
@@ -163,21 +193,62 @@ static void __bench_mem_function(struct bench_mem_info *info, int r_idx, size_t
 		BUG_ON(1);
 		break;
 	}
+}
+
+static void __bench_mem_function(struct bench_mem_info *info, int r_idx, size_t size, size_t size_max)
+{
+	const struct function *r = &info->functions[r_idx];
+	bool sweep = size_max > size;
+	void *src = NULL, *dst;
+	size_t cur;
+
+	printf("# function '%s' (%s)\n", r->name, r->desc);
+
+	if (r->available && !r->available()) {
+		printf("# Not supported by this CPU, skipping\n\n");
+		return;
+	}
+
+	/* A sweep runs every step on the start of the largest buffer */
+	dst = zalloc(size_max);
+	if (dst == NULL)
+		goto out_alloc_failed;
+
+	if (info->alloc_src) {
+		src = zalloc(size_max);
+		if (src == NULL)
+			goto out_alloc_failed;
+	}
+
+	if (bench_format == BENCH_FORMAT_DEFAULT) {
+		if (sweep)
+			printf("# Copying %s to %s bytes ...\n\n", size_str, size_max_str);
+		else
+			printf("# Copying %s bytes ...\n\n", size_str);
+	}
+
+	for (cur = size; cur <= size_max && cur >= size; cur *= 2) {
+		/* Keep the total the same as nr_loops copies of the largest size */
+		u64 loops = (u64)nr_loops * (size_max / cur);
+
+		__bench_mem_size(info, r, cur, loops > INT_MAX ? INT_MAX : (int)loops,
+				 sweep, src, dst);
+	}
 
 out_free:
 	free(src);
 	free(dst);
 	return;
 out_alloc_failed:
-	printf("# Memory allocation failed - maybe size (%s) is too large?\n", size_str);
+	printf("# Memory allocation failed - maybe size (%s) is too large?\n",
+	       sweep ? size_max_str : size_str);
 	goto out_free;
 }
 
 static int bench_mem_common(int argc, const char **argv, struct bench_mem_info *info)
 {
 	int i;
-	size_t size;
-	double size_total;
+	size_t size, size_max;
 
 	argc = parse_options(argc, argv, options, info->usage, 0);
 
@@ -190,16 +261,24 @@ static int bench_mem_common(int argc, const char **argv, struct bench_mem_info *
 	}
 
 	size = (size_t)perf_atoll((char *)size_str);
-	size_total = (double)size * nr_loops;
 
 	if ((s64)size <= 0) {
 		fprintf(stderr, "Invalid size:%s\n", size_str);
 		return 1;
 	}
 
+	size_max = size;
+	if (size_max_str) {
+		size_max = (size_t)perf_atoll((char *)size_max_str);
+		if ((s64)size_max <= 0 || size_max < size) {
+			fprintf(stderr, "Invalid size-max:%s\n", size_max_str);
+			return 1;
+		}
+	}
+
 	if (!strncmp(function_str, "all", 3)) {
 		for (i = 0; info->functions[i].name; i++)
-			__bench_mem_function(info, i, size, size_total);
+			__bench_mem_function(info, i, size, size_max);
 		return 0;
 	}
 
@@ -218,7 +297,7 @@ static int bench_mem_common(int argc, const char **argv, struct bench_mem_info *
 		return 1;
 	}
 
-	__bench_mem_function(info, i, size, size_total);
+	__bench_mem_function(info, i, size, size_max);
 
 	return 0;
 }
@@ -235,7 +314,7 @@ static void memcpy_prefault(memcpy_t fn, size_t size, void *src, void *dst)
 	fn(dst, src, size);
 }
 
-static u64 do_memcpy_cycles(const struct function *r, size_t size, void *src, void *dst)
+static u64 do_memcpy_cycles(const struct function *r, size_t size, int loops, void *src, void *dst)
 {
 	u64 cycle_start = 0ULL, cycle_end = 0ULL;
 	memcpy_t fn = r->fn.memcpy;
@@ -244,14 +323,14 @@ static u64 do_memcpy_cycles(const struct function *r, size_t size, void *src, vo
 	memcpy_prefault(fn, size, src, dst);
 
 	cycle_start = get_cycles();
-	for (i = 0; i < nr_loops; ++i)
+	for (i = 0; i < loops; ++i)
 		fn(dst, src, size);
 	cycle_end = get_cycles();
 
 	return cycle_end - cycle_start;
 }
 
-static double do_memcpy_gettimeofday(const struct function *r, size_t size, void *src, void *dst)
+static double do_memcpy_gettimeofday(const struct function *r, size_t size, int loops, void *src, void *dst)
 {
 	struct timeval tv_start, tv_end, tv_diff;
 	memcpy_t fn = r->fn.memcpy;
@@ -260,13 +339,13 @@ static double do_memcpy_gettimeofday(const struct function *r, size_t size, void
 	memcpy_prefault(fn, size, src, dst);
 
 	BUG_ON(gettimeofday(&tv_start, NULL));
-	for (i = 0; i < nr_loops; ++i)
+	for (i = 0; i < loops; ++i)
 		fn(dst, src, size);
 	BUG_ON(gettimeofday(&tv_end, NULL));
 
 	timersub(&tv_end, &tv_start, &tv_diff);
 
-	return (double)(((double)size * nr_loops) / timeval2double(&tv_diff));
+	return (double)(((double)size * loops) / timeval2double(&tv_diff));
 }
 
 struct function memcpy_functions[] = {
@@ -278,6 +357,14 @@ struct function memcpy_functions[] = {
 # define MEMCPY_FN(_fn, _name, _desc) {.name = _name, .desc = _desc, .fn.memcpy = _fn},
 # include "mem-memcpy-x86-64-asm-def.h"
 # undef MEMCPY_FN
+#endif
+
+#ifdef HAVE_ARCH_ARM_SUPPORT
+# define MEMCPY_FN(_fn, _name, _desc) {.name = _name, .desc = _desc, .fn.memcpy = _fn},
+# define MEMCPY_NEON_FN(_fn, _name, _desc) {.name = _name, .desc = _desc, .fn.memcpy = _fn, .available = arm_has_neon},
+# include "mem-memcpy-arm-asm-def.h"
+# undef MEMCPY_FN
+# undef MEMCPY_NEON_FN
 #endif
 
 	{ .name = NULL, }
@@ -301,7 +388,7 @@ int bench_mem_memcpy(int argc, const char **argv)
 	return bench_mem_common(argc, argv, &info);
 }
 
-static u64 do_memset_cycles(const struct function *r, size_t size, void *src __maybe_unused, void *dst)
+static u64 do_memset_cycles(const struct function *r, size_t size, int loops, void *src __maybe_unused, void *dst)
 {
 	u64 cycle_start = 0ULL, cycle_end = 0ULL;
 	memset_t fn = r->fn.memset;
@@ -314,14 +401,14 @@ static u64 do_memset_cycles(const struct function *r, size_t size, void *src __m
 	fn(dst, -1, size);
 
 	cycle_start = get_cycles();
-	for (i = 0; i < nr_loops; ++i)
+	for (i = 0; i < loops; ++i)
 		fn(dst, i, size);
 	cycle_end = get_cycles();
 
 	return cycle_end - cycle_start;
 }
 
-static double do_memset_gettimeofday(const struct function *r, size_t size, void *src __maybe_unused, void *dst)
+static double do_memset_gettimeofday(const struct function *r, size_t size, int loops, void *src __maybe_unused, void *dst)
 {
 	struct timeval tv_start, tv_end, tv_diff;
 	memset_t fn = r->fn.memset;
@@ -334,13 +421,13 @@ static double do_memset_gettimeofday(const struct function *r, size_t size, void
 	fn(dst, -1, size);
 
 	BUG_ON(gettimeofday(&tv_start, NULL));
-	for (i = 0; i < nr_loops; ++i)
+	for (i = 0; i < loops; ++i)
 		fn(dst, i, size);
 	BUG_ON(gettimeofday(&tv_end, NULL));
 
 	timersub(&tv_end, &tv_start, &tv_diff);
 
-	return (double)(((double)size * nr_loops) / timeval2double(&tv_diff));
+	return (double)(((double)size * loops) / timeval2double(&tv_diff));
 }
 
 static const char * const bench_mem_memset_usage[] = {
@@ -357,6 +444,14 @@ static const struct function memset_functions[] = {
 # define MEMSET_FN(_fn, _name, _desc) { .name = _name, .desc = _desc, .fn.memset = _fn },
 # include "mem-memset-x86-64-asm-def.h"
 # undef MEMSET_FN
+#endif
+
+#ifdef HAVE_ARCH_ARM_SUPPORT
+# define MEMSET_FN(_fn, _name, _desc) { .name = _name, .desc = _desc, .fn.memset = _fn },
+# define MEMSET_NEON_FN(_fn, _name, _desc) { .name = _name, .desc = _desc, .fn.memset = _fn, .available = arm_has_neon },
+# include "mem-memset-arm-asm-def.h"
+# undef MEMSET_FN
+# undef MEMSET_NEON_FN
 #endif
 
 	{ .name = NULL, }
@@ -11,3 +11,16 @@
 
 #endif
 
+#ifdef HAVE_ARCH_ARM_SUPPORT
+
+#define MEMCPY_FN(fn, name, desc)		\
+	void *fn(void *, const void *, size_t);
+#define MEMCPY_NEON_FN(fn, name, desc)	\
+	void *fn(void *, const void *, size_t);
+
+#include "mem-memcpy-arm-asm-def.h"
+
+#undef MEMCPY_FN
+#undef MEMCPY_NEON_FN
+
+#endif
@@ -0,0 +1,13 @@
+/* SPDX-License-Identifier: GPL-2.0 */
+
+MEMCPY_FN(memcpy_arm_ldm,
+	"arm-ldm",
+	"ldm/stm loop, 32 bytes per iteration")
+
+MEMCPY_FN(memcpy_arm_ldm_pld,
+	"arm-ldm-pld",
+	"ldm/stm loop with pld prefetch")
+
+MEMCPY_NEON_FN(memcpy_arm_neon,
+	"arm-neon",
+	"NEON vld1/vst1 loop with pld prefetch, 64 bytes per iteration")
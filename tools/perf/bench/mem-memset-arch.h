@@ -11,3 +11,16 @@
 
 #endif
 
+#ifdef HAVE_ARCH_ARM_SUPPORT
+
+#define MEMSET_FN(fn, name, desc)		\
+	void *fn(void *, int, size_t);
+#define MEMSET_NEON_FN(fn, name, desc)	\
+	void *fn(void *, int, size_t);
+
+#include "mem-memset-arm-asm-def.h"
+
+#undef MEMSET_FN
+#undef MEMSET_NEON_FN
+
+#endif
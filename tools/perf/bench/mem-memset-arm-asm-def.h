@@ -0,0 +1,9 @@
+/* SPDX-License-Identifier: GPL-2.0 */
+
+MEMSET_FN(memset_arm_stm,
+	"arm-stm",
+	"stm loop, 32 bytes per iteration")
+
+MEMSET_NEON_FN(memset_arm_neon,
+	"arm-neon",
+	"NEON vst1 loop, 64 bytes per iteration")
@@ -0,0 +1,75 @@
+#!/bin/bash
+# SPDX-License-Identifier: GPL-2.0
+#
+# Throughput of the splice fallback of copy_file_range().
+#
+# Creates an ext4 filesystem, which has neither ->copy_file_range() nor
+# reflink, on a loop device whose reads and writes are each throttled to
+# RATE_MB MB/s with the io.max controller, and copies a file within it.
+# A fallback that overlaps reading and writing gets close to RATE_MB,
+# one that alternates gets about half of it.
+#
+# Usage: copy_file_range_bench.sh [SIZE_MB [RATE_MB]]
+
+# kselftest skip code
+ksft_skip=4
+
+size_mb=${1:-256}
+rate_mb=${2:-20}
+tmp=$(mktemp -d)
+cg=/sys/fs/cgroup/copy_file_range_bench
+loopdev=
+
+cleanup()
+{
+	umount "$tmp/mnt" 2>/dev/null
+	[ -n "$loopdev" ] && losetup -d "$loopdev"
+	[ -d "$cg" ] && rmdir "$cg" 2>/dev/null
+	rm -rf "$tmp"
+}
+trap cleanup EXIT
+
+skip()
+{
+	echo "SKIP: $*"
+	exit $ksft_skip
+}
+
+[ "$(id -u)" -eq 0 ] || skip "must be run as root"
+for tool in losetup mkfs.ext4 xfs_io; do
+	command -v $tool >/dev/null || skip "$tool not found"
+done
+grep -qw io /sys/fs/cgroup/cgroup.controllers 2>/dev/null ||
+	skip "cgroup v2 io controller not available"
+
+truncate -s $((size_mb * 3))M "$tmp/backing"
+loopdev=$(losetup -f --show "$tmp/backing") || skip "no loop device"
+mkfs.ext4 -q "$loopdev" || exit 1
+mkdir "$tmp/mnt"
+mount "$loopdev" "$tmp/mnt" || exit 1
+
+xfs_io -f -c "pwrite -q -S 0x5a 0 ${size_mb}m" -c fsync "$tmp/mnt/src" ||
+	exit 1
+echo 3 > /proc/sys/vm/drop_caches
+
+echo +io > /sys/fs/cgroup/cgroup.subtree_control 2>/dev/null
+mkdir -p "$cg" || skip "cannot create cgroup"
+bps=$((rate_mb * 1024 * 1024))
+echo "$(lsblk -dno MAJ:MIN "$loopdev" | tr -d ' ') rbps=$bps wbps=$bps" \
+	> "$cg/io.max" || skip "cannot throttle $loopdev"
+
+start=$(date +%s.%N)
+(
+	echo $BASHPID > "$cg/cgroup.procs"
+	xfs_io -f -c "copy_range -l ${size_mb}m $tmp/mnt/src" -c fsync \
+		"$tmp/mnt/dst"
+) || exit 1
+end=$(date +%s.%N)
+
+cmp -s "$tmp/mnt/src" "$tmp/mnt/dst" || { echo "FAIL: copy differs"; exit 1; }
+
+awk -v s="$start" -v e="$end" -v mb="$size_mb" -v r="$rate_mb" 'BEGIN {
+	printf "copied %d MB in %.1f s: %.1f MB/s (limit %d MB/s each way)\n",
+	       mb, e - s, mb / (e - s), r
+}'
+echo "PASS"
@@ -0,0 +1,214 @@
+// SPDX-License-Identifier: GPL-2.0
+/*
+ * Microbenchmark for POSIX byte-range locks on a single file.
+ *
+ * A child process holds NR_LOCKS one-byte write locks on the even offsets
+ * of a temporary file. The parent then times
+ *  - F_SETLK on free (odd) bytes and their release, which must look for
+ *    conflicts among the child's locks,
+ *  - F_GETLK on held (even) bytes, which must report the child's lock,
+ *  - building NR_LOCKS locks of its own one byte apart and then merging
+ *    them with a single lock over the whole range.
+ * Results are checked, so the program doubles as a functional test.
+ *
+ * Usage: posix_locks_bench [NR_LOCKS [ITERATIONS]]
+ */
+#define _GNU_SOURCE
+#include <errno.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/wait.h>
+
+static long nr_locks = 10000;
+static long iterations = 100000;
+
+static int set_lock(int fd, int cmd, short type, off_t start, off_t len)
+{
+	struct flock fl = {
+		.l_type = type,
+		.l_whence = SEEK_SET,
+		.l_start = start,
+		.l_len = len,
+	};
+
+	return fcntl(fd, cmd, &fl);
+}
+
+static double now_ns(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+static void report(const char *what, double start, long ops)
+{
+	printf("%-28s %10ld ops %10.1f ns/op\n", what, ops,
+	       (now_ns() - start) / ops);
+}
+
+static int bench_conflicts(int fd)
+{
+	double start;
+	struct flock fl;
+	long i;
+
+	start = now_ns();
+	for (i = 0; i < iterations; i++) {
+		off_t off = 2 * (i % nr_locks) + 1;
+
+		if (set_lock(fd, F_SETLK, F_WRLCK, off, 1) ||
+		    set_lock(fd, F_SETLK, F_UNLCK, off, 1)) {
+			fprintf(stderr, "lock of free byte %lld: %s\n",
+				(long long)off, strerror(errno));
+			return -1;
+		}
+	}
+	report("lock+unlock free byte", start, iterations);
+
+	start = now_ns();
+	for (i = 0; i < iterations; i++) {
+		off_t off = 2 * (i % nr_locks);
+
+		memset(&fl, 0, sizeof(fl));
+		fl.l_type = F_RDLCK;
+		fl.l_whence = SEEK_SET;
+		fl.l_start = off;
+		fl.l_len = 1;
+		if (fcntl(fd, F_GETLK, &fl)) {
+			perror("F_GETLK");
+			return -1;
+		}
+		if (fl.l_type != F_WRLCK || fl.l_start != off || fl.l_len != 1) {
+			fprintf(stderr, "F_GETLK at %lld: type %d start %lld len %lld\n",
+				(long long)off, fl.l_type,
+				(long long)fl.l_start, (long long)fl.l_len);
+			return -1;
+		}
+	}
+	report("F_GETLK held byte", start, iterations);
+
+	if (set_lock(fd, F_SETLK, F_WRLCK, 0, 2 * nr_locks) == 0 ||
+	    (errno != EAGAIN && errno != EACCES)) {
+		fprintf(stderr, "lock over held bytes did not conflict\n");
+		return -1;
+	}
+	return 0;
+}
+
+static int bench_coalesce(int fd)
+{
+	off_t base = 4 * nr_locks;
+	struct flock fl;
+	int status;
+	double start;
+	long i;
+
+	start = now_ns();
+	for (i = nr_locks - 1; i >= 0; i--) {
+		if (set_lock(fd, F_SETLK, F_RDLCK, base + 2 * i, 1)) {
+			perror("F_SETLK own lock");
+			return -1;
+		}
+	}
+	report("lock own scattered bytes", start, nr_locks);
+
+	start = now_ns();
+	if (set_lock(fd, F_SETLK, F_RDLCK, base, 2 * nr_locks)) {
+		perror("F_SETLK merge");
+		return -1;
+	}
+	report("merge own locks", start, 1);
+
+	/* A write lock from another process must see one merged lock */
+	if (fork() == 0) {
+		memset(&fl, 0, sizeof(fl));
+		fl.l_type = F_WRLCK;
+		fl.l_whence = SEEK_SET;
+		fl.l_start = base + 1;
+		fl.l_len = 1;
+		if (fcntl(fd, F_GETLK, &fl) || fl.l_type != F_RDLCK ||
+		    fl.l_start != base || fl.l_len != 2 * nr_locks)
+			_exit(1);
+		_exit(0);
+	}
+	wait(&status);
+	if (!WIFEXITED(status) || WEXITSTATUS(status)) {
+		fprintf(stderr, "own locks were not merged\n");
+		return -1;
+	}
+
+	return set_lock(fd, F_SETLK, F_UNLCK, base, 0);
+}
+
+int main(int argc, char **argv)
+{
+	char path[] = "/tmp/posix_locks_bench.XXXXXX";
+	int ready[2], status, fd, ret = 1;
+	pid_t child;
+	char c;
+	long i;
+
+	if (argc > 1)
+		nr_locks = strtol(argv[1], NULL, 0);
+	if (argc > 2)
+		iterations = strtol(argv[2], NULL, 0);
+	if (nr_locks <= 0 || iterations <= 0) {
+		fprintf(stderr, "usage: %s [NR_LOCKS [ITERATIONS]]\n", argv[0]);
+		return 1;
+	}
+
+	fd = mkstemp(path);
+	if (fd < 0) {
+		perror("mkstemp");
+		return 1;
+	}
+	unlink(path);
+
+	if (pipe(ready)) {
+		perror("pipe");
+		return 1;
+	}
+
+	child = fork();
+	if (child < 0) {
+		perror("fork");
+		return 1;
+	}
+	if (child == 0) {
+		for (i = 0; i < nr_locks; i++) {
+			if (set_lock(fd, F_SETLK, F_WRLCK, 2 * i, 1)) {
+				perror("child F_SETLK");
+				_exit(1);
+			}
+		}
+		c = 0;
+		if (write(ready[1], &c, 1) != 1)
+			_exit(1);
+		pause();
+		_exit(0);
+	}
+
+	close(ready[1]);
+	if (read(ready[0], &c, 1) != 1) {
+		fprintf(stderr, "child failed to take its locks\n");
+		goto out;
+	}
+
+	printf("%ld locks held by another process\n", nr_locks);
+	if (bench_conflicts(fd) || bench_coalesce(fd))
+		goto out;
+	ret = 0;
+out:
+	kill(child, SIGTERM);
+	waitpid(child, &status, 0);
+	close(fd);
+	printf("%s\n", ret ? "FAIL" : "PASS");
+	return ret;
+}
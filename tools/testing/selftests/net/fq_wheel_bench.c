@@ -0,0 +1,452 @@
+// SPDX-License-Identifier: GPL-2.0
+/*
+ * Benchmark for the fq qdisc with many paced flows, comparing the default
+ * rbtree layout with the timer wheel (TCA_FQ_TIMER_WHEEL).
+ *
+ * In a new network namespace, a dummy device gets an fq root qdisc built
+ * through raw rtnetlink, so no iproute2 support for the attribute is
+ * needed. NR_FLOWS connected UDP sockets, each paced to RATE_KBPS with
+ * SO_MAX_PACING_RATE, then send NR_PKTS packets each in round robin. The
+ * program reports the time to enqueue everything, the time until the
+ * qdisc drained, and the fq throttled and unthrottle latency statistics.
+ * All packets must leave the qdisc without drops, so the program doubles
+ * as a functional test of both modes.
+ *
+ * Usage: fq_wheel_bench [NR_FLOWS [NR_PKTS [RATE_KBPS]]]
+ */
+#define _GNU_SOURCE
+#include <errno.h>
+#include <net/if.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include <sched.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/resource.h>
+#include <sys/socket.h>
+#include <linux/if_link.h>
+#include <linux/netlink.h>
+#include <linux/pkt_sched.h>
+#include <linux/rtnetlink.h>
+
+#include "../kselftest.h"
+
+#ifndef SO_MAX_PACING_RATE
+#define SO_MAX_PACING_RATE 47
+#endif
+
+#define DEV_NAME	"fqb0"
+#define PKT_SIZE	1000
+#define DRAIN_TIMEOUT_MS 60000
+
+static long nr_flows = 1000;
+static long nr_pkts = 20;
+static long rate_kbps = 1000;
+
+static int rtnl;
+static __u32 seq;
+
+struct fq_stats {
+	__u32 qlen;
+	__u32 drops;
+	__u32 packets;
+	int wheel;
+	struct tc_fq_qd_stats app;
+};
+
+static double now_ms(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1e3 + ts.tv_nsec / 1e6;
+}
+
+static void addattr(struct nlmsghdr *nh, int type, const void *data, int len)
+{
+	struct rtattr *rta = (void *)nh + NLMSG_ALIGN(nh->nlmsg_len);
+
+	rta->rta_type = type;
+	rta->rta_len = RTA_LENGTH(len);
+	if (len)
+		memcpy(RTA_DATA(rta), data, len);
+	nh->nlmsg_len = NLMSG_ALIGN(nh->nlmsg_len) + RTA_ALIGN(rta->rta_len);
+}
+
+static struct rtattr *nest_start(struct nlmsghdr *nh, int type)
+{
+	struct rtattr *rta = (void *)nh + NLMSG_ALIGN(nh->nlmsg_len);
+
+	addattr(nh, type, NULL, 0);
+	return rta;
+}
+
+static void nest_end(struct nlmsghdr *nh, struct rtattr *rta)
+{
+	rta->rta_len = (void *)nh + nh->nlmsg_len - (void *)rta;
+}
+
+/* Send one request and wait for its ack, returns 0 or -1 with errno set */
+static int nl_talk(struct nlmsghdr *nh)
+{
+	char buf[4096];
+	struct nlmsghdr *h;
+	int len;
+
+	nh->nlmsg_flags |= NLM_F_REQUEST | NLM_F_ACK;
+	nh->nlmsg_seq = ++seq;
+	if (send(rtnl, nh, nh->nlmsg_len, 0) < 0)
+		return -1;
+
+	for (;;) {
+		len = recv(rtnl, buf, sizeof(buf), 0);
+		if (len < 0)
+			return -1;
+		for (h = (void *)buf; NLMSG_OK(h, len); h = NLMSG_NEXT(h, len)) {
+			struct nlmsgerr *err = NLMSG_DATA(h);
+
+			if (h->nlmsg_seq != seq || h->nlmsg_type != NLMSG_ERROR)
+				continue;
+			if (err->error) {
+				errno = -err->error;
+				return -1;
+			}
+			return 0;
+		}
+	}
+}
+
+static int create_dummy(void)
+{
+	struct {
+		struct nlmsghdr nh;
+		struct ifinfomsg ifi;
+		char attrs[256];
+	} req = {};
+	struct rtattr *linkinfo;
+
+	req.nh.nlmsg_len = NLMSG_LENGTH(sizeof(req.ifi));
+	req.nh.nlmsg_type = RTM_NEWLINK;
+	req.nh.nlmsg_flags = NLM_F_CREATE | NLM_F_EXCL;
+	req.ifi.ifi_family = AF_UNSPEC;
+	req.ifi.ifi_flags = IFF_UP;
+	req.ifi.ifi_change = IFF_UP;
+	addattr(&req.nh, IFLA_IFNAME, DEV_NAME, sizeof(DEV_NAME));
+	linkinfo = nest_start(&req.nh, IFLA_LINKINFO);
+	addattr(&req.nh, IFLA_INFO_KIND, "dummy", sizeof("dummy"));
+	nest_end(&req.nh, linkinfo);
+
+	if (nl_talk(&req.nh)) {
+		int err = errno;
+
+		perror("RTM_NEWLINK " DEV_NAME);
+		return -err;
+	}
+	return if_nametoindex(DEV_NAME);
+}
+
+static int add_address(int ifindex)
+{
+	struct {
+		struct nlmsghdr nh;
+		struct ifaddrmsg ifa;
+		char attrs[64];
+	} req = {};
+	struct in_addr addr;
+
+	inet_pton(AF_INET, "10.66.0.1", &addr);
+	req.nh.nlmsg_len = NLMSG_LENGTH(sizeof(req.ifa));
+	req.nh.nlmsg_type = RTM_NEWADDR;
+	req.nh.nlmsg_flags = NLM_F_CREATE | NLM_F_EXCL;
+	req.ifa.ifa_family = AF_INET;
+	req.ifa.ifa_prefixlen = 24;
+	req.ifa.ifa_index = ifindex;
+	addattr(&req.nh, IFA_LOCAL, &addr, sizeof(addr));
+	addattr(&req.nh, IFA_ADDRESS, &addr, sizeof(addr));
+
+	if (nl_talk(&req.nh)) {
+		perror("RTM_NEWADDR");
+		return -1;
+	}
+	return 0;
+}
+
+/* Replace the root qdisc of @ifindex by fq when @kind is set, else delete it */
+static int set_root_qdisc(int ifindex, const char *kind, int wheel)
+{
+	struct {
+		struct nlmsghdr nh;
+		struct tcmsg tcm;
+		char attrs[256];
+	} req = {};
+	__u32 plimit = nr_flows * nr_pkts + 1000;
+	__u32 flow_plimit = nr_pkts + 100;
+	__u8 use_wheel = wheel;
+	struct rtattr *opts;
+
+	req.nh.nlmsg_len = NLMSG_LENGTH(sizeof(req.tcm));
+	req.tcm.tcm_family = AF_UNSPEC;
+	req.tcm.tcm_ifindex = ifindex;
+	req.tcm.tcm_handle = 0x10000;
+	req.tcm.tcm_parent = TC_H_ROOT;
+
+	if (!kind) {
+		req.nh.nlmsg_type = RTM_DELQDISC;
+		if (nl_talk(&req.nh)) {
+			perror("RTM_DELQDISC");
+			return -1;
+		}
+		return 0;
+	}
+
+	req.nh.nlmsg_type = RTM_NEWQDISC;
+	req.nh.nlmsg_flags = NLM_F_CREATE | NLM_F_EXCL;
+	addattr(&req.nh, TCA_KIND, kind, strlen(kind) + 1);
+	opts = nest_start(&req.nh, TCA_OPTIONS);
+	addattr(&req.nh, TCA_FQ_PLIMIT, &plimit, sizeof(plimit));
+	addattr(&req.nh, TCA_FQ_FLOW_PLIMIT, &flow_plimit, sizeof(flow_plimit));
+	addattr(&req.nh, TCA_FQ_TIMER_WHEEL, &use_wheel, sizeof(use_wheel));
+	nest_end(&req.nh, opts);
+
+	if (nl_talk(&req.nh)) {
+		perror("RTM_NEWQDISC fq");
+		return -1;
+	}
+	return 0;
+}
+
+static void parse_qdisc(struct tcmsg *tcm, int len, struct fq_stats *st)
+{
+	struct rtattr *rta = (void *)tcm + NLMSG_ALIGN(sizeof(*tcm));
+	struct rtattr *opt;
+	int optlen;
+
+	len -= NLMSG_ALIGN(sizeof(*tcm));
+	for (; RTA_OK(rta, len); rta = RTA_NEXT(rta, len)) {
+		switch (rta->rta_type) {
+		case TCA_STATS:
+			if (RTA_PAYLOAD(rta) >= sizeof(struct tc_stats)) {
+				struct tc_stats *ts = RTA_DATA(rta);
+
+				st->qlen = ts->qlen;
+				st->drops = ts->drops;
+				st->packets = ts->packets;
+			}
+			break;
+		case TCA_XSTATS:
+			memcpy(&st->app, RTA_DATA(rta),
+			       RTA_PAYLOAD(rta) < sizeof(st->app) ?
+			       RTA_PAYLOAD(rta) : sizeof(st->app));
+			break;
+		case TCA_OPTIONS:
+			opt = RTA_DATA(rta);
+			optlen = RTA_PAYLOAD(rta);
+			for (; RTA_OK(opt, optlen); opt = RTA_NEXT(opt, optlen))
+				if (opt->rta_type == TCA_FQ_TIMER_WHEEL)
+					st->wheel = *(__u8 *)RTA_DATA(opt);
+			break;
+		}
+	}
+}
+
+static int get_stats(int ifindex, struct fq_stats *st)
+{
+	struct {
+		struct nlmsghdr nh;
+		struct tcmsg tcm;
+	} req = {};
+	static char buf[32768];
+	struct nlmsghdr *h;
+	int len, found = 0;
+
+	memset(st, 0, sizeof(*st));
+	st->wheel = -1;
+	req.nh.nlmsg_len = NLMSG_LENGTH(sizeof(req.tcm));
+	req.nh.nlmsg_type = RTM_GETQDISC;
+	req.nh.nlmsg_flags = NLM_F_REQUEST | NLM_F_DUMP;
+	req.nh.nlmsg_seq = ++seq;
+	req.tcm.tcm_family = AF_UNSPEC;
+	if (send(rtnl, &req, req.nh.nlmsg_len, 0) < 0) {
+		perror("RTM_GETQDISC");
+		return -1;
+	}
+
+	for (;;) {
+		len = recv(rtnl, buf, sizeof(buf), 0);
+		if (len < 0) {
+			perror("recv qdisc dump");
+			return -1;
+		}
+		for (h = (void *)buf; NLMSG_OK(h, len); h = NLMSG_NEXT(h, len)) {
+			struct tcmsg *tcm = NLMSG_DATA(h);
+
+			if (h->nlmsg_seq != seq)
+				continue;
+			if (h->nlmsg_type == NLMSG_DONE)
+				return found ? 0 : -1;
+			if (h->nlmsg_type == NLMSG_ERROR) {
+				fprintf(stderr, "qdisc dump failed\n");
+				return -1;
+			}
+			if (h->nlmsg_type != RTM_NEWQDISC ||
+			    tcm->tcm_ifindex != ifindex ||
+			    tcm->tcm_parent != TC_H_ROOT)
+				continue;
+			parse_qdisc(tcm, NLMSG_PAYLOAD(h, 0), st);
+			found = 1;
+		}
+	}
+}
+
+static int open_flows(int *fds)
+{
+	struct sockaddr_in dst = {
+		.sin_family = AF_INET,
+		.sin_port = htons(9),
+	};
+	unsigned int rate = rate_kbps * 1000 / 8;
+	long i;
+
+	inet_pton(AF_INET, "10.66.0.2", &dst.sin_addr);
+	for (i = 0; i < nr_flows; i++) {
+		fds[i] = socket(AF_INET, SOCK_DGRAM, 0);
+		if (fds[i] < 0) {
+			perror("socket");
+			return -1;
+		}
+		/* fq only paces sockets it can map to a flow, i.e. connected */
+		if (setsockopt(fds[i], SOL_SOCKET, SO_MAX_PACING_RATE,
+			       &rate, sizeof(rate)) ||
+		    connect(fds[i], (void *)&dst, sizeof(dst))) {
+			perror("UDP flow setup");
+			return -1;
+		}
+	}
+	return 0;
+}
+
+static int run(int ifindex, int wheel)
+{
+	const char *mode = wheel ? "wheel" : "rbtree";
+	char pkt[PKT_SIZE] = {};
+	double start, sent, drained;
+	struct fq_stats st;
+	long i, j, expected = nr_flows * nr_pkts;
+	int *fds, ret = -1;
+
+	fds = calloc(nr_flows, sizeof(*fds));
+	if (!fds)
+		return -1;
+	for (i = 0; i < nr_flows; i++)
+		fds[i] = -1;
+
+	if (set_root_qdisc(ifindex, "fq", wheel))
+		goto out;
+	if (get_stats(ifindex, &st))
+		goto out_qdisc;
+	if (wheel && st.wheel != 1) {
+		printf("%-8s timer wheel not supported, skipped\n", mode);
+		ret = KSFT_SKIP;
+		goto out_qdisc;
+	}
+	if (open_flows(fds))
+		goto out_qdisc;
+
+	start = now_ms();
+	for (j = 0; j < nr_pkts; j++) {
+		for (i = 0; i < nr_flows; i++) {
+			if (send(fds[i], pkt, sizeof(pkt), 0) != sizeof(pkt)) {
+				perror("send");
+				goto out_qdisc;
+			}
+		}
+	}
+	sent = now_ms();
+
+	do {
+		if (get_stats(ifindex, &st))
+			goto out_qdisc;
+		drained = now_ms();
+		if (drained - sent > DRAIN_TIMEOUT_MS) {
+			fprintf(stderr, "%s: %u packets still queued\n",
+				mode, st.qlen);
+			goto out_qdisc;
+		}
+		if (st.qlen)
+			usleep(1000);
+	} while (st.qlen);
+
+	printf("%-8s %6ld flows %10.1f ms enqueue %10.1f ms drain %10llu throttled %8u ns unthrottle latency\n",
+	       mode, nr_flows, sent - start, drained - sent,
+	       (unsigned long long)st.app.throttled,
+	       st.app.unthrottle_latency_ns);
+
+	if (st.packets != expected || st.drops) {
+		fprintf(stderr, "%s: %u of %ld packets sent, %u drops\n",
+			mode, st.packets, expected, st.drops);
+		goto out_qdisc;
+	}
+	ret = 0;
+
+out_qdisc:
+	set_root_qdisc(ifindex, NULL, 0);
+out:
+	for (i = 0; i < nr_flows; i++)
+		if (fds[i] >= 0)
+			close(fds[i]);
+	free(fds);
+	return ret;
+}
+
+int main(int argc, char **argv)
+{
+	struct sockaddr_nl nladdr = { .nl_family = AF_NETLINK };
+	struct rlimit rlim;
+	int ifindex, ret;
+
+	if (argc > 1)
+		nr_flows = strtol(argv[1], NULL, 0);
+	if (argc > 2)
+		nr_pkts = strtol(argv[2], NULL, 0);
+	if (argc > 3)
+		rate_kbps = strtol(argv[3], NULL, 0);
+	if (nr_flows <= 0 || nr_pkts <= 0 || rate_kbps <= 0) {
+		fprintf(stderr, "usage: %s [NR_FLOWS [NR_PKTS [RATE_KBPS]]]\n",
+			argv[0]);
+		return 1;
+	}
+
+	if (unshare(CLONE_NEWNET)) {
+		fprintf(stderr, "unshare(CLONE_NEWNET): %s, skipped\n",
+			strerror(errno));
+		return KSFT_SKIP;
+	}
+
+	rlim.rlim_cur = rlim.rlim_max = nr_flows + 64;
+	if (setrlimit(RLIMIT_NOFILE, &rlim)) {
+		perror("setrlimit(RLIMIT_NOFILE)");
+		return 1;
+	}
+
+	rtnl = socket(AF_NETLINK, SOCK_RAW | SOCK_CLOEXEC, NETLINK_ROUTE);
+	if (rtnl < 0 || bind(rtnl, (void *)&nladdr, sizeof(nladdr))) {
+		perror("NETLINK_ROUTE");
+		return 1;
+	}
+
+	ifindex = create_dummy();
+	if (ifindex == -EOPNOTSUPP)
+		return KSFT_SKIP;
+	if (ifindex <= 0 || add_address(ifindex))
+		return 1;
+
+	ret = run(ifindex, 0);
+	if (!ret)
+		ret = run(ifindex, 1);
+
+	printf("%s\n", ret == KSFT_SKIP ? "SKIP" : ret ? "FAIL" : "PASS");
+	return ret == KSFT_SKIP ? KSFT_SKIP : ret ? 1 : 0;
+}